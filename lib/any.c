@@ -18,10 +18,16 @@
  *
  * @section DESCRIPTION
  *
- * The any data type represents any data type in scripting context: int, long, double, string, or object (void *).
+ * The any data type represents any data type in scripting context: int, long, double, string, object (void *),
+ * boolean, null, array of anys, or map.
  *
  */
+#include <string.h>
+#include <limits.h>
+#include <math.h>
 #include "any.h"
+#include "hash.h"
+#include "number.h"
 
 any any_new()
 {
@@ -29,6 +35,15 @@ any any_new()
 	return anyone;
 }
 
+/**
+* Allocates an any with room for an inline string of 'size' bytes plus the terminating zero.
+*/
+any any_new_inline(size_t size)
+{
+	any anyone=(any)object_new(sizeof(_any)+size+1);
+	return anyone;
+}
+
 any any_new_int(int i)
 {
 	any anyone=any_new();
@@ -69,3 +84,241 @@ any any_new_object(object obj)
 	return anyone;
 }
 
+any any_new_bool(bool bln)
+{
+	any anyone=any_new();
+	anyone->type=TYPE_BOOL;
+	anyone->bln=bln;
+	return anyone;
+}
+
+any any_new_null()
+{
+	any anyone=any_new();
+	anyone->type=TYPE_NULL;
+	return anyone;
+}
+
+/**
+* Creates an array any over 'size' anys. The items are not copied.
+*
+* @param items the items of the array.
+* @param size the number of items.
+* @return A pointer to the new any.
+*/
+any any_new_array(manyany items, size_t size)
+{
+	any anyone=any_new();
+	any_array arr=(any_array)object_new(sizeof(_any_array));
+	arr->items=items;
+	arr->size=size;
+	anyone->type=TYPE_ARRAY;
+	anyone->arr=arr;
+	return anyone;
+}
+
+/**
+* Creates a map any; see map.h.
+*
+* @param map the map.
+* @return A pointer to the new any.
+*/
+any any_new_map(struct _map *map)
+{
+	any anyone=any_new();
+	anyone->type=TYPE_MAP;
+	anyone->map=map;
+	return anyone;
+}
+
+/**
+* Creates a record any; see shape.h.
+*
+* @param rec the record.
+* @return A pointer to the new any.
+*/
+any any_new_record(struct _record *rec)
+{
+	any anyone=any_new();
+	anyone->type=TYPE_RECORD;
+	anyone->rec=rec;
+	return anyone;
+}
+
+/**
+* Creates a string any holding its own copy of a string.
+* Unlike any_new_string(), which refers to the string passed in,
+* later changes to 'str' do not show through.
+* Strings of up to ANY_INLINE_CAPACITY bytes are stored inside the any, in one allocation.
+*
+* @param str the string to copy.
+* @return A pointer to the new any.
+*/
+any any_new_string_copy(string str)
+{
+	return any_new_string_bytes(str,strlen(str));
+}
+
+/**
+* Creates a string any from the 'size' bytes at 'data', which need not be null-terminated.
+* Strings of up to ANY_INLINE_CAPACITY bytes are stored inside the any, in one allocation;
+* longer ones get a string of their own.
+*
+* @param data the bytes of the string.
+* @param size the number of bytes.
+* @return A pointer to the new any.
+*/
+any any_new_string_bytes(const char *data, size_t size)
+{
+	any anyone;
+	if(size<=ANY_INLINE_CAPACITY)
+	{
+		anyone=any_new_inline(size);
+		anyone->str=anyone->inline_str;
+	}
+	else
+	{
+		anyone=any_new();
+		anyone->str=string_new(size);
+	}
+	anyone->type=TYPE_STRING;
+	memcpy(anyone->str,data,size);
+	anyone->str[size]=0;
+	return anyone;
+}
+
+/**
+* Returns the string held by a string any, wherever it is stored.
+* Equivalent to reading anyone->str.
+*
+* @param anyone the string any.
+* @return the string.
+*/
+string any_string(any anyone)
+{
+	return anyone->str;
+}
+
+/**
+* Checks if a string any stores its string inline.
+*
+* @param anyone the string any.
+* @return true, if the string lives inside the any; false, if it is a separate allocation.
+*/
+bool any_string_is_inline(any anyone)
+{
+	return anyone->type==TYPE_STRING && anyone->str==anyone->inline_str;
+}
+
+/**
+* Computes the hash value of an any.
+* Integers hash by value, so that an int and a long holding the same number hash alike;
+* doubles hash by bit pattern, with -0.0 folded onto 0.0 and every NaN onto one NaN; strings hash by content;
+* booleans and null hash by value; objects, arrays, maps and records hash by address.
+*
+* @param anyone the any to hash.
+* @return the 64-bit hash value.
+*/
+uint64_t any_hash(any anyone)
+{
+	double dbl;
+	uint64_t bits;
+	switch(anyone->type)
+	{
+		case TYPE_INT: return hash_uint64((uint64_t)(long)anyone->i);
+		case TYPE_LONG: return hash_uint64((uint64_t)anyone->lng);
+		case TYPE_DOUBLE:
+			dbl=anyone->dbl==0.0?0.0:anyone->dbl;
+			if(dbl!=dbl) dbl=NAN;
+			memcpy(&bits,&dbl,sizeof(bits));
+			return hash_uint64(bits);
+		case TYPE_STRING: return string_hash(anyone->str);
+		case TYPE_BOOL: return hash_uint64(anyone->bln?1:0);
+		case TYPE_NULL: return hash_uint64(0);
+		default: return hash_uint64((uint64_t)(size_t)anyone->obj);
+	}
+}
+
+/**
+* Checks if two anys hold the same value, consistently with any_hash():
+* an int and a long are equal when they hold the same number; doubles are compared by value,
+* except that NaN equals NaN, so that it can be found as a key; strings are compared by content;
+* booleans by value, and all nulls are equal; objects, arrays, maps and records are compared by address.
+*
+* @param a the first any.
+* @param b the second any.
+* @return true if a is equal to b; false, if not.
+*/
+bool any_equal(any a, any b)
+{
+	long la, lb;
+	if(a==b) return true;
+	if(a==NULL || b==NULL) return false;
+	if((a->type==TYPE_INT || a->type==TYPE_LONG) && (b->type==TYPE_INT || b->type==TYPE_LONG))
+	{
+		la=a->type==TYPE_INT?a->i:a->lng;
+		lb=b->type==TYPE_INT?b->i:b->lng;
+		return la==lb;
+	}
+	if(a->type!=b->type) return false;
+	switch(a->type)
+	{
+		case TYPE_DOUBLE: return a->dbl==b->dbl || (a->dbl!=a->dbl && b->dbl!=b->dbl);
+		case TYPE_STRING: return string_equal(a->str,b->str);
+		case TYPE_BOOL: return a->bln==b->bln;
+		case TYPE_NULL: return true;
+		default: return a->obj==b->obj;
+	}
+}
+
+/**
+* Parses a number from the 'size' bytes at 'data', which need not be null-terminated,
+* into the narrowest any that holds it: an int, then a long, and otherwise a double.
+* Integers too large for a long are returned as doubles.
+* Parsing does not depend on the locale; see string_to_long() and string_to_double().
+*
+* @param data the text to parse.
+* @param size the number of bytes.
+* @return A pointer to the new any; or NULL if the text is not a number.
+*/
+any any_parse_number(const char *data, size_t size)
+{
+	long lng;
+	double dbl;
+	if(string_to_long(data,size,&lng))
+	{
+		if(lng>=INT_MIN && lng<=INT_MAX) return any_new_int((int)lng);
+		return any_new_long(lng);
+	}
+	if(string_to_double(data,size,&dbl)) return any_new_double(dbl);
+	return NULL;
+}
+
+/**
+* Converts an any to a new string.
+* Numbers are written in decimal, doubles with the fewest digits that read back as the same value;
+* see number_write_double(). Strings are copied. Booleans become "true" or "false", and null "null".
+* Objects, arrays, maps and records are written as their address.
+*
+* @param anyone the any to convert.
+* @return A new string representing the any.
+*/
+string any_to_string(any anyone)
+{
+	char digits[NUMBER_MAX_LENGTH];
+	size_t size;
+	switch(anyone->type)
+	{
+		case TYPE_INT: size=number_write_long(digits,anyone->i); break;
+		case TYPE_LONG: size=number_write_long(digits,anyone->lng); break;
+		case TYPE_DOUBLE: size=number_write_double(digits,anyone->dbl); break;
+		case TYPE_STRING: return string_new_copy(anyone->str);
+		case TYPE_BOOL: return string_new_copy(anyone->bln?"true":"false");
+		case TYPE_NULL: return string_new_copy("null");
+		default: return string_format("%p",anyone->obj);
+	}
+	string s=string_new(size);
+	memcpy(s,digits,size);
+	s[size]=0;
+	return s;
+}
@@ -18,12 +18,14 @@
  *
  * @section DESCRIPTION
  *
- * The any data type represents any data type in scripting context: int, long, double, string, or object (void *).
+ * The any data type represents any data type in scripting context: int, long, double, string, object (void *),
+ * boolean, null, array of anys, or map.
  *
  */
 #ifndef _ANY_H
 #define _ANY_H
 
+#include <stdint.h>
 #include "object.h"
 #include "string_utf8.h"
 
@@ -38,10 +40,22 @@ enum _vartype
 	, TYPE_DOUBLE
 	, TYPE_STRING
 	, TYPE_OBJECT
+	, TYPE_BOOL
+	, TYPE_NULL
+	, TYPE_ARRAY
+	, TYPE_MAP
+	, TYPE_RECORD
 };
 
 typedef enum _vartype vartype;
 
+/* strings up to this many bytes are stored inside the any itself */
+#define ANY_INLINE_CAPACITY 15
+
+struct _any_array;
+struct _map;
+struct _record;
+
 typedef struct
 {
 	vartype type;
@@ -52,19 +66,46 @@ typedef struct
 		double dbl;
 		string str;
 		object obj;
+		bool bln;
+		struct _any_array *arr;
+		struct _map *map; //see map.h
+		struct _record *rec; //see shape.h
 	};
+	//only allocated for inline strings; 'str' then points here.
+	char inline_str[];
 } _any;
 
 typedef _any* any;
 
 typedef any* manyany;
 
+typedef struct _any_array
+{
+	manyany items;
+	size_t size;
+} _any_array;
+
+typedef _any_array* any_array;
+
 
 any any_new_int(int i);
 any any_new_long(long lng);
 any any_new_double(double dbl);
 any any_new_string(string str);
 any any_new_object(object obj);
+any any_new_bool(bool bln);
+any any_new_null();
+any any_new_array(manyany items, size_t size);
+any any_new_map(struct _map *map);
+any any_new_record(struct _record *rec);
+any any_new_string_copy(string str);
+any any_new_string_bytes(const char *data, size_t size);
+string any_string(any anyone);
+bool any_string_is_inline(any anyone);
+uint64_t any_hash(any anyone);
+bool any_equal(any a, any b);
+any any_parse_number(const char *data, size_t size);
+string any_to_string(any anyone);
 
 #ifdef __cplusplus
 	}
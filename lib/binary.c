@@ -0,0 +1,777 @@
+/**
+ *
+ * libscriptify
+ *
+ * @author  Erik Poupaert <erik@sankuru.biz>
+ *
+ * @section LICENSE
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU LGPL as
+ * published by the Free Software Foundation; either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * LGPL for more details at: http://www.gnu.org/licenses/lgpl.html
+ *
+ * @section DESCRIPTION
+ *
+ * A compact binary encoding of any values, for storing and passing them between processes.
+ * Documents are read in place, for instance from a mapped file: values are only decoded when they are used.
+ *
+ */
+#include <stdlib.h>
+#include <string.h>
+#include "object.h"
+#include "map.h"
+#include "shape.h"
+#include "binary.h"
+
+//PRIVATE
+
+/*
+* Layout of a document; all fixed-size integers are little-endian.
+*
+*   header:         "SCRB", the version, 3 zero bytes
+*   values:         every array and map comes after its items, so the root value comes last
+*   strings:        every distinct string once: varint length, the bytes, a zero byte
+*   string offsets: the offset of every string, 'string width' bytes each
+*   trailer:        root offset (8), offset of the string offsets (8), string count (8),
+*                   string width (1), 3 zero bytes, "SCRB"
+*
+* A value starts with a tag byte: its kind in the low 4 bits, and for arrays and maps,
+* the width of their offsets in bits 4-5 (1, 2, 4 or 8 bytes) and, for maps, BINARY_INDEXED.
+*
+*   null, false, true: the tag only
+*   int, long:         zigzag varint
+*   double:            8 bytes
+*   string:            varint index in the string table
+*   array:             varint count; per item, the distance back from the array to the item
+*   map:               varint count; per entry, the distances back to the key and to the value;
+*                      if indexed, then the entry numbers sorted by key
+*/
+
+#define BINARY_MAGIC "SCRB"
+#define BINARY_HEADER_SIZE 8
+#define BINARY_TRAILER_SIZE 32
+/* maps with at least this many entries, all with string keys, get a sorted index of their keys */
+#define BINARY_INDEX_MIN 8
+#define BINARY_INDEXED 0x40
+#define BINARY_KIND(tag) ((tag)&0x0f)
+#define BINARY_WIDTH(tag) (1<<(((tag)>>4)&3))
+
+enum
+{
+	  BINARY_NULL
+	, BINARY_FALSE
+	, BINARY_TRUE
+	, BINARY_INT
+	, BINARY_LONG
+	, BINARY_DOUBLE
+	, BINARY_STRING
+	, BINARY_ARRAY
+	, BINARY_MAP
+};
+
+typedef struct
+{
+	buffer out;
+	size_t base; //where the document starts in the buffer
+	map strings; //every string written, with its index in the string table
+	string *table;
+	size_t string_count;
+	size_t string_capacity;
+	int depth;
+	void *path[BINARY_MAX_DEPTH]; //the arrays and maps being written, to detect cycles
+} _binary_writer;
+
+typedef _binary_writer* binary_writer;
+
+typedef struct
+{
+	binary_writer writer;
+	uint64_t *offsets; //key and value of every entry
+	string *keys; //NULL for keys that are not strings
+	size_t count;
+	size_t capacity;
+	bool failed;
+} binary_entries;
+
+typedef struct
+{
+	string key;
+	uint64_t entry;
+} binary_sorted;
+
+static void binary_put_varint(buffer out, uint64_t value)
+{
+	unsigned char bytes[10];
+	size_t n=0;
+	while(value>=0x80)
+	{
+		bytes[n++]=(unsigned char)(value|0x80);
+		value>>=7;
+	}
+	bytes[n++]=(unsigned char)value;
+	buffer_append(out,(const char *)bytes,n);
+}
+
+static void binary_put_fixed(buffer out, uint64_t value, int width)
+{
+	unsigned char bytes[8];
+	int i;
+	for(i=0; i<width; i++) bytes[i]=(unsigned char)(value>>(8*i));
+	buffer_append(out,(const char *)bytes,(size_t)width);
+}
+
+static uint64_t binary_zigzag(long value)
+{
+	return ((uint64_t)value<<1)^(uint64_t)(value>>63);
+}
+
+static int binary_width_code(uint64_t max)
+{
+	if(max<=0xff) return 0;
+	if(max<=0xffff) return 1;
+	if(max<=0xffffffffULL) return 2;
+	return 3;
+}
+
+static uint64_t binary_position(binary_writer w)
+{
+	return (uint64_t)(w->out->size-w->base);
+}
+
+static uint64_t binary_string_index(binary_writer w, string str)
+{
+	any index=map_get_string(w->strings,str);
+	if(index!=NULL) return (uint64_t)index->lng;
+	if(w->string_count==w->string_capacity)
+	{
+		size_t capacity=w->string_capacity>0?2*w->string_capacity:64;
+		string *table=(string *)object_new(capacity*sizeof(string));
+		if(w->string_count>0) memcpy(table,w->table,w->string_count*sizeof(string));
+		w->table=table;
+		w->string_capacity=capacity;
+	}
+	w->table[w->string_count]=str;
+	map_put(w->strings,any_new_string(str),any_new_long((long)w->string_count));
+	return w->string_count++;
+}
+
+static bool binary_enter(binary_writer w, void *container)
+{
+	int i;
+	if(w->depth>=BINARY_MAX_DEPTH) return false;
+	for(i=0; i<w->depth; i++)
+		if(w->path[i]==container) return false;
+	w->path[w->depth++]=container;
+	return true;
+}
+
+static bool binary_write_value(binary_writer w, any value, uint64_t *offset);
+
+static bool binary_write_array(binary_writer w, any_array arr, uint64_t *offset)
+{
+	uint64_t *items=(uint64_t *)object_new_atomic((arr->size+1)*sizeof(uint64_t));
+	uint64_t start, max=0;
+	size_t i;
+	int code;
+	if(!binary_enter(w,arr)) return false;
+	for(i=0; i<arr->size; i++)
+		if(!binary_write_value(w,arr->items[i],&items[i])) return false;
+	start=binary_position(w);
+	for(i=0; i<arr->size; i++)
+		if(start-items[i]>max) max=start-items[i];
+	code=binary_width_code(max);
+	buffer_reserve(w->out,11+arr->size*((size_t)1<<code));
+	buffer_appendchar(w->out,(char)(BINARY_ARRAY|code<<4));
+	binary_put_varint(w->out,arr->size);
+	for(i=0; i<arr->size; i++) binary_put_fixed(w->out,start-items[i],1<<code);
+	w->depth--;
+	*offset=start;
+	return true;
+}
+
+static void binary_write_entry(any key, any value, void *data)
+{
+	binary_entries *entries=(binary_entries *)data;
+	size_t n=entries->count;
+	if(entries->failed) return;
+	if(n==entries->capacity)
+	{
+		size_t capacity=2*entries->capacity+8;
+		uint64_t *offsets=(uint64_t *)object_new_atomic(2*capacity*sizeof(uint64_t));
+		string *keys=(string *)object_new(capacity*sizeof(string));
+		if(n>0)
+		{
+			memcpy(offsets,entries->offsets,2*n*sizeof(uint64_t));
+			memcpy(keys,entries->keys,n*sizeof(string));
+		}
+		entries->offsets=offsets;
+		entries->keys=keys;
+		entries->capacity=capacity;
+	}
+	if(!binary_write_value(entries->writer,key,&entries->offsets[2*n])
+		|| !binary_write_value(entries->writer,value,&entries->offsets[2*n+1]))
+	{
+		entries->failed=true;
+		return;
+	}
+	entries->keys[n]=key->type==TYPE_STRING?key->str:NULL;
+	entries->count++;
+}
+
+static int binary_compare_sorted(const void *a, const void *b)
+{
+	return strcmp(((const binary_sorted *)a)->key,((const binary_sorted *)b)->key);
+}
+
+/**
+* Writes the table of a map whose entries have been written, and leaves the map.
+*/
+static bool binary_write_table(binary_writer w, binary_entries *entries, uint64_t *offset)
+{
+	binary_sorted *sorted=NULL;
+	uint64_t start, max;
+	size_t i;
+	int code, tag;
+	start=binary_position(w);
+	max=entries->count;
+	for(i=0; i<2*entries->count; i++)
+		if(start-entries->offsets[i]>max) max=start-entries->offsets[i];
+	code=binary_width_code(max);
+	tag=BINARY_MAP|code<<4;
+	if(entries->count>=BINARY_INDEX_MIN)
+	{
+		sorted=(binary_sorted *)object_new(entries->count*sizeof(binary_sorted));
+		for(i=0; i<entries->count && entries->keys[i]!=NULL; i++)
+		{
+			sorted[i].key=entries->keys[i];
+			sorted[i].entry=i;
+		}
+		if(i<entries->count) sorted=NULL;
+		else
+		{
+			qsort(sorted,entries->count,sizeof(binary_sorted),binary_compare_sorted);
+			tag|=BINARY_INDEXED;
+		}
+	}
+	buffer_reserve(w->out,11+3*entries->count*((size_t)1<<code));
+	buffer_appendchar(w->out,(char)tag);
+	binary_put_varint(w->out,entries->count);
+	for(i=0; i<2*entries->count; i++) binary_put_fixed(w->out,start-entries->offsets[i],1<<code);
+	for(i=0; sorted!=NULL && i<entries->count; i++) binary_put_fixed(w->out,sorted[i].entry,1<<code);
+	w->depth--;
+	*offset=start;
+	return true;
+}
+
+static bool binary_write_map(binary_writer w, map m, uint64_t *offset)
+{
+	binary_entries entries;
+	if(!binary_enter(w,m)) return false;
+	memset(&entries,0,sizeof(entries));
+	entries.writer=w;
+	map_foreach(m,binary_write_entry,&entries);
+	if(entries.failed) return false;
+	return binary_write_table(w,&entries,offset);
+}
+
+/**
+* Writes a record as a map from the names of its properties to their values.
+*/
+static bool binary_write_record(binary_writer w, record r, uint64_t *offset)
+{
+	binary_entries entries;
+	size_t i;
+	if(!binary_enter(w,r)) return false;
+	memset(&entries,0,sizeof(entries));
+	entries.writer=w;
+	for(i=0; i<r->shape->count && !entries.failed; i++)
+		binary_write_entry(any_new_string(r->shape->names[i]),r->slots[i],&entries);
+	if(entries.failed) return false;
+	return binary_write_table(w,&entries,offset);
+}
+
+static bool binary_write_value(binary_writer w, any value, uint64_t *offset)
+{
+	uint64_t bits;
+	*offset=binary_position(w);
+	if(value==NULL)
+	{
+		buffer_appendchar(w->out,BINARY_NULL);
+		return true;
+	}
+	switch(value->type)
+	{
+		case TYPE_INT:
+			buffer_appendchar(w->out,BINARY_INT);
+			binary_put_varint(w->out,binary_zigzag(value->i));
+			return true;
+		case TYPE_LONG:
+			buffer_appendchar(w->out,BINARY_LONG);
+			binary_put_varint(w->out,binary_zigzag(value->lng));
+			return true;
+		case TYPE_DOUBLE:
+			memcpy(&bits,&value->dbl,sizeof(bits));
+			buffer_appendchar(w->out,BINARY_DOUBLE);
+			binary_put_fixed(w->out,bits,8);
+			return true;
+		case TYPE_STRING:
+			buffer_appendchar(w->out,BINARY_STRING);
+			binary_put_varint(w->out,binary_string_index(w,value->str));
+			return true;
+		case TYPE_BOOL:
+			buffer_appendchar(w->out,value->bln?BINARY_TRUE:BINARY_FALSE);
+			return true;
+		case TYPE_ARRAY: return binary_write_array(w,value->arr,offset);
+		case TYPE_MAP: return binary_write_map(w,value->map,offset);
+		case TYPE_RECORD: return binary_write_record(w,value->rec,offset);
+		default:
+			//null, and objects, whose content is unknown
+			buffer_appendchar(w->out,BINARY_NULL);
+			return true;
+	}
+}
+
+static uint64_t binary_get_fixed(const unsigned char *p, int width)
+{
+	uint64_t value=0;
+	int i;
+	for(i=0; i<width; i++) value|=(uint64_t)p[i]<<(8*i);
+	return value;
+}
+
+static bool binary_get_varint(binary_doc doc, uint64_t *offset, uint64_t *value)
+{
+	uint64_t result=0;
+	int shift=0;
+	while(*offset<doc->size && shift<64)
+	{
+		unsigned char byte=doc->data[(*offset)++];
+		result|=(uint64_t)(byte&0x7f)<<shift;
+		if((byte&0x80)==0)
+		{
+			*value=result;
+			return true;
+		}
+		shift+=7;
+	}
+	return false;
+}
+
+static long binary_unzigzag(uint64_t value)
+{
+	return (long)(value>>1)^-(long)(value&1);
+}
+
+/**
+* Returns the tag of a value; values outside the document read as null.
+*/
+static unsigned char binary_tag(binary_value v)
+{
+	if(v.doc==NULL || v.offset<BINARY_HEADER_SIZE || v.offset>=v.doc->strings) return BINARY_NULL;
+	return v.doc->data[v.offset];
+}
+
+/**
+* Reads the header of an array or map: the number of items, and where their offsets start.
+*/
+static bool binary_container(binary_value v, int kind, uint64_t *count, uint64_t *table, int *width)
+{
+	unsigned char tag=binary_tag(v);
+	uint64_t offset=v.offset+1;
+	uint64_t per_item=kind==BINARY_MAP?2:1;
+	if(BINARY_KIND(tag)!=kind || !binary_get_varint(v.doc,&offset,count)) return false;
+	*width=BINARY_WIDTH(tag);
+	*table=offset;
+	if(*count>v.doc->size || offset+*count*per_item*(uint64_t)*width>v.doc->strings) return false;
+	if((tag&BINARY_INDEXED)!=0 && offset+*count*3*(uint64_t)*width>v.doc->strings) return false;
+	return true;
+}
+
+/**
+* Returns the value at the distance stored in an offset slot; an item always comes before its container.
+*/
+static binary_value binary_child(binary_value v, uint64_t table, int width, uint64_t slot)
+{
+	uint64_t distance=binary_get_fixed(v.doc->data+table+slot*(uint64_t)width,width);
+	binary_value child;
+	child.doc=v.doc;
+	child.offset=distance>0 && distance<=v.offset?v.offset-distance:0;
+	return child;
+}
+
+static any binary_decode(binary_value v, int depth)
+{
+	uint64_t count, table, i;
+	int width;
+	switch(binary_type(v))
+	{
+		case TYPE_BOOL: return any_new_bool(binary_bool(v));
+		case TYPE_INT: return any_new_int((int)binary_long(v));
+		case TYPE_LONG: return any_new_long(binary_long(v));
+		case TYPE_DOUBLE: return any_new_double(binary_double(v));
+		case TYPE_STRING:
+		{
+			string str=binary_string(v);
+			return str!=NULL?any_new_string_copy(str):NULL;
+		}
+		case TYPE_ARRAY:
+		{
+			manyany items;
+			if(depth>=BINARY_MAX_DEPTH || !binary_container(v,BINARY_ARRAY,&count,&table,&width)) return NULL;
+			items=(manyany)object_new((size_t)(count+1)*sizeof(any));
+			for(i=0; i<count; i++)
+				if((items[i]=binary_decode(binary_child(v,table,width,i),depth+1))==NULL) return NULL;
+			return any_new_array(items,(size_t)count);
+		}
+		case TYPE_MAP:
+		{
+			map m=map_new();
+			if(depth>=BINARY_MAX_DEPTH || !binary_container(v,BINARY_MAP,&count,&table,&width)) return NULL;
+			for(i=0; i<count; i++)
+			{
+				any key=binary_decode(binary_child(v,table,width,2*i),depth+1);
+				any value=binary_decode(binary_child(v,table,width,2*i+1),depth+1);
+				if(key==NULL || value==NULL) return NULL;
+				map_put(m,key,value);
+			}
+			return any_new_map(m);
+		}
+		default: return any_new_null();
+	}
+}
+
+//PRIVATE
+
+/**
+* Writes an any in the binary encoding at the end of a buffer, as a document that binary_open() reads.
+* Every distinct string is stored once, in a string table. Integers are stored as varints,
+* and arrays and maps as tables of offsets to their items, in the fewest bytes that hold them,
+* so that any item can be reached without decoding the others.
+* Maps with string keys get a sorted index of their keys, for lookups by binary search.
+* Records are stored as maps from the names of their properties to their values, and read back as maps.
+* Objects are stored as null, since their content is unknown.
+*
+* @param b the buffer.
+* @param value the value to write.
+* @return true, if the value was written; false, if an array, map or record contains itself,
+* or nesting is deeper than BINARY_MAX_DEPTH. Nothing is written then.
+*/
+bool binary_write(buffer b, any value)
+{
+	binary_writer w=(binary_writer)object_new(sizeof(_binary_writer));
+	uint64_t root, strings, max=0, *offsets;
+	size_t i;
+	int code;
+	w->out=b;
+	w->base=b->size;
+	w->strings=map_new();
+	buffer_append(b,BINARY_MAGIC,4);
+	binary_put_fixed(b,BINARY_VERSION,4);
+	if(!binary_write_value(w,value,&root))
+	{
+		b->size=w->base;
+		return false;
+	}
+	offsets=(uint64_t *)object_new_atomic((w->string_count+1)*sizeof(uint64_t));
+	for(i=0; i<w->string_count; i++)
+	{
+		size_t size=strlen(w->table[i]);
+		offsets[i]=binary_position(w);
+		binary_put_varint(b,size);
+		buffer_append(b,w->table[i],size+1);
+		max=offsets[i];
+	}
+	strings=binary_position(w);
+	code=binary_width_code(max);
+	for(i=0; i<w->string_count; i++) binary_put_fixed(b,offsets[i],1<<code);
+	binary_put_fixed(b,root,8);
+	binary_put_fixed(b,strings,8);
+	binary_put_fixed(b,w->string_count,8);
+	binary_put_fixed(b,(uint64_t)1<<code,4);
+	buffer_append(b,BINARY_MAGIC,4);
+	return true;
+}
+
+/**
+* Opens a document in memory, written by binary_write(). Only the header and trailer are read:
+* values are decoded when they are used, in place, so opening takes the same time for any size.
+* The memory must stay as it is while the document is used.
+*
+* @param data the document.
+* @return the document; or NULL, if the data is not a document of this version.
+*/
+binary_doc binary_open(view data)
+{
+	const unsigned char *p=(const unsigned char *)data.data;
+	const unsigned char *trailer;
+	binary_doc doc;
+	uint64_t width;
+	if(data.size<BINARY_HEADER_SIZE+BINARY_TRAILER_SIZE) return NULL;
+	trailer=p+data.size-BINARY_TRAILER_SIZE;
+	if(memcmp(p,BINARY_MAGIC,4)!=0 || binary_get_fixed(p+4,4)!=BINARY_VERSION || memcmp(trailer+28,BINARY_MAGIC,4)!=0) return NULL;
+	doc=(binary_doc)object_new(sizeof(_binary_doc));
+	doc->data=p;
+	doc->size=data.size;
+	doc->root=binary_get_fixed(trailer,8);
+	doc->strings=binary_get_fixed(trailer+8,8);
+	doc->string_count=binary_get_fixed(trailer+16,8);
+	width=binary_get_fixed(trailer+24,4);
+	doc->string_width=(int)width;
+	if(width!=1 && width!=2 && width!=4 && width!=8) return NULL;
+	if(doc->strings>data.size-BINARY_TRAILER_SIZE || doc->root<BINARY_HEADER_SIZE || doc->root>=doc->strings) return NULL;
+	if(doc->string_count>(data.size-BINARY_TRAILER_SIZE-doc->strings)/width) return NULL;
+	return doc;
+}
+
+/**
+* Opens a document stored in a file, which is mapped into memory; see binary_open().
+* Only the pages holding the values used are ever read from the file.
+*
+* @param path the file.
+* @return the document; or NULL, if the file cannot be mapped, or is not a document of this version.
+*/
+binary_doc binary_open_file(const char *path)
+{
+	mapped_file file=string_map_file(path,MAPPED_FILE_RANDOM);
+	binary_doc doc;
+	if(file==NULL) return NULL;
+	doc=binary_open(mapped_file_view(file));
+	if(doc==NULL)
+	{
+		mapped_file_close(file);
+		return NULL;
+	}
+	doc->file=file;
+	return doc;
+}
+
+/**
+* Returns the value a document was written from.
+*
+* @param doc the document.
+* @return the root value.
+*/
+binary_value binary_root(binary_doc doc)
+{
+	binary_value v;
+	v.doc=doc;
+	v.offset=doc->root;
+	return v;
+}
+
+/**
+* Returns the type of a value. Integers keep the type they were written with.
+* Values that are missing, such as items past the end of an array, are null.
+*
+* @param v the value.
+* @return the type.
+*/
+vartype binary_type(binary_value v)
+{
+	switch(BINARY_KIND(binary_tag(v)))
+	{
+		case BINARY_FALSE: case BINARY_TRUE: return TYPE_BOOL;
+		case BINARY_INT: return TYPE_INT;
+		case BINARY_LONG: return TYPE_LONG;
+		case BINARY_DOUBLE: return TYPE_DOUBLE;
+		case BINARY_STRING: return TYPE_STRING;
+		case BINARY_ARRAY: return TYPE_ARRAY;
+		case BINARY_MAP: return TYPE_MAP;
+		default: return TYPE_NULL;
+	}
+}
+
+/**
+* Returns the value of a boolean.
+*
+* @param v the value.
+* @return true, if the value is the boolean true; false, otherwise.
+*/
+bool binary_bool(binary_value v)
+{
+	return binary_tag(v)==BINARY_TRUE;
+}
+
+/**
+* Returns the value of an integer, or of a double converted to an integer.
+*
+* @param v the value.
+* @return the number; 0, if the value is not a number.
+*/
+long binary_long(binary_value v)
+{
+	unsigned char tag=binary_tag(v);
+	uint64_t offset=v.offset+1, value;
+	if(tag==BINARY_DOUBLE) return (long)binary_double(v);
+	if(tag!=BINARY_INT && tag!=BINARY_LONG) return 0;
+	if(!binary_get_varint(v.doc,&offset,&value)) return 0;
+	return binary_unzigzag(value);
+}
+
+/**
+* Returns the value of a double, or of an integer converted to a double.
+*
+* @param v the value.
+* @return the number; 0.0, if the value is not a number.
+*/
+double binary_double(binary_value v)
+{
+	unsigned char tag=binary_tag(v);
+	uint64_t bits;
+	double dbl;
+	if(tag==BINARY_INT || tag==BINARY_LONG) return (double)binary_long(v);
+	if(tag!=BINARY_DOUBLE || v.offset+9>v.doc->strings) return 0.0;
+	bits=binary_get_fixed(v.doc->data+v.offset+1,8);
+	memcpy(&dbl,&bits,sizeof(dbl));
+	return dbl;
+}
+
+/**
+* Returns a string, without copying it: the string lies inside the document,
+* and stays valid as long as the document is used. It must not be changed.
+*
+* @param v the value.
+* @return the string; or NULL, if the value is not a string.
+*/
+string binary_string(binary_value v)
+{
+	binary_doc doc=v.doc;
+	uint64_t offset=v.offset+1, index, size;
+	if(binary_tag(v)!=BINARY_STRING || !binary_get_varint(doc,&offset,&index) || index>=doc->string_count) return NULL;
+	offset=binary_get_fixed(doc->data+doc->strings+index*(uint64_t)doc->string_width,doc->string_width);
+	if(offset>=doc->strings || !binary_get_varint(doc,&offset,&size)) return NULL;
+	if(offset>=doc->strings || size>=doc->strings-offset || doc->data[offset+size]!=0) return NULL;
+	return (string)(doc->data+offset);
+}
+
+/**
+* Returns the number of items of an array, or of entries of a map.
+*
+* @param v the value.
+* @return the number of items; 0, if the value is neither an array nor a map.
+*/
+size_t binary_size(binary_value v)
+{
+	uint64_t count, table;
+	int width;
+	int kind=BINARY_KIND(binary_tag(v));
+	if(kind!=BINARY_ARRAY && kind!=BINARY_MAP) return 0;
+	if(!binary_container(v,kind,&count,&table,&width)) return 0;
+	return (size_t)count;
+}
+
+/**
+* Returns an item of an array, without decoding any other item.
+*
+* @param v the array.
+* @param index the position of the item.
+* @return the item; a null value, if there is no such item.
+*/
+binary_value binary_at(binary_value v, size_t index)
+{
+	uint64_t count, table;
+	int width;
+	binary_value missing={v.doc, 0};
+	if(!binary_container(v,BINARY_ARRAY,&count,&table,&width) || index>=count) return missing;
+	return binary_child(v,table,width,index);
+}
+
+/**
+* Returns the key of an entry of a map; entries are in the order of the map they were written from.
+*
+* @param v the map.
+* @param index the position of the entry.
+* @return the key; a null value, if there is no such entry.
+*/
+binary_value binary_map_key(binary_value v, size_t index)
+{
+	uint64_t count, table;
+	int width;
+	binary_value missing={v.doc, 0};
+	if(!binary_container(v,BINARY_MAP,&count,&table,&width) || index>=count) return missing;
+	return binary_child(v,table,width,2*(uint64_t)index);
+}
+
+/**
+* Returns the value of an entry of a map.
+*
+* @param v the map.
+* @param index the position of the entry.
+* @return the value; a null value, if there is no such entry.
+*/
+binary_value binary_map_value(binary_value v, size_t index)
+{
+	uint64_t count, table;
+	int width;
+	binary_value missing={v.doc, 0};
+	if(!binary_container(v,BINARY_MAP,&count,&table,&width) || index>=count) return missing;
+	return binary_child(v,table,width,2*(uint64_t)index+1);
+}
+
+/**
+* Looks up the value of a string key in a map, decoding only the keys it compares with:
+* by binary search if the map has a sorted index of its keys, and one by one otherwise.
+*
+* @param v the map.
+* @param key the key.
+* @param value receives the value.
+* @return true, if the key was found; false, if not.
+*/
+bool binary_get(binary_value v, string key, binary_value *value)
+{
+	uint64_t count, table, low=0, high, i;
+	int width;
+	if(!binary_container(v,BINARY_MAP,&count,&table,&width)) return false;
+	if((binary_tag(v)&BINARY_INDEXED)!=0)
+	{
+		uint64_t sorted=table+2*count*(uint64_t)width;
+		high=count;
+		while(low<high)
+		{
+			uint64_t middle=low+(high-low)/2;
+			uint64_t entry=binary_get_fixed(v.doc->data+sorted+middle*(uint64_t)width,width);
+			string candidate;
+			int order;
+			if(entry>=count) return false;
+			candidate=binary_string(binary_child(v,table,width,2*entry));
+			if(candidate==NULL) return false;
+			order=strcmp(key,candidate);
+			if(order==0)
+			{
+				*value=binary_child(v,table,width,2*entry+1);
+				return true;
+			}
+			if(order<0) high=middle;
+			else low=middle+1;
+		}
+		return false;
+	}
+	for(i=0; i<count; i++)
+	{
+		string candidate=binary_string(binary_child(v,table,width,2*i));
+		if(candidate!=NULL && strcmp(key,candidate)==0)
+		{
+			*value=binary_child(v,table,width,2*i+1);
+			return true;
+		}
+	}
+	return false;
+}
+
+/**
+* Decodes a value and everything in it into anys. Strings are copied,
+* so that the result does not depend on the document any more.
+*
+* @param v the value.
+* @return A new any; or NULL, if the document is damaged.
+*/
+any binary_to_any(binary_value v)
+{
+	return binary_decode(v,0);
+}
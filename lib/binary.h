@@ -0,0 +1,86 @@
+/**
+ *
+ * libscriptify
+ *
+ * @author  Erik Poupaert <erik@sankuru.biz>
+ *
+ * @section LICENSE
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU LGPL as
+ * published by the Free Software Foundation; either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * LGPL for more details at: http://www.gnu.org/licenses/lgpl.html
+ *
+ * @section DESCRIPTION
+ *
+ * A compact binary encoding of any values, for storing and passing them between processes.
+ * Documents are read in place, for instance from a mapped file: values are only decoded when they are used.
+ *
+ */
+#ifndef _BINARY_H
+#define _BINARY_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include "any.h"
+#include "view.h"
+#include "buffer.h"
+#include "mapped_file.h"
+
+#ifdef __cplusplus
+	extern "C" {
+#endif
+
+/* the version of the encoding written by binary_write() */
+#define BINARY_VERSION 1
+/* maximum nesting of arrays and maps */
+#define BINARY_MAX_DEPTH 1024
+
+typedef struct
+{
+	const unsigned char *data;
+	size_t size;
+	uint64_t root; //offset of the root value
+	uint64_t strings; //offset of the offsets of the strings in the string table
+	uint64_t string_count;
+	int string_width; //bytes per offset of a string
+	mapped_file file; //keeps the mapping alive; NULL if the document is not a mapped file
+} _binary_doc;
+
+typedef _binary_doc* binary_doc;
+
+/* a value inside a document, decoded only when asked for; passed by value */
+typedef struct
+{
+	binary_doc doc;
+	uint64_t offset;
+} binary_value;
+
+bool binary_write(buffer b, any value);
+
+binary_doc binary_open(view data);
+binary_doc binary_open_file(const char *path);
+binary_value binary_root(binary_doc doc);
+vartype binary_type(binary_value v);
+bool binary_bool(binary_value v);
+long binary_long(binary_value v);
+double binary_double(binary_value v);
+string binary_string(binary_value v);
+size_t binary_size(binary_value v);
+binary_value binary_at(binary_value v, size_t index);
+binary_value binary_map_key(binary_value v, size_t index);
+binary_value binary_map_value(binary_value v, size_t index);
+bool binary_get(binary_value v, string key, binary_value *value);
+any binary_to_any(binary_value v);
+
+#ifdef __cplusplus
+	}
+#endif
+
+#endif // _BINARY_H
@@ -24,9 +24,13 @@
  */
 #include <string.h>
 #include <stdlib.h>
+#include <stdio.h>
 #include "object.h"
 #include "buffer.h"
 #include "string_utf8.h"
+#include "hash.h"
+#include "number.h"
+#include "format.h"
 
 /**
 * Creates a new buffer with default capacity (BUFFER_INIT_CAPACITY).
@@ -49,7 +53,8 @@ buffer buffer_new()
 buffer buffer_new_capacity(size_t capacity)
 {
 	buffer abuffer = (buffer)object_new(sizeof(_buffer));  
-	abuffer->data=(string)object_new(BUFFER_INIT_CAPACITY);
+	if(capacity==0) capacity=1;
+	abuffer->data=(string)object_new(capacity);
 	abuffer->size=0;
 	abuffer->capacity=capacity;
 	return abuffer;
@@ -62,21 +67,52 @@ buffer buffer_new_capacity(size_t capacity)
 */
 void buffer_doublesize(buffer abuffer)
 {
-	size_t newcapacity=abuffer->capacity*2;
-	abuffer->data = object_resize((object)abuffer->data, newcapacity);
-	abuffer->capacity=newcapacity;
+	buffer_ensure_capacity(abuffer,abuffer->capacity>0?abuffer->capacity*2:BUFFER_INIT_CAPACITY);
 }
 
 /**
 * Ensures that the buffer has the capacity required.
-* Keeps doubling the buffer capacity until it is equal or larger than the requirement.
+* Grows the buffer in a single step, to at least double its current capacity,
+* so that a sequence of appends costs amortized constant time per byte.
 *
 * @param abuffer the buffer to ensure the capacity for.
 * @param capacity_required the capacity requirement.
 */
 void buffer_ensure_capacity(buffer abuffer, size_t capacity_required)
 {
-	while(capacity_required>abuffer->capacity) buffer_doublesize(abuffer);
+	size_t newcapacity;
+	if(capacity_required<=abuffer->capacity) return;
+	newcapacity=abuffer->capacity*2;
+	if(newcapacity<capacity_required) newcapacity=capacity_required;
+	abuffer->data = object_resize((object)abuffer->data, newcapacity);
+	abuffer->capacity=newcapacity;
+}
+
+/**
+* Ensures that the buffer has room for 'size' more bytes, growing it at most once.
+* Reserving up front avoids intermediate reallocations when the size of the output is known.
+*
+* @param abuffer the buffer to reserve room in.
+* @param size the number of bytes about to be appended.
+*/
+void buffer_reserve(buffer abuffer, size_t size)
+{
+	buffer_ensure_capacity(abuffer,abuffer->size+size);
+}
+
+/**
+* Appends 'size' bytes to a buffer. The bytes may include null characters.
+* The buffer grows automatically, if needed, for adding the bytes supplied.
+*
+* @param abuffer the buffer to append the bytes to.
+* @param data the bytes to append.
+* @param size the number of bytes.
+*/
+void buffer_append(buffer abuffer, const char *data, size_t size)
+{
+	buffer_ensure_capacity(abuffer,abuffer->size+size);
+	memcpy(abuffer->data+abuffer->size,data,size);
+	abuffer->size+=size;
 }
 
 /**
@@ -88,10 +124,18 @@ void buffer_ensure_capacity(buffer abuffer, size_t capacity_required)
 */
 void buffer_appendstring(buffer abuffer,string astring)
 {
-	size_t len=strlen(astring);
-	buffer_ensure_capacity(abuffer,abuffer->size+len);
-	strncpy(abuffer->data+abuffer->size,astring,len);
-	abuffer->size+=len;
+	buffer_append(abuffer,astring,strlen(astring));
+}
+
+/**
+* Appends the bytes of a view to a buffer.
+*
+* @param abuffer the buffer to append the bytes to.
+* @param v the view to append.
+*/
+void buffer_append_view(buffer abuffer, view v)
+{
+	buffer_append(abuffer,v.data,v.size);
 }
 
 /**
@@ -109,9 +153,9 @@ void buffer_appendchar(buffer abuffer,char c)
 }
 
 /**
-* Returns a null-terminated string containing the content of the buffer.
-* Warning: make sure never to have added null characters in the middle of the buffer,
-* or the resulting string will be truncated at the first such null character.
+* Returns a null-terminated string containing a copy of the content of the buffer.
+* Warning: null characters added in the middle of the buffer are copied as well,
+* but string functions will see the string end at the first one.
 *
 * @param abuffer the buffer to return the string from.
 * @return A pointer to new string containing the content of the buffer.
@@ -119,8 +163,122 @@ void buffer_appendchar(buffer abuffer,char c)
 string buffer_tostring(buffer abuffer)
 {
 	string astring=string_new(abuffer->size);
-	strncpy(astring, abuffer->data, abuffer->size);
+	memcpy(astring, abuffer->data, abuffer->size);
+	astring[abuffer->size]=0;
+	return astring;
+}
+
+/**
+* Hands the storage of the buffer over to a null-terminated string, without copying it.
+* The buffer is left empty; appending to it afterwards allocates new storage,
+* so the string returned is never modified by the buffer again.
+*
+* @param abuffer the buffer to take the content from.
+* @return the content of the buffer, as a string.
+*/
+string buffer_steal(buffer abuffer)
+{
+	string astring;
+	buffer_ensure_capacity(abuffer,abuffer->size+1);
+	astring=abuffer->data;
 	astring[abuffer->size]=0;
+	abuffer->data=NULL;
+	abuffer->size=0;
+	abuffer->capacity=0;
 	return astring;
 }
 
+/**
+* Computes the hash value of the content of a buffer.
+* The result is equal to string_hash() of buffer_tostring(), without making the copy.
+* To hash content that is produced piecemeal, feed each piece to hash_update() instead.
+*
+* @param abuffer the buffer to hash.
+* @return the 64-bit hash value.
+*/
+uint64_t buffer_hash(buffer abuffer)
+{
+	return hash_bytes(abuffer->data,abuffer->size);
+}
+
+/**
+* Appends the decimal representation of a long to a buffer.
+* The digits are written straight into the buffer, without an intermediate string.
+*
+* @param abuffer the buffer to append the number to.
+* @param lng the number to append.
+*/
+void buffer_append_long(buffer abuffer, long lng)
+{
+	buffer_ensure_capacity(abuffer,abuffer->size+NUMBER_MAX_LENGTH);
+	abuffer->size+=number_write_long(abuffer->data+abuffer->size,lng);
+}
+
+/**
+* Appends the shortest decimal representation of a double that reads back as the same double.
+* See number_write_double() for the notation used. Does not depend on the locale.
+*
+* @param abuffer the buffer to append the number to.
+* @param dbl the number to append.
+*/
+void buffer_append_double(buffer abuffer, double dbl)
+{
+	buffer_ensure_capacity(abuffer,abuffer->size+NUMBER_MAX_LENGTH);
+	abuffer->size+=number_write_double(abuffer->data+abuffer->size,dbl);
+}
+
+/**
+* Appends formatted output to a buffer, as printf() would print it.
+* The format string is compiled on first use and cached, see format_cached(),
+* and the output is written straight into the buffer.
+*
+* @param abuffer the buffer to append to.
+* @param fmt the format string.
+*/
+void buffer_appendf(buffer abuffer, const char *fmt, ...)
+{
+	va_list args;
+	va_start(args,fmt);
+	buffer_vappendf(abuffer,fmt,args);
+	va_end(args);
+}
+
+/**
+* Appends formatted output to a buffer, with a va_list of arguments.
+* Format strings that format_compile() does not support are handed to vsnprintf() as they are.
+*
+* @param abuffer the buffer to append to.
+* @param fmt the format string.
+* @param args the arguments.
+*/
+void buffer_vappendf(buffer abuffer, const char *fmt, va_list args)
+{
+	format compiled=format_cached(fmt);
+	if(compiled!=NULL) format_vrender(compiled,abuffer,args);
+	else buffer_vprintf(abuffer,fmt,args);
+}
+
+/**
+* Appends formatted output to a buffer with vsnprintf(), without compiling the format string;
+* for format strings that format_compile() does not support, such as those with %m.
+*
+* @param abuffer the buffer to append to.
+* @param fmt the format string.
+* @param args the arguments.
+*/
+void buffer_vprintf(buffer abuffer, const char *fmt, va_list args)
+{
+	va_list copy;
+	int n;
+	while(1)
+	{
+		size_t room=abuffer->capacity-abuffer->size;
+		va_copy(copy,args);
+		n=vsnprintf(abuffer->data+abuffer->size,room,fmt,copy);
+		va_end(copy);
+		if(n<0) return;
+		if((size_t)n<room) break;
+		buffer_ensure_capacity(abuffer,abuffer->size+n+1);
+	}
+	abuffer->size+=n;
+}
@@ -26,7 +26,10 @@
 #define _BUFFER_H
 
 #include <stdlib.h>
+#include <stdint.h>
+#include <stdarg.h>
 #include "string_utf8.h"
+#include "view.h"
 
 #ifdef __cplusplus
 	extern "C" {
@@ -48,9 +51,20 @@ typedef _buffer* buffer;
 buffer buffer_new();
 buffer buffer_new_capacity(size_t capacity);
 void buffer_doublesize(buffer abuffer);
+void buffer_ensure_capacity(buffer abuffer, size_t capacity_required);
+void buffer_reserve(buffer abuffer, size_t size);
+void buffer_append(buffer abuffer, const char *data, size_t size);
 void buffer_appendstring(buffer abuffer,string astring);
+void buffer_append_view(buffer abuffer, view v);
 void buffer_appendchar(buffer abuffer,char c);
 string buffer_tostring(buffer abuffer);
+string buffer_steal(buffer abuffer);
+uint64_t buffer_hash(buffer abuffer);
+void buffer_append_long(buffer abuffer, long lng);
+void buffer_append_double(buffer abuffer, double dbl);
+void buffer_appendf(buffer abuffer, const char *fmt, ...);
+void buffer_vappendf(buffer abuffer, const char *fmt, va_list args);
+void buffer_vprintf(buffer abuffer, const char *fmt, va_list args);
 
 #ifdef __cplusplus
 	}
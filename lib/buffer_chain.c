@@ -0,0 +1,284 @@
+/**
+ *
+ * libscriptify
+ *
+ * @author  Erik Poupaert <erik@sankuru.biz>
+ *
+ * @section LICENSE
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU LGPL as
+ * published by the Free Software Foundation; either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * LGPL for more details at: http://www.gnu.org/licenses/lgpl.html
+ *
+ * @section DESCRIPTION
+ *
+ * A buffer chain collects output as a list of fragments, referring to existing strings
+ * instead of copying them, and writes it out with writev().
+ *
+ */
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/uio.h>
+#include "object.h"
+#include "buffer_chain.h"
+#include "number.h"
+
+//PRIVATE
+
+static buffer_segment buffer_chain_link(buffer_chain chain, buffer_segment segment)
+{
+	if(chain->tail==NULL) chain->head=segment;
+	else chain->tail->next=segment;
+	chain->tail=segment;
+	return segment;
+}
+
+/**
+* Returns an inline segment at the end of the chain with room for 'size' more bytes,
+* adding a new one if the last segment is a reference or is full.
+*/
+static buffer_segment buffer_chain_room(buffer_chain chain, size_t size)
+{
+	buffer_segment tail=chain->tail;
+	size_t capacity;
+	if(tail!=NULL && tail->data==tail->inline_data && tail->capacity-tail->size>=size) return tail;
+	capacity=size>BUFFER_CHAIN_SEGMENT_CAPACITY?size:BUFFER_CHAIN_SEGMENT_CAPACITY;
+	buffer_segment segment=(buffer_segment)object_new(sizeof(_buffer_segment)+capacity);
+	segment->data=segment->inline_data;
+	segment->capacity=capacity;
+	return buffer_chain_link(chain,segment);
+}
+
+/**
+* Drops the first 'written' bytes from the chain.
+*/
+static void buffer_chain_consume(buffer_chain chain, size_t written)
+{
+	chain->size-=written;
+	while(written>0)
+	{
+		size_t left=chain->head->size-chain->offset;
+		if(written<left)
+		{
+			chain->offset+=written;
+			return;
+		}
+		written-=left;
+		chain->offset=0;
+		chain->head=chain->head->next;
+	}
+	//segments of zero bytes are never linked, so the chain is empty exactly when size is 0
+	if(chain->size==0)
+	{
+		chain->head=NULL;
+		chain->tail=NULL;
+	}
+}
+
+//PRIVATE
+
+/**
+* Creates a new, empty buffer chain.
+* A buffer chain collects output as a list of fragments, most of which refer to existing
+* strings instead of copying them, and writes them out with writev().
+*
+* @return A pointer to the new buffer chain.
+*/
+buffer_chain buffer_chain_new()
+{
+	return (buffer_chain)object_new(sizeof(_buffer_chain));
+}
+
+/**
+* Returns the number of bytes in a buffer chain that have not been written yet.
+*
+* @param chain the buffer chain.
+* @return the number of bytes.
+*/
+size_t buffer_chain_size(buffer_chain chain)
+{
+	return chain->size;
+}
+
+/**
+* Appends a copy of 'size' bytes to a buffer chain.
+* The bytes are copied into an inline segment, so they may be modified afterwards.
+*
+* @param chain the buffer chain.
+* @param data the bytes to append.
+* @param size the number of bytes.
+*/
+void buffer_chain_append(buffer_chain chain, const char *data, size_t size)
+{
+	buffer_segment segment;
+	if(size==0) return;
+	segment=buffer_chain_room(chain,size);
+	memcpy(segment->inline_data+segment->size,data,size);
+	segment->size+=size;
+	chain->size+=size;
+}
+
+/**
+* Appends 'size' bytes to a buffer chain by reference, without copying them.
+* The bytes must stay unchanged until the chain has been written.
+* Fragments of at most BUFFER_CHAIN_INLINE_LIMIT bytes are copied nevertheless,
+* since copying them costs less than an extra entry in the writev() call.
+*
+* @param chain the buffer chain.
+* @param data the bytes to append.
+* @param size the number of bytes.
+*/
+void buffer_chain_append_ref(buffer_chain chain, const char *data, size_t size)
+{
+	buffer_segment segment;
+	if(size<=BUFFER_CHAIN_INLINE_LIMIT)
+	{
+		buffer_chain_append(chain,data,size);
+		return;
+	}
+	segment=(buffer_segment)object_new(sizeof(_buffer_segment));
+	segment->data=data;
+	segment->size=size;
+	buffer_chain_link(chain,segment);
+	chain->size+=size;
+}
+
+/**
+* Appends a string to a buffer chain by reference; see buffer_chain_append_ref().
+*
+* @param chain the buffer chain.
+* @param str the string to append; it must not be modified until the chain has been written.
+*/
+void buffer_chain_append_string(buffer_chain chain, string str)
+{
+	buffer_chain_append_ref(chain,str,strlen(str));
+}
+
+/**
+* Appends the bytes of a view to a buffer chain by reference; see buffer_chain_append_ref().
+*
+* @param chain the buffer chain.
+* @param v the view to append; its bytes must not be modified until the chain has been written.
+*/
+void buffer_chain_append_view(buffer_chain chain, view v)
+{
+	buffer_chain_append_ref(chain,v.data,v.size);
+}
+
+/**
+* Moves the content of a buffer to the end of a buffer chain.
+* The storage of the buffer is taken over without copying, see buffer_steal(),
+* and the buffer is left empty.
+*
+* @param chain the buffer chain.
+* @param abuffer the buffer to take the content from.
+*/
+void buffer_chain_append_buffer(buffer_chain chain, buffer abuffer)
+{
+	size_t size=abuffer->size;
+	if(size<=BUFFER_CHAIN_INLINE_LIMIT)
+	{
+		buffer_chain_append(chain,abuffer->data,size);
+		abuffer->size=0;
+		return;
+	}
+	buffer_chain_append_ref(chain,buffer_steal(abuffer),size);
+}
+
+/**
+* Appends the decimal representation of a long to a buffer chain.
+*
+* @param chain the buffer chain.
+* @param lng the number to append.
+*/
+void buffer_chain_append_long(buffer_chain chain, long lng)
+{
+	buffer_segment segment=buffer_chain_room(chain,NUMBER_MAX_LENGTH);
+	size_t n=number_write_long(segment->inline_data+segment->size,lng);
+	segment->size+=n;
+	chain->size+=n;
+}
+
+/**
+* Appends the shortest decimal representation of a double to a buffer chain;
+* see number_write_double().
+*
+* @param chain the buffer chain.
+* @param dbl the number to append.
+*/
+void buffer_chain_append_double(buffer_chain chain, double dbl)
+{
+	buffer_segment segment=buffer_chain_room(chain,NUMBER_MAX_LENGTH);
+	size_t n=number_write_double(segment->inline_data+segment->size,dbl);
+	segment->size+=n;
+	chain->size+=n;
+}
+
+/**
+* Returns a null-terminated string with the bytes of a buffer chain not written yet.
+* The chain itself is left unchanged.
+*
+* @param chain the buffer chain.
+* @return A pointer to the new string.
+*/
+string buffer_chain_tostring(buffer_chain chain)
+{
+	string s=string_new(chain->size);
+	size_t offset=chain->offset, size=0;
+	buffer_segment segment;
+	for(segment=chain->head; segment!=NULL; segment=segment->next)
+	{
+		memcpy(s+size,segment->data+offset,segment->size-offset);
+		size+=segment->size-offset;
+		offset=0;
+	}
+	s[size]=0;
+	return s;
+}
+
+/**
+* Writes a buffer chain to a file descriptor with writev(), up to BUFFER_CHAIN_IOV_MAX segments per call.
+* Partial writes are continued where they stopped. The bytes written are removed from the chain;
+* if the descriptor cannot take more without blocking, or an error occurs,
+* the bytes not written yet stay in the chain, so that the call can be repeated.
+*
+* @param chain the buffer chain.
+* @param fd the file descriptor to write to.
+* @return the number of bytes written; or -1 if an error occurred before anything was written, with errno set.
+*/
+ssize_t buffer_chain_writev(buffer_chain chain, int fd)
+{
+	struct iovec iov[BUFFER_CHAIN_IOV_MAX];
+	ssize_t total=0;
+	while(chain->size>0)
+	{
+		buffer_segment segment=chain->head;
+		size_t offset=chain->offset;
+		int count=0;
+		ssize_t written;
+		for(; segment!=NULL && count<BUFFER_CHAIN_IOV_MAX; segment=segment->next)
+		{
+			iov[count].iov_base=(void *)(segment->data+offset);
+			iov[count].iov_len=segment->size-offset;
+			count++;
+			offset=0;
+		}
+		written=writev(fd,iov,count);
+		if(written<0)
+		{
+			if(errno==EINTR) continue;
+			return total>0?total:-1;
+		}
+		if(written==0) break;
+		buffer_chain_consume(chain,(size_t)written);
+		total+=written;
+	}
+	return total;
+}
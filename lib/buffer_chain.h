@@ -0,0 +1,82 @@
+/**
+ *
+ * libscriptify
+ *
+ * @author  Erik Poupaert <erik@sankuru.biz>
+ *
+ * @section LICENSE
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU LGPL as
+ * published by the Free Software Foundation; either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * LGPL for more details at: http://www.gnu.org/licenses/lgpl.html
+ *
+ * @section DESCRIPTION
+ *
+ * A buffer chain collects output as a list of fragments, referring to existing strings
+ * instead of copying them, and writes it out with writev().
+ *
+ */
+#ifndef _BUFFER_CHAIN_H
+#define _BUFFER_CHAIN_H
+
+#include <stddef.h>
+#include <sys/types.h>
+#include "string_utf8.h"
+#include "view.h"
+#include "buffer.h"
+
+#ifdef __cplusplus
+	extern "C" {
+#endif
+
+/* fragments up to this many bytes are copied into inline segments instead of referenced */
+#define BUFFER_CHAIN_INLINE_LIMIT 128
+/* default capacity of an inline segment */
+#define BUFFER_CHAIN_SEGMENT_CAPACITY 1024
+/* maximum number of segments handed to a single writev() call */
+#define BUFFER_CHAIN_IOV_MAX 64
+
+typedef struct _buffer_segment
+{
+	struct _buffer_segment *next;
+	const char *data;
+	size_t size;
+	size_t capacity; //inline segments: room in inline_data; 0 for referenced fragments
+	char inline_data[];
+} _buffer_segment;
+
+typedef _buffer_segment* buffer_segment;
+
+typedef struct
+{
+	buffer_segment head;
+	buffer_segment tail;
+	size_t size; //bytes not written yet
+	size_t offset; //bytes of the head segment already written
+} _buffer_chain;
+
+typedef _buffer_chain* buffer_chain;
+
+buffer_chain buffer_chain_new();
+size_t buffer_chain_size(buffer_chain chain);
+void buffer_chain_append(buffer_chain chain, const char *data, size_t size);
+void buffer_chain_append_ref(buffer_chain chain, const char *data, size_t size);
+void buffer_chain_append_string(buffer_chain chain, string str);
+void buffer_chain_append_view(buffer_chain chain, view v);
+void buffer_chain_append_buffer(buffer_chain chain, buffer abuffer);
+void buffer_chain_append_long(buffer_chain chain, long lng);
+void buffer_chain_append_double(buffer_chain chain, double dbl);
+string buffer_chain_tostring(buffer_chain chain);
+ssize_t buffer_chain_writev(buffer_chain chain, int fd);
+
+#ifdef __cplusplus
+	}
+#endif
+
+#endif // _BUFFER_CHAIN_H
@@ -0,0 +1,727 @@
+/**
+ *
+ * libscriptify
+ *
+ * @author  Erik Poupaert <erik@sankuru.biz>
+ *
+ * @section LICENSE
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU LGPL as
+ * published by the Free Software Foundation; either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * LGPL for more details at: http://www.gnu.org/licenses/lgpl.html
+ *
+ * @section DESCRIPTION
+ *
+ * Hex and base64 encoding and decoding, into caller memory or buffers, whole or in chunks.
+ * Kernels for AVX2 and SSSE3 are picked at run time, with a scalar fallback.
+ *
+ */
+#include <string.h>
+#include <pthread.h>
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define CODEC_X86
+#include <immintrin.h>
+#endif
+#include "object.h"
+#include "codec.h"
+
+//PRIVATE
+
+static const char codec_hex_digits[]="0123456789abcdef";
+static const char *codec_alphabets[]=
+{
+	"ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/",
+	"ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789-_"
+};
+
+/* kernels for whole blocks: each returns the number of bytes of 'src' it took, and leaves the rest to the scalar code */
+typedef size_t (*codec_kernel)(char *dest, const char *src, size_t size, const char *alphabet);
+
+typedef struct
+{
+	codec_kernel base64_encode;
+	codec_kernel base64_decode;
+	codec_kernel hex_encode;
+	codec_kernel hex_decode;
+} _codec_kernels;
+
+static _codec_kernels codec_kernels;
+static signed char codec_base64_values[2][256]; //value of every character per alphabet; -1 if not in it
+static pthread_once_t codec_once=PTHREAD_ONCE_INIT;
+
+static size_t codec_none(char *dest, const char *src, size_t size, const char *alphabet)
+{
+	(void)dest;
+	(void)src;
+	(void)size;
+	(void)alphabet;
+	return 0;
+}
+
+#ifdef CODEC_X86
+
+/**
+* Marks the bytes between 'low' and 'high'; signed compares leave out the bytes from 0x80 on.
+*/
+__attribute__((target("ssse3")))
+static __m128i codec_range(__m128i v, char low, char high)
+{
+	return _mm_and_si128(_mm_cmpgt_epi8(v,_mm_set1_epi8((char)(low-1))),_mm_cmplt_epi8(v,_mm_set1_epi8((char)(high+1))));
+}
+
+/**
+* Maps the 6-bit values of 16 bytes to the characters of an alphabet: a saturating subtract and a compare
+* pick one of 14 offsets, which pshufb looks up.
+*/
+__attribute__((target("ssse3")))
+static __m128i codec_base64_offsets(const char *alphabet)
+{
+	return _mm_setr_epi8('a'-26, '0'-52, '0'-52, '0'-52, '0'-52, '0'-52, '0'-52, '0'-52, '0'-52, '0'-52, '0'-52,
+		(char)(alphabet[62]-62), (char)(alphabet[63]-63), 'A', 0, 0);
+}
+
+/**
+* Splits the bytes 0-11 of every 16 into 16 values of 6 bits.
+*/
+__attribute__((target("ssse3")))
+static __m128i codec_base64_split(__m128i in)
+{
+	__m128i t0, t1;
+	in=_mm_shuffle_epi8(in,_mm_set_epi8(10, 11, 9, 10, 7, 8, 6, 7, 4, 5, 3, 4, 1, 2, 0, 1));
+	t0=_mm_mulhi_epu16(_mm_and_si128(in,_mm_set1_epi32(0x0fc0fc00)),_mm_set1_epi32(0x04000040));
+	t1=_mm_mullo_epi16(_mm_and_si128(in,_mm_set1_epi32(0x003f03f0)),_mm_set1_epi32(0x01000010));
+	return _mm_or_si128(t0,t1);
+}
+
+__attribute__((target("ssse3")))
+static __m128i codec_base64_chars(__m128i values, __m128i offsets)
+{
+	__m128i index=_mm_subs_epu8(values,_mm_set1_epi8(51));
+	index=_mm_or_si128(index,_mm_and_si128(_mm_cmpgt_epi8(_mm_set1_epi8(26),values),_mm_set1_epi8(13)));
+	return _mm_add_epi8(_mm_shuffle_epi8(offsets,index),values);
+}
+
+/**
+* Maps 16 characters to their 6-bit values; 'valid' receives a bitmask of the ones in the alphabet.
+*/
+__attribute__((target("ssse3")))
+static __m128i codec_base64_values16(__m128i v, const char *alphabet, unsigned *valid)
+{
+	__m128i upper=codec_range(v,'A','Z');
+	__m128i lower=codec_range(v,'a','z');
+	__m128i digit=codec_range(v,'0','9');
+	__m128i c62=_mm_cmpeq_epi8(v,_mm_set1_epi8(alphabet[62]));
+	__m128i c63=_mm_cmpeq_epi8(v,_mm_set1_epi8(alphabet[63]));
+	*valid=(unsigned)_mm_movemask_epi8(_mm_or_si128(_mm_or_si128(upper,lower),_mm_or_si128(digit,_mm_or_si128(c62,c63))));
+	return _mm_or_si128(
+		_mm_or_si128(_mm_and_si128(upper,_mm_add_epi8(v,_mm_set1_epi8(-65))),_mm_and_si128(lower,_mm_add_epi8(v,_mm_set1_epi8(-71)))),
+		_mm_or_si128(_mm_and_si128(digit,_mm_add_epi8(v,_mm_set1_epi8(4))),
+			_mm_or_si128(_mm_and_si128(c62,_mm_set1_epi8(62)),_mm_and_si128(c63,_mm_set1_epi8(63)))));
+}
+
+/**
+* Joins 16 values of 6 bits into 12 bytes, at the start of the result.
+*/
+__attribute__((target("ssse3")))
+static __m128i codec_base64_join(__m128i values)
+{
+	__m128i merged=_mm_madd_epi16(_mm_maddubs_epi16(values,_mm_set1_epi32(0x01400140)),_mm_set1_epi32(0x00011000));
+	return _mm_shuffle_epi8(merged,_mm_setr_epi8(2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1));
+}
+
+/**
+* 12 bytes to 16 characters at a time; reads 16 bytes.
+*/
+__attribute__((target("ssse3")))
+static size_t codec_base64_encode_ssse3(char *dest, const char *src, size_t size, const char *alphabet)
+{
+	__m128i offsets=codec_base64_offsets(alphabet);
+	size_t i=0;
+	for(; i+16<=size; i+=12, dest+=16)
+	{
+		__m128i values=codec_base64_split(_mm_loadu_si128((const __m128i *)(src+i)));
+		_mm_storeu_si128((__m128i *)dest,codec_base64_chars(values,offsets));
+	}
+	return i;
+}
+
+/**
+* 16 characters to 12 bytes at a time; writes 16 bytes, so it stops while more than 4 bytes of output
+* are still to come. Stops at the first block with a character outside the alphabet, such as padding.
+*/
+__attribute__((target("ssse3")))
+static size_t codec_base64_decode_ssse3(char *dest, const char *src, size_t size, const char *alphabet)
+{
+	size_t i=0;
+	unsigned valid;
+	for(; i+24<=size; i+=16, dest+=12)
+	{
+		__m128i values=codec_base64_values16(_mm_loadu_si128((const __m128i *)(src+i)),alphabet,&valid);
+		if(valid!=0xffff) break;
+		_mm_storeu_si128((__m128i *)dest,codec_base64_join(values));
+	}
+	return i;
+}
+
+__attribute__((target("ssse3")))
+static size_t codec_hex_encode_ssse3(char *dest, const char *src, size_t size, const char *alphabet)
+{
+	__m128i digits=_mm_loadu_si128((const __m128i *)codec_hex_digits);
+	__m128i nibble=_mm_set1_epi8(0x0f);
+	size_t i=0;
+	(void)alphabet;
+	for(; i+16<=size; i+=16, dest+=32)
+	{
+		__m128i v=_mm_loadu_si128((const __m128i *)(src+i));
+		__m128i high=_mm_shuffle_epi8(digits,_mm_and_si128(_mm_srli_epi16(v,4),nibble));
+		__m128i low=_mm_shuffle_epi8(digits,_mm_and_si128(v,nibble));
+		_mm_storeu_si128((__m128i *)dest,_mm_unpacklo_epi8(high,low));
+		_mm_storeu_si128((__m128i *)(dest+16),_mm_unpackhi_epi8(high,low));
+	}
+	return i;
+}
+
+/**
+* Maps 16 hex digits to pairs of nibbles joined in 16-bit words; 'valid' receives a bitmask of the digits.
+*/
+__attribute__((target("ssse3")))
+static __m128i codec_hex_values16(__m128i v, unsigned *valid)
+{
+	__m128i folded=_mm_or_si128(v,_mm_set1_epi8(0x20));
+	__m128i digit=codec_range(v,'0','9');
+	__m128i letter=codec_range(folded,'a','f');
+	__m128i values=_mm_or_si128(_mm_and_si128(digit,_mm_sub_epi8(v,_mm_set1_epi8('0'))),
+		_mm_and_si128(letter,_mm_sub_epi8(folded,_mm_set1_epi8('a'-10))));
+	*valid=(unsigned)_mm_movemask_epi8(_mm_or_si128(digit,letter));
+	return _mm_maddubs_epi16(values,_mm_set1_epi16(0x0110));
+}
+
+__attribute__((target("ssse3")))
+static size_t codec_hex_decode_ssse3(char *dest, const char *src, size_t size, const char *alphabet)
+{
+	size_t i=0;
+	unsigned valid0, valid1;
+	(void)alphabet;
+	for(; i+32<=size; i+=32, dest+=16)
+	{
+		__m128i words0=codec_hex_values16(_mm_loadu_si128((const __m128i *)(src+i)),&valid0);
+		__m128i words1=codec_hex_values16(_mm_loadu_si128((const __m128i *)(src+i+16)),&valid1);
+		if((valid0&valid1)!=0xffff) break;
+		_mm_storeu_si128((__m128i *)dest,_mm_packus_epi16(words0,words1));
+	}
+	return i;
+}
+
+__attribute__((target("avx2")))
+static __m256i codec_range256(__m256i v, char low, char high)
+{
+	return _mm256_and_si256(_mm256_cmpgt_epi8(v,_mm256_set1_epi8((char)(low-1))),_mm256_cmpgt_epi8(_mm256_set1_epi8((char)(high+1)),v));
+}
+
+/**
+* 24 bytes to 32 characters at a time: the two lanes get 12 bytes each, and are processed as with SSSE3;
+* reads 28 bytes.
+*/
+__attribute__((target("avx2")))
+static size_t codec_base64_encode_avx2(char *dest, const char *src, size_t size, const char *alphabet)
+{
+	__m256i offsets=_mm256_broadcastsi128_si256(codec_base64_offsets(alphabet));
+	__m256i split=_mm256_broadcastsi128_si256(_mm_set_epi8(10, 11, 9, 10, 7, 8, 6, 7, 4, 5, 3, 4, 1, 2, 0, 1));
+	size_t i=0;
+	for(; i+28<=size; i+=24, dest+=32)
+	{
+		__m256i in=_mm256_inserti128_si256(_mm256_castsi128_si256(_mm_loadu_si128((const __m128i *)(src+i))),
+			_mm_loadu_si128((const __m128i *)(src+i+12)),1);
+		__m256i values, index;
+		in=_mm256_shuffle_epi8(in,split);
+		values=_mm256_or_si256(
+			_mm256_mulhi_epu16(_mm256_and_si256(in,_mm256_set1_epi32(0x0fc0fc00)),_mm256_set1_epi32(0x04000040)),
+			_mm256_mullo_epi16(_mm256_and_si256(in,_mm256_set1_epi32(0x003f03f0)),_mm256_set1_epi32(0x01000010)));
+		index=_mm256_subs_epu8(values,_mm256_set1_epi8(51));
+		index=_mm256_or_si256(index,_mm256_and_si256(_mm256_cmpgt_epi8(_mm256_set1_epi8(26),values),_mm256_set1_epi8(13)));
+		_mm256_storeu_si256((__m256i *)dest,_mm256_add_epi8(_mm256_shuffle_epi8(offsets,index),values));
+	}
+	if(i+16<=size) i+=codec_base64_encode_ssse3(dest,src+i,size-i,alphabet);
+	return i;
+}
+
+/**
+* 32 characters to 24 bytes at a time; writes 32 bytes, so it stops while more than 8 bytes of output
+* are still to come.
+*/
+__attribute__((target("avx2")))
+static size_t codec_base64_decode_avx2(char *dest, const char *src, size_t size, const char *alphabet)
+{
+	size_t i=0;
+	for(; i+48<=size; i+=32, dest+=24)
+	{
+		__m256i v=_mm256_loadu_si256((const __m256i *)(src+i));
+		__m256i upper=codec_range256(v,'A','Z');
+		__m256i lower=codec_range256(v,'a','z');
+		__m256i digit=codec_range256(v,'0','9');
+		__m256i c62=_mm256_cmpeq_epi8(v,_mm256_set1_epi8(alphabet[62]));
+		__m256i c63=_mm256_cmpeq_epi8(v,_mm256_set1_epi8(alphabet[63]));
+		__m256i values, merged;
+		if((unsigned)_mm256_movemask_epi8(_mm256_or_si256(_mm256_or_si256(upper,lower),_mm256_or_si256(digit,_mm256_or_si256(c62,c63))))!=0xffffffffu) break;
+		values=_mm256_or_si256(
+			_mm256_or_si256(_mm256_and_si256(upper,_mm256_add_epi8(v,_mm256_set1_epi8(-65))),_mm256_and_si256(lower,_mm256_add_epi8(v,_mm256_set1_epi8(-71)))),
+			_mm256_or_si256(_mm256_and_si256(digit,_mm256_add_epi8(v,_mm256_set1_epi8(4))),
+				_mm256_or_si256(_mm256_and_si256(c62,_mm256_set1_epi8(62)),_mm256_and_si256(c63,_mm256_set1_epi8(63)))));
+		merged=_mm256_madd_epi16(_mm256_maddubs_epi16(values,_mm256_set1_epi32(0x01400140)),_mm256_set1_epi32(0x00011000));
+		merged=_mm256_shuffle_epi8(merged,_mm256_broadcastsi128_si256(_mm_setr_epi8(2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1)));
+		//the 12 bytes of each lane next to each other
+		merged=_mm256_permutevar8x32_epi32(merged,_mm256_setr_epi32(0, 1, 2, 4, 5, 6, 7, 7));
+		_mm256_storeu_si256((__m256i *)dest,merged);
+	}
+	if(i+24<=size) i+=codec_base64_decode_ssse3(dest,src+i,size-i,alphabet);
+	return i;
+}
+
+__attribute__((target("avx2")))
+static size_t codec_hex_encode_avx2(char *dest, const char *src, size_t size, const char *alphabet)
+{
+	__m256i digits=_mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i *)codec_hex_digits));
+	__m256i nibble=_mm256_set1_epi8(0x0f);
+	size_t i=0;
+	for(; i+32<=size; i+=32, dest+=64)
+	{
+		__m256i v=_mm256_loadu_si256((const __m256i *)(src+i));
+		__m256i high=_mm256_shuffle_epi8(digits,_mm256_and_si256(_mm256_srli_epi16(v,4),nibble));
+		__m256i low=_mm256_shuffle_epi8(digits,_mm256_and_si256(v,nibble));
+		__m256i first=_mm256_unpacklo_epi8(high,low);
+		__m256i second=_mm256_unpackhi_epi8(high,low);
+		_mm256_storeu_si256((__m256i *)dest,_mm256_permute2x128_si256(first,second,0x20));
+		_mm256_storeu_si256((__m256i *)(dest+32),_mm256_permute2x128_si256(first,second,0x31));
+	}
+	if(i+16<=size) i+=codec_hex_encode_ssse3(dest,src+i,size-i,alphabet);
+	return i;
+}
+
+__attribute__((target("avx2")))
+static __m256i codec_hex_values32(__m256i v, unsigned *valid)
+{
+	__m256i folded=_mm256_or_si256(v,_mm256_set1_epi8(0x20));
+	__m256i digit=codec_range256(v,'0','9');
+	__m256i letter=codec_range256(folded,'a','f');
+	__m256i values=_mm256_or_si256(_mm256_and_si256(digit,_mm256_sub_epi8(v,_mm256_set1_epi8('0'))),
+		_mm256_and_si256(letter,_mm256_sub_epi8(folded,_mm256_set1_epi8('a'-10))));
+	*valid=(unsigned)_mm256_movemask_epi8(_mm256_or_si256(digit,letter));
+	return _mm256_maddubs_epi16(values,_mm256_set1_epi16(0x0110));
+}
+
+__attribute__((target("avx2")))
+static size_t codec_hex_decode_avx2(char *dest, const char *src, size_t size, const char *alphabet)
+{
+	size_t i=0;
+	unsigned valid0, valid1;
+	for(; i+64<=size; i+=64, dest+=32)
+	{
+		__m256i words0=codec_hex_values32(_mm256_loadu_si256((const __m256i *)(src+i)),&valid0);
+		__m256i words1=codec_hex_values32(_mm256_loadu_si256((const __m256i *)(src+i+32)),&valid1);
+		if((valid0&valid1)!=0xffffffffu) break;
+		//packing works per lane: put the quadwords back in order
+		_mm256_storeu_si256((__m256i *)dest,_mm256_permute4x64_epi64(_mm256_packus_epi16(words0,words1),0xd8));
+	}
+	if(i+32<=size) i+=codec_hex_decode_ssse3(dest,src+i,size-i,alphabet);
+	return i;
+}
+
+#endif
+
+static void codec_init_once()
+{
+	int a, i;
+	memset(codec_base64_values,-1,sizeof(codec_base64_values));
+	for(a=0; a<2; a++)
+		for(i=0; i<64; i++) codec_base64_values[a][(unsigned char)codec_alphabets[a][i]]=(signed char)i;
+	codec_kernels.base64_encode=codec_none;
+	codec_kernels.base64_decode=codec_none;
+	codec_kernels.hex_encode=codec_none;
+	codec_kernels.hex_decode=codec_none;
+#ifdef CODEC_X86
+	__builtin_cpu_init();
+	if(__builtin_cpu_supports("avx2"))
+	{
+		codec_kernels.base64_encode=codec_base64_encode_avx2;
+		codec_kernels.base64_decode=codec_base64_decode_avx2;
+		codec_kernels.hex_encode=codec_hex_encode_avx2;
+		codec_kernels.hex_decode=codec_hex_decode_avx2;
+	}
+	else if(__builtin_cpu_supports("ssse3"))
+	{
+		codec_kernels.base64_encode=codec_base64_encode_ssse3;
+		codec_kernels.base64_decode=codec_base64_decode_ssse3;
+		codec_kernels.hex_encode=codec_hex_encode_ssse3;
+		codec_kernels.hex_decode=codec_hex_decode_ssse3;
+	}
+#endif
+}
+
+static void codec_init()
+{
+	pthread_once(&codec_once,codec_init_once);
+}
+
+static size_t codec_base64_encode(CODEC codec, char *dest, const char *src, size_t size)
+{
+	const char *alphabet=codec_alphabets[codec==CODEC_BASE64_URL];
+	const unsigned char *s;
+	size_t i=codec_kernels.base64_encode(dest,src,size,alphabet);
+	char *d=dest+i/3*4;
+	s=(const unsigned char *)src;
+	for(; i+3<=size; i+=3)
+	{
+		unsigned group=(unsigned)s[i]<<16|(unsigned)s[i+1]<<8|s[i+2];
+		*d++=alphabet[group>>18];
+		*d++=alphabet[(group>>12)&63];
+		*d++=alphabet[(group>>6)&63];
+		*d++=alphabet[group&63];
+	}
+	if(i<size)
+	{
+		unsigned group=(unsigned)s[i]<<16|(i+1<size?(unsigned)s[i+1]<<8:0);
+		*d++=alphabet[group>>18];
+		*d++=alphabet[(group>>12)&63];
+		if(i+1<size) *d++=alphabet[(group>>6)&63];
+		if(codec==CODEC_BASE64)
+		{
+			if(i+1==size) *d++='=';
+			*d++='=';
+		}
+	}
+	return (size_t)(d-dest);
+}
+
+static size_t codec_hex_encode(char *dest, const char *src, size_t size)
+{
+	size_t i=codec_kernels.hex_encode(dest,src,size,NULL);
+	for(; i<size; i++)
+	{
+		unsigned char c=(unsigned char)src[i];
+		dest[2*i]=codec_hex_digits[c>>4];
+		dest[2*i+1]=codec_hex_digits[c&15];
+	}
+	return 2*size;
+}
+
+/**
+* Decodes the last 2 or 3 characters of base64, which were not padded to a group of 4, into 1 or 2 bytes.
+* Bits left over, which are zero in canonical base64, are ignored.
+*/
+static bool codec_base64_decode_tail(const signed char *values, char *dest, const char *src, size_t size)
+{
+	int a=values[(unsigned char)src[0]], b=values[(unsigned char)src[1]];
+	int c=size>2?values[(unsigned char)src[2]]:0;
+	if(size<2 || a<0 || b<0 || c<0) return false;
+	dest[0]=(char)(a<<2|b>>4);
+	if(size>2) dest[1]=(char)((b&15)<<4|c>>2);
+	return true;
+}
+
+/**
+* Decodes whole groups of 4 characters; only the last group may end in padding.
+* '*ended' is set if it does.
+*/
+static bool codec_base64_decode_groups(CODEC codec, char *dest, const char *src, size_t size, size_t *written, bool *ended)
+{
+	const signed char *values=codec_base64_values[codec==CODEC_BASE64_URL];
+	size_t i=codec_kernels.base64_decode(dest,src,size,codec_alphabets[codec==CODEC_BASE64_URL]);
+	char *d=dest+i/4*3;
+	*ended=false;
+	for(; i<size; i+=4)
+	{
+		int a=values[(unsigned char)src[i]], b=values[(unsigned char)src[i+1]];
+		int c=values[(unsigned char)src[i+2]], e=values[(unsigned char)src[i+3]];
+		if((a|b|c|e)<0)
+		{
+			size_t tail=src[i+2]=='='?2:3;
+			if(i+4!=size || src[i+3]!='=' || (tail==3 && c<0)) return false;
+			if(!codec_base64_decode_tail(values,d,src+i,tail)) return false;
+			d+=tail-1;
+			*ended=true;
+			break;
+		}
+		d[0]=(char)(a<<2|b>>4);
+		d[1]=(char)((b&15)<<4|c>>2);
+		d[2]=(char)((c&3)<<6|e);
+		d+=3;
+	}
+	*written=(size_t)(d-dest);
+	return true;
+}
+
+static bool codec_base64_decode(CODEC codec, char *dest, const char *src, size_t size, size_t *written)
+{
+	size_t groups=size/4*4, tail=size-groups;
+	bool ended;
+	if(tail==1 || !codec_base64_decode_groups(codec,dest,src,groups,written,&ended)) return false;
+	if(tail==0) return true;
+	if(ended || !codec_base64_decode_tail(codec_base64_values[codec==CODEC_BASE64_URL],dest+*written,src+groups,tail)) return false;
+	*written+=tail-1;
+	return true;
+}
+
+static int codec_hex_value(char c)
+{
+	if(c>='0' && c<='9') return c-'0';
+	if((c|0x20)>='a' && (c|0x20)<='f') return (c|0x20)-'a'+10;
+	return -1;
+}
+
+static bool codec_hex_decode(char *dest, const char *src, size_t size, size_t *written)
+{
+	size_t i;
+	if(size%2!=0) return false;
+	for(i=codec_kernels.hex_decode(dest,src,size,NULL); i<size; i+=2)
+	{
+		int high=codec_hex_value(src[i]), low=codec_hex_value(src[i+1]);
+		if(high<0 || low<0) return false;
+		dest[i/2]=(char)(high<<4|low);
+	}
+	*written=size/2;
+	return true;
+}
+
+/**
+* Decodes into the buffer, after reserving room for the output; the buffer is left as it was on failure.
+*/
+static bool codec_decode_into(buffer b, CODEC codec, const char *src, size_t size)
+{
+	size_t written;
+	buffer_reserve(b,codec_decoded_size(codec,src,size));
+	if(!codec_decode(codec,b->data+b->size,src,size,&written)) return false;
+	b->size+=written;
+	return true;
+}
+
+//PRIVATE
+
+/**
+* Returns the exact number of characters that encoding 'size' bytes gives.
+*
+* @param codec the encoding.
+* @param size the number of bytes.
+* @return the size of the encoded text.
+*/
+size_t codec_encoded_size(CODEC codec, size_t size)
+{
+	switch(codec)
+	{
+		case CODEC_HEX: return 2*size;
+		case CODEC_BASE64: return (size+2)/3*4;
+		default: return size/3*4+(size%3!=0?size%3+1:0);
+	}
+}
+
+/**
+* Returns the exact number of bytes that decoding valid text gives; for invalid text, no less than
+* codec_decode() writes before it finds out. Padding is taken into account, so that base64 can be
+* decoded straight into memory of the exact size.
+*
+* @param codec the encoding.
+* @param src the encoded text.
+* @param size the number of characters.
+* @return the size of the decoded bytes.
+*/
+size_t codec_decoded_size(CODEC codec, const char *src, size_t size)
+{
+	if(codec==CODEC_HEX) return size/2;
+	if(size>0 && src[size-1]=='=') size--;
+	if(size>0 && src[size-1]=='=') size--;
+	return size/4*3+(size%4>1?size%4-1:0);
+}
+
+/**
+* Encodes bytes into caller memory, with the AVX2 or SSSE3 kernels that the CPU supports, picked
+* on first use, or with scalar code. No terminating null character is written.
+*
+* @param codec the encoding.
+* @param dest receives the text; room for codec_encoded_size() characters.
+* @param src the bytes.
+* @param size the number of bytes.
+* @return the number of characters written, which is codec_encoded_size().
+*/
+size_t codec_encode(CODEC codec, char *dest, const char *src, size_t size)
+{
+	codec_init();
+	if(codec==CODEC_HEX) return codec_hex_encode(dest,src,size);
+	return codec_base64_encode(codec,dest,src,size);
+}
+
+/**
+* Decodes text into caller memory; see codec_encode().
+* Hex digits may be of either case. Base64 may be padded or not, whatever the alphabet;
+* whitespace and characters of the other alphabet are errors.
+*
+* @param codec the encoding.
+* @param dest receives the bytes; room for codec_decoded_size() bytes.
+* @param src the text.
+* @param size the number of characters.
+* @param written receives the number of bytes written.
+* @return true; or false, if the text is not valid, in which case 'dest' may have been written to.
+*/
+bool codec_decode(CODEC codec, char *dest, const char *src, size_t size, size_t *written)
+{
+	codec_init();
+	*written=0;
+	if(codec==CODEC_HEX) return codec_hex_decode(dest,src,size,written);
+	return codec_base64_decode(codec,dest,src,size,written);
+}
+
+/**
+* Appends the encoding of some bytes to a buffer, which grows at most once.
+*
+* @param b the buffer.
+* @param codec the encoding.
+* @param v the bytes.
+*/
+void codec_encode_append(buffer b, CODEC codec, view v)
+{
+	size_t size=codec_encoded_size(codec,v.size);
+	buffer_reserve(b,size);
+	b->size+=codec_encode(codec,b->data+b->size,v.data,v.size);
+}
+
+/**
+* Appends the bytes that some text decodes to to a buffer, which grows at most once.
+*
+* @param b the buffer.
+* @param codec the encoding.
+* @param v the text.
+* @return true; or false, if the text is not valid, in which case the buffer is left as it was.
+*/
+bool codec_decode_append(buffer b, CODEC codec, view v)
+{
+	codec_init();
+	return codec_decode_into(b,codec,v.data,v.size);
+}
+
+/**
+* Creates the state for encoding or decoding input that comes in chunks, such as reads from a socket.
+* Chunks may end anywhere: the bytes of an incomplete group are carried over to the next chunk.
+*
+* @param codec the encoding.
+* @return A pointer to the new state.
+*/
+codec_stream codec_stream_new(CODEC codec)
+{
+	codec_stream s=(codec_stream)object_new(sizeof(_codec_stream));
+	s->codec=codec;
+	codec_init();
+	return s;
+}
+
+/**
+* Appends the encoding of a chunk of bytes to a buffer; see codec_stream_new().
+*
+* @param s the state.
+* @param b the buffer.
+* @param chunk the bytes.
+*/
+void codec_stream_encode(codec_stream s, buffer b, view chunk)
+{
+	size_t whole;
+	if(s->codec==CODEC_HEX)
+	{
+		codec_encode_append(b,s->codec,chunk);
+		return;
+	}
+	if(s->carried>0)
+	{
+		while(s->carried<3 && chunk.size>0)
+		{
+			s->carry[s->carried++]=*chunk.data++;
+			chunk.size--;
+		}
+		if(s->carried<3) return;
+		codec_encode_append(b,s->codec,view_new(s->carry,3));
+		s->carried=0;
+	}
+	whole=chunk.size/3*3;
+	codec_encode_append(b,s->codec,view_new(chunk.data,whole));
+	memcpy(s->carry,chunk.data+whole,chunk.size-whole);
+	s->carried=chunk.size-whole;
+}
+
+/**
+* Appends the encoding of the bytes carried over from the last chunk, with padding if the encoding has it.
+*
+* @param s the state.
+* @param b the buffer.
+*/
+void codec_stream_encode_end(codec_stream s, buffer b)
+{
+	codec_encode_append(b,s->codec,view_new(s->carry,s->carried));
+	s->carried=0;
+}
+
+/**
+* Appends the bytes that a chunk of text decodes to to a buffer; see codec_stream_new().
+* Padding may only come at the very end of the input.
+*
+* @param s the state.
+* @param b the buffer.
+* @param chunk the text.
+* @return true; or false, if the text is not valid, in which case the buffer may hold part of the output.
+*/
+bool codec_stream_decode(codec_stream s, buffer b, view chunk)
+{
+	size_t group=s->codec==CODEC_HEX?2:4;
+	size_t whole, written;
+	bool ended;
+	if(chunk.size==0) return true;
+	if(s->ended) return false;
+	if(s->carried>0)
+	{
+		while(s->carried<group && chunk.size>0)
+		{
+			s->carry[s->carried++]=*chunk.data++;
+			chunk.size--;
+		}
+		if(s->carried<group) return true;
+		s->carried=0;
+		if(s->codec==CODEC_HEX) return codec_decode_into(b,s->codec,s->carry,group) && codec_stream_decode(s,b,chunk);
+		buffer_reserve(b,3);
+		if(!codec_base64_decode_groups(s->codec,b->data+b->size,s->carry,group,&written,&s->ended)) return false;
+		b->size+=written;
+		return codec_stream_decode(s,b,chunk);
+	}
+	whole=chunk.size/group*group;
+	if(s->codec==CODEC_HEX)
+	{
+		if(!codec_decode_into(b,s->codec,chunk.data,whole)) return false;
+	}
+	else
+	{
+		buffer_reserve(b,codec_decoded_size(s->codec,chunk.data,whole));
+		if(!codec_base64_decode_groups(s->codec,b->data+b->size,chunk.data,whole,&written,&ended)) return false;
+		b->size+=written;
+		s->ended=ended;
+		if(ended && whole<chunk.size) return false;
+	}
+	memcpy(s->carry,chunk.data+whole,chunk.size-whole);
+	s->carried=chunk.size-whole;
+	return true;
+}
+
+/**
+* Appends the bytes that the characters carried over from the last chunk decode to, for base64 that is not padded.
+*
+* @param s the state.
+* @param b the buffer.
+* @return true; or false, if the input ended in the middle of a group.
+*/
+bool codec_stream_decode_end(codec_stream s, buffer b)
+{
+	size_t carried=s->carried;
+	s->carried=0;
+	if(carried==0) return true;
+	if(s->codec==CODEC_HEX) return false;
+	return codec_decode_into(b,s->codec,s->carry,carried);
+}
@@ -0,0 +1,75 @@
+/**
+ *
+ * libscriptify
+ *
+ * @author  Erik Poupaert <erik@sankuru.biz>
+ *
+ * @section LICENSE
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU LGPL as
+ * published by the Free Software Foundation; either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * LGPL for more details at: http://www.gnu.org/licenses/lgpl.html
+ *
+ * @section DESCRIPTION
+ *
+ * Hex and base64 encoding and decoding, into caller memory or buffers, whole or in chunks.
+ * Kernels for AVX2 and SSSE3 are picked at run time, with a scalar fallback.
+ *
+ */
+#ifndef _CODEC_H
+#define _CODEC_H
+
+#include <stddef.h>
+#include <stdbool.h>
+#include "view.h"
+#include "buffer.h"
+
+#ifdef __cplusplus
+	extern "C" {
+#endif
+
+enum _CODEC
+{
+	  CODEC_HEX //two lower-case hex digits per byte; decoding takes either case
+	, CODEC_BASE64 //RFC 4648 base64 with + and /, padded with =
+	, CODEC_BASE64_URL //RFC 4648 base64url with - and _, without padding
+};
+
+typedef enum _CODEC CODEC;
+
+/* state of chunked encoding or decoding */
+typedef struct
+{
+	CODEC codec;
+	char carry[4]; //bytes of an incomplete group, from the end of the previous chunk
+	size_t carried;
+	bool ended; //decoding: the padding was seen, so no more input may follow
+} _codec_stream;
+
+typedef _codec_stream* codec_stream;
+
+size_t codec_encoded_size(CODEC codec, size_t size);
+size_t codec_decoded_size(CODEC codec, const char *src, size_t size);
+size_t codec_encode(CODEC codec, char *dest, const char *src, size_t size);
+bool codec_decode(CODEC codec, char *dest, const char *src, size_t size, size_t *written);
+void codec_encode_append(buffer b, CODEC codec, view v);
+bool codec_decode_append(buffer b, CODEC codec, view v);
+
+/* chunked input */
+codec_stream codec_stream_new(CODEC codec);
+void codec_stream_encode(codec_stream s, buffer b, view chunk);
+void codec_stream_encode_end(codec_stream s, buffer b);
+bool codec_stream_decode(codec_stream s, buffer b, view chunk);
+bool codec_stream_decode_end(codec_stream s, buffer b);
+
+#ifdef __cplusplus
+	}
+#endif
+
+#endif // _CODEC_H
@@ -0,0 +1,642 @@
+/**
+ *
+ * libscriptify
+ *
+ * @author  Erik Poupaert <erik@sankuru.biz>
+ *
+ * @section LICENSE
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU LGPL as
+ * published by the Free Software Foundation; either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * LGPL for more details at: http://www.gnu.org/licenses/lgpl.html
+ *
+ * @section DESCRIPTION
+ *
+ * Reading of CSV and TSV data as in RFC 4180: records are split into fields that are views
+ * into the input, and converted to rows of any values, either typed as declared or inferred,
+ * or to typed columns. Large inputs can be split into chunks that are parsed in parallel.
+ *
+ */
+#include <stdint.h>
+#include <string.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+#include "object.h"
+#include "string_utf8.h"
+#include "number.h"
+#include "map.h"
+#include "threadpool.h"
+#include "csv.h"
+
+//PRIVATE
+
+typedef struct
+{
+	const char *data;
+	size_t size;
+	size_t parts;
+	size_t *quotes; //number of quotes in each nominal part
+	char quote;
+} _csv_split_job;
+
+typedef _csv_split_job* csv_split_job;
+
+static csv csv_new(char delimiter)
+{
+	csv c=(csv)object_new(sizeof(_csv));
+	c->delimiter=delimiter;
+	c->quote='"';
+	c->fields_capacity=CSV_FIELDS_CAPACITY;
+	c->fields=(view *)object_new(c->fields_capacity*sizeof(view));
+	return c;
+}
+
+/**
+* Returns the first delimiter, CR or LF at or after 'p', or 'end' if there is none.
+*/
+static const char *csv_scan(const char *p, const char *end, char delimiter)
+{
+#ifdef __SSE2__
+	__m128i d=_mm_set1_epi8(delimiter);
+	__m128i lf=_mm_set1_epi8(CHAR_LF);
+	__m128i cr=_mm_set1_epi8(CHAR_CR);
+	while(end-p>=16)
+	{
+		__m128i v=_mm_loadu_si128((const __m128i *)p);
+		unsigned mask=(unsigned)_mm_movemask_epi8(_mm_or_si128(_mm_cmpeq_epi8(v,d),
+			_mm_or_si128(_mm_cmpeq_epi8(v,lf),_mm_cmpeq_epi8(v,cr))));
+		if(mask!=0) return p+__builtin_ctz(mask);
+		p+=16;
+	}
+#endif
+	while(p<end && *p!=delimiter && *p!=CHAR_LF && *p!=CHAR_CR) p++;
+	return p;
+}
+
+/**
+* Copies the inside of a quoted field without its escaping quotes, followed by the 'extra_size' bytes
+* at 'extra' that stood between the closing quote and the end of the field.
+*/
+static view csv_unescape(const char *data, size_t size, char quote, const char *extra, size_t extra_size)
+{
+	char *copy=(char *)object_new_atomic(size+extra_size+1);
+	size_t i, n=0;
+	for(i=0; i<size; i++)
+	{
+		copy[n++]=data[i];
+		if(data[i]==quote && i+1<size && data[i+1]==quote) i++;
+	}
+	if(extra_size>0) memcpy(copy+n,extra,extra_size);
+	n+=extra_size;
+	copy[n]=0;
+	return view_new(copy,n);
+}
+
+static void csv_add_field(csv c, view field)
+{
+	if(c->count==c->fields_capacity)
+	{
+		c->fields_capacity*=2;
+		c->fields=(view *)object_resize(c->fields,c->fields_capacity*sizeof(view));
+	}
+	c->fields[c->count++]=field;
+}
+
+/**
+* Parses the quoted field whose opening quote is at 'p'; '*next' receives the end of the field.
+* Returns false if the field may go on past 'end' and more input is needed first.
+*/
+static bool csv_parse_quoted(csv c, const char *p, const char *end, bool eof, const char **next)
+{
+	const char *from=p+1, *close, *after;
+	bool doubled=false;
+	while(1)
+	{
+		close=(const char *)memchr(from,c->quote,(size_t)(end-from));
+		if(close==NULL || close+1==end)
+		{
+			//whether a quote closes the field or starts a doubled quote depends on the next byte
+			if(!eof) return false;
+			if(close==NULL)
+			{
+				c->malformed=true;
+				close=end;
+			}
+			break;
+		}
+		if(close[1]!=c->quote) break;
+		doubled=true;
+		from=close+2;
+	}
+	after=close<end?close+1:end;
+	if(after<end && *after!=c->delimiter && *after!=CHAR_LF && *after!=CHAR_CR)
+	{
+		//bytes between the closing quote and the delimiter are kept, as most readers do
+		*next=csv_scan(after,end,c->delimiter);
+		if(*next==end && !eof) return false;
+		c->malformed=true;
+		csv_add_field(c,csv_unescape(p+1,(size_t)(close-p-1),c->quote,after,(size_t)(*next-after)));
+		return true;
+	}
+	*next=after;
+	if(doubled) csv_add_field(c,csv_unescape(p+1,(size_t)(close-p-1),c->quote,NULL,0));
+	else csv_add_field(c,view_new(p+1,(size_t)(close-p-1)));
+	return true;
+}
+
+/**
+* Splits the record at 'begin' into fields.
+* Returns the number of bytes taken by the record and its line ending, or 0 if the record
+* may go on past 'end' and more input is needed first. An empty line gives a record of no fields.
+*/
+static size_t csv_parse(csv c, const char *begin, const char *end, bool eof)
+{
+	const char *p=begin;
+	c->count=0;
+	if(*p!=CHAR_LF && *p!=CHAR_CR)
+	{
+		while(1)
+		{
+			if(c->quote!=0 && p<end && *p==c->quote)
+			{
+				if(!csv_parse_quoted(c,p,end,eof,&p)) return 0;
+			}
+			else
+			{
+				const char *field=p;
+				p=csv_scan(p,end,c->delimiter);
+				csv_add_field(c,view_new(field,(size_t)(p-field)));
+			}
+			if(p==end) return eof?(size_t)(end-begin):0;
+			if(*p!=c->delimiter) break;
+			p++;
+		}
+	}
+	if(*p==CHAR_CR)
+	{
+		//a CR at the end of the input so far may be followed by an LF
+		if(p+1==end && !eof) return 0;
+		p++;
+		if(p<end && *p==CHAR_LF) p++;
+	}
+	else p++;
+	return (size_t)(p-begin);
+}
+
+static bool csv_is_true(view v)
+{
+	return v.size==4 && memcmp(v.data,"true",4)==0;
+}
+
+static bool csv_is_false(view v)
+{
+	return v.size==5 && memcmp(v.data,"false",5)==0;
+}
+
+/**
+* Infers the type of a field, and parses it: empty fields are CSV_AUTO, "true" and "false" booleans,
+* fields that start like a number and parse as a long or a double numbers, and all others strings.
+*/
+static csv_type csv_infer(view v, long *lng, double *dbl)
+{
+	char first;
+	if(v.size==0) return CSV_AUTO;
+	if(csv_is_true(v) || csv_is_false(v)) return CSV_BOOL;
+	first=v.data[0];
+	if((first>='0' && first<='9') || first=='-' || first=='+' || first=='.')
+	{
+		if(string_to_long(v.data,v.size,lng)) return CSV_LONG;
+		if(string_to_double(v.data,v.size,dbl)) return CSV_DOUBLE;
+	}
+	return CSV_STRING;
+}
+
+/**
+* Converts a field to an any of the given type; CSV_AUTO infers the type.
+* Empty fields, and fields that do not parse as their declared type, become null.
+*/
+static any csv_field_any(view v, csv_type type)
+{
+	long lng;
+	double dbl;
+	if(type==CSV_AUTO) type=csv_infer(v,&lng,&dbl);
+	else if(type==CSV_LONG && !string_to_long(v.data,v.size,&lng)) type=CSV_AUTO;
+	else if(type==CSV_DOUBLE && !string_to_double(v.data,v.size,&dbl)) type=CSV_AUTO;
+	else if(type==CSV_BOOL && !csv_is_true(v) && !csv_is_false(v)) type=CSV_AUTO;
+	switch(type)
+	{
+		case CSV_BOOL: return any_new_bool(csv_is_true(v));
+		case CSV_LONG: return any_new_long(lng);
+		case CSV_DOUBLE: return any_new_double(dbl);
+		case CSV_STRING: return any_new_string_bytes(v.data,v.size);
+		default: return any_new_null();
+	}
+}
+
+static csv_type csv_declared_type(csv c, size_t index)
+{
+	return index<c->types_count?c->types[index]:CSV_AUTO;
+}
+
+static size_t csv_type_size(csv_type type)
+{
+	switch(type)
+	{
+		case CSV_BOOL: return sizeof(bool);
+		case CSV_LONG: return sizeof(long);
+		case CSV_DOUBLE: return sizeof(double);
+		case CSV_STRING: return sizeof(string);
+		default: return 0;
+	}
+}
+
+static void *csv_values_new(csv_type type, size_t capacity)
+{
+	if(type==CSV_AUTO) return NULL;
+	if(type==CSV_STRING) return object_new(capacity*sizeof(string));
+	return object_new_atomic(capacity*csv_type_size(type));
+}
+
+static string csv_value_tostring(csv_column column, size_t row)
+{
+	char digits[NUMBER_MAX_LENGTH];
+	size_t size;
+	switch(column->type)
+	{
+		case CSV_BOOL: return string_new_copy(column->bools[row]?"true":"false");
+		case CSV_LONG: size=number_write_long(digits,column->longs[row]); break;
+		case CSV_DOUBLE: size=number_write_double(digits,column->doubles[row]); break;
+		default: return column->strings[row];
+	}
+	return view_tostring(view_new(digits,size));
+}
+
+/**
+* Changes the type of a column to one that holds both its values and values of type 'type':
+* longs widen to doubles, and mixed types to strings. The values so far are converted.
+*/
+static void csv_column_widen(csv_column column, csv_type type)
+{
+	csv_type wider;
+	void *values;
+	size_t i;
+	if(column->type==type || type==CSV_AUTO || column->type==CSV_STRING) return;
+	if(column->type==CSV_AUTO) wider=type;
+	else if((column->type==CSV_LONG && type==CSV_DOUBLE) || (column->type==CSV_DOUBLE && type==CSV_LONG)) wider=CSV_DOUBLE;
+	else wider=CSV_STRING;
+	if(wider==column->type) return;
+	values=csv_values_new(wider,column->capacity);
+	for(i=0; i<column->size; i++)
+	{
+		if(!column->present[i]) continue;
+		if(wider==CSV_DOUBLE) ((double *)values)[i]=(double)column->longs[i];
+		else ((string *)values)[i]=csv_value_tostring(column,i);
+	}
+	column->type=wider;
+	column->longs=(long *)values;
+}
+
+static void csv_column_reserve(csv_column column, size_t size)
+{
+	size_t capacity=column->capacity;
+	if(size<=capacity) return;
+	while(capacity<size) capacity*=2;
+	column->present=(bool *)object_resize(column->present,capacity*sizeof(bool));
+	if(column->longs!=NULL) column->longs=(long *)object_resize(column->longs,capacity*csv_type_size(column->type));
+	column->capacity=capacity;
+}
+
+/**
+* Adds the field of row 'row' to a column, after padding the rows before it that lacked the column.
+*/
+static void csv_column_add(csv_column column, size_t row, view v, csv_type declared)
+{
+	long lng=0;
+	double dbl=0.0;
+	csv_type type;
+	bool present;
+	csv_column_reserve(column,row+1);
+	while(column->size<row) column->present[column->size++]=false;
+	if(declared==CSV_AUTO)
+	{
+		type=csv_infer(v,&lng,&dbl);
+		csv_column_widen(column,type);
+		present=type!=CSV_AUTO;
+	}
+	else
+	{
+		type=declared;
+		if(declared==CSV_LONG) present=string_to_long(v.data,v.size,&lng);
+		else if(declared==CSV_DOUBLE) present=string_to_double(v.data,v.size,&dbl);
+		else if(declared==CSV_BOOL) present=csv_is_true(v) || csv_is_false(v);
+		else present=true;
+	}
+	column->present[row]=present;
+	column->size=row+1;
+	if(!present) return;
+	switch(column->type)
+	{
+		case CSV_BOOL: column->bools[row]=csv_is_true(v); break;
+		case CSV_LONG: column->longs[row]=lng; break;
+		case CSV_DOUBLE: column->doubles[row]=type==CSV_LONG?(double)lng:dbl; break;
+		case CSV_STRING: column->strings[row]=view_tostring(v); break;
+		default: break;
+	}
+}
+
+static void csv_count_quotes(size_t begin, size_t end, void *arg)
+{
+	csv_split_job job=(csv_split_job)arg;
+	size_t part;
+	for(part=begin; part<end; part++)
+	{
+		const char *p=job->data+part*job->size/job->parts;
+		const char *stop=job->data+(part+1)*job->size/job->parts;
+		size_t count=0;
+		while((p=(const char *)memchr(p,job->quote,(size_t)(stop-p)))!=NULL)
+		{
+			count++;
+			p++;
+		}
+		job->quotes[part]=count;
+	}
+}
+
+//PRIVATE
+
+/**
+* Creates a new CSV reader over a block of memory, such as a mapped file.
+* Fields are views into the block, except for quoted fields with doubled quotes, which are unescaped
+* into a copy. The quote character is '"'; set the 'quote' field to another one, or to 0 for input
+* that is never quoted, such as most TSV.
+*
+* @param input the CSV data; it must stay valid while the fields are used.
+* @param delimiter the byte between fields: ',' for CSV, '\t' for TSV.
+* @return A pointer to the new reader.
+*/
+csv csv_new_view(view input, char delimiter)
+{
+	csv c=csv_new(delimiter);
+	c->input=input;
+	return c;
+}
+
+/**
+* Creates a new CSV reader over a file descriptor, such as a pipe; see csv_new_view().
+* The input is read through a reader, whose buffer grows for records longer than it.
+*
+* @param fd the file descriptor to read from; it is not closed.
+* @param delimiter the byte between fields.
+* @return A pointer to the new reader.
+*/
+csv csv_new_fd(int fd, char delimiter)
+{
+	csv c=csv_new(delimiter);
+	c->source=reader_new_fd(fd);
+	return c;
+}
+
+/**
+* Creates a new CSV reader over a stdio stream; see csv_new_fd().
+*
+* @param file the stream to read from; it is not closed.
+* @param delimiter the byte between fields.
+* @return A pointer to the new reader.
+*/
+csv csv_new_file(FILE *file, char delimiter)
+{
+	csv c=csv_new(delimiter);
+	c->source=reader_new_file(file);
+	return c;
+}
+
+/**
+* Reads the next record into the 'fields' and 'count' of the reader.
+* Records end with LF, CRLF or CR, except inside quoted fields, which may span lines;
+* the last record need not end with a line ending. Empty lines are skipped.
+* Fields are found 16 bytes at a time with SSE2 where available, and closing quotes with memchr().
+* The fields stay valid until the next call only, when reading from a file descriptor or stream.
+* Malformed input is read as most readers do, and sets 'malformed': an unclosed quoted field runs
+* to the end of the input, and bytes after a closing quote are added to the field.
+*
+* @param c the reader.
+* @return true, if a record was read; false, at the end of the input or after a read error, see csv_error().
+*/
+bool csv_next(csv c)
+{
+	size_t used;
+	while(1)
+	{
+		if(c->source==NULL)
+		{
+			if(c->position>=c->input.size) return false;
+			c->position+=csv_parse(c,c->input.data+c->position,c->input.data+c->input.size,true);
+		}
+		else
+		{
+			reader r=c->source;
+			used=r->start<r->end?csv_parse(c,r->data+r->start,r->data+r->end,r->eof):0;
+			if(used==0)
+			{
+				if(r->eof) return false;
+				reader_fill(r);
+				continue;
+			}
+			r->start+=used;
+			r->scanned=0;
+		}
+		if(c->count>0)
+		{
+			c->records++;
+			return true;
+		}
+	}
+}
+
+/**
+* Returns the error of the last failed read.
+*
+* @param c the reader.
+* @return the errno of the failed read; 0 if none failed, or when reading a view.
+*/
+int csv_error(csv c)
+{
+	return c->source!=NULL?reader_error(c->source):0;
+}
+
+/**
+* Reads the next record as the names of the columns, which csv_row_map() and csv_read_columns() use.
+*
+* @param c the reader.
+* @return true, if there was a record; false, if not.
+*/
+bool csv_read_header(csv c)
+{
+	size_t i;
+	if(!csv_next(c)) return false;
+	c->names=(string *)object_new(c->count*sizeof(string));
+	for(i=0; i<c->count; i++) c->names[i]=view_tostring(c->fields[i]);
+	c->names_count=c->count;
+	return true;
+}
+
+/**
+* Declares the types of the first 'count' columns; the types of the other columns, and of columns
+* declared CSV_AUTO, are inferred from every field.
+*
+* @param c the reader.
+* @param types the types of the columns; they are copied.
+* @param count the number of types.
+*/
+void csv_set_types(csv c, const csv_type *types, size_t count)
+{
+	c->types=(csv_type *)object_new_atomic(count*sizeof(csv_type)+1);
+	memcpy(c->types,types,count*sizeof(csv_type));
+	c->types_count=count;
+}
+
+/**
+* Converts the current record to an array any.
+* Fields of declared columns are parsed to their type, and become null if empty or if they do not parse.
+* The types of the other fields are inferred: empty fields are null, "true" and "false" booleans,
+* integers longs, other numbers doubles, and all else strings.
+*
+* @param c the reader, after csv_next() returned true.
+* @return A pointer to the new array any.
+*/
+any csv_row(csv c)
+{
+	manyany items=(manyany)object_new(c->count*sizeof(any)+1);
+	size_t i;
+	for(i=0; i<c->count; i++) items[i]=csv_field_any(c->fields[i],csv_declared_type(c,i));
+	return any_new_array(items,c->count);
+}
+
+/**
+* Converts the current record to a map any from the column names read by csv_read_header()
+* to the fields, typed as by csv_row(). Fields without a column name are left out.
+*
+* @param c the reader, after csv_read_header() and csv_next() returned true.
+* @return A pointer to the new map any.
+*/
+any csv_row_map(csv c)
+{
+	map m=map_new();
+	size_t i;
+	for(i=0; i<c->count && i<c->names_count; i++)
+		map_put_string(m,c->names[i],csv_field_any(c->fields[i],csv_declared_type(c,i)));
+	return any_new_map(m);
+}
+
+/**
+* Reads all remaining records into typed columns.
+* Declared columns have their declared type, and their empty and unparsable fields are missing.
+* The types of the other columns widen as their fields come in: a column starts as CSV_AUTO while
+* its fields are empty, and becomes CSV_BOOL, CSV_LONG or CSV_DOUBLE; longs widen to doubles, and
+* mixed types to strings, with the values so far converted, numbers written back the shortest way.
+* Columns take their names from csv_read_header(), if it was called.
+*
+* @param c the reader.
+* @return A pointer to the new table, with all columns 'rows' long.
+*/
+csv_table csv_read_columns(csv c)
+{
+	csv_table table=(csv_table)object_new(sizeof(_csv_table));
+	size_t capacity=0, i;
+	while(csv_next(c))
+	{
+		if(c->count>table->count)
+		{
+			if(c->count>capacity)
+			{
+				capacity=c->count>2*capacity?c->count:2*capacity;
+				table->columns=(csv_column)object_resize(table->columns,capacity*sizeof(_csv_column));
+			}
+			for(i=table->count; i<c->count; i++)
+			{
+				csv_column column=&table->columns[i];
+				memset(column,0,sizeof(_csv_column));
+				column->name=i<c->names_count?c->names[i]:NULL;
+				column->type=csv_declared_type(c,i);
+				column->capacity=CSV_COLUMN_CAPACITY;
+				column->present=(bool *)object_new_atomic(column->capacity*sizeof(bool));
+				column->longs=(long *)csv_values_new(column->type,column->capacity);
+			}
+			table->count=c->count;
+		}
+		for(i=0; i<c->count; i++)
+			csv_column_add(&table->columns[i],table->rows,c->fields[i],csv_declared_type(c,i));
+		table->rows++;
+	}
+	for(i=0; i<table->count; i++)
+	{
+		csv_column column=&table->columns[i];
+		csv_column_reserve(column,table->rows);
+		while(column->size<table->rows) column->present[column->size++]=false;
+	}
+	return table;
+}
+
+/**
+* Cuts CSV data into at most 'parts' chunks of about the same size that each start at a record,
+* so that each can be parsed by its own csv_new_view() on its own thread.
+* An LF only ends a record outside quotes. Whether a point of the input lies inside quotes
+* follows from the number of quotes before it, which is counted for all parts in parallel on
+* the default thread pool; each chunk then ends at the first LF outside quotes after its
+* nominal end. Quotes inside unquoted fields, which RFC 4180 does not allow, throw the count off.
+*
+* @param input the CSV data.
+* @param quote the quote character; 0 if fields are never quoted.
+* @param parts the number of chunks wanted.
+* @param chunks receives the chunks; room for 'parts' of them.
+* @return the number of chunks.
+*/
+size_t csv_split(view input, char quote, size_t parts, view *chunks)
+{
+	_csv_split_job job;
+	size_t count=0, start=0, quotes=0, part;
+	if(input.size==0 || parts==0) return 0;
+	if(parts>input.size) parts=input.size;
+	job.data=input.data;
+	job.size=input.size;
+	job.parts=parts;
+	job.quote=quote;
+	job.quotes=(size_t *)object_new_atomic(parts*sizeof(size_t));
+	if(quote!=0) threadpool_for(threadpool_default(),0,parts,1,csv_count_quotes,&job);
+	else memset(job.quotes,0,parts*sizeof(size_t));
+	for(part=0; part<parts; part++)
+	{
+		size_t nominal=(part+1)*input.size/parts, end;
+		bool quoted;
+		quotes+=job.quotes[part];
+		if(part==parts-1 || nominal<=start)
+		{
+			if(part<parts-1) continue;
+			end=input.size;
+		}
+		else
+		{
+			quoted=(quotes&1)!=0;
+			for(end=nominal; end<input.size; end++)
+			{
+				if(input.data[end]==quote && quote!=0) quoted=!quoted;
+				else if(input.data[end]==CHAR_LF && !quoted) break;
+			}
+			if(end<input.size) end++;
+			//the quotes skipped past belong to the parts that follow, and are counted there
+		}
+		if(end>start)
+		{
+			chunks[count++]=view_new(input.data+start,end-start);
+			start=end;
+		}
+	}
+	return count;
+}
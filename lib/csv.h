@@ -0,0 +1,116 @@
+/**
+ *
+ * libscriptify
+ *
+ * @author  Erik Poupaert <erik@sankuru.biz>
+ *
+ * @section LICENSE
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU LGPL as
+ * published by the Free Software Foundation; either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * LGPL for more details at: http://www.gnu.org/licenses/lgpl.html
+ *
+ * @section DESCRIPTION
+ *
+ * Reading of CSV and TSV data as in RFC 4180: records are split into fields that are views
+ * into the input, and converted to rows of any values, either typed as declared or inferred,
+ * or to typed columns. Large inputs can be split into chunks that are parsed in parallel.
+ *
+ */
+#ifndef _CSV_H
+#define _CSV_H
+
+#include <stddef.h>
+#include <stdbool.h>
+#include "any.h"
+#include "view.h"
+#include "reader.h"
+
+#ifdef __cplusplus
+	extern "C" {
+#endif
+
+/* initial number of fields a record can hold; it grows as needed */
+#define CSV_FIELDS_CAPACITY 16
+/* initial number of rows a column can hold; it grows as needed */
+#define CSV_COLUMN_CAPACITY 1024
+
+typedef enum
+{
+	CSV_AUTO, //infer the type of every field; for a column: only empty fields so far
+	CSV_BOOL,
+	CSV_LONG,
+	CSV_DOUBLE,
+	CSV_STRING
+} csv_type;
+
+typedef struct
+{
+	reader source; //NULL when parsing a view
+	view input; //the input, when parsing a view
+	size_t position; //start of the next record in 'input'
+	char delimiter;
+	char quote; //0: fields are never quoted
+	view *fields; //fields of the current record, valid until the next record is read
+	size_t count;
+	size_t fields_capacity;
+	size_t records; //number of records read so far
+	bool malformed; //a quoted field was not closed, or had bytes after its closing quote
+	string *names; //column names from csv_read_header(); NULL if none
+	size_t names_count;
+	csv_type *types; //declared column types from csv_set_types(); NULL to infer all
+	size_t types_count;
+} _csv;
+
+typedef _csv* csv;
+
+typedef struct
+{
+	string name; //NULL if there is no header
+	csv_type type;
+	size_t size;
+	size_t capacity;
+	union
+	{
+		long *longs;
+		double *doubles;
+		bool *bools;
+		string *strings;
+	};
+	bool *present; //false for empty and unparsable fields, and for the missing fields of short rows
+} _csv_column;
+
+typedef _csv_column* csv_column;
+
+typedef struct
+{
+	csv_column columns;
+	size_t count;
+	size_t rows;
+} _csv_table;
+
+typedef _csv_table* csv_table;
+
+csv csv_new_view(view input, char delimiter);
+csv csv_new_fd(int fd, char delimiter);
+csv csv_new_file(FILE *file, char delimiter);
+bool csv_next(csv c);
+int csv_error(csv c);
+bool csv_read_header(csv c);
+void csv_set_types(csv c, const csv_type *types, size_t count);
+any csv_row(csv c);
+any csv_row_map(csv c);
+csv_table csv_read_columns(csv c);
+size_t csv_split(view input, char quote, size_t parts, view *chunks);
+
+#ifdef __cplusplus
+	}
+#endif
+
+#endif // _CSV_H
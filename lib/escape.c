@@ -0,0 +1,523 @@
+/**
+ *
+ * libscriptify
+ *
+ * @author  Erik Poupaert <erik@sankuru.biz>
+ *
+ * @section LICENSE
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU LGPL as
+ * published by the Free Software Foundation; either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * LGPL for more details at: http://www.gnu.org/licenses/lgpl.html
+ *
+ * @section DESCRIPTION
+ *
+ * Escaping and unescaping of text for JSON strings, HTML, URLs and shell words.
+ * Runs of bytes that need no escaping are found with SIMD and copied at once.
+ *
+ */
+#include <string.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+#include "object.h"
+#include "escape.h"
+
+//PRIVATE
+
+static const char escape_hex_lower[]="0123456789abcdef";
+static const char escape_hex_upper[]="0123456789ABCDEF";
+
+static bool escape_alnum(unsigned char c)
+{
+	return (c>='0' && c<='9') || ((c|0x20)>='a' && (c|0x20)<='z');
+}
+
+/**
+* Checks if a byte needs escaping in a context; or, when unescaping, if it starts an escape.
+*/
+static bool escape_special(unsigned char c, ESCAPE_CONTEXT context, bool unescape)
+{
+	if(unescape)
+	{
+		switch(context)
+		{
+			case ESCAPE_JSON: return c=='\\';
+			case ESCAPE_HTML: return c=='&';
+			case ESCAPE_URL: return c=='%';
+			default: return c=='\'' || c=='"' || c=='\\';
+		}
+	}
+	switch(context)
+	{
+		case ESCAPE_JSON: return c<0x20 || c=='"' || c=='\\';
+		case ESCAPE_HTML: return c=='&' || c=='<' || c=='>' || c=='"' || c=='\'';
+		case ESCAPE_URL: return !escape_alnum(c) && c!='-' && c!='_' && c!='.' && c!='~';
+		default: return !escape_alnum(c) && (c==0 || strchr("_@%+=:,./-",c)==NULL);
+	}
+}
+
+#ifdef __SSE2__
+
+static __m128i escape_eq(__m128i v, char c)
+{
+	return _mm_cmpeq_epi8(v,_mm_set1_epi8(c));
+}
+
+/**
+* Marks the bytes between 'low' and 'high'; signed compares leave out the bytes from 0x80 on.
+*/
+static __m128i escape_range(__m128i v, char low, char high)
+{
+	return _mm_and_si128(_mm_cmpgt_epi8(v,_mm_set1_epi8((char)(low-1))),_mm_cmplt_epi8(v,_mm_set1_epi8((char)(high+1))));
+}
+
+static __m128i escape_alnum16(__m128i v)
+{
+	return _mm_or_si128(escape_range(v,'0','9'),escape_range(_mm_or_si128(v,_mm_set1_epi8(0x20)),'a','z'));
+}
+
+/**
+* Returns a bitmask of the bytes of 16 that escape_special() picks out.
+*/
+static unsigned escape_mask(__m128i v, ESCAPE_CONTEXT context, bool unescape)
+{
+	__m128i special, safe;
+	if(unescape) special=_mm_or_si128(_mm_or_si128(escape_eq(v,'\''),escape_eq(v,'"')),escape_eq(v,'\\'));
+	else switch(context)
+	{
+		case ESCAPE_JSON:
+			special=_mm_or_si128(_mm_or_si128(escape_eq(v,'"'),escape_eq(v,'\\')),
+				_mm_cmpeq_epi8(_mm_min_epu8(v,_mm_set1_epi8(0x1f)),v));
+			break;
+		case ESCAPE_HTML:
+			special=_mm_or_si128(_mm_or_si128(escape_eq(v,'&'),escape_eq(v,'<')),
+				_mm_or_si128(_mm_or_si128(escape_eq(v,'>'),escape_eq(v,'"')),escape_eq(v,'\'')));
+			break;
+		case ESCAPE_URL:
+			safe=_mm_or_si128(_mm_or_si128(escape_alnum16(v),_mm_or_si128(escape_eq(v,'-'),escape_eq(v,'_'))),
+				_mm_or_si128(escape_eq(v,'.'),escape_eq(v,'~')));
+			return ~(unsigned)_mm_movemask_epi8(safe)&0xffff;
+		default:
+			safe=_mm_or_si128(_mm_or_si128(escape_alnum16(v),_mm_or_si128(escape_eq(v,'_'),escape_eq(v,'@'))),
+				_mm_or_si128(_mm_or_si128(escape_eq(v,'%'),escape_eq(v,'+')),_mm_or_si128(escape_eq(v,'='),escape_eq(v,':'))));
+			//',' '-' '.' '/' are consecutive
+			safe=_mm_or_si128(safe,escape_range(v,',','/'));
+			return ~(unsigned)_mm_movemask_epi8(safe)&0xffff;
+	}
+	return (unsigned)_mm_movemask_epi8(special);
+}
+
+#endif
+
+/**
+* Returns the number of bytes at the start of 's' that need no escaping or unescaping.
+* Escapes that start with a single byte are found with memchr(); the others 16 bytes at a time.
+*/
+static size_t escape_clean(const char *s, size_t size, ESCAPE_CONTEXT context, bool unescape)
+{
+	size_t i=0;
+	if(unescape && context!=ESCAPE_SHELL)
+	{
+		const char *found=(const char *)memchr(s,context==ESCAPE_JSON?'\\':context==ESCAPE_HTML?'&':'%',size);
+		return found!=NULL?(size_t)(found-s):size;
+	}
+#ifdef __SSE2__
+	for(; i+16<=size; i+=16)
+	{
+		unsigned mask=escape_mask(_mm_loadu_si128((const __m128i *)(s+i)),context,unescape);
+		if(mask!=0) return i+(size_t)__builtin_ctz(mask);
+	}
+#endif
+	while(i<size && !escape_special((unsigned char)s[i],context,unescape)) i++;
+	return i;
+}
+
+static void escape_byte(buffer b, ESCAPE_CONTEXT context, unsigned char c)
+{
+	if(context==ESCAPE_URL)
+	{
+		char escape[3]={'%', escape_hex_upper[c>>4], escape_hex_upper[c&15]};
+		buffer_append(b,escape,3);
+	}
+	else if(context==ESCAPE_HTML)
+	{
+		switch(c)
+		{
+			case '&': buffer_append(b,"&amp;",5); break;
+			case '<': buffer_append(b,"&lt;",4); break;
+			case '>': buffer_append(b,"&gt;",4); break;
+			case '"': buffer_append(b,"&quot;",6); break;
+			default: buffer_append(b,"&#39;",5); break;
+		}
+	}
+	else
+	{
+		switch(c)
+		{
+			case '"': buffer_append(b,"\\\"",2); break;
+			case '\\': buffer_append(b,"\\\\",2); break;
+			case '\b': buffer_append(b,"\\b",2); break;
+			case '\f': buffer_append(b,"\\f",2); break;
+			case '\n': buffer_append(b,"\\n",2); break;
+			case '\r': buffer_append(b,"\\r",2); break;
+			case '\t': buffer_append(b,"\\t",2); break;
+			default:
+			{
+				char escape[6]={'\\', 'u', '0', '0', escape_hex_lower[c>>4], escape_hex_lower[c&15]};
+				buffer_append(b,escape,6);
+			}
+		}
+	}
+}
+
+/**
+* Writes a shell word between single quotes, inside which only the single quote itself is special:
+* it ends the quotes, is escaped with a backslash, and starts new ones.
+*/
+static void escape_shell(buffer b, const char *s, size_t size)
+{
+	const char *end=s+size;
+	buffer_reserve(b,size+2);
+	buffer_appendchar(b,'\'');
+	while(s<end)
+	{
+		const char *quote=(const char *)memchr(s,'\'',(size_t)(end-s));
+		if(quote==NULL)
+		{
+			buffer_append(b,s,(size_t)(end-s));
+			break;
+		}
+		buffer_append(b,s,(size_t)(quote-s));
+		buffer_append(b,"'\\''",4);
+		s=quote+1;
+	}
+	buffer_appendchar(b,'\'');
+}
+
+static int escape_hex_digit(char c)
+{
+	if(c>='0' && c<='9') return c-'0';
+	if((c|0x20)>='a' && (c|0x20)<='f') return (c|0x20)-'a'+10;
+	return -1;
+}
+
+static bool escape_hex4(const char *s, const char *end, unsigned *value)
+{
+	unsigned v=0;
+	int i, digit;
+	if(end-s<4) return false;
+	for(i=0; i<4; i++)
+	{
+		digit=escape_hex_digit(s[i]);
+		if(digit<0) return false;
+		v=(v<<4)|(unsigned)digit;
+	}
+	*value=v;
+	return true;
+}
+
+static void escape_append_utf8(buffer b, unsigned code)
+{
+	char utf8[4];
+	size_t size;
+	if(code<0x80)
+	{
+		utf8[0]=(char)code;
+		size=1;
+	}
+	else if(code<0x800)
+	{
+		utf8[0]=(char)(0xc0|(code>>6));
+		utf8[1]=(char)(0x80|(code&0x3f));
+		size=2;
+	}
+	else if(code<0x10000)
+	{
+		utf8[0]=(char)(0xe0|(code>>12));
+		utf8[1]=(char)(0x80|((code>>6)&0x3f));
+		utf8[2]=(char)(0x80|(code&0x3f));
+		size=3;
+	}
+	else
+	{
+		utf8[0]=(char)(0xf0|(code>>18));
+		utf8[1]=(char)(0x80|((code>>12)&0x3f));
+		utf8[2]=(char)(0x80|((code>>6)&0x3f));
+		utf8[3]=(char)(0x80|(code&0x3f));
+		size=4;
+	}
+	buffer_append(b,utf8,size);
+}
+
+/**
+* Decodes the JSON escape at 's', with a second \u escape for a surrogate pair.
+*
+* @return the number of bytes of the escape; or 0, if it is not valid.
+*/
+static size_t unescape_json(buffer b, const char *s, const char *end)
+{
+	unsigned code, low;
+	if(end-s<2) return 0;
+	switch(s[1])
+	{
+		case '"': buffer_appendchar(b,'"'); return 2;
+		case '\\': buffer_appendchar(b,'\\'); return 2;
+		case '/': buffer_appendchar(b,'/'); return 2;
+		case 'b': buffer_appendchar(b,'\b'); return 2;
+		case 'f': buffer_appendchar(b,'\f'); return 2;
+		case 'n': buffer_appendchar(b,'\n'); return 2;
+		case 'r': buffer_appendchar(b,'\r'); return 2;
+		case 't': buffer_appendchar(b,'\t'); return 2;
+		case 'u': break;
+		default: return 0;
+	}
+	if(!escape_hex4(s+2,end,&code) || (code>=0xdc00 && code<=0xdfff)) return 0;
+	if(code<0xd800 || code>0xdbff)
+	{
+		escape_append_utf8(b,code);
+		return 6;
+	}
+	if(end-s<12 || s[6]!='\\' || s[7]!='u' || !escape_hex4(s+8,end,&low) || low<0xdc00 || low>0xdfff) return 0;
+	escape_append_utf8(b,0x10000+((code-0xd800)<<10)+(low-0xdc00));
+	return 12;
+}
+
+/**
+* Decodes the HTML character reference at 's'. References that are not known or not valid
+* are not decoded, as browsers do: the '&' is copied as is.
+*
+* @return the number of bytes decoded.
+*/
+static size_t unescape_html(buffer b, const char *s, const char *end)
+{
+	static const char *names[]={"amp", "lt", "gt", "quot", "apos", "nbsp"};
+	static const unsigned codes[]={'&', '<', '>', '"', '\'', 0xa0};
+	const char *semicolon=(const char *)memchr(s,';',(size_t)(end-s)<12?(size_t)(end-s):12);
+	size_t size, i;
+	if(semicolon!=NULL && s[1]=='#')
+	{
+		const char *p=s+2;
+		unsigned long code=0;
+		int base=10, digit;
+		if(p<semicolon && (*p|0x20)=='x')
+		{
+			base=16;
+			p++;
+		}
+		if(p==semicolon) goto literal;
+		for(; p<semicolon; p++)
+		{
+			digit=escape_hex_digit(*p);
+			if(digit<0 || digit>=base) goto literal;
+			code=code*(unsigned long)base+(unsigned long)digit;
+		}
+		//as in HTML5, invalid code points become the replacement character
+		if(code==0 || code>0x10ffff || (code>=0xd800 && code<=0xdfff)) code=0xfffd;
+		escape_append_utf8(b,(unsigned)code);
+		return (size_t)(semicolon-s)+1;
+	}
+	if(semicolon!=NULL)
+	{
+		size=(size_t)(semicolon-s)-1;
+		for(i=0; i<sizeof(codes)/sizeof(codes[0]); i++)
+		{
+			if(strlen(names[i])==size && memcmp(s+1,names[i],size)==0)
+			{
+				escape_append_utf8(b,codes[i]);
+				return size+2;
+			}
+		}
+	}
+literal:
+	buffer_appendchar(b,'&');
+	return 1;
+}
+
+/**
+* Decodes the %XX escape at 's'.
+*
+* @return 3; or 0, if it is not valid.
+*/
+static size_t unescape_url(buffer b, const char *s, const char *end)
+{
+	int high, low;
+	if(end-s<3) return 0;
+	high=escape_hex_digit(s[1]);
+	low=escape_hex_digit(s[2]);
+	if(high<0 || low<0) return 0;
+	buffer_appendchar(b,(char)(high<<4|low));
+	return 3;
+}
+
+/**
+* Removes the quoting of a POSIX shell word: single quotes, double quotes, and backslashes.
+* Inside double quotes, a backslash only escapes $ ` " \ and newline; a backslash before a newline
+* joins lines. Expansions are not performed: $ and ` are copied as is.
+*
+* @return false, if a quote is not closed or the word ends in a backslash.
+*/
+static bool unescape_shell(buffer b, const char *s, const char *end)
+{
+	while(s<end)
+	{
+		size_t clean=escape_clean(s,(size_t)(end-s),ESCAPE_SHELL,true);
+		const char *close;
+		buffer_append(b,s,clean);
+		s+=clean;
+		if(s==end) break;
+		if(*s=='\'')
+		{
+			close=(const char *)memchr(s+1,'\'',(size_t)(end-s-1));
+			if(close==NULL) return false;
+			buffer_append(b,s+1,(size_t)(close-s-1));
+			s=close+1;
+		}
+		else if(*s=='\\')
+		{
+			if(s+1==end) return false;
+			if(s[1]!='\n') buffer_appendchar(b,s[1]);
+			s+=2;
+		}
+		else
+		{
+			for(s++; s<end && *s!='"'; s++)
+			{
+				if(*s=='\\' && s+1<end && (s[1]=='$' || s[1]=='`' || s[1]=='"' || s[1]=='\\' || s[1]=='\n'))
+				{
+					s++;
+					if(*s=='\n') continue;
+				}
+				buffer_appendchar(b,*s);
+			}
+			if(s==end) return false;
+			s++;
+		}
+	}
+	return true;
+}
+
+//PRIVATE
+
+/**
+* Appends text to a buffer, escaped for a context. Runs of bytes that need no escaping are found
+* 16 bytes at a time with SSE2 where available, or with memchr(), and copied at once.
+* ESCAPE_JSON escapes the inside of a JSON string, without the quotes around it.
+* ESCAPE_HTML escapes the characters that are special in HTML text and quoted attribute values.
+* ESCAPE_URL percent-encodes every byte but the unreserved characters of RFC 3986, as for a query
+* parameter or a path segment; a space becomes %20.
+* ESCAPE_SHELL writes the text as one POSIX shell word: as is, if it only holds letters, digits and
+* _@%+=:,./- and is not empty; between single quotes, if not.
+*
+* @param b the buffer to append to.
+* @param context the context of the text.
+* @param v the text.
+*/
+void escape_append(buffer b, ESCAPE_CONTEXT context, view v)
+{
+	const char *s=v.data;
+	size_t size=v.size;
+	size_t clean=escape_clean(s,size,context,false);
+	if(context==ESCAPE_SHELL)
+	{
+		if(clean==size && size>0) buffer_append(b,s,size);
+		else escape_shell(b,s,size);
+		return;
+	}
+	buffer_reserve(b,size);
+	while(1)
+	{
+		buffer_append(b,s,clean);
+		if(clean==size) return;
+		escape_byte(b,context,(unsigned char)s[clean]);
+		s+=clean+1;
+		size-=clean+1;
+		clean=escape_clean(s,size,context,false);
+	}
+}
+
+/**
+* Escapes a string for a context; see escape_append().
+*
+* @param context the context of the string.
+* @param str the string.
+* @return the string itself, without allocating, if nothing needs escaping; or a new, escaped string.
+*/
+string escape_string(ESCAPE_CONTEXT context, string str)
+{
+	size_t size=strlen(str);
+	buffer b;
+	if(escape_clean(str,size,context,false)==size && (context!=ESCAPE_SHELL || size>0)) return str;
+	b=buffer_new_capacity(size+size/4+8);
+	escape_append(b,context,view_new(str,size));
+	return buffer_steal(b);
+}
+
+/**
+* Appends text to a buffer, with the escapes of a context decoded; runs without escapes are found
+* as by escape_append() and copied at once.
+* ESCAPE_JSON decodes all JSON string escapes, including surrogate pairs, into utf-8.
+* ESCAPE_HTML decodes numeric character references and &amp; &lt; &gt; &quot; &apos; &nbsp;;
+* other references are copied as is.
+* ESCAPE_URL decodes %XX escapes; '+' is left alone, as RFC 3986 gives it no special meaning.
+* ESCAPE_SHELL removes the quoting of one shell word, without expanding anything.
+* Decoded text may hold null characters, from escapes such as %00.
+*
+* @param b the buffer to append to.
+* @param context the context of the text.
+* @param v the escaped text.
+* @return true; or false, if the text holds an invalid escape or an unclosed quote, in which case
+* the buffer is left as it was.
+*/
+bool unescape_append(buffer b, ESCAPE_CONTEXT context, view v)
+{
+	size_t mark=b->size;
+	const char *s=v.data, *end=v.data+v.size;
+	if(context==ESCAPE_SHELL)
+	{
+		if(unescape_shell(b,s,end)) return true;
+		b->size=mark;
+		return false;
+	}
+	buffer_reserve(b,v.size);
+	while(1)
+	{
+		size_t clean=escape_clean(s,(size_t)(end-s),context,true), used;
+		buffer_append(b,s,clean);
+		s+=clean;
+		if(s==end) return true;
+		if(context==ESCAPE_JSON) used=unescape_json(b,s,end);
+		else if(context==ESCAPE_HTML) used=unescape_html(b,s,end);
+		else used=unescape_url(b,s,end);
+		if(used==0)
+		{
+			b->size=mark;
+			return false;
+		}
+		s+=used;
+	}
+}
+
+/**
+* Decodes the escapes of a context in a string; see unescape_append().
+*
+* @param context the context of the string.
+* @param str the escaped string.
+* @return the string itself, without allocating, if it holds no escapes; a new, decoded string;
+* or NULL, if the string holds an invalid escape.
+*/
+string unescape_string(ESCAPE_CONTEXT context, string str)
+{
+	size_t size=strlen(str);
+	buffer b;
+	if(escape_clean(str,size,context,true)==size) return str;
+	b=buffer_new_capacity(size+1);
+	if(!unescape_append(b,context,view_new(str,size))) return NULL;
+	return buffer_steal(b);
+}
@@ -0,0 +1,57 @@
+/**
+ *
+ * libscriptify
+ *
+ * @author  Erik Poupaert <erik@sankuru.biz>
+ *
+ * @section LICENSE
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU LGPL as
+ * published by the Free Software Foundation; either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * LGPL for more details at: http://www.gnu.org/licenses/lgpl.html
+ *
+ * @section DESCRIPTION
+ *
+ * Escaping and unescaping of text for JSON strings, HTML, URLs and shell words.
+ * Runs of bytes that need no escaping are found with SIMD and copied at once.
+ *
+ */
+#ifndef _ESCAPE_H
+#define _ESCAPE_H
+
+#include <stddef.h>
+#include <stdbool.h>
+#include "string_utf8.h"
+#include "view.h"
+#include "buffer.h"
+
+#ifdef __cplusplus
+	extern "C" {
+#endif
+
+enum _ESCAPE_CONTEXT
+{
+	  ESCAPE_JSON //inside a JSON string: quote, backslash and control characters
+	, ESCAPE_HTML //HTML text and attribute values: & < > " and '
+	, ESCAPE_URL //percent-encoding of all but the unreserved characters of RFC 3986
+	, ESCAPE_SHELL //one word for a POSIX shell, single-quoted if it holds anything but safe characters
+};
+
+typedef enum _ESCAPE_CONTEXT ESCAPE_CONTEXT;
+
+void escape_append(buffer b, ESCAPE_CONTEXT context, view v);
+string escape_string(ESCAPE_CONTEXT context, string str);
+bool unescape_append(buffer b, ESCAPE_CONTEXT context, view v);
+string unescape_string(ESCAPE_CONTEXT context, string str);
+
+#ifdef __cplusplus
+	}
+#endif
+
+#endif // _ESCAPE_H
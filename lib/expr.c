@@ -0,0 +1,1150 @@
+/**
+ *
+ * libscriptify
+ *
+ * @author  Erik Poupaert <erik@sankuru.biz>
+ *
+ * @section LICENSE
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU LGPL as
+ * published by the Free Software Foundation; either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * LGPL for more details at: http://www.gnu.org/licenses/lgpl.html
+ *
+ * @section DESCRIPTION
+ *
+ * Expressions over any values: a compiler with constant folding, and a register machine
+ * with computed-goto dispatch and inline paths for longs and doubles.
+ *
+ */
+#include <string.h>
+#include <limits.h>
+#include <math.h>
+#include "object.h"
+#include "number.h"
+#include "buffer.h"
+#include "map.h"
+#include "shape.h"
+#include "string_utf8.h"
+#include "expr.h"
+
+//PRIVATE
+
+/* the order is that of the labels in expr_run() */
+enum _EXPR_OP
+{
+	  EXPR_LOADK //a=constants[b]
+	, EXPR_FIELD //a=the field constants[b] of the record, through caches[b] for records
+	, EXPR_GET //a=the field constants[c] of b, through caches[c] for records
+	, EXPR_INDEX //a=b[c]
+	, EXPR_ADD //a=b+c, and so on
+	, EXPR_SUB
+	, EXPR_MUL
+	, EXPR_DIV
+	, EXPR_MOD
+	, EXPR_EQ
+	, EXPR_NE
+	, EXPR_LT
+	, EXPR_LE
+	, EXPR_GT
+	, EXPR_GE
+	, EXPR_NEG //a=-b
+	, EXPR_NOT //a=!b
+	, EXPR_BOOL //a=b converted to a boolean
+	, EXPR_JUMP //to c
+	, EXPR_JUMP_FALSE //to c if b is false
+	, EXPR_JUMP_TRUE //to c if b is true
+	, EXPR_CALL //a=the function aux of the c registers from b on
+	, EXPR_RETURN //b
+};
+
+/* initial sizes of the code and the constants; they grow as needed */
+#define EXPR_CODE_CAPACITY 16
+#define EXPR_CONSTANTS_CAPACITY 8
+
+/* operators that only exist in the compiler */
+#define EXPR_AND 100
+#define EXPR_OR 101
+
+enum _EXPR_FUNCTION
+{
+	  EXPR_LEN
+	, EXPR_LOWER
+	, EXPR_UPPER
+	, EXPR_CONTAINS
+	, EXPR_STARTS_WITH
+	, EXPR_ENDS_WITH
+	, EXPR_ABS
+	, EXPR_MIN
+	, EXPR_MAX
+	, EXPR_INT
+	, EXPR_FLOAT
+	, EXPR_STR
+};
+
+/* maximum number of arguments of a function */
+#define EXPR_MAX_ARGUMENTS 8
+
+typedef struct
+{
+	const char *name;
+	int min_arguments;
+	int max_arguments;
+} expr_function;
+
+static const expr_function expr_functions[]=
+{
+	{"len", 1, 1}, {"lower", 1, 1}, {"upper", 1, 1}, {"contains", 2, 2}, {"starts_with", 2, 2}, {"ends_with", 2, 2},
+	{"abs", 1, 1}, {"min", 2, EXPR_MAX_ARGUMENTS}, {"max", 2, EXPR_MAX_ARGUMENTS}, {"int", 1, 1}, {"float", 1, 1}, {"str", 1, 1}
+};
+
+typedef struct
+{
+	bool constant;
+	_expr_value value; //constant: the value
+	int reg; //otherwise: the register that holds the value
+} _expr_operand;
+
+typedef _expr_operand* expr_operand;
+
+typedef struct
+{
+	expr e;
+	const char *p; //the next character of the source
+	size_t code_capacity;
+	size_t constants_capacity;
+	int top; //the next free register
+	int depth;
+} _expr_compiler;
+
+typedef _expr_compiler* expr_compiler;
+
+static _expr_value expr_null()
+{
+	_expr_value v;
+	v.type=TYPE_NULL;
+	v.obj=NULL;
+	return v;
+}
+
+static _expr_value expr_long(long lng)
+{
+	_expr_value v;
+	v.type=TYPE_LONG;
+	v.lng=lng;
+	return v;
+}
+
+static _expr_value expr_double(double dbl)
+{
+	_expr_value v;
+	v.type=TYPE_DOUBLE;
+	v.dbl=dbl;
+	return v;
+}
+
+static _expr_value expr_bool(bool bln)
+{
+	_expr_value v;
+	v.type=TYPE_BOOL;
+	v.bln=bln;
+	return v;
+}
+
+static _expr_value expr_from_any(any value)
+{
+	_expr_value v;
+	if(value==NULL) return expr_null();
+	switch(value->type)
+	{
+		case TYPE_INT: return expr_long(value->i);
+		case TYPE_LONG: return expr_long(value->lng);
+		case TYPE_DOUBLE: return expr_double(value->dbl);
+		case TYPE_BOOL: return expr_bool(value->bln);
+		case TYPE_NULL: return expr_null();
+		default:
+			v.type=value->type;
+			v.obj=value;
+			return v;
+	}
+}
+
+static _expr_value expr_string(string str)
+{
+	_expr_value v;
+	v.type=TYPE_STRING;
+	v.obj=any_new_string(str);
+	return v;
+}
+
+static any expr_to_any(const _expr_value *v)
+{
+	switch(v->type)
+	{
+		case TYPE_LONG: return any_new_long(v->lng);
+		case TYPE_DOUBLE: return any_new_double(v->dbl);
+		case TYPE_BOOL: return any_new_bool(v->bln);
+		case TYPE_NULL: return any_new_null();
+		default: return v->obj;
+	}
+}
+
+static bool expr_truthy(const _expr_value *v)
+{
+	switch(v->type)
+	{
+		case TYPE_BOOL: return v->bln;
+		case TYPE_NULL: return false;
+		case TYPE_LONG: return v->lng!=0;
+		case TYPE_DOUBLE: return v->dbl!=0.0;
+		case TYPE_STRING: return v->obj->str[0]!=0;
+		case TYPE_ARRAY: return v->obj->arr->size>0;
+		default: return true;
+	}
+}
+
+static bool expr_number(const _expr_value *v, double *dbl)
+{
+	if(v->type==TYPE_LONG) *dbl=(double)v->lng;
+	else if(v->type==TYPE_DOUBLE) *dbl=v->dbl;
+	else return false;
+	return true;
+}
+
+static bool expr_scalar(const _expr_value *v)
+{
+	return v->type==TYPE_LONG || v->type==TYPE_DOUBLE || v->type==TYPE_STRING || v->type==TYPE_BOOL;
+}
+
+static void expr_append_text(buffer b, const _expr_value *v)
+{
+	switch(v->type)
+	{
+		case TYPE_LONG: buffer_append_long(b,v->lng); break;
+		case TYPE_DOUBLE: buffer_append_double(b,v->dbl); break;
+		case TYPE_BOOL: buffer_appendstring(b,v->bln?"true":"false"); break;
+		case TYPE_STRING: buffer_appendstring(b,v->obj->str); break;
+		default: buffer_appendstring(b,"null"); break;
+	}
+}
+
+/**
+* Arithmetic on any values: longs stay longs unless they overflow, and mix with doubles as doubles;
+* + joins two strings, or a string and a number or boolean. Division by zero, and operands
+* of other types, give null.
+*/
+static _expr_value expr_arith(int op, const _expr_value *x, const _expr_value *y)
+{
+	double a, b;
+	long l;
+	if(x->type==TYPE_LONG && y->type==TYPE_LONG)
+	{
+		switch(op)
+		{
+			case EXPR_ADD: if(!__builtin_add_overflow(x->lng,y->lng,&l)) return expr_long(l); break;
+			case EXPR_SUB: if(!__builtin_sub_overflow(x->lng,y->lng,&l)) return expr_long(l); break;
+			case EXPR_MUL: if(!__builtin_mul_overflow(x->lng,y->lng,&l)) return expr_long(l); break;
+			case EXPR_DIV:
+				if(y->lng==0) return expr_null();
+				if(x->lng==LONG_MIN && y->lng==-1) break;
+				return expr_long(x->lng/y->lng);
+			default:
+				if(y->lng==0) return expr_null();
+				if(y->lng==-1) return expr_long(0);
+				return expr_long(x->lng%y->lng);
+		}
+	}
+	if(expr_number(x,&a) && expr_number(y,&b))
+	{
+		switch(op)
+		{
+			case EXPR_ADD: return expr_double(a+b);
+			case EXPR_SUB: return expr_double(a-b);
+			case EXPR_MUL: return expr_double(a*b);
+			case EXPR_DIV: return b!=0.0?expr_double(a/b):expr_null();
+			default: return b!=0.0?expr_double(fmod(a,b)):expr_null();
+		}
+	}
+	if(op==EXPR_ADD && (x->type==TYPE_STRING || y->type==TYPE_STRING) && expr_scalar(x) && expr_scalar(y))
+	{
+		buffer b=buffer_new();
+		expr_append_text(b,x);
+		expr_append_text(b,y);
+		return expr_string(buffer_steal(b));
+	}
+	return expr_null();
+}
+
+/**
+* Orders a long and a double exactly, rather than after rounding the long to a double, which
+* loses precision above 2^53. The double is not NaN.
+*/
+static int expr_order_long_double(long l, double d)
+{
+	double whole;
+	long t;
+	if(d>=9223372036854775808.0) return -1;
+	if(d<-9223372036854775808.0) return 1;
+	whole=trunc(d);
+	t=(long)whole;
+	if(l!=t) return (l>t)-(l<t);
+	return (whole>d)-(whole<d);
+}
+
+/**
+* Orders two values: numbers by value, strings by their bytes.
+*
+* @return false, if the values cannot be ordered.
+*/
+static bool expr_order(const _expr_value *x, const _expr_value *y, int *order)
+{
+	double a, b;
+	if(x->type==TYPE_LONG && y->type==TYPE_LONG)
+	{
+		*order=(x->lng>y->lng)-(x->lng<y->lng);
+		return true;
+	}
+	if(x->type==TYPE_LONG && y->type==TYPE_DOUBLE)
+	{
+		if(y->dbl!=y->dbl) return false;
+		*order=expr_order_long_double(x->lng,y->dbl);
+		return true;
+	}
+	if(x->type==TYPE_DOUBLE && y->type==TYPE_LONG)
+	{
+		if(x->dbl!=x->dbl) return false;
+		*order=-expr_order_long_double(y->lng,x->dbl);
+		return true;
+	}
+	if(expr_number(x,&a) && expr_number(y,&b))
+	{
+		if(a!=a || b!=b) return false;
+		*order=(a>b)-(a<b);
+		return true;
+	}
+	if(x->type==TYPE_STRING && y->type==TYPE_STRING)
+	{
+		int c=strcmp(x->obj->str,y->obj->str);
+		*order=(c>0)-(c<0);
+		return true;
+	}
+	return false;
+}
+
+static bool expr_equal(const _expr_value *x, const _expr_value *y)
+{
+	int order;
+	if(expr_order(x,y,&order)) return order==0;
+	if(x->type!=y->type) return false;
+	switch(x->type)
+	{
+		case TYPE_BOOL: return x->bln==y->bln;
+		case TYPE_NULL: return true;
+		case TYPE_LONG:
+		case TYPE_DOUBLE: return false; //NaN
+		default: return any_equal(x->obj,y->obj);
+	}
+}
+
+/**
+* Comparisons: == and != hold between any values; the others are false for values that cannot be ordered.
+*/
+static _expr_value expr_compare(int op, const _expr_value *x, const _expr_value *y)
+{
+	int order;
+	if(op==EXPR_EQ) return expr_bool(expr_equal(x,y));
+	if(op==EXPR_NE) return expr_bool(!expr_equal(x,y));
+	if(!expr_order(x,y,&order)) return expr_bool(false);
+	switch(op)
+	{
+		case EXPR_LT: return expr_bool(order<0);
+		case EXPR_LE: return expr_bool(order<=0);
+		case EXPR_GT: return expr_bool(order>0);
+		default: return expr_bool(order>=0);
+	}
+}
+
+static _expr_value expr_unary(int op, const _expr_value *x)
+{
+	if(op==EXPR_NOT) return expr_bool(!expr_truthy(x));
+	if(op==EXPR_BOOL) return expr_bool(expr_truthy(x));
+	if(x->type==TYPE_LONG && x->lng!=LONG_MIN) return expr_long(-x->lng);
+	if(x->type==TYPE_LONG) return expr_double(-(double)x->lng);
+	if(x->type==TYPE_DOUBLE) return expr_double(-x->dbl);
+	return expr_null();
+}
+
+/**
+* Items of arrays by position, counting from the end for negative positions, and values of maps and records by key.
+*/
+static _expr_value expr_index(const _expr_value *x, const _expr_value *y)
+{
+	if(x->type==TYPE_ARRAY && y->type==TYPE_LONG)
+	{
+		long size=(long)x->obj->arr->size, i=y->lng<0?y->lng+size:y->lng;
+		return i>=0 && i<size?expr_from_any(x->obj->arr->items[i]):expr_null();
+	}
+	if(x->type==TYPE_MAP && y->type==TYPE_STRING) return expr_from_any(map_get(x->obj->map,y->obj));
+	if(x->type==TYPE_RECORD && y->type==TYPE_STRING) return expr_from_any(record_get(x->obj->rec,y->obj->str));
+	return expr_null();
+}
+
+static bool expr_ends_with(string str, string suffix)
+{
+	size_t size=strlen(str), suffix_size=strlen(suffix);
+	return suffix_size<=size && memcmp(str+size-suffix_size,suffix,suffix_size)==0;
+}
+
+static _expr_value expr_call(int function, const _expr_value *args, int count)
+{
+	const _expr_value *x=&args[0], *y=&args[1];
+	_expr_value result;
+	double dbl;
+	long lng;
+	int i, order;
+	switch(function)
+	{
+		case EXPR_LEN:
+			if(x->type==TYPE_STRING) return expr_long((long)string_length_utf8(x->obj->str));
+			if(x->type==TYPE_ARRAY) return expr_long((long)x->obj->arr->size);
+			if(x->type==TYPE_MAP) return expr_long((long)map_size(x->obj->map));
+			return expr_null();
+		case EXPR_LOWER:
+			return x->type==TYPE_STRING?expr_string(string_tolower_utf8(x->obj->str)):expr_null();
+		case EXPR_UPPER:
+			return x->type==TYPE_STRING?expr_string(string_toupper_utf8(x->obj->str)):expr_null();
+		case EXPR_CONTAINS:
+			if(x->type==TYPE_STRING && y->type==TYPE_STRING) return expr_bool(strstr(x->obj->str,y->obj->str)!=NULL);
+			if(x->type==TYPE_ARRAY)
+			{
+				size_t k;
+				for(k=0; k<x->obj->arr->size; k++)
+				{
+					_expr_value item=expr_from_any(x->obj->arr->items[k]);
+					if(expr_equal(&item,y)) return expr_bool(true);
+				}
+				return expr_bool(false);
+			}
+			if(x->type==TYPE_MAP && y->type==TYPE_STRING) return expr_bool(map_has(x->obj->map,y->obj));
+			return expr_null();
+		case EXPR_STARTS_WITH:
+			if(x->type!=TYPE_STRING || y->type!=TYPE_STRING) return expr_null();
+			return expr_bool(strncmp(x->obj->str,y->obj->str,strlen(y->obj->str))==0);
+		case EXPR_ENDS_WITH:
+			if(x->type!=TYPE_STRING || y->type!=TYPE_STRING) return expr_null();
+			return expr_bool(expr_ends_with(x->obj->str,y->obj->str));
+		case EXPR_ABS:
+			if(x->type==TYPE_LONG) return x->lng<0?expr_unary(EXPR_NEG,x):*x;
+			return x->type==TYPE_DOUBLE?expr_double(fabs(x->dbl)):expr_null();
+		case EXPR_MIN:
+		case EXPR_MAX:
+			result=*x;
+			for(i=1; i<count; i++)
+			{
+				if(!expr_order(&result,&args[i],&order)) return expr_null();
+				if((function==EXPR_MIN && order>0) || (function==EXPR_MAX && order<0)) result=args[i];
+			}
+			return result;
+		case EXPR_INT:
+			if(x->type==TYPE_LONG) return *x;
+			if(x->type==TYPE_BOOL) return expr_long(x->bln?1:0);
+			if(x->type==TYPE_STRING && string_to_long(x->obj->str,strlen(x->obj->str),&lng)) return expr_long(lng);
+			if(x->type==TYPE_STRING && !string_to_double(x->obj->str,strlen(x->obj->str),&dbl)) return expr_null();
+			if(x->type==TYPE_DOUBLE) dbl=x->dbl;
+			else if(x->type!=TYPE_STRING) return expr_null();
+			//truncated towards zero; out of range values and NaN give null
+			if(!(dbl>=-9223372036854775808.0 && dbl<9223372036854775808.0)) return expr_null();
+			return expr_long((long)dbl);
+		case EXPR_FLOAT:
+			if(expr_number(x,&dbl)) return expr_double(dbl);
+			if(x->type==TYPE_STRING && string_to_double(x->obj->str,strlen(x->obj->str),&dbl)) return expr_double(dbl);
+			return expr_null();
+		default:
+			if(x->type==TYPE_STRING) return *x;
+			return expr_string(any_to_string(expr_to_any(x)));
+	}
+}
+
+static _expr_value expr_fold(int op, const _expr_value *x, const _expr_value *y)
+{
+	if(op>=EXPR_EQ && op<=EXPR_GE) return expr_compare(op,x,y);
+	if(op>=EXPR_NEG) return expr_unary(op,x);
+	return expr_arith(op,x,y);
+}
+
+#if defined(__GNUC__)
+#define EXPR_DISPATCH() goto *labels[ip->op]
+#define EXPR_LABEL(op) label_##op
+#else
+#define EXPR_DISPATCH() goto dispatch
+#define EXPR_LABEL(op) case op
+#endif
+#define EXPR_NEXT() do { ip++; EXPR_DISPATCH(); } while(0)
+
+/**
+* Runs the bytecode. With GCC and clang, every instruction jumps straight to the next one through
+* a table of label addresses, rather than through one shared switch, which branch predictors handle
+* better. Arithmetic and comparisons handle two longs and two doubles inline, and leave the rest
+* to the general functions. Fields of records are read through the inline cache of their instruction.
+*/
+static _expr_value expr_run(expr e, any record)
+{
+	_expr_value r[EXPR_MAX_REGISTERS];
+	const _expr_instr *ip=e->code;
+	map fields=record!=NULL && record->type==TYPE_MAP?record->map:NULL;
+	struct _record *properties=record!=NULL && record->type==TYPE_RECORD?record->rec:NULL;
+	_expr_value *x, *y;
+	long l;
+#if defined(__GNUC__)
+	static void *labels[]=
+	{
+		&&label_EXPR_LOADK, &&label_EXPR_FIELD, &&label_EXPR_GET, &&label_EXPR_INDEX,
+		&&label_EXPR_ADD, &&label_EXPR_SUB, &&label_EXPR_MUL, &&label_EXPR_DIV, &&label_EXPR_MOD,
+		&&label_EXPR_EQ, &&label_EXPR_NE, &&label_EXPR_LT, &&label_EXPR_LE, &&label_EXPR_GT, &&label_EXPR_GE,
+		&&label_EXPR_NEG, &&label_EXPR_NOT, &&label_EXPR_BOOL,
+		&&label_EXPR_JUMP, &&label_EXPR_JUMP_FALSE, &&label_EXPR_JUMP_TRUE, &&label_EXPR_CALL, &&label_EXPR_RETURN
+	};
+	EXPR_DISPATCH();
+#else
+dispatch:
+	switch(ip->op)
+	{
+#endif
+	EXPR_LABEL(EXPR_LOADK):
+		r[ip->a]=e->constants[ip->b];
+		EXPR_NEXT();
+	EXPR_LABEL(EXPR_FIELD):
+		if(fields!=NULL) r[ip->a]=expr_from_any(map_get(fields,e->constants[ip->b].obj));
+		else if(properties!=NULL) r[ip->a]=expr_from_any(record_get_cached(properties,e->constants[ip->b].obj->str,&e->caches[ip->b]));
+		else r[ip->a]=expr_null();
+		EXPR_NEXT();
+	EXPR_LABEL(EXPR_GET):
+		x=&r[ip->b];
+		if(x->type==TYPE_MAP) r[ip->a]=expr_from_any(map_get(x->obj->map,e->constants[ip->c].obj));
+		else if(x->type==TYPE_RECORD) r[ip->a]=expr_from_any(record_get_cached(x->obj->rec,e->constants[ip->c].obj->str,&e->caches[ip->c]));
+		else r[ip->a]=expr_null();
+		EXPR_NEXT();
+	EXPR_LABEL(EXPR_INDEX):
+		r[ip->a]=expr_index(&r[ip->b],&r[ip->c]);
+		EXPR_NEXT();
+	EXPR_LABEL(EXPR_ADD):
+		x=&r[ip->b];
+		y=&r[ip->c];
+		if(x->type==TYPE_LONG && y->type==TYPE_LONG && !__builtin_add_overflow(x->lng,y->lng,&l)) r[ip->a]=expr_long(l);
+		else if(x->type==TYPE_DOUBLE && y->type==TYPE_DOUBLE) r[ip->a]=expr_double(x->dbl+y->dbl);
+		else r[ip->a]=expr_arith(EXPR_ADD,x,y);
+		EXPR_NEXT();
+	EXPR_LABEL(EXPR_SUB):
+		x=&r[ip->b];
+		y=&r[ip->c];
+		if(x->type==TYPE_LONG && y->type==TYPE_LONG && !__builtin_sub_overflow(x->lng,y->lng,&l)) r[ip->a]=expr_long(l);
+		else if(x->type==TYPE_DOUBLE && y->type==TYPE_DOUBLE) r[ip->a]=expr_double(x->dbl-y->dbl);
+		else r[ip->a]=expr_arith(EXPR_SUB,x,y);
+		EXPR_NEXT();
+	EXPR_LABEL(EXPR_MUL):
+		x=&r[ip->b];
+		y=&r[ip->c];
+		if(x->type==TYPE_LONG && y->type==TYPE_LONG && !__builtin_mul_overflow(x->lng,y->lng,&l)) r[ip->a]=expr_long(l);
+		else if(x->type==TYPE_DOUBLE && y->type==TYPE_DOUBLE) r[ip->a]=expr_double(x->dbl*y->dbl);
+		else r[ip->a]=expr_arith(EXPR_MUL,x,y);
+		EXPR_NEXT();
+	EXPR_LABEL(EXPR_DIV):
+		r[ip->a]=expr_arith(EXPR_DIV,&r[ip->b],&r[ip->c]);
+		EXPR_NEXT();
+	EXPR_LABEL(EXPR_MOD):
+		r[ip->a]=expr_arith(EXPR_MOD,&r[ip->b],&r[ip->c]);
+		EXPR_NEXT();
+	EXPR_LABEL(EXPR_EQ):
+		x=&r[ip->b];
+		y=&r[ip->c];
+		if(x->type==TYPE_LONG && y->type==TYPE_LONG) r[ip->a]=expr_bool(x->lng==y->lng);
+		else r[ip->a]=expr_compare(EXPR_EQ,x,y);
+		EXPR_NEXT();
+	EXPR_LABEL(EXPR_NE):
+		x=&r[ip->b];
+		y=&r[ip->c];
+		if(x->type==TYPE_LONG && y->type==TYPE_LONG) r[ip->a]=expr_bool(x->lng!=y->lng);
+		else r[ip->a]=expr_compare(EXPR_NE,x,y);
+		EXPR_NEXT();
+	EXPR_LABEL(EXPR_LT):
+		x=&r[ip->b];
+		y=&r[ip->c];
+		if(x->type==TYPE_LONG && y->type==TYPE_LONG) r[ip->a]=expr_bool(x->lng<y->lng);
+		else if(x->type==TYPE_DOUBLE && y->type==TYPE_DOUBLE) r[ip->a]=expr_bool(x->dbl<y->dbl);
+		else r[ip->a]=expr_compare(EXPR_LT,x,y);
+		EXPR_NEXT();
+	EXPR_LABEL(EXPR_LE):
+		x=&r[ip->b];
+		y=&r[ip->c];
+		if(x->type==TYPE_LONG && y->type==TYPE_LONG) r[ip->a]=expr_bool(x->lng<=y->lng);
+		else if(x->type==TYPE_DOUBLE && y->type==TYPE_DOUBLE) r[ip->a]=expr_bool(x->dbl<=y->dbl);
+		else r[ip->a]=expr_compare(EXPR_LE,x,y);
+		EXPR_NEXT();
+	EXPR_LABEL(EXPR_GT):
+		x=&r[ip->b];
+		y=&r[ip->c];
+		if(x->type==TYPE_LONG && y->type==TYPE_LONG) r[ip->a]=expr_bool(x->lng>y->lng);
+		else if(x->type==TYPE_DOUBLE && y->type==TYPE_DOUBLE) r[ip->a]=expr_bool(x->dbl>y->dbl);
+		else r[ip->a]=expr_compare(EXPR_GT,x,y);
+		EXPR_NEXT();
+	EXPR_LABEL(EXPR_GE):
+		x=&r[ip->b];
+		y=&r[ip->c];
+		if(x->type==TYPE_LONG && y->type==TYPE_LONG) r[ip->a]=expr_bool(x->lng>=y->lng);
+		else if(x->type==TYPE_DOUBLE && y->type==TYPE_DOUBLE) r[ip->a]=expr_bool(x->dbl>=y->dbl);
+		else r[ip->a]=expr_compare(EXPR_GE,x,y);
+		EXPR_NEXT();
+	EXPR_LABEL(EXPR_NEG):
+		r[ip->a]=expr_unary(EXPR_NEG,&r[ip->b]);
+		EXPR_NEXT();
+	EXPR_LABEL(EXPR_NOT):
+		r[ip->a]=expr_bool(!expr_truthy(&r[ip->b]));
+		EXPR_NEXT();
+	EXPR_LABEL(EXPR_BOOL):
+		r[ip->a]=expr_bool(expr_truthy(&r[ip->b]));
+		EXPR_NEXT();
+	EXPR_LABEL(EXPR_JUMP):
+		ip=e->code+ip->c;
+		EXPR_DISPATCH();
+	EXPR_LABEL(EXPR_JUMP_FALSE):
+		if(!expr_truthy(&r[ip->b]))
+		{
+			ip=e->code+ip->c;
+			EXPR_DISPATCH();
+		}
+		EXPR_NEXT();
+	EXPR_LABEL(EXPR_JUMP_TRUE):
+		if(expr_truthy(&r[ip->b]))
+		{
+			ip=e->code+ip->c;
+			EXPR_DISPATCH();
+		}
+		EXPR_NEXT();
+	EXPR_LABEL(EXPR_CALL):
+		r[ip->a]=expr_call(ip->aux,&r[ip->b],ip->c);
+		EXPR_NEXT();
+	EXPR_LABEL(EXPR_RETURN):
+		return r[ip->b];
+#if !defined(__GNUC__)
+	}
+	return expr_null();
+#endif
+}
+
+static bool expr_emit(expr_compiler c, int op, int aux, int a, int b, int target)
+{
+	expr e=c->e;
+	_expr_instr *instr;
+	if(e->count==UINT16_MAX) return false;
+	if(e->count==c->code_capacity)
+	{
+		c->code_capacity*=2;
+		e->code=(_expr_instr *)object_resize(e->code,c->code_capacity*sizeof(_expr_instr));
+	}
+	instr=&e->code[e->count++];
+	instr->op=(uint8_t)op;
+	instr->aux=(uint8_t)aux;
+	instr->a=(uint16_t)a;
+	instr->b=(uint16_t)b;
+	instr->c=(uint16_t)target;
+	return true;
+}
+
+static int expr_constant(expr_compiler c, _expr_value value)
+{
+	expr e=c->e;
+	if(e->constants_count==UINT16_MAX) return -1;
+	if(e->constants_count==c->constants_capacity)
+	{
+		c->constants_capacity*=2;
+		e->constants=(_expr_value *)object_resize(e->constants,c->constants_capacity*sizeof(_expr_value));
+	}
+	e->constants[e->constants_count]=value;
+	return (int)e->constants_count++;
+}
+
+/**
+* Adds the name of a field as a constant of its own, so that every access has its own inline cache.
+* Names are interned, which records match by address.
+*/
+static int expr_name(expr_compiler c, const char *name, size_t size)
+{
+	_expr_value key;
+	key.type=TYPE_STRING;
+	key.obj=any_new_string(string_intern_bytes(name,size));
+	return expr_constant(c,key);
+}
+
+static int expr_register(expr_compiler c)
+{
+	if(c->top==EXPR_MAX_REGISTERS) return -1;
+	if(c->top+1>c->e->registers) c->e->registers=c->top+1;
+	return c->top++;
+}
+
+/**
+* Puts an operand in a register: constants are loaded into the next free register.
+*/
+static int expr_to_register(expr_compiler c, expr_operand operand)
+{
+	int reg, k;
+	if(!operand->constant) return operand->reg;
+	k=expr_constant(c,operand->value);
+	reg=expr_register(c);
+	if(k<0 || reg<0 || !expr_emit(c,EXPR_LOADK,0,reg,k,0)) return -1;
+	operand->constant=false;
+	operand->reg=reg;
+	return reg;
+}
+
+static void expr_set_constant(expr_operand operand, _expr_value value)
+{
+	operand->constant=true;
+	operand->value=value;
+}
+
+static void expr_skip_space(expr_compiler c)
+{
+	while(*c->p==' ' || *c->p=='\t' || *c->p=='\n' || *c->p=='\r') c->p++;
+}
+
+static bool expr_is_name_char(char ch)
+{
+	return (ch>='a' && ch<='z') || (ch>='A' && ch<='Z') || (ch>='0' && ch<='9') || ch=='_';
+}
+
+static bool expr_accept(expr_compiler c, const char *token)
+{
+	size_t size=strlen(token);
+	expr_skip_space(c);
+	if(strncmp(c->p,token,size)!=0) return false;
+	if(expr_is_name_char(token[0]) && expr_is_name_char(c->p[size])) return false;
+	c->p+=size;
+	return true;
+}
+
+/**
+* Recognizes the binary operator at the current position, without taking it.
+*
+* @return the operator; or -1, if there is none.
+*/
+static int expr_peek_binary(expr_compiler c, int *precedence, size_t *size)
+{
+	static const struct { const char *token; int op; int precedence; } operators[]=
+	{
+		{"||", EXPR_OR, 1}, {"or", EXPR_OR, 1}, {"&&", EXPR_AND, 2}, {"and", EXPR_AND, 2},
+		{"==", EXPR_EQ, 3}, {"!=", EXPR_NE, 3}, {"<=", EXPR_LE, 4}, {">=", EXPR_GE, 4}, {"<", EXPR_LT, 4}, {">", EXPR_GT, 4},
+		{"+", EXPR_ADD, 5}, {"-", EXPR_SUB, 5}, {"*", EXPR_MUL, 6}, {"/", EXPR_DIV, 6}, {"%", EXPR_MOD, 6}
+	};
+	size_t i;
+	expr_skip_space(c);
+	for(i=0; i<sizeof(operators)/sizeof(operators[0]); i++)
+	{
+		size_t length=strlen(operators[i].token);
+		if(strncmp(c->p,operators[i].token,length)!=0) continue;
+		if(expr_is_name_char(operators[i].token[0]) && expr_is_name_char(c->p[length])) continue;
+		*precedence=operators[i].precedence;
+		*size=length;
+		return operators[i].op;
+	}
+	return -1;
+}
+
+static bool expr_parse_expression(expr_compiler c, expr_operand out);
+
+static bool expr_parse_number(expr_compiler c, expr_operand out)
+{
+	const char *start=c->p, *p=c->p;
+	bool integral=true;
+	long lng;
+	double dbl;
+	while(*p>='0' && *p<='9') p++;
+	if(*p=='.')
+	{
+		integral=false;
+		for(p++; *p>='0' && *p<='9'; p++);
+	}
+	if(*p=='e' || *p=='E')
+	{
+		integral=false;
+		p++;
+		if(*p=='+' || *p=='-') p++;
+		while(*p>='0' && *p<='9') p++;
+	}
+	if(expr_is_name_char(*p)) return false;
+	c->p=p;
+	if(integral && string_to_long(start,(size_t)(p-start),&lng))
+	{
+		expr_set_constant(out,expr_long(lng));
+		return true;
+	}
+	if(!string_to_double(start,(size_t)(p-start),&dbl)) return false;
+	expr_set_constant(out,expr_double(dbl));
+	return true;
+}
+
+static bool expr_parse_string(expr_compiler c, expr_operand out)
+{
+	char quote=*c->p++;
+	buffer b=buffer_new();
+	while(*c->p!=quote)
+	{
+		char ch=*c->p++;
+		if(ch==0) return false;
+		if(ch=='\\')
+		{
+			ch=*c->p++;
+			switch(ch)
+			{
+				case 0: return false;
+				case 'n': ch='\n'; break;
+				case 't': ch='\t'; break;
+				case 'r': ch='\r'; break;
+				default: break;
+			}
+		}
+		buffer_appendchar(b,ch);
+	}
+	c->p++;
+	expr_set_constant(out,expr_string(buffer_steal(b)));
+	return true;
+}
+
+/**
+* Compiles a call of a built-in function, whose arguments go into consecutive registers.
+* Calls with constant arguments are folded, since all functions are pure.
+*/
+static bool expr_parse_call(expr_compiler c, const char *name, size_t size, expr_operand out)
+{
+	_expr_value values[EXPR_MAX_ARGUMENTS];
+	int function, count=0, base=c->top;
+	size_t start=c->e->count;
+	bool constant=true;
+	for(function=0; function<(int)(sizeof(expr_functions)/sizeof(expr_functions[0])); function++)
+		if(strlen(expr_functions[function].name)==size && memcmp(expr_functions[function].name,name,size)==0) break;
+	if(function==(int)(sizeof(expr_functions)/sizeof(expr_functions[0]))) return false;
+	if(!expr_accept(c,")"))
+	{
+		do
+		{
+			_expr_operand argument;
+			if(count==EXPR_MAX_ARGUMENTS || !expr_parse_expression(c,&argument)) return false;
+			if(argument.constant) values[count]=argument.value;
+			else constant=false;
+			if(expr_to_register(c,&argument)<0) return false;
+			count++;
+		}
+		while(expr_accept(c,","));
+		if(!expr_accept(c,")")) return false;
+	}
+	if(count<expr_functions[function].min_arguments || count>expr_functions[function].max_arguments) return false;
+	c->top=base;
+	if(constant)
+	{
+		c->e->count=start;
+		expr_set_constant(out,expr_call(function,values,count));
+		return true;
+	}
+	out->constant=false;
+	out->reg=expr_register(c);
+	return out->reg>=0 && expr_emit(c,EXPR_CALL,function,base,base,count);
+}
+
+static bool expr_parse_primary(expr_compiler c, expr_operand out)
+{
+	const char *name;
+	size_t size;
+	int k;
+	expr_skip_space(c);
+	if((*c->p>='0' && *c->p<='9') || (*c->p=='.' && c->p[1]>='0' && c->p[1]<='9')) return expr_parse_number(c,out);
+	if(*c->p=='"' || *c->p=='\'') return expr_parse_string(c,out);
+	if(expr_accept(c,"("))
+	{
+		if(!expr_parse_expression(c,out)) return false;
+		return expr_accept(c,")");
+	}
+	if(!expr_is_name_char(*c->p) || (*c->p>='0' && *c->p<='9')) return false;
+	name=c->p;
+	while(expr_is_name_char(*c->p)) c->p++;
+	size=(size_t)(c->p-name);
+	if(size==4 && memcmp(name,"true",4)==0) expr_set_constant(out,expr_bool(true));
+	else if(size==5 && memcmp(name,"false",5)==0) expr_set_constant(out,expr_bool(false));
+	else if(size==4 && memcmp(name,"null",4)==0) expr_set_constant(out,expr_null());
+	else if(expr_accept(c,"(")) return expr_parse_call(c,name,size,out);
+	else
+	{
+		k=expr_name(c,name,size);
+		out->constant=false;
+		out->reg=expr_register(c);
+		return k>=0 && out->reg>=0 && expr_emit(c,EXPR_FIELD,0,out->reg,k,0);
+	}
+	return true;
+}
+
+/**
+* Compiles a primary expression followed by field accesses, such as a.b, and indexes, such as a[0].
+*/
+static bool expr_parse_postfix(expr_compiler c, expr_operand out)
+{
+	int base=c->top, k;
+	if(!expr_parse_primary(c,out)) return false;
+	while(1)
+	{
+		if(expr_accept(c,"."))
+		{
+			const char *name;
+			expr_skip_space(c);
+			name=c->p;
+			while(expr_is_name_char(*c->p)) c->p++;
+			if(c->p==name || expr_to_register(c,out)<0) return false;
+			k=expr_name(c,name,(size_t)(c->p-name));
+			if(k<0 || !expr_emit(c,EXPR_GET,0,base,base,k)) return false;
+		}
+		else if(expr_accept(c,"["))
+		{
+			_expr_operand index;
+			int reg;
+			if(expr_to_register(c,out)<0 || !expr_parse_expression(c,&index)) return false;
+			reg=expr_to_register(c,&index);
+			if(reg<0 || !expr_accept(c,"]") || !expr_emit(c,EXPR_INDEX,0,base,base,reg)) return false;
+			c->top=base+1;
+		}
+		else return true;
+	}
+}
+
+/**
+* Tells whether the literal at 'p' is 2^63, which only fits in a long once negated.
+*/
+static bool expr_is_long_min_magnitude(const char *p)
+{
+	while(*p=='0') p++;
+	return strncmp(p,"9223372036854775808",19)==0 && !expr_is_name_char(p[19]) && p[19]!='.';
+}
+
+static bool expr_parse_unary(expr_compiler c, expr_operand out)
+{
+	int op, base=c->top;
+	const char *operand;
+	bool ok;
+	if(expr_accept(c,"!") || expr_accept(c,"not")) op=EXPR_NOT;
+	else if(expr_accept(c,"-")) op=EXPR_NEG;
+	else return expr_parse_postfix(c,out);
+	expr_skip_space(c);
+	operand=c->p;
+	if(++c->depth>EXPR_MAX_DEPTH) return false;
+	ok=expr_parse_unary(c,out);
+	c->depth--;
+	if(!ok) return false;
+	if(out->constant)
+	{
+		//the literal is parsed before it is negated, so -9223372036854775808 would otherwise be a double
+		if(op==EXPR_NEG && out->value.type==TYPE_DOUBLE && expr_is_long_min_magnitude(operand)) expr_set_constant(out,expr_long(LONG_MIN));
+		else expr_set_constant(out,expr_unary(op,&out->value));
+		return true;
+	}
+	return expr_emit(c,op,0,base,out->reg,0);
+}
+
+
+static bool expr_parse_binary(expr_compiler c, int min_precedence, expr_operand out);
+
+/**
+* Compiles the right side of && or ||, whose left side is in 'out': the result is a boolean,
+* and the right side is only evaluated if the left side does not decide it. A constant left side
+* decides at compile time, and the code of a right side that is never evaluated is dropped.
+*/
+static bool expr_parse_logical(expr_compiler c, int op, int precedence, expr_operand out, int base)
+{
+	_expr_operand right;
+	size_t start=c->e->count, jump;
+	int reg;
+	if(out->constant)
+	{
+		bool truth=expr_truthy(&out->value);
+		c->top=base;
+		if(!expr_parse_binary(c,precedence+1,&right)) return false;
+		if(truth==(op==EXPR_OR))
+		{
+			c->e->count=start;
+			c->top=base;
+			expr_set_constant(out,expr_bool(truth));
+			return true;
+		}
+		if(right.constant)
+		{
+			expr_set_constant(out,expr_bool(expr_truthy(&right.value)));
+			return true;
+		}
+		out->constant=false;
+		out->reg=base;
+		return expr_emit(c,EXPR_BOOL,0,base,right.reg,0);
+	}
+	if(!expr_emit(c,EXPR_BOOL,0,base,base,0)) return false;
+	jump=c->e->count;
+	if(!expr_emit(c,op==EXPR_AND?EXPR_JUMP_FALSE:EXPR_JUMP_TRUE,0,0,base,0)) return false;
+	if(!expr_parse_binary(c,precedence+1,&right)) return false;
+	if(right.constant) expr_set_constant(&right,expr_bool(expr_truthy(&right.value)));
+	reg=expr_to_register(c,&right);
+	if(reg<0 || !expr_emit(c,EXPR_BOOL,0,base,reg,0)) return false;
+	c->e->code[jump].c=(uint16_t)c->e->count;
+	c->top=base+1;
+	return true;
+}
+
+/**
+* Compiles binary operators by precedence climbing: operators of at least 'min_precedence' are taken
+* here, tighter ones in the recursion for their right side. Operators on two constants are folded.
+*/
+static bool expr_parse_binary(expr_compiler c, int min_precedence, expr_operand out)
+{
+	int base=c->top, op, precedence, left, right_reg;
+	size_t size;
+	if(!expr_parse_unary(c,out)) return false;
+	while((op=expr_peek_binary(c,&precedence,&size))>=0 && precedence>=min_precedence)
+	{
+		_expr_operand right;
+		c->p+=size;
+		if(op==EXPR_AND || op==EXPR_OR)
+		{
+			if(!expr_parse_logical(c,op,precedence,out,base)) return false;
+			continue;
+		}
+		if(!expr_parse_binary(c,precedence+1,&right)) return false;
+		if(out->constant && right.constant)
+		{
+			expr_set_constant(out,expr_fold(op,&out->value,&right.value));
+			continue;
+		}
+		//a non-constant side is in 'base'; the other one goes in the next register
+		right_reg=expr_to_register(c,&right);
+		left=expr_to_register(c,out);
+		if(right_reg<0 || left<0 || !expr_emit(c,op,0,base,left,right_reg)) return false;
+		out->reg=base;
+		c->top=base+1;
+	}
+	return true;
+}
+
+/**
+* Compiles a full expression, which may be a conditional: condition ? then : else.
+* The result is a constant, or is left in the first free register.
+*/
+static bool expr_parse_expression(expr_compiler c, expr_operand out)
+{
+	_expr_operand then_operand, else_operand;
+	int base=c->top;
+	size_t start, jump_false, jump;
+	if(++c->depth>EXPR_MAX_DEPTH || !expr_parse_binary(c,1,out)) return false;
+	if(!expr_accept(c,"?"))
+	{
+		c->depth--;
+		return true;
+	}
+	if(out->constant)
+	{
+		//only the branch taken is kept
+		bool truth=expr_truthy(&out->value);
+		start=c->e->count;
+		if(!expr_parse_expression(c,&then_operand) || !expr_accept(c,":")) return false;
+		if(!truth) c->e->count=start;
+		start=c->e->count;
+		c->top=base;
+		if(!expr_parse_expression(c,&else_operand)) return false;
+		if(truth) c->e->count=start;
+		*out=truth?then_operand:else_operand;
+		c->top=out->constant?base:base+1;
+		c->depth--;
+		return true;
+	}
+	jump_false=c->e->count;
+	if(!expr_emit(c,EXPR_JUMP_FALSE,0,0,base,0)) return false;
+	c->top=base;
+	if(!expr_parse_expression(c,&then_operand) || expr_to_register(c,&then_operand)<0) return false;
+	jump=c->e->count;
+	if(!expr_emit(c,EXPR_JUMP,0,0,0,0) || !expr_accept(c,":")) return false;
+	c->e->code[jump_false].c=(uint16_t)c->e->count;
+	c->top=base;
+	if(!expr_parse_expression(c,&else_operand) || expr_to_register(c,&else_operand)<0) return false;
+	c->e->code[jump].c=(uint16_t)c->e->count;
+	out->reg=base;
+	c->top=base+1;
+	c->depth--;
+	return true;
+}
+
+//PRIVATE
+
+/**
+* Compiles an expression into bytecode for a register machine, once, so that evaluating it per record
+* is a loop over a few instructions. The language has numbers, 'strings' or "strings" with \n, \t, \r
+* and \ escapes, true, false and null; fields of the record by name, fields of maps and records as in a.b,
+* items of arrays, maps and records as in a[0] or a['b']; the operators - ! not * / % + - < <= > >= == != && and || or,
+* from the tightest to the loosest, and the conditional c ? x : y; and the functions len, lower, upper,
+* contains, starts_with, ends_with, abs, min, max, int, float and str. Integers are longs, become
+* doubles when they overflow, and compare exactly with doubles; / on two longs truncates; + joins
+* strings; division by zero and operators on values of the wrong types give null, and comparisons
+* of such values give false. && and || give booleans, and only evaluate their right side if needed.
+* Null, false, zero, the empty string and the empty array are false. Subexpressions whose operands
+* are all constants are computed while compiling.
+*
+* @param source the expression.
+* @return A pointer to the compiled expression; or NULL, if the expression is not valid or too large.
+*/
+expr expr_compile(string source)
+{
+	_expr_compiler compiler;
+	expr_compiler c=&compiler;
+	_expr_operand result;
+	expr e=(expr)object_new(sizeof(_expr));
+	int reg;
+	c->e=e;
+	c->p=source;
+	c->code_capacity=EXPR_CODE_CAPACITY;
+	c->constants_capacity=EXPR_CONSTANTS_CAPACITY;
+	c->top=0;
+	c->depth=0;
+	e->code=(_expr_instr *)object_new_atomic(c->code_capacity*sizeof(_expr_instr));
+	e->constants=(_expr_value *)object_new(c->constants_capacity*sizeof(_expr_value));
+	if(!expr_parse_expression(c,&result)) return NULL;
+	expr_skip_space(c);
+	if(*c->p!=0) return NULL;
+	reg=expr_to_register(c,&result);
+	if(reg<0 || !expr_emit(c,EXPR_RETURN,0,0,reg,0)) return NULL;
+	e->caches=(_shape_cache *)object_new((e->constants_count+1)*sizeof(_shape_cache));
+	return e;
+}
+
+/**
+* Evaluates an expression against a record. Fields of records, see shape.h, are read through
+* inline caches kept in the expression, so one expression must not evaluate records
+* on several threads at once; maps have no such limit.
+*
+* @param e the expression.
+* @param record the record whose fields the expression names; a map or a record.
+* @return The value.
+*/
+any expr_eval(expr e, any record)
+{
+	_expr_value value=expr_run(e,record);
+	return expr_to_any(&value);
+}
+
+/**
+* Evaluates an expression against a record as a condition, such as a filter; unlike expr_eval(),
+* it does not allocate the result.
+*
+* @param e the expression.
+* @param record the record; see expr_eval().
+* @return true, if the value is true; see expr_compile().
+*/
+bool expr_test(expr e, any record)
+{
+	_expr_value value=expr_run(e,record);
+	return expr_truthy(&value);
+}
@@ -0,0 +1,85 @@
+/**
+ *
+ * libscriptify
+ *
+ * @author  Erik Poupaert <erik@sankuru.biz>
+ *
+ * @section LICENSE
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU LGPL as
+ * published by the Free Software Foundation; either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * LGPL for more details at: http://www.gnu.org/licenses/lgpl.html
+ *
+ * @section DESCRIPTION
+ *
+ * Expressions over any values, such as filters and transforms of records: the source is compiled
+ * once, with constants folded, into bytecode for a register machine, which evaluates it per record.
+ *
+ */
+#ifndef _EXPR_H
+#define _EXPR_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include "any.h"
+#include "shape.h"
+
+#ifdef __cplusplus
+	extern "C" {
+#endif
+
+/* maximum number of registers an expression may use */
+#define EXPR_MAX_REGISTERS 256
+/* maximum nesting of subexpressions */
+#define EXPR_MAX_DEPTH 256
+
+/* a value in a register: numbers and booleans unboxed, everything else as an any */
+typedef struct
+{
+	vartype type; //TYPE_LONG, TYPE_DOUBLE, TYPE_BOOL, TYPE_NULL; otherwise 'obj' holds the value
+	union
+	{
+		long lng;
+		double dbl;
+		bool bln;
+		any obj;
+	};
+} _expr_value;
+
+typedef struct
+{
+	uint8_t op;
+	uint8_t aux; //CALL: the function
+	uint16_t a; //the destination register
+	uint16_t b;
+	uint16_t c;
+} _expr_instr;
+
+typedef struct
+{
+	_expr_instr *code;
+	size_t count;
+	_expr_value *constants; //constants, and the names of fields as string anys
+	size_t constants_count;
+	_shape_cache *caches; //inline caches for fields of records, by the index of their name in 'constants'
+	int registers; //number of registers used
+} _expr;
+
+typedef _expr* expr;
+
+expr expr_compile(string source);
+any expr_eval(expr e, any record);
+bool expr_test(expr e, any record);
+
+#ifdef __cplusplus
+	}
+#endif
+
+#endif // _EXPR_H
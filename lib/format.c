@@ -0,0 +1,456 @@
+/**
+ *
+ * libscriptify
+ *
+ * @author  Erik Poupaert <erik@sankuru.biz>
+ *
+ * @section LICENSE
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU LGPL as
+ * published by the Free Software Foundation; either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * LGPL for more details at: http://www.gnu.org/licenses/lgpl.html
+ *
+ * @section DESCRIPTION
+ *
+ * Format strings compiled once into a list of operations, and rendered into buffers.
+ * Compiled formats are cached by address, so that the same template is parsed only once.
+ *
+ */
+#include <string.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <stddef.h>
+#include <wchar.h>
+#include "object.h"
+#include "format.h"
+#include "number.h"
+
+//PRIVATE
+
+/* room reserved for each conversion when estimating the size of the output */
+#define FORMAT_CONVERSION_ESTIMATE 16
+
+static format format_cache[FORMAT_CACHE_SIZE];
+
+typedef union
+{
+	long long i;
+	unsigned long long u;
+	double d;
+	long double ld;
+	const void *p;
+	wint_t c;
+} format_value;
+
+static inline bool format_isdigit(char c)
+{
+	return c>='0' && c<='9';
+}
+
+/**
+* Reads a signed integer argument with the given length modifier,
+* converted the way printf() converts it.
+*/
+static long long format_arg_signed(char length, va_list *args)
+{
+	switch(length)
+	{
+		case 'H': return (signed char)va_arg(*args,int);
+		case 'h': return (short)va_arg(*args,int);
+		case 'l': return va_arg(*args,long);
+		case 'q': return va_arg(*args,long long);
+		case 'j': return va_arg(*args,intmax_t);
+		case 'z': return (long long)va_arg(*args,size_t);
+		case 't': return va_arg(*args,ptrdiff_t);
+		default: return va_arg(*args,int);
+	}
+}
+
+static unsigned long long format_arg_unsigned(char length, va_list *args)
+{
+	switch(length)
+	{
+		case 'H': return (unsigned char)va_arg(*args,unsigned int);
+		case 'h': return (unsigned short)va_arg(*args,unsigned int);
+		case 'l': return va_arg(*args,unsigned long);
+		case 'q': return va_arg(*args,unsigned long long);
+		case 'j': return va_arg(*args,uintmax_t);
+		case 'z': return va_arg(*args,size_t);
+		case 't': return (unsigned long long)va_arg(*args,ptrdiff_t);
+		default: return va_arg(*args,unsigned int);
+	}
+}
+
+/**
+* Formats one value with snprintf(), using the specification of the operation.
+* Integer specifications were rewritten at compile time to take a long long,
+* so that every integer type goes through the same call.
+*/
+static int format_snprintf(char *dest, size_t room, _format_op *op, int *stars, format_value *value)
+{
+#define FORMAT_SNPRINTF(x) (op->stars==0?snprintf(dest,room,op->data,x) \
+	:op->stars==1?snprintf(dest,room,op->data,stars[0],x) \
+	:snprintf(dest,room,op->data,stars[0],stars[1],x))
+	switch(op->conversion)
+	{
+		case 'd': case 'i':
+			return FORMAT_SNPRINTF(value->i);
+		case 'o': case 'u': case 'x': case 'X':
+			return FORMAT_SNPRINTF(value->u);
+		case 'c':
+			return FORMAT_SNPRINTF(value->c);
+		case 's': case 'p':
+			return FORMAT_SNPRINTF(value->p);
+		default:
+			if(op->length=='L') return FORMAT_SNPRINTF(value->ld);
+			return FORMAT_SNPRINTF(value->d);
+	}
+#undef FORMAT_SNPRINTF
+}
+
+/**
+* Renders a conversion that has no fast path.
+*/
+static void format_generic(_format_op *op, buffer abuffer, va_list *args)
+{
+	int stars[2];
+	int i, n;
+	format_value value;
+	for(i=0; i<op->stars; i++) stars[i]=va_arg(*args,int);
+	switch(op->conversion)
+	{
+		case 'd': case 'i':
+			value.i=format_arg_signed(op->length,args);
+			break;
+		case 'o': case 'u': case 'x': case 'X':
+			value.u=format_arg_unsigned(op->length,args);
+			break;
+		case 'c':
+			value.c=op->length=='l'?va_arg(*args,wint_t):(wint_t)va_arg(*args,int);
+			break;
+		case 's': case 'p':
+			value.p=va_arg(*args,const void *);
+			break;
+		default:
+			if(op->length=='L') value.ld=va_arg(*args,long double);
+			else value.d=va_arg(*args,double);
+	}
+	while(1)
+	{
+		size_t room=abuffer->capacity-abuffer->size;
+		n=format_snprintf(abuffer->data+abuffer->size,room,op,stars,&value);
+		if(n<0) return;
+		if((size_t)n<room) break;
+		buffer_ensure_capacity(abuffer,abuffer->size+n+1);
+	}
+	abuffer->size+=n;
+}
+
+/**
+* Renders a fixed-point conversion; values out of the range of number_write_fixed()
+* go through snprintf().
+*/
+static void format_double(_format_op *op, buffer abuffer, double value)
+{
+	size_t n;
+	int i;
+	buffer_ensure_capacity(abuffer,abuffer->size+NUMBER_MAX_LENGTH);
+	n=number_write_fixed(abuffer->data+abuffer->size,value,op->precision<0?6:op->precision);
+	if(n>0)
+	{
+		abuffer->size+=n;
+		return;
+	}
+	while(1)
+	{
+		size_t room=abuffer->capacity-abuffer->size;
+		i=snprintf(abuffer->data+abuffer->size,room,op->data,value);
+		if(i<0) return;
+		if((size_t)i<room) break;
+		buffer_ensure_capacity(abuffer,abuffer->size+i+1);
+	}
+	abuffer->size+=i;
+}
+
+/**
+* Parses one conversion specification starting at the '%' at 'p'.
+*
+* @return the first character after the specification; or NULL if it is not supported.
+*/
+static const char *format_parse_conversion(const char *p, _format_op *op)
+{
+	const char *start=p++;
+	const char *flags, *length;
+	bool simple;
+	size_t n;
+	string spec;
+	op->stars=0;
+	op->precision=-1;
+	op->length=0;
+	flags=p;
+	while(*p=='-' || *p=='+' || *p==' ' || *p=='#' || *p=='0' || *p=='\'') p++;
+	simple=p==flags;
+	if(*p=='*')
+	{
+		op->stars++;
+		p++;
+		simple=false;
+	}
+	else while(format_isdigit(*p))
+	{
+		p++;
+		simple=false;
+	}
+	if(*p=='.')
+	{
+		p++;
+		if(*p=='*')
+		{
+			op->stars++;
+			p++;
+			simple=false;
+		}
+		else
+		{
+			op->precision=0;
+			while(format_isdigit(*p)) op->precision=op->precision*10+(*p++-'0');
+		}
+	}
+	length=p;
+	if(p[0]=='h' && p[1]=='h') { op->length='H'; p+=2; }
+	else if(p[0]=='l' && p[1]=='l') { op->length='q'; p+=2; }
+	else if(*p=='h' || *p=='l' || *p=='L' || *p=='j' || *p=='z' || *p=='t') op->length=*p++;
+	if(*p==0 || strchr("diouxXcspfFeEgGaA",*p)==NULL) return NULL;
+	op->conversion=*p;
+	switch(op->conversion)
+	{
+		case 'd': case 'i':
+			op->type=simple && op->precision<0?FORMAT_INT:FORMAT_GENERIC;
+			break;
+		case 'u':
+			op->type=simple && op->precision<0?FORMAT_UNSIGNED:FORMAT_GENERIC;
+			break;
+		case 's':
+			op->type=simple && op->precision<0 && op->length==0?FORMAT_STRING:FORMAT_GENERIC;
+			break;
+		case 'c':
+			op->type=simple && op->length==0?FORMAT_CHAR:FORMAT_GENERIC;
+			break;
+		case 'f':
+			op->type=simple && op->precision<=NUMBER_MAX_FIXED_PRECISION && (op->length==0 || op->length=='l')?FORMAT_DOUBLE:FORMAT_GENERIC;
+			break;
+		default:
+			op->type=FORMAT_GENERIC;
+	}
+	//the printf specification, with integer lengths rewritten to 'll'
+	n=(size_t)(length-start);
+	spec=string_new(n+3);
+	memcpy(spec,start,n);
+	if(strchr("diouxX",op->conversion)!=NULL)
+	{
+		spec[n++]='l';
+		spec[n++]='l';
+	}
+	else if(op->length=='l' || op->length=='L')
+	{
+		spec[n++]=op->length;
+	}
+	spec[n++]=op->conversion;
+	spec[n]=0;
+	op->data=spec;
+	op->size=n;
+	return p+1;
+}
+
+/**
+* Compiles a format string; a format string with a conversion that is not supported
+* is returned as well, with 'supported' false, so that format_cached() can remember it.
+*/
+static format format_parse(const char *fmt)
+{
+	size_t length=strlen(fmt);
+	size_t conversions=0;
+	size_t i;
+	const char *p;
+	string literals;
+	size_t literals_size=0;
+	format f=(format)object_new(sizeof(_format));
+	for(i=0; i<length; i++)
+		if(fmt[i]=='%') conversions++;
+	f->address=fmt;
+	f->source=string_new(length);
+	memcpy(f->source,fmt,length+1);
+	f->ops=(_format_op *)object_new((2*conversions+1)*sizeof(_format_op));
+	f->count=0;
+	f->estimate=1;
+	literals=string_new(length);
+	p=fmt;
+	while(*p!=0)
+	{
+		const char *literal;
+		size_t literal_size;
+		_format_op *op;
+		if(*p=='%' && p[1]!='%')
+		{
+			op=&f->ops[f->count++];
+			p=format_parse_conversion(p,op);
+			if(p==NULL)
+			{
+				f->count=0;
+				return f;
+			}
+			f->estimate+=FORMAT_CONVERSION_ESTIMATE;
+			continue;
+		}
+		if(*p=='%')
+		{
+			literal=p+1;
+			p+=2;
+		}
+		else
+		{
+			literal=p;
+			while(*p!=0 && *p!='%') p++;
+		}
+		//consecutive literals are merged into one operation
+		literal_size=(size_t)(p-literal);
+		memcpy(literals+literals_size,literal,literal_size);
+		if(f->count>0 && f->ops[f->count-1].type==FORMAT_LITERAL)
+		{
+			f->ops[f->count-1].size+=literal_size;
+		}
+		else
+		{
+			op=&f->ops[f->count++];
+			op->type=FORMAT_LITERAL;
+			op->data=literals+literals_size;
+			op->size=literal_size;
+		}
+		literals_size+=literal_size;
+		f->estimate+=literal_size;
+	}
+	f->supported=true;
+	return f;
+}
+
+//PRIVATE
+
+/**
+* Compiles a printf-style format string into a list of operations.
+* The usual conversions are supported, with flags, width, precision and length modifiers;
+* %n and %m are not.
+*
+* @param fmt the format string.
+* @return A pointer to the compiled format; or NULL if the format string contains a conversion that is not supported.
+*/
+format format_compile(const char *fmt)
+{
+	format f=format_parse(fmt);
+	return f->supported?f:NULL;
+}
+
+/**
+* Returns the compiled form of a format string, compiling it only on first use.
+* Compiled formats are cached by the address of the format string; the content
+* is compared as well, so a format string at a reused address is recompiled.
+* Format strings that are not supported are cached too, so that they are not compiled again.
+* This function is safe to call from several threads at the same time.
+*
+* @param fmt the format string.
+* @return A pointer to the compiled format; or NULL if the format string is not supported, see format_compile().
+*/
+format format_cached(const char *fmt)
+{
+	size_t slot=(size_t)((((uint64_t)(uintptr_t)fmt)*0x9e3779b97f4a7c15ull)>>32)%FORMAT_CACHE_SIZE;
+	format f=__atomic_load_n(&format_cache[slot],__ATOMIC_ACQUIRE);
+	if(f==NULL || f->address!=fmt || strcmp(f->source,fmt)!=0)
+	{
+		f=format_parse(fmt);
+		__atomic_store_n(&format_cache[slot],f,__ATOMIC_RELEASE);
+	}
+	return f->supported?f:NULL;
+}
+
+/**
+* Renders a compiled format with the arguments given, and appends the result to a buffer.
+* The arguments must match the conversions of the format, as for printf().
+*
+* @param f the compiled format.
+* @param abuffer the buffer to append to.
+*/
+void format_render(format f, buffer abuffer, ...)
+{
+	va_list args;
+	va_start(args,abuffer);
+	format_vrender(f,abuffer,args);
+	va_end(args);
+}
+
+/**
+* Renders a compiled format with a va_list of arguments, and appends the result to a buffer.
+* Plain %d, %u, %s, %c and %f conversions are written without going through printf().
+*
+* @param f the compiled format.
+* @param abuffer the buffer to append to.
+* @param args the arguments.
+*/
+void format_vrender(format f, buffer abuffer, va_list args)
+{
+	va_list ap;
+	size_t i;
+	const char *s;
+	va_copy(ap,args);
+	for(i=0; i<f->count; i++)
+	{
+		_format_op *op=&f->ops[i];
+		switch(op->type)
+		{
+			case FORMAT_LITERAL:
+				buffer_append(abuffer,op->data,op->size);
+				break;
+			case FORMAT_INT:
+				buffer_append_long(abuffer,(long)format_arg_signed(op->length,&ap));
+				break;
+			case FORMAT_UNSIGNED:
+				buffer_ensure_capacity(abuffer,abuffer->size+NUMBER_MAX_LENGTH);
+				abuffer->size+=number_write_ulong(abuffer->data+abuffer->size,(unsigned long)format_arg_unsigned(op->length,&ap));
+				break;
+			case FORMAT_STRING:
+				s=va_arg(ap,const char *);
+				if(s==NULL) s="(null)";
+				buffer_append(abuffer,s,strlen(s));
+				break;
+			case FORMAT_CHAR:
+				buffer_appendchar(abuffer,(char)va_arg(ap,int));
+				break;
+			case FORMAT_DOUBLE:
+				format_double(op,abuffer,va_arg(ap,double));
+				break;
+			default:
+				format_generic(op,abuffer,&ap);
+		}
+	}
+	va_end(ap);
+}
+
+/**
+* Renders a compiled format with the arguments given, into a new string.
+*
+* @param f the compiled format.
+* @return A pointer to the new string.
+*/
+string format_tostring(format f, ...)
+{
+	va_list args;
+	buffer abuffer=buffer_new_capacity(f->estimate);
+	va_start(args,f);
+	format_vrender(f,abuffer,args);
+	va_end(args);
+	return buffer_steal(abuffer);
+}
@@ -0,0 +1,87 @@
+/**
+ *
+ * libscriptify
+ *
+ * @author  Erik Poupaert <erik@sankuru.biz>
+ *
+ * @section LICENSE
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU LGPL as
+ * published by the Free Software Foundation; either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * LGPL for more details at: http://www.gnu.org/licenses/lgpl.html
+ *
+ * @section DESCRIPTION
+ *
+ * Format strings compiled once into a list of operations, and rendered into buffers.
+ * Compiled formats are cached by address, so that the same template is parsed only once.
+ *
+ */
+#ifndef _FORMAT_H
+#define _FORMAT_H
+
+#include <stddef.h>
+#include <stdarg.h>
+#include <stdbool.h>
+#include "string_utf8.h"
+#include "buffer.h"
+
+#ifdef __cplusplus
+	extern "C" {
+#endif
+
+/* number of slots in the cache of format_cached() */
+#define FORMAT_CACHE_SIZE 256
+
+enum _FORMAT_OPTYPE
+{
+	  FORMAT_LITERAL //bytes copied as they are
+	, FORMAT_INT //%d, %i without flags, width or precision
+	, FORMAT_UNSIGNED //%u without flags, width or precision
+	, FORMAT_STRING //%s without flags, width or precision
+	, FORMAT_CHAR //%c without flags or width
+	, FORMAT_DOUBLE //%f without flags or width, at most NUMBER_MAX_FIXED_PRECISION decimals
+	, FORMAT_GENERIC //any other conversion, or one with flags or a width
+};
+
+typedef enum _FORMAT_OPTYPE FORMAT_OPTYPE;
+
+typedef struct
+{
+	FORMAT_OPTYPE type;
+	char conversion; //the conversion character, such as 'd' or 'x'
+	char length; //the length modifier: 0, 'H' (hh), 'h', 'l', 'q' (ll), 'L', 'j', 'z' or 't'
+	int precision; //-1 when absent
+	int stars; //number of '*' arguments read before the value
+	const char *data; //literals: the bytes; conversions: the printf specification, null-terminated
+	size_t size; //literals: the number of bytes
+} _format_op;
+
+typedef struct
+{
+	const char *address; //the format string it was compiled from, the key in the cache
+	string source; //copy of the format string
+	_format_op *ops;
+	size_t count;
+	size_t estimate; //expected size of the output, to size buffers up front
+	bool supported; //false for a format string format_compile() rejects, cached so that it is not compiled again
+} _format;
+
+typedef _format* format;
+
+format format_compile(const char *fmt);
+format format_cached(const char *fmt);
+void format_render(format f, buffer abuffer, ...);
+void format_vrender(format f, buffer abuffer, va_list args);
+string format_tostring(format f, ...);
+
+#ifdef __cplusplus
+	}
+#endif
+
+#endif // _FORMAT_H
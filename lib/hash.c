@@ -0,0 +1,346 @@
+/**
+ *
+ * libscriptify
+ *
+ * @author  Erik Poupaert <erik@sankuru.biz>
+ *
+ * @section LICENSE
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU LGPL as
+ * published by the Free Software Foundation; either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * LGPL for more details at: http://www.gnu.org/licenses/lgpl.html
+ *
+ * @section DESCRIPTION
+ *
+ * Seeded 64-bit hashing of byte sequences (wyhash construction), in one shot or streaming.
+ * The default seed is drawn from the operating system once per process, so that hash values
+ * cannot be predicted by whoever supplies the keys.
+ *
+ */
+#include <string.h>
+#include <stdio.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+#include "object.h"
+#include "hash.h"
+
+//PRIVATE
+
+static const uint64_t hash_secret[4]=
+{
+	  0x2d358dccaa6c78a5ull
+	, 0x8bb84b93962eacc9ull
+	, 0x4b33a62ed433d4a3ull
+	, 0x4d5a2da51de1aa47ull
+};
+
+static uint64_t hash_process_seed=0;
+static int hash_process_seed_ready=0;
+
+#if defined(__GNUC__)
+#define HASH_LIKELY(x) __builtin_expect(!!(x),1)
+#define HASH_UNLIKELY(x) __builtin_expect(!!(x),0)
+#else
+#define HASH_LIKELY(x) (x)
+#define HASH_UNLIKELY(x) (x)
+#endif
+
+/**
+* Multiplies two 64-bit values into a 128-bit product, leaving the low half in 'a'
+* and the high half in 'b'.
+*/
+static inline void hash_mum(uint64_t *a, uint64_t *b)
+{
+#ifdef __SIZEOF_INT128__
+	__uint128_t r=*a;
+	r*=*b;
+	*a=(uint64_t)r;
+	*b=(uint64_t)(r>>64);
+#else
+	uint64_t ha=*a>>32, hb=*b>>32, la=(uint32_t)*a, lb=(uint32_t)*b;
+	uint64_t rh=ha*hb, rm0=ha*lb, rm1=hb*la, rl=la*lb, t=rl+(rm0<<32), c=t<rl;
+	uint64_t lo=t+(rm1<<32);
+	c+=lo<t;
+	*a=lo;
+	*b=rh+(rm0>>32)+(rm1>>32)+c;
+#endif
+}
+
+static inline uint64_t hash_mix(uint64_t a, uint64_t b)
+{
+	hash_mum(&a,&b);
+	return a^b;
+}
+
+static inline uint64_t hash_read8(const unsigned char *p)
+{
+	uint64_t v;
+	memcpy(&v,p,8);
+	return v;
+}
+
+static inline uint64_t hash_read4(const unsigned char *p)
+{
+	uint32_t v;
+	memcpy(&v,p,4);
+	return v;
+}
+
+static inline uint64_t hash_read3(const unsigned char *p, size_t k)
+{
+	return (((uint64_t)p[0])<<16)|(((uint64_t)p[k>>1])<<8)|p[k-1];
+}
+
+static inline uint64_t hash_premix(uint64_t seed)
+{
+	return seed^hash_mix(seed^hash_secret[0],hash_secret[1]);
+}
+
+static inline uint64_t hash_block(const unsigned char *p, uint64_t seed, uint64_t *see1, uint64_t *see2)
+{
+	*see1=hash_mix(hash_read8(p+16)^hash_secret[2],hash_read8(p+24)^*see1);
+	*see2=hash_mix(hash_read8(p+32)^hash_secret[3],hash_read8(p+40)^*see2);
+	return hash_mix(hash_read8(p)^hash_secret[1],hash_read8(p+8)^seed);
+}
+
+/**
+* Hashes at most 16 bytes. The short path reads overlapping words instead of looping.
+*/
+static inline uint64_t hash_short(const unsigned char *p, size_t len, uint64_t seed)
+{
+	uint64_t a, b;
+	if(HASH_LIKELY(len>=4))
+	{
+		a=(hash_read4(p)<<32)|hash_read4(p+((len>>3)<<2));
+		b=(hash_read4(p+len-4)<<32)|hash_read4(p+len-4-((len>>3)<<2));
+	}
+	else if(HASH_LIKELY(len>0))
+	{
+		a=hash_read3(p,len);
+		b=0;
+	}
+	else a=b=0;
+	a^=hash_secret[1];
+	b^=seed;
+	hash_mum(&a,&b);
+	return hash_mix(a^hash_secret[0]^len,b^hash_secret[1]);
+}
+
+/**
+* Finishes a hash of more than 16 bytes: consumes the remaining 16-byte strides of 'p'
+* and mixes in 'tail', which holds the last 16 bytes of the whole input.
+*/
+static inline uint64_t hash_finish(const unsigned char *p, size_t i, const unsigned char *tail, size_t len, uint64_t seed)
+{
+	uint64_t a, b;
+	while(HASH_UNLIKELY(i>16))
+	{
+		seed=hash_mix(hash_read8(p)^hash_secret[1],hash_read8(p+8)^seed);
+		i-=16;
+		p+=16;
+	}
+	a=hash_read8(tail)^hash_secret[1];
+	b=hash_read8(tail+8)^seed;
+	hash_mum(&a,&b);
+	return hash_mix(a^hash_secret[0]^len,b^hash_secret[1]);
+}
+
+/**
+* Draws a seed from the operating system random source.
+* Falls back on the clock, the process id and the address space layout when none is available.
+*/
+static uint64_t hash_random_seed()
+{
+	uint64_t seed=0;
+#ifdef SYS_getrandom
+	if(syscall(SYS_getrandom,&seed,sizeof(seed),0)==(long)sizeof(seed)) return seed;
+#endif
+	FILE *f=fopen("/dev/urandom","rb");
+	if(f!=NULL)
+	{
+		size_t got=fread(&seed,sizeof(seed),1,f);
+		fclose(f);
+		if(got==1) return seed;
+	}
+	struct timespec ts;
+	clock_gettime(CLOCK_REALTIME,&ts);
+	seed=hash_mix((uint64_t)ts.tv_nsec^((uint64_t)ts.tv_sec<<32),(uint64_t)getpid()^(uint64_t)(size_t)&seed);
+	return seed;
+}
+
+//PRIVATE
+
+/**
+* Returns the process-wide hash seed.
+* The seed is drawn from the operating system on first use and never changes afterwards,
+* so hash values are stable within a process but differ between processes.
+*
+* @return the process-wide seed.
+*/
+uint64_t hash_seed()
+{
+	if(HASH_LIKELY(__atomic_load_n(&hash_process_seed_ready,__ATOMIC_ACQUIRE)))
+		return __atomic_load_n(&hash_process_seed,__ATOMIC_RELAXED);
+	//zero marks the seed as unset, so it is never handed out as a seed itself.
+	uint64_t seed=hash_random_seed()|1;
+	uint64_t expected=0;
+	//the first thread to get here publishes its seed; the others adopt it.
+	__atomic_compare_exchange_n(&hash_process_seed,&expected,seed,0,__ATOMIC_ACQ_REL,__ATOMIC_ACQUIRE);
+	__atomic_store_n(&hash_process_seed_ready,1,__ATOMIC_RELEASE);
+	return __atomic_load_n(&hash_process_seed,__ATOMIC_ACQUIRE);
+}
+
+/**
+* Hashes a sequence of bytes with the process-wide seed.
+*
+* @param data the bytes to hash.
+* @param size the number of bytes.
+* @return the 64-bit hash value.
+*/
+uint64_t hash_bytes(const void *data, size_t size)
+{
+	return hash_bytes_seeded(data,size,hash_seed());
+}
+
+/**
+* Hashes a sequence of bytes with an explicit seed.
+* Long inputs are consumed in 48-byte blocks with three independent lanes.
+*
+* @param data the bytes to hash.
+* @param size the number of bytes.
+* @param seed the seed.
+* @return the 64-bit hash value.
+*/
+uint64_t hash_bytes_seeded(const void *data, size_t size, uint64_t seed)
+{
+	const unsigned char *p=(const unsigned char *)data;
+	size_t i=size;
+	seed=hash_premix(seed);
+	if(HASH_LIKELY(size<=16)) return hash_short(p,size,seed);
+	if(HASH_UNLIKELY(i>=HASH_BLOCK_SIZE))
+	{
+		uint64_t see1=seed, see2=seed;
+		do
+		{
+			seed=hash_block(p,seed,&see1,&see2);
+			p+=HASH_BLOCK_SIZE;
+			i-=HASH_BLOCK_SIZE;
+		}
+		while(HASH_LIKELY(i>=HASH_BLOCK_SIZE));
+		seed^=see1^see2;
+	}
+	return hash_finish(p,i,p+i-16,size,seed);
+}
+
+/**
+* Hashes a single 64-bit value with the process-wide seed.
+* Equivalent to hashing its 8 bytes with hash_bytes().
+*
+* @param value the value to hash.
+* @return the 64-bit hash value.
+*/
+uint64_t hash_uint64(uint64_t value)
+{
+	return hash_bytes(&value,sizeof(value));
+}
+
+/**
+* Creates a new streaming hash state with the process-wide seed.
+* Feeding the same bytes through hash_update() in any number of pieces yields
+* the same value as hash_bytes() on the concatenation.
+*
+* @return A pointer to the new hash state.
+*/
+hash_state hash_state_new()
+{
+	return hash_state_new_seeded(hash_seed());
+}
+
+/**
+* Creates a new streaming hash state with an explicit seed.
+*
+* @param seed the seed.
+* @return A pointer to the new hash state.
+*/
+hash_state hash_state_new_seeded(uint64_t seed)
+{
+	hash_state state=(hash_state)object_new(sizeof(_hash_state));
+	state->seed=hash_premix(seed);
+	state->see1=state->seed;
+	state->see2=state->seed;
+	state->length=0;
+	state->pending_size=0;
+	return state;
+}
+
+/**
+* Feeds more bytes into a streaming hash state.
+* Complete 48-byte blocks are consumed immediately; only the remainder is kept.
+*
+* @param state the hash state.
+* @param data the bytes to add.
+* @param size the number of bytes.
+*/
+void hash_update(hash_state state, const void *data, size_t size)
+{
+	const unsigned char *p=(const unsigned char *)data;
+	state->length+=size;
+	while(size>0)
+	{
+		if(state->pending_size==0 && size>HASH_BLOCK_SIZE)
+		{
+			//fast path: consume whole blocks straight from the input
+			state->seed=hash_block(p,state->seed,&state->see1,&state->see2);
+			memcpy(state->last,p+HASH_BLOCK_SIZE-16,16);
+			p+=HASH_BLOCK_SIZE;
+			size-=HASH_BLOCK_SIZE;
+			continue;
+		}
+		size_t take=HASH_BLOCK_SIZE-state->pending_size;
+		if(take>size) take=size;
+		memcpy(state->pending+state->pending_size,p,take);
+		state->pending_size+=take;
+		p+=take;
+		size-=take;
+		if(state->pending_size==HASH_BLOCK_SIZE)
+		{
+			state->seed=hash_block(state->pending,state->seed,&state->see1,&state->see2);
+			memcpy(state->last,state->pending+HASH_BLOCK_SIZE-16,16);
+			state->pending_size=0;
+		}
+	}
+}
+
+/**
+* Computes the hash value of all bytes fed into a streaming hash state so far.
+* The state itself is left untouched, so more bytes can still be added afterwards.
+*
+* @param state the hash state.
+* @return the 64-bit hash value.
+*/
+uint64_t hash_final(hash_state state)
+{
+	unsigned char tail[16];
+	size_t n=state->pending_size;
+	uint64_t seed=state->seed;
+	if(state->length<=16) return hash_short(state->pending,state->length,seed);
+	if(state->length>=HASH_BLOCK_SIZE) seed^=state->see1^state->see2;
+	if(n>=16)
+	{
+		memcpy(tail,state->pending+n-16,16);
+	}
+	else
+	{
+		//the last 16 bytes straddle the previous block and the pending bytes
+		memcpy(tail,state->last+n,16-n);
+		memcpy(tail+16-n,state->pending,n);
+	}
+	return hash_finish(state->pending,n,tail,state->length,seed);
+}
@@ -0,0 +1,66 @@
+/**
+ *
+ * libscriptify
+ *
+ * @author  Erik Poupaert <erik@sankuru.biz>
+ *
+ * @section LICENSE
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU LGPL as
+ * published by the Free Software Foundation; either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * LGPL for more details at: http://www.gnu.org/licenses/lgpl.html
+ *
+ * @section DESCRIPTION
+ *
+ * Seeded 64-bit hashing of byte sequences (wyhash construction), in one shot or streaming.
+ * The default seed is drawn from the operating system once per process, so that hash values
+ * cannot be predicted by whoever supplies the keys.
+ *
+ */
+#ifndef _HASH_H
+#define _HASH_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+	extern "C" {
+#endif
+
+#define HASH_BLOCK_SIZE 48
+
+typedef struct
+{
+	uint64_t seed;
+	uint64_t see1;
+	uint64_t see2;
+	size_t length;
+	size_t pending_size;
+	unsigned char pending[HASH_BLOCK_SIZE];
+	unsigned char last[16];
+} _hash_state;
+
+typedef _hash_state* hash_state;
+
+uint64_t hash_seed();
+uint64_t hash_bytes(const void *data, size_t size);
+uint64_t hash_bytes_seeded(const void *data, size_t size, uint64_t seed);
+uint64_t hash_uint64(uint64_t value);
+
+/* streaming */
+hash_state hash_state_new();
+hash_state hash_state_new_seeded(uint64_t seed);
+void hash_update(hash_state state, const void *data, size_t size);
+uint64_t hash_final(hash_state state);
+
+#ifdef __cplusplus
+	}
+#endif
+
+#endif // _HASH_H
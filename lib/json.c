@@ -0,0 +1,788 @@
+/**
+ *
+ * libscriptify
+ *
+ * @author  Erik Poupaert <erik@sankuru.biz>
+ *
+ * @section LICENSE
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU LGPL as
+ * published by the Free Software Foundation; either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * LGPL for more details at: http://www.gnu.org/licenses/lgpl.html
+ *
+ * @section DESCRIPTION
+ *
+ * Parsing of JSON text into any values: objects become maps, arrays become arrays of anys.
+ * Also parses NDJSON, one value per line, as a stream, and writes any values as JSON text.
+ *
+ */
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+#include "object.h"
+#include "number.h"
+#include "buffer.h"
+#include "buffer_chain.h"
+#include "escape.h"
+#include "shape.h"
+#include "json.h"
+
+//PRIVATE
+
+/* zero bytes after the copy of the input, so that whole blocks can be read past its end */
+#define JSON_PADDING 64
+/* initial number of items on the stack of array items */
+#define JSON_STACK_CAPACITY 64
+
+typedef struct
+{
+	char *data; //copy of the input, followed by JSON_PADDING zero bytes
+	size_t size;
+	uint32_t *positions; //structural index: the offsets of all tokens, followed by 'size'
+	size_t count;
+	size_t next; //the next token to parse
+	manyany stack; //items of the arrays being parsed
+	size_t stack_size;
+	size_t stack_capacity;
+} _json_parser;
+
+typedef _json_parser* json_parser;
+
+/* bitmasks of the bytes of a 64-byte block that have some property: bit i is byte i */
+typedef struct
+{
+	uint64_t quote;
+	uint64_t backslash;
+	uint64_t op; //one of {}[]:,
+	uint64_t space;
+	uint64_t control;
+} json_block;
+
+#ifdef __SSE2__
+
+static void json_classify(const char *data, json_block *block)
+{
+	int i;
+	memset(block,0,sizeof(*block));
+	for(i=0; i<4; i++)
+	{
+		__m128i v=_mm_loadu_si128((const __m128i *)(data+16*i));
+		//'[' and ']' become '{' and '}' when 0x20 is set
+		__m128i folded=_mm_or_si128(v,_mm_set1_epi8(0x20));
+		__m128i op=_mm_or_si128(
+			_mm_or_si128(_mm_cmpeq_epi8(folded,_mm_set1_epi8('{')),_mm_cmpeq_epi8(folded,_mm_set1_epi8('}'))),
+			_mm_or_si128(_mm_cmpeq_epi8(v,_mm_set1_epi8(':')),_mm_cmpeq_epi8(v,_mm_set1_epi8(','))));
+		__m128i space=_mm_or_si128(
+			_mm_or_si128(_mm_cmpeq_epi8(v,_mm_set1_epi8(' ')),_mm_cmpeq_epi8(v,_mm_set1_epi8('\t'))),
+			_mm_or_si128(_mm_cmpeq_epi8(v,_mm_set1_epi8('\n')),_mm_cmpeq_epi8(v,_mm_set1_epi8('\r'))));
+		__m128i control=_mm_cmpeq_epi8(_mm_min_epu8(v,_mm_set1_epi8(0x1f)),v);
+		int shift=16*i;
+		block->quote|=(uint64_t)(unsigned)_mm_movemask_epi8(_mm_cmpeq_epi8(v,_mm_set1_epi8('"')))<<shift;
+		block->backslash|=(uint64_t)(unsigned)_mm_movemask_epi8(_mm_cmpeq_epi8(v,_mm_set1_epi8('\\')))<<shift;
+		block->op|=(uint64_t)(unsigned)_mm_movemask_epi8(op)<<shift;
+		block->space|=(uint64_t)(unsigned)_mm_movemask_epi8(space)<<shift;
+		block->control|=(uint64_t)(unsigned)_mm_movemask_epi8(control)<<shift;
+	}
+}
+
+/**
+* Returns the first quote or backslash at or after 's', 16 bytes at a time.
+*/
+static char *json_scan_string(char *s)
+{
+	for(;;)
+	{
+		__m128i v=_mm_loadu_si128((const __m128i *)s);
+		unsigned mask=(unsigned)_mm_movemask_epi8(_mm_or_si128(
+			_mm_cmpeq_epi8(v,_mm_set1_epi8('"')),_mm_cmpeq_epi8(v,_mm_set1_epi8('\\'))));
+		if(mask!=0) return s+__builtin_ctz(mask);
+		s+=16;
+	}
+}
+
+#else
+
+static void json_classify(const char *data, json_block *block)
+{
+	int i;
+	memset(block,0,sizeof(*block));
+	for(i=0; i<64; i++)
+	{
+		unsigned char c=(unsigned char)data[i];
+		uint64_t bit=1ULL<<i;
+		switch(c)
+		{
+			case '"': block->quote|=bit; break;
+			case '\\': block->backslash|=bit; break;
+			case '{': case '}': case '[': case ']': case ':': case ',': block->op|=bit; break;
+			case ' ': block->space|=bit; break;
+			case '\t': case '\n': case '\r': block->space|=bit; block->control|=bit; break;
+			default: if(c<0x20) block->control|=bit;
+		}
+	}
+}
+
+static char *json_scan_string(char *s)
+{
+	while(*s!='"' && *s!='\\') s++;
+	return s;
+}
+
+#endif
+
+/**
+* Finds the characters escaped by a backslash in a block. A backslash escaped itself escapes nothing.
+*
+* @param carry whether the first byte of the block is escaped; receives the same for the next block.
+*/
+static uint64_t json_escaped(uint64_t backslash, uint64_t *carry)
+{
+	uint64_t escaped=*carry;
+	*carry=0;
+	backslash&=~escaped;
+	while(backslash!=0)
+	{
+		int i=__builtin_ctzll(backslash);
+		backslash&=backslash-1;
+		if(i==63)
+		{
+			*carry=1;
+			break;
+		}
+		escaped|=1ULL<<(i+1);
+		backslash&=~(1ULL<<(i+1));
+	}
+	return escaped;
+}
+
+/**
+* Sets every bit that has an odd number of set bits at or below it:
+* applied to the quotes of a block, it marks the bytes inside strings.
+*/
+static uint64_t json_prefix_xor(uint64_t x)
+{
+	x^=x<<1;
+	x^=x<<2;
+	x^=x<<4;
+	x^=x<<8;
+	x^=x<<16;
+	x^=x<<32;
+	return x;
+}
+
+/**
+* Stage 1: finds the offsets of all tokens, 64 bytes at a time, without branching per byte.
+* The tokens are the structural characters {}[]:, outside strings, the opening quotes of strings,
+* and the first bytes of all other values. Also fails on unterminated strings,
+* and on control characters inside strings.
+*/
+static bool json_index(json_parser p)
+{
+	uint64_t escape_carry=0, in_string_carry=0, scalar_carry=0;
+	size_t base;
+	uint32_t *out;
+	p->positions=(uint32_t *)malloc((p->size+1)*sizeof(uint32_t));
+	if(p->positions==NULL) return false;
+	out=p->positions;
+	for(base=0; base<p->size; base+=64)
+	{
+		json_block block;
+		uint64_t valid=p->size-base>=64?~0ULL:(1ULL<<(p->size-base))-1;
+		uint64_t escaped, quotes, in_string, scalar, structural;
+		json_classify(p->data+base,&block);
+		escaped=json_escaped(block.backslash&valid,&escape_carry);
+		quotes=block.quote&~escaped&valid;
+		in_string=json_prefix_xor(quotes)^in_string_carry;
+		in_string_carry=(uint64_t)((int64_t)in_string>>63);
+		if((block.control&in_string&valid)!=0) return false;
+		scalar=~(block.op|block.space|quotes)&~in_string&valid;
+		structural=(block.op&~in_string)|(quotes&in_string)|(scalar&~((scalar<<1)|scalar_carry));
+		scalar_carry=scalar>>63;
+		structural&=valid;
+		while(structural!=0)
+		{
+			*out++=(uint32_t)(base+(size_t)__builtin_ctzll(structural));
+			structural&=structural-1;
+		}
+	}
+	if(in_string_carry!=0) return false;
+	p->count=(size_t)(out-p->positions);
+	//reading past the last token gives the zero byte after the input
+	*out=(uint32_t)p->size;
+	return true;
+}
+
+static uint32_t json_take(json_parser p)
+{
+	uint32_t position=p->positions[p->next];
+	if(p->next<p->count) p->next++;
+	return position;
+}
+
+static char json_peek(json_parser p)
+{
+	return p->data[p->positions[p->next]];
+}
+
+static bool json_is_delimiter(char c)
+{
+	switch(c)
+	{
+		case 0: case ' ': case '\t': case '\n': case '\r':
+		case ',': case ':': case ']': case '}': case '[': case '{':
+			return true;
+		default:
+			return false;
+	}
+}
+
+static bool json_hex4(const char *s, unsigned *value)
+{
+	unsigned v=0;
+	int i;
+	for(i=0; i<4; i++)
+	{
+		char c=s[i];
+		v<<=4;
+		if(c>='0' && c<='9') v|=(unsigned)(c-'0');
+		else if((c|0x20)>='a' && (c|0x20)<='f') v|=(unsigned)((c|0x20)-'a'+10);
+		else return false;
+	}
+	*value=v;
+	return true;
+}
+
+/**
+* Decodes a \u escape, with a second one for a surrogate pair, into utf-8 at 'dest'.
+*
+* @return the number of bytes of the escape; or 0, if it is not valid.
+*/
+static size_t json_unicode(const char *s, char **dest)
+{
+	unsigned code, low;
+	size_t size=6;
+	char *d=*dest;
+	if(!json_hex4(s+2,&code)) return 0;
+	if(code>=0xdc00 && code<=0xdfff) return 0;
+	if(code>=0xd800 && code<=0xdbff)
+	{
+		if(s[6]!='\\' || s[7]!='u' || !json_hex4(s+8,&low) || low<0xdc00 || low>0xdfff) return 0;
+		code=0x10000+((code-0xd800)<<10)+(low-0xdc00);
+		size=12;
+	}
+	if(code<0x80) *d++=(char)code;
+	else if(code<0x800)
+	{
+		*d++=(char)(0xc0|(code>>6));
+		*d++=(char)(0x80|(code&0x3f));
+	}
+	else if(code<0x10000)
+	{
+		*d++=(char)(0xe0|(code>>12));
+		*d++=(char)(0x80|((code>>6)&0x3f));
+		*d++=(char)(0x80|(code&0x3f));
+	}
+	else
+	{
+		*d++=(char)(0xf0|(code>>18));
+		*d++=(char)(0x80|((code>>12)&0x3f));
+		*d++=(char)(0x80|((code>>6)&0x3f));
+		*d++=(char)(0x80|(code&0x3f));
+	}
+	*dest=d;
+	return size;
+}
+
+/**
+* Parses the string whose opening quote is at 'position'. The string is terminated in place,
+* in the copy of the input, and escapes are decoded in place, since they only get shorter:
+* the any refers to the copy, and nothing is copied for strings without escapes.
+*/
+static any json_string(json_parser p, uint32_t position)
+{
+	char *start=p->data+position+1;
+	char *src=json_scan_string(start);
+	char *dest;
+	if(*src=='"')
+	{
+		*src=0;
+		return any_new_string(start);
+	}
+	dest=src;
+	while(*src!='"')
+	{
+		char *next;
+		size_t size;
+		if(*src=='\\')
+		{
+			switch(src[1])
+			{
+				case '"': *dest++='"'; break;
+				case '\\': *dest++='\\'; break;
+				case '/': *dest++='/'; break;
+				case 'b': *dest++='\b'; break;
+				case 'f': *dest++='\f'; break;
+				case 'n': *dest++='\n'; break;
+				case 'r': *dest++='\r'; break;
+				case 't': *dest++='\t'; break;
+				case 'u':
+					size=json_unicode(src,&dest);
+					if(size==0) return NULL;
+					src+=size;
+					continue;
+				default: return NULL;
+			}
+			src+=2;
+			continue;
+		}
+		next=json_scan_string(src);
+		memmove(dest,src,(size_t)(next-src));
+		dest+=next-src;
+		src=next;
+	}
+	*dest=0;
+	return any_new_string(start);
+}
+
+/**
+* Parses a number, after checking it against the JSON grammar, which is stricter than any_parse_number().
+*/
+static any json_number(const char *s)
+{
+	const char *p=s;
+	if(*p=='-') p++;
+	if(*p=='0') p++;
+	else if(*p>='1' && *p<='9') while(*p>='0' && *p<='9') p++;
+	else return NULL;
+	if(*p=='.')
+	{
+		p++;
+		if(*p<'0' || *p>'9') return NULL;
+		while(*p>='0' && *p<='9') p++;
+	}
+	if(*p=='e' || *p=='E')
+	{
+		p++;
+		if(*p=='+' || *p=='-') p++;
+		if(*p<'0' || *p>'9') return NULL;
+		while(*p>='0' && *p<='9') p++;
+	}
+	if(!json_is_delimiter(*p)) return NULL;
+	return any_parse_number(s,(size_t)(p-s));
+}
+
+static bool json_literal(const char *s, const char *literal, size_t size)
+{
+	return memcmp(s,literal,size)==0 && json_is_delimiter(s[size]);
+}
+
+static void json_push(json_parser p, any item)
+{
+	if(p->stack_size==p->stack_capacity)
+	{
+		size_t capacity=p->stack_capacity>0?2*p->stack_capacity:JSON_STACK_CAPACITY;
+		manyany stack=(manyany)object_new(capacity*sizeof(any));
+		if(p->stack_size>0) memcpy(stack,p->stack,p->stack_size*sizeof(any));
+		p->stack=stack;
+		p->stack_capacity=capacity;
+	}
+	p->stack[p->stack_size++]=item;
+}
+
+static any json_value(json_parser p, int depth);
+
+/**
+* Parses the items of an array onto the stack, and copies them into an array of the exact size.
+*/
+static any json_array(json_parser p, int depth)
+{
+	size_t base=p->stack_size, size;
+	manyany items=NULL;
+	if(depth>JSON_MAX_DEPTH) return NULL;
+	if(json_peek(p)==']')
+	{
+		json_take(p);
+		return any_new_array(NULL,0);
+	}
+	for(;;)
+	{
+		any item=json_value(p,depth);
+		char c;
+		if(item==NULL) return NULL;
+		json_push(p,item);
+		c=p->data[json_take(p)];
+		if(c==']') break;
+		if(c!=',') return NULL;
+	}
+	size=p->stack_size-base;
+	items=(manyany)object_new(size*sizeof(any));
+	memcpy(items,p->stack+base,size*sizeof(any));
+	p->stack_size=base;
+	return any_new_array(items,size);
+}
+
+static any json_object(json_parser p, int depth)
+{
+	map m=map_new();
+	if(depth>JSON_MAX_DEPTH) return NULL;
+	if(json_peek(p)=='}')
+	{
+		json_take(p);
+		return any_new_map(m);
+	}
+	for(;;)
+	{
+		uint32_t position=json_take(p);
+		any key, value;
+		char c;
+		if(p->data[position]!='"') return NULL;
+		key=json_string(p,position);
+		if(key==NULL || p->data[json_take(p)]!=':') return NULL;
+		value=json_value(p,depth);
+		if(value==NULL) return NULL;
+		map_put(m,key,value);
+		c=p->data[json_take(p)];
+		if(c=='}') break;
+		if(c!=',') return NULL;
+	}
+	return any_new_map(m);
+}
+
+/**
+* Stage 2: builds the value that starts at the next token.
+*/
+static any json_value(json_parser p, int depth)
+{
+	uint32_t position=json_take(p);
+	const char *s=p->data+position;
+	switch(*s)
+	{
+		case '{': return json_object(p,depth+1);
+		case '[': return json_array(p,depth+1);
+		case '"': return json_string(p,position);
+		case 't': return json_literal(s,"true",4)?any_new_bool(true):NULL;
+		case 'f': return json_literal(s,"false",5)?any_new_bool(false):NULL;
+		case 'n': return json_literal(s,"null",4)?any_new_null():NULL;
+		default: return json_number(s);
+	}
+}
+
+static bool json_blank(view line)
+{
+	size_t i;
+	for(i=0; i<line.size; i++)
+		if(line.data[i]!=' ' && line.data[i]!='\t' && line.data[i]!='\r') return false;
+	return true;
+}
+
+/* the writer hands its buffer to the buffer chain once it holds this many bytes */
+#define JSON_FLUSH_SIZE 65536
+
+typedef struct
+{
+	buffer out;
+	buffer_chain chain; //NULL when writing into 'out' only
+	int indent; //spaces per level; 0 for compact output
+	int depth;
+	void *path[JSON_MAX_DEPTH]; //the arrays and maps being written, to detect cycles
+} _json_writer;
+
+typedef _json_writer* json_writer;
+
+/**
+* Writes a string between quotes; see escape_append().
+*/
+static void json_write_string(json_writer w, const char *s, size_t size)
+{
+	buffer_reserve(w->out,size+2);
+	buffer_appendchar(w->out,'"');
+	escape_append(w->out,ESCAPE_JSON,view_new(s,size));
+	buffer_appendchar(w->out,'"');
+}
+
+/**
+* Writes a double with the fewest digits that read back as the same value,
+* adding ".0" to integral values, so that they read back as doubles. JSON has no NaN or infinity:
+* those are written as null.
+*/
+static void json_write_double(json_writer w, double dbl)
+{
+	char digits[NUMBER_MAX_LENGTH+2];
+	size_t size;
+	if(dbl!=dbl || dbl-dbl!=0)
+	{
+		buffer_append(w->out,"null",4);
+		return;
+	}
+	size=number_write_double(digits,dbl);
+	if(memchr(digits,'.',size)==NULL && memchr(digits,'e',size)==NULL)
+	{
+		digits[size++]='.';
+		digits[size++]='0';
+	}
+	buffer_append(w->out,digits,size);
+}
+
+static void json_newline(json_writer w)
+{
+	int spaces=w->indent*w->depth;
+	if(w->indent==0) return;
+	buffer_reserve(w->out,(size_t)spaces+1);
+	buffer_appendchar(w->out,'\n');
+	while(spaces-->0) buffer_appendchar(w->out,' ');
+}
+
+/**
+* Hands the output written so far to the buffer chain, so that the working set stays bounded.
+*/
+static void json_flush(json_writer w)
+{
+	if(w->chain==NULL || w->out->size<JSON_FLUSH_SIZE) return;
+	buffer_chain_append_buffer(w->chain,w->out);
+	buffer_reserve(w->out,JSON_FLUSH_SIZE+JSON_FLUSH_SIZE/4);
+}
+
+static bool json_write_value(json_writer w, any value);
+
+/**
+* Enters an array or a map, unless it is already being written, which would never end.
+*/
+static bool json_enter(json_writer w, void *container, char open)
+{
+	int i;
+	if(w->depth>=JSON_MAX_DEPTH) return false;
+	for(i=0; i<w->depth; i++)
+		if(w->path[i]==container) return false;
+	w->path[w->depth++]=container;
+	buffer_appendchar(w->out,open);
+	return true;
+}
+
+static void json_leave(json_writer w, bool empty, char close)
+{
+	w->depth--;
+	if(!empty) json_newline(w);
+	buffer_appendchar(w->out,close);
+}
+
+typedef struct
+{
+	json_writer writer;
+	bool first;
+	bool failed;
+} json_members;
+
+static void json_write_field(json_members *members, string name, any value)
+{
+	json_writer w=members->writer;
+	if(members->failed) return;
+	if(!members->first) buffer_appendchar(w->out,',');
+	members->first=false;
+	json_newline(w);
+	json_write_string(w,name,strlen(name));
+	buffer_appendchar(w->out,':');
+	if(w->indent>0) buffer_appendchar(w->out,' ');
+	if(!json_write_value(w,value)) members->failed=true;
+}
+
+static void json_write_member(any key, any value, void *data)
+{
+	json_write_field((json_members *)data,key->type==TYPE_STRING?key->str:any_to_string(key),value);
+}
+
+static bool json_write_value(json_writer w, any value)
+{
+	size_t i;
+	json_flush(w);
+	if(value==NULL)
+	{
+		buffer_append(w->out,"null",4);
+		return true;
+	}
+	switch(value->type)
+	{
+		case TYPE_INT: buffer_append_long(w->out,value->i); return true;
+		case TYPE_LONG: buffer_append_long(w->out,value->lng); return true;
+		case TYPE_DOUBLE: json_write_double(w,value->dbl); return true;
+		case TYPE_STRING: json_write_string(w,value->str,strlen(value->str)); return true;
+		case TYPE_BOOL:
+			if(value->bln) buffer_append(w->out,"true",4);
+			else buffer_append(w->out,"false",5);
+			return true;
+		case TYPE_ARRAY:
+			if(!json_enter(w,value->arr,'[')) return false;
+			for(i=0; i<value->arr->size; i++)
+			{
+				if(i>0) buffer_appendchar(w->out,',');
+				json_newline(w);
+				if(!json_write_value(w,value->arr->items[i])) return false;
+			}
+			json_leave(w,value->arr->size==0,']');
+			return true;
+		case TYPE_MAP:
+		{
+			json_members members={w, true, false};
+			if(!json_enter(w,value->map,'{')) return false;
+			map_foreach(value->map,json_write_member,&members);
+			if(members.failed) return false;
+			json_leave(w,members.first,'}');
+			return true;
+		}
+		case TYPE_RECORD:
+		{
+			json_members members={w, true, false};
+			if(!json_enter(w,value->rec,'{')) return false;
+			for(i=0; i<value->rec->shape->count; i++)
+				json_write_field(&members,value->rec->shape->names[i],value->rec->slots[i]);
+			if(members.failed) return false;
+			json_leave(w,members.first,'}');
+			return true;
+		}
+		default:
+			//null, and objects, whose content is unknown
+			buffer_append(w->out,"null",4);
+			return true;
+	}
+}
+
+static bool json_write_to(buffer out, buffer_chain chain, any value, int indent)
+{
+	json_writer w=(json_writer)object_new(sizeof(_json_writer));
+	bool written;
+	w->out=out;
+	w->chain=chain;
+	w->indent=indent>0?indent:0;
+	written=json_write_value(w,value);
+	if(chain!=NULL) buffer_chain_append_buffer(chain,out);
+	return written;
+}
+
+//PRIVATE
+
+/**
+* Parses a JSON text; see json_parse_view().
+*
+* @param text the JSON text.
+* @return the value; or NULL, if the text is not valid JSON.
+*/
+any json_parse(string text)
+{
+	return json_parse_view(view_from_string(text));
+}
+
+/**
+* Parses a JSON text into an any. Objects become maps with their keys in document order;
+* a key that occurs twice keeps the last value. Arrays become arrays of anys,
+* numbers the narrowest of int, long and double that holds them, and true, false and null
+* become booleans and nulls.
+*
+* The text is copied once. A first pass indexes all tokens, 64 bytes at a time with SIMD
+* instructions where available; a second pass builds the values from the index.
+* Strings are decoded in place in the copy, and refer to it: the copy lives as long as
+* any of them does.
+*
+* @param text the JSON text; at most 4 GB.
+* @return the value; or NULL, if the text is not valid JSON, or is nested deeper than JSON_MAX_DEPTH.
+*/
+any json_parse_view(view text)
+{
+	_json_parser parser;
+	any value=NULL;
+	if(text.size>=UINT32_MAX) return NULL;
+	memset(&parser,0,sizeof(parser));
+	parser.size=text.size;
+	parser.data=(char *)object_new_atomic(text.size+JSON_PADDING);
+	memcpy(parser.data,text.data,text.size);
+	memset(parser.data+text.size,0,JSON_PADDING);
+	if(json_index(&parser))
+	{
+		value=json_value(&parser,0);
+		//nothing may follow the value
+		if(value!=NULL && parser.next!=parser.count) value=NULL;
+	}
+	free(parser.positions);
+	return value;
+}
+
+/**
+* Parses NDJSON: one JSON value per line, read from a reader as a stream, so that the input
+* can be of any size. Blank lines are skipped.
+*
+* @param r the reader.
+* @param fn the function to call with the value of every line, and its line number, starting at 1.
+* @param data passed on to 'fn'.
+* @return true, if the input was read until its end or until 'fn' returned false;
+* false, if reading failed, see reader_error().
+*/
+bool json_parse_lines(reader r, json_line_fn fn, void *data)
+{
+	view line;
+	size_t number=0;
+	while(reader_next_line(r,&line))
+	{
+		number++;
+		if(json_blank(line)) continue;
+		if(!fn(json_parse_view(line),number,data)) break;
+	}
+	return reader_error(r)==0;
+}
+
+/**
+* Writes an any as JSON text at the end of a buffer. Strings are escaped as little as JSON requires,
+* with runs that need no escaping found 16 bytes at a time; doubles are written with the fewest
+* digits that read back as the same value. NaN, infinities, nulls and objects are written as null.
+* Keys of maps that are not strings are converted with any_to_string(). Records are written as objects,
+* with their properties in order; properties that are not set are written as null.
+*
+* @param b the buffer.
+* @param value the value to write.
+* @param indent 0 for compact output without any whitespace; otherwise, the number of spaces
+* to indent every level with, putting every item and member on a line of its own.
+* @return true, if the value was written; false, if an array, map or record contains itself,
+* or nesting is deeper than JSON_MAX_DEPTH. The buffer then holds part of the output.
+*/
+bool json_write(buffer b, any value, int indent)
+{
+	return json_write_to(b,NULL,value,indent);
+}
+
+/**
+* Writes an any as JSON text at the end of a buffer chain; see json_write().
+* The output is built in a buffer that is moved to the chain whenever it holds JSON_FLUSH_SIZE bytes,
+* so that large values are never held in one contiguous block, and can be written
+* to a file with buffer_chain_writev().
+*
+* @param chain the buffer chain.
+* @param value the value to write.
+* @param indent 0 for compact output; otherwise, the number of spaces to indent every level with.
+* @return true, if the value was written; false, if an array, map or record contains itself,
+* or nesting is deeper than JSON_MAX_DEPTH.
+*/
+bool json_write_chain(buffer_chain chain, any value, int indent)
+{
+	buffer b=buffer_new_capacity(JSON_FLUSH_SIZE+JSON_FLUSH_SIZE/4);
+	return json_write_to(b,chain,value,indent);
+}
+
+/**
+* Converts an any to a new string of JSON text; see json_write().
+*
+* @param value the value to convert.
+* @param indent 0 for compact output; otherwise, the number of spaces to indent every level with.
+* @return A new string; or NULL, if an array or map contains itself, or nesting is deeper than JSON_MAX_DEPTH.
+*/
+string json_tostring(any value, int indent)
+{
+	buffer b=buffer_new();
+	if(!json_write(b,value,indent)) return NULL;
+	return buffer_steal(b);
+}
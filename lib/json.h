@@ -0,0 +1,58 @@
+/**
+ *
+ * libscriptify
+ *
+ * @author  Erik Poupaert <erik@sankuru.biz>
+ *
+ * @section LICENSE
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU LGPL as
+ * published by the Free Software Foundation; either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * LGPL for more details at: http://www.gnu.org/licenses/lgpl.html
+ *
+ * @section DESCRIPTION
+ *
+ * Parsing of JSON text into any values: objects become maps, arrays become arrays of anys.
+ * Also parses NDJSON, one value per line, as a stream, and writes any values as JSON text.
+ *
+ */
+#ifndef _JSON_H
+#define _JSON_H
+
+#include <stddef.h>
+#include <stdbool.h>
+#include "any.h"
+#include "view.h"
+#include "map.h"
+#include "reader.h"
+#include "buffer.h"
+#include "buffer_chain.h"
+
+#ifdef __cplusplus
+	extern "C" {
+#endif
+
+/* maximum nesting of arrays and objects */
+#define JSON_MAX_DEPTH 1024
+
+/* called for every line of NDJSON input; 'value' is NULL if the line is not valid JSON. Return false to stop. */
+typedef bool (*json_line_fn)(any value, size_t line, void *data);
+
+any json_parse(string text);
+any json_parse_view(view text);
+bool json_parse_lines(reader r, json_line_fn fn, void *data);
+bool json_write(buffer b, any value, int indent);
+bool json_write_chain(buffer_chain chain, any value, int indent);
+string json_tostring(any value, int indent);
+
+#ifdef __cplusplus
+	}
+#endif
+
+#endif // _JSON_H
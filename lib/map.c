@@ -0,0 +1,378 @@
+/**
+ *
+ * libscriptify
+ *
+ * @author  Erik Poupaert <erik@sankuru.biz>
+ *
+ * @section LICENSE
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU LGPL as
+ * published by the Free Software Foundation; either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * LGPL for more details at: http://www.gnu.org/licenses/lgpl.html
+ *
+ * @section DESCRIPTION
+ *
+ * A hash map from any keys to any values that threads can share.
+ * Lookups take no lock; writers lock one stripe of the map. Entries are kept in insertion order.
+ *
+ */
+#include <string.h>
+#include "object.h"
+#include "map.h"
+
+//PRIVATE
+
+#define MAP_EMPTY (-1)
+#define MAP_REMOVED (-2)
+/* index slots of the first table of a stripe */
+#define MAP_INITIAL_SLOTS 8
+
+static map_stripe map_stripe_for(map m, uint64_t hash)
+{
+	if(m->stripe_bits==0) return m->stripes[0];
+	return m->stripes[hash>>(64-m->stripe_bits)];
+}
+
+static map_table map_table_new(size_t slots)
+{
+	map_table table=(map_table)object_new(sizeof(_map_table));
+	table->mask=slots-1;
+	table->capacity=slots*2/3;
+	table->index=(int32_t *)object_new_atomic(slots*sizeof(int32_t));
+	memset(table->index,0xff,slots*sizeof(int32_t)); //all MAP_EMPTY
+	table->entries=(map_entry)object_new(table->capacity*sizeof(_map_entry));
+	return table;
+}
+
+/**
+* Finds the index slot of a key in a table; this is safe while a writer changes the table.
+*
+* @return the slot, with the position of the entry in '*position'; or -1, if the key is not in the table.
+*/
+static long map_table_find(map_table table, uint64_t hash, any key, int32_t *position)
+{
+	size_t i=(size_t)hash&table->mask;
+	size_t probes;
+	for(probes=0; probes<=table->mask; probes++, i=(i+1)&table->mask)
+	{
+		int32_t found=__atomic_load_n(&table->index[i],__ATOMIC_ACQUIRE);
+		map_entry entry;
+		any candidate;
+		if(found==MAP_EMPTY) return -1;
+		if(found==MAP_REMOVED) continue;
+		entry=&table->entries[found];
+		if(entry->hash!=hash) continue;
+		candidate=__atomic_load_n(&entry->key,__ATOMIC_ACQUIRE);
+		if(candidate!=NULL && any_equal(candidate,key))
+		{
+			*position=found;
+			return (long)i;
+		}
+	}
+	return -1;
+}
+
+/**
+* Returns the value of a key, without taking any lock.
+* Within a table, entries are filled before they are published in the index, and are never reused;
+* a table replaced by a larger one is left as it is, and lives on until no reader uses it any more.
+* So a reader always sees a consistent state, even while a writer changes the stripe.
+*/
+static any map_lookup(map m, uint64_t hash, any key)
+{
+	map_stripe stripe=map_stripe_for(m,hash);
+	map_table table=__atomic_load_n(&stripe->table,__ATOMIC_ACQUIRE);
+	int32_t position;
+	if(table==NULL || map_table_find(table,hash,key,&position)<0) return NULL;
+	return __atomic_load_n(&table->entries[position].value,__ATOMIC_ACQUIRE);
+}
+
+/**
+* Puts the live entries of a stripe into a new table with room for as many again,
+* and publishes it. The lock of the stripe is held.
+*/
+static map_table map_stripe_grow(map_stripe stripe)
+{
+	map_table old=stripe->table;
+	size_t count=old!=NULL?old->count:0;
+	size_t slots=MAP_INITIAL_SLOTS, i;
+	map_table table;
+	while(slots*2/3<2*count+1) slots*=2;
+	table=map_table_new(slots);
+	for(i=0; old!=NULL && i<old->used; i++)
+	{
+		map_entry entry=&old->entries[i];
+		size_t slot;
+		if(entry->key==NULL) continue;
+		table->entries[table->used]=*entry;
+		for(slot=(size_t)entry->hash&table->mask; table->index[slot]!=MAP_EMPTY; slot=(slot+1)&table->mask);
+		table->index[slot]=(int32_t)table->used;
+		table->used++;
+	}
+	table->count=table->used;
+	__atomic_store_n(&stripe->table,table,__ATOMIC_RELEASE);
+	return table;
+}
+
+/**
+* Stores a value for a key in its stripe.
+*
+* @param replace if false, an existing value is kept.
+* @return the previous value of the key; or NULL, if it had none.
+*/
+static any map_store(map m, any key, any value, bool replace)
+{
+	uint64_t hash=any_hash(key);
+	map_stripe stripe=map_stripe_for(m,hash);
+	map_table table;
+	map_entry entry;
+	int32_t position;
+	size_t i;
+	any previous=NULL;
+	pthread_mutex_lock(&stripe->lock);
+	table=stripe->table;
+	if(table!=NULL && map_table_find(table,hash,key,&position)>=0)
+	{
+		entry=&table->entries[position];
+		previous=entry->value;
+		if(replace) __atomic_store_n(&entry->value,value,__ATOMIC_RELEASE);
+		pthread_mutex_unlock(&stripe->lock);
+		return previous;
+	}
+	if(table==NULL || table->used==table->capacity) table=map_stripe_grow(stripe);
+	entry=&table->entries[table->used];
+	entry->hash=hash;
+	entry->value=value;
+	__atomic_store_n(&entry->key,key,__ATOMIC_RELEASE);
+	for(i=(size_t)hash&table->mask; table->index[i]!=MAP_EMPTY; i=(i+1)&table->mask);
+	__atomic_store_n(&table->used,table->used+1,__ATOMIC_RELEASE);
+	__atomic_store_n(&table->count,table->count+1,__ATOMIC_RELAXED);
+	__atomic_store_n(&table->index[i],(int32_t)(table->used-1),__ATOMIC_RELEASE);
+	pthread_mutex_unlock(&stripe->lock);
+	return NULL;
+}
+
+static map map_alloc(int stripe_bits)
+{
+	map m=(map)object_new(sizeof(_map));
+	size_t stripes=(size_t)1<<stripe_bits, i;
+	m->stripe_bits=stripe_bits;
+	m->stripes=(map_stripe *)object_new(stripes*sizeof(map_stripe));
+	for(i=0; i<stripes; i++)
+	{
+		m->stripes[i]=(map_stripe)object_new(sizeof(_map_stripe));
+		pthread_mutex_init(&m->stripes[i]->lock,NULL);
+	}
+	return m;
+}
+
+static any map_string_key(_any *key, string str)
+{
+	key->type=TYPE_STRING;
+	key->str=str;
+	return key;
+}
+
+//PRIVATE
+
+/**
+* Creates a new empty map with a single stripe: lookups take no lock, and writers take one lock
+* for the whole map. Iterating over it visits the entries in insertion order.
+*
+* @return A pointer to the new map.
+*/
+map map_new()
+{
+	return map_alloc(0);
+}
+
+/**
+* Creates a new empty map for sharing between many threads that write to it:
+* the keys are spread over 'stripes' stripes by hash, and writers only lock the stripe of their key.
+* Lookups take no lock at all. Iterating over the map visits the entries of one stripe
+* after another, each in insertion order.
+*
+* @param stripes the number of stripes, rounded up to a power of two; 0 for MAP_STRIPES.
+* @return A pointer to the new map.
+*/
+map map_new_striped(size_t stripes)
+{
+	int bits=0;
+	if(stripes==0) stripes=MAP_STRIPES;
+	while(((size_t)1<<bits)<stripes && bits<16) bits++;
+	return map_alloc(bits);
+}
+
+/**
+* Returns the number of entries in a map. While other threads write to it, it is only an estimate.
+*
+* @param m the map.
+* @return the number of entries.
+*/
+size_t map_size(map m)
+{
+	size_t size=0, i, stripes=(size_t)1<<m->stripe_bits;
+	for(i=0; i<stripes; i++)
+	{
+		map_table table=__atomic_load_n(&m->stripes[i]->table,__ATOMIC_ACQUIRE);
+		if(table!=NULL) size+=__atomic_load_n(&table->count,__ATOMIC_RELAXED);
+	}
+	return size;
+}
+
+/**
+* Returns the value of a key in a map. Takes no lock, and writes no shared memory,
+* so that lookups from many threads do not slow each other down.
+* Keys are compared with any_equal().
+*
+* @param m the map.
+* @param key the key.
+* @return the value; or NULL, if the key is not in the map.
+*/
+any map_get(map m, any key)
+{
+	return map_lookup(m,any_hash(key),key);
+}
+
+/**
+* Checks if a key is in a map.
+*
+* @param m the map.
+* @param key the key.
+* @return true, if the key is in the map; false, if not.
+*/
+bool map_has(map m, any key)
+{
+	return map_get(m,key)!=NULL;
+}
+
+/**
+* Sets the value of a key in a map. A new key goes after all other keys of its stripe;
+* an existing key keeps its place. Keys must not change while they are in the map.
+*
+* @param m the map.
+* @param key the key.
+* @param value the value; not NULL.
+* @return the previous value of the key; or NULL, if it had none.
+*/
+any map_put(map m, any key, any value)
+{
+	return map_store(m,key,value,true);
+}
+
+/**
+* Sets the value of a key in a map, unless it already has one. Useful for shared caches:
+* when several threads compute a value for the same key, all of them end up with the first one.
+*
+* @param m the map.
+* @param key the key.
+* @param value the value; not NULL.
+* @return the value the key already had; or NULL, if 'value' was stored.
+*/
+any map_put_if_absent(map m, any key, any value)
+{
+	return map_store(m,key,value,false);
+}
+
+/**
+* Removes a key from a map.
+*
+* @param m the map.
+* @param key the key.
+* @return the value of the key; or NULL, if it was not in the map.
+*/
+any map_remove(map m, any key)
+{
+	uint64_t hash=any_hash(key);
+	map_stripe stripe=map_stripe_for(m,hash);
+	map_table table;
+	map_entry entry;
+	long slot=-1;
+	int32_t position;
+	any previous=NULL;
+	pthread_mutex_lock(&stripe->lock);
+	table=stripe->table;
+	if(table!=NULL) slot=map_table_find(table,hash,key,&position);
+	if(slot>=0)
+	{
+		entry=&table->entries[position];
+		previous=entry->value;
+		__atomic_store_n(&table->index[slot],MAP_REMOVED,__ATOMIC_RELEASE);
+		__atomic_store_n(&entry->key,NULL,__ATOMIC_RELEASE);
+		__atomic_store_n(&entry->value,NULL,__ATOMIC_RELEASE);
+		__atomic_store_n(&table->count,table->count-1,__ATOMIC_RELAXED);
+	}
+	pthread_mutex_unlock(&stripe->lock);
+	return previous;
+}
+
+/**
+* Calls a function for every entry of a map; see map_new() and map_new_striped() for the order.
+* Takes no lock: entries put or removed by other threads meanwhile may or may not be visited.
+*
+* @param m the map.
+* @param fn the function to call with every key and value.
+* @param data passed on to 'fn'.
+*/
+void map_foreach(map m, map_fn fn, void *data)
+{
+	size_t i, j, used, stripes=(size_t)1<<m->stripe_bits;
+	for(i=0; i<stripes; i++)
+	{
+		map_table table=__atomic_load_n(&m->stripes[i]->table,__ATOMIC_ACQUIRE);
+		if(table==NULL) continue;
+		used=__atomic_load_n(&table->used,__ATOMIC_ACQUIRE);
+		for(j=0; j<used; j++)
+		{
+			map_entry entry=&table->entries[j];
+			any key=__atomic_load_n(&entry->key,__ATOMIC_ACQUIRE);
+			any value=__atomic_load_n(&entry->value,__ATOMIC_ACQUIRE);
+			if(key!=NULL && value!=NULL) fn(key,value,data);
+		}
+	}
+}
+
+/**
+* Returns the value of a string key in a map, without allocating a key.
+*
+* @param m the map.
+* @param key the key.
+* @return the value; or NULL, if the key is not in the map.
+*/
+any map_get_string(map m, string key)
+{
+	_any lookup;
+	return map_get(m,map_string_key(&lookup,key));
+}
+
+/**
+* Sets the value of a string key in a map; the key is copied.
+*
+* @param m the map.
+* @param key the key.
+* @param value the value; not NULL.
+* @return the previous value of the key; or NULL, if it had none.
+*/
+any map_put_string(map m, string key, any value)
+{
+	return map_put(m,any_new_string_copy(key),value);
+}
+
+/**
+* Removes a string key from a map.
+*
+* @param m the map.
+* @param key the key.
+* @return the value of the key; or NULL, if it was not in the map.
+*/
+any map_remove_string(map m, string key)
+{
+	_any lookup;
+	return map_remove(m,map_string_key(&lookup,key));
+}
@@ -0,0 +1,101 @@
+/**
+ *
+ * libscriptify
+ *
+ * @author  Erik Poupaert <erik@sankuru.biz>
+ *
+ * @section LICENSE
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU LGPL as
+ * published by the Free Software Foundation; either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * LGPL for more details at: http://www.gnu.org/licenses/lgpl.html
+ *
+ * @section DESCRIPTION
+ *
+ * A hash map from any keys to any values that threads can share.
+ * Lookups take no lock; writers lock one stripe of the map. Entries are kept in insertion order.
+ *
+ */
+#ifndef _MAP_H
+#define _MAP_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <pthread.h>
+#include "object.h"
+#include "any.h"
+
+#ifdef __cplusplus
+	extern "C" {
+#endif
+
+/* number of stripes of map_new_striped(0) */
+#define MAP_STRIPES 64
+
+typedef void (*map_fn)(any key, any value, void *data);
+
+typedef struct
+{
+	uint64_t hash;
+	any key; //NULL once the entry is removed
+	any value;
+} _map_entry;
+
+typedef _map_entry* map_entry;
+
+/* a compact hash table: the index points into the entries, which are kept in insertion order */
+typedef struct
+{
+	size_t mask; //the number of index slots minus one
+	size_t capacity; //the number of entries, two thirds of the number of index slots
+	size_t used; //entries filled, including removed ones; entries are never reused
+	size_t count; //entries not removed
+	int32_t *index; //MAP_EMPTY, MAP_REMOVED or the position of an entry
+	map_entry entries;
+} _map_table;
+
+typedef _map_table* map_table;
+
+typedef struct
+{
+	pthread_mutex_t lock; //taken by writers only
+	map_table table; //NULL while the stripe is empty
+} _map_stripe;
+
+typedef _map_stripe* map_stripe;
+
+typedef struct _map
+{
+	int stripe_bits; //the stripe of a key is picked by the top bits of its hash
+	map_stripe *stripes;
+} _map;
+
+typedef _map* map;
+
+map map_new();
+map map_new_striped(size_t stripes);
+size_t map_size(map m);
+any map_get(map m, any key);
+bool map_has(map m, any key);
+any map_put(map m, any key, any value);
+any map_put_if_absent(map m, any key, any value);
+any map_remove(map m, any key);
+void map_foreach(map m, map_fn fn, void *data);
+
+/* string keys */
+any map_get_string(map m, string key);
+any map_put_string(map m, string key, any value);
+any map_remove_string(map m, string key);
+
+#ifdef __cplusplus
+	}
+#endif
+
+#endif // _MAP_H
@@ -0,0 +1,217 @@
+/**
+ *
+ * libscriptify
+ *
+ * @author  Erik Poupaert <erik@sankuru.biz>
+ *
+ * @section LICENSE
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU LGPL as
+ * published by the Free Software Foundation; either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * LGPL for more details at: http://www.gnu.org/licenses/lgpl.html
+ *
+ * @section DESCRIPTION
+ *
+ * Files mapped into memory read-only, and used as strings without copying them.
+ * The pages of a file are read from disk only when they are first touched.
+ *
+ */
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "object.h"
+#include "buffer.h"
+#include "mapped_file.h"
+
+//PRIVATE
+
+#define MAPPED_FILE_READ_CHUNK 65536
+
+static int mapped_file_advice(MAPPED_FILE_ACCESS access)
+{
+	switch(access)
+	{
+		case MAPPED_FILE_SEQUENTIAL: return MADV_SEQUENTIAL;
+		case MAPPED_FILE_RANDOM: return MADV_RANDOM;
+		case MAPPED_FILE_WILLNEED: return MADV_WILLNEED;
+		default: return MADV_NORMAL;
+	}
+}
+
+/**
+* Maps 'size' bytes of a file, followed by at least one zero byte.
+* When the size is not a multiple of the page size, the kernel fills the rest of the last page with zeros.
+* Otherwise, an anonymous zero page is reserved behind the file, and the file is mapped in front of it.
+*/
+static bool mapped_file_mmap(mapped_file file, int fd, size_t size)
+{
+	size_t page=(size_t)sysconf(_SC_PAGESIZE);
+	void *mapping;
+	if(size%page!=0)
+	{
+		mapping=mmap(NULL,size,PROT_READ,MAP_PRIVATE,fd,0);
+		if(mapping==MAP_FAILED) return false;
+		file->mapping_size=size;
+	}
+	else
+	{
+		mapping=mmap(NULL,size+page,PROT_READ,MAP_PRIVATE|MAP_ANONYMOUS,-1,0);
+		if(mapping==MAP_FAILED) return false;
+		if(mmap(mapping,size,PROT_READ,MAP_PRIVATE|MAP_FIXED,fd,0)==MAP_FAILED)
+		{
+			munmap(mapping,size+page);
+			return false;
+		}
+		file->mapping_size=size+page;
+	}
+	file->mapping=mapping;
+	file->data=(string)mapping;
+	file->size=size;
+	return true;
+}
+
+/**
+* Reads a file that cannot be mapped, such as a pipe or a file in /proc, into a string.
+*/
+static bool mapped_file_read(mapped_file file, int fd)
+{
+	buffer abuffer=buffer_new_capacity(MAPPED_FILE_READ_CHUNK);
+	ssize_t n;
+	while(1)
+	{
+		buffer_reserve(abuffer,MAPPED_FILE_READ_CHUNK);
+		n=read(fd,abuffer->data+abuffer->size,abuffer->capacity-abuffer->size);
+		if(n==0) break;
+		if(n<0)
+		{
+			if(errno==EINTR) continue;
+			return false;
+		}
+		abuffer->size+=(size_t)n;
+	}
+	file->size=abuffer->size;
+	file->data=buffer_steal(abuffer);
+	return true;
+}
+
+//PRIVATE
+
+/**
+* Maps a file into memory, read-only, without copying it.
+* Pages are read from disk only when they are first touched, so mapping costs
+* the same for a small and a multi-gigabyte file. The content is null-terminated,
+* so all string functions that do not modify their argument work on it directly.
+* Files that cannot be mapped, such as pipes, are read into memory instead.
+*
+* The content stays valid until mapped_file_close(), even when only its string or
+* views are still referenced: the collector does not see pointers into the mapping, so it
+* is never unmapped behind their back. A file that is never closed stays mapped until the
+* process exits; its pages belong to the file, so that only costs address space.
+*
+* @param path the file to map.
+* @param access the expected access pattern, passed on to the kernel with madvise().
+* @return A pointer to the mapped file; or NULL if the file could not be opened or read, with errno set.
+*/
+mapped_file string_map_file(const char *path, MAPPED_FILE_ACCESS access)
+{
+	struct stat st;
+	mapped_file file;
+	bool ok;
+	int fd=open(path,O_RDONLY|O_CLOEXEC);
+	if(fd<0) return NULL;
+	if(fstat(fd,&st)!=0)
+	{
+		close(fd);
+		return NULL;
+	}
+	file=(mapped_file)object_new(sizeof(_mapped_file));
+	if(S_ISREG(st.st_mode) && st.st_size>0 && mapped_file_mmap(file,fd,(size_t)st.st_size))
+	{
+		mapped_file_advise(file,access);
+		ok=true;
+	}
+	else
+	{
+		ok=mapped_file_read(file,fd);
+	}
+	close(fd);
+	return ok?file:NULL;
+}
+
+/**
+* Returns the content of a mapped file as a null-terminated string.
+* The string must not be modified; for a file that was mapped, writing to it crashes the program.
+* A file that contains null bytes looks shorter to string functions than it is;
+* use mapped_file_view() to see all of it.
+* The string stays valid until the file is closed with mapped_file_close().
+*
+* @param file the mapped file.
+* @return the content.
+*/
+string mapped_file_string(mapped_file file)
+{
+	return file->data;
+}
+
+/**
+* Returns a view of the content of a mapped file, including any null bytes.
+* Like the string, the view stays valid until the file is closed.
+*
+* @param file the mapped file.
+* @return the view.
+*/
+view mapped_file_view(mapped_file file)
+{
+	return view_new(file->data,file->size);
+}
+
+/**
+* Returns the size of a mapped file.
+*
+* @param file the mapped file.
+* @return the size in bytes.
+*/
+size_t mapped_file_size(mapped_file file)
+{
+	return file->size;
+}
+
+/**
+* Tells the kernel how the content of a mapped file is going to be accessed, from now on.
+*
+* @param file the mapped file.
+* @param access the expected access pattern.
+* @return true, if the kernel accepted the advice or the file was not mapped; false, if not.
+*/
+bool mapped_file_advise(mapped_file file, MAPPED_FILE_ACCESS access)
+{
+	if(file->mapping==NULL) return true;
+	return madvise(file->mapping,file->size,mapped_file_advice(access))==0;
+}
+
+/**
+* Releases the mapping of a file; the collector never does.
+* Afterwards, the content is gone: its string and views must no longer be used.
+* Closing a file twice does no harm.
+*
+* @param file the mapped file.
+*/
+void mapped_file_close(mapped_file file)
+{
+	if(file->mapping!=NULL)
+	{
+		munmap(file->mapping,file->mapping_size);
+		file->mapping=NULL;
+	}
+	file->data="";
+	file->size=0;
+}
@@ -0,0 +1,74 @@
+/**
+ *
+ * libscriptify
+ *
+ * @author  Erik Poupaert <erik@sankuru.biz>
+ *
+ * @section LICENSE
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU LGPL as
+ * published by the Free Software Foundation; either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * LGPL for more details at: http://www.gnu.org/licenses/lgpl.html
+ *
+ * @section DESCRIPTION
+ *
+ * Files mapped into memory read-only, and used as strings without copying them.
+ * The pages of a file are read from disk only when they are first touched.
+ * The content stays mapped until the file is closed.
+ *
+ */
+#ifndef _MAPPED_FILE_H
+#define _MAPPED_FILE_H
+
+#include <stddef.h>
+#include <stdbool.h>
+#include "string_utf8.h"
+#include "view.h"
+
+#ifdef __cplusplus
+	extern "C" {
+#endif
+
+enum _MAPPED_FILE_ACCESS
+{
+	  MAPPED_FILE_NORMAL //no particular access pattern
+	, MAPPED_FILE_SEQUENTIAL //read from front to back: read ahead aggressively, drop pages behind
+	, MAPPED_FILE_RANDOM //read at random places: do not read ahead
+	, MAPPED_FILE_WILLNEED //the whole file will be read soon: start paging it in now
+};
+
+typedef enum _MAPPED_FILE_ACCESS MAPPED_FILE_ACCESS;
+
+typedef struct
+{
+	string data; //the content, null-terminated; must not be modified
+	size_t size; //the size of the file
+	void *mapping; //the start of the mapping; NULL when the file was read instead, or after closing
+	size_t mapping_size;
+} _mapped_file;
+
+typedef _mapped_file* mapped_file;
+
+/*
+ * The strings and views of a mapped file point into the mapping, which the collector does not see
+ * as references to the mapped_file; so the mapping is only released by mapped_file_close(),
+ * and its content stays valid until then, whether the mapped_file is still referenced or not.
+ */
+mapped_file string_map_file(const char *path, MAPPED_FILE_ACCESS access);
+string mapped_file_string(mapped_file file);
+view mapped_file_view(mapped_file file);
+size_t mapped_file_size(mapped_file file);
+bool mapped_file_advise(mapped_file file, MAPPED_FILE_ACCESS access);
+void mapped_file_close(mapped_file file);
+
+#ifdef __cplusplus
+	}
+#endif
+
+#endif // _MAPPED_FILE_H
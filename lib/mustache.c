@@ -0,0 +1,365 @@
+/**
+ *
+ * libscriptify
+ *
+ * @author  Erik Poupaert <erik@sankuru.biz>
+ *
+ * @section LICENSE
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU LGPL as
+ * published by the Free Software Foundation; either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * LGPL for more details at: http://www.gnu.org/licenses/lgpl.html
+ *
+ * @section DESCRIPTION
+ *
+ * Mustache-like text templates: a template is compiled once into a list of instructions,
+ * literal slices, lookups of names in maps, loops over arrays and conditionals,
+ * and rendered into a buffer as often as needed.
+ *
+ */
+#include <string.h>
+#include "object.h"
+#include "map.h"
+#include "shape.h"
+#include "escape.h"
+#include "mustache.h"
+
+//PRIVATE
+
+/* initial number of instructions; it grows as needed */
+#define MUSTACHE_OPS_CAPACITY 16
+
+typedef struct
+{
+	mustache m;
+	size_t capacity;
+	size_t open[MUSTACHE_MAX_DEPTH]; //the sections not closed yet
+	int depth;
+} _mustache_compiler;
+
+typedef _mustache_compiler* mustache_compiler;
+
+/**
+* Returns the first occurrence of 'delimiter' at or after 'p', or NULL.
+*/
+static const char *mustache_find(const char *p, const char *end, const char *delimiter, size_t size)
+{
+	while(end-p>=(ptrdiff_t)size)
+	{
+		p=(const char *)memchr(p,delimiter[0],(size_t)(end-p)-size+1);
+		if(p==NULL) return NULL;
+		if(memcmp(p,delimiter,size)==0) return p;
+		p++;
+	}
+	return NULL;
+}
+
+static mustache_op mustache_add(mustache_compiler c, MUSTACHE_OP op)
+{
+	mustache m=c->m;
+	mustache_op added;
+	if(m->count==c->capacity)
+	{
+		c->capacity*=2;
+		m->ops=(mustache_op)object_resize(m->ops,c->capacity*sizeof(_mustache_op));
+	}
+	added=&m->ops[m->count++];
+	memset(added,0,sizeof(_mustache_op));
+	added->op=op;
+	return added;
+}
+
+static void mustache_add_text(mustache_compiler c, const char *data, size_t size)
+{
+	if(size==0) return;
+	mustache_add(c,MUSTACHE_TEXT)->text=view_new(data,size);
+	c->m->literal_size+=size;
+}
+
+static view mustache_trim(const char *data, size_t size)
+{
+	while(size>0 && (*data==' ' || *data=='\t'))
+	{
+		data++;
+		size--;
+	}
+	while(size>0 && (data[size-1]==' ' || data[size-1]=='\t')) size--;
+	return view_new(data,size);
+}
+
+/**
+* Splits a dotted name into keys of maps and records; "." is the current item.
+* The keys are interned, which records match by address.
+*/
+static bool mustache_set_name(mustache_op op, view name)
+{
+	size_t start=0, i, parts=1, k=0;
+	if(name.size==0) return false;
+	if(name.size==1 && name.data[0]=='.') return true;
+	for(i=0; i<name.size; i++) if(name.data[i]=='.') parts++;
+	op->path=(any *)object_new(parts*sizeof(any));
+	op->path_size=parts;
+	for(i=0; i<=name.size; i++)
+	{
+		if(i<name.size && name.data[i]!='.') continue;
+		if(i==start) return false;
+		op->path[k++]=any_new_string(string_intern_bytes(name.data+start,i-start));
+		start=i+1;
+	}
+	return true;
+}
+
+/**
+* Checks if a tag is alone on its line, apart from spaces and tabs; such a line is left out of the output.
+* '*line_start' and '*next' receive the start of the line and the start of the next one.
+*/
+static bool mustache_standalone(const char *source, const char *end, const char *open, const char *after,
+	const char **line_start, const char **next)
+{
+	const char *p=open;
+	while(p>source && (p[-1]==' ' || p[-1]=='\t')) p--;
+	if(p>source && p[-1]!='\n') return false;
+	*line_start=p;
+	p=after;
+	while(p<end && (*p==' ' || *p=='\t')) p++;
+	if(p<end && *p=='\r' && p+1<end && p[1]=='\n') p++;
+	if(p<end && *p!='\n') return false;
+	*next=p<end?p+1:end;
+	return true;
+}
+
+/**
+* Compiles one tag; 'kind' is its first character.
+*/
+static bool mustache_tag(mustache_compiler c, char kind, view name)
+{
+	mustache m=c->m;
+	mustache_op op, section;
+	switch(kind)
+	{
+		case '!':
+			return true;
+		case '#':
+		case '^':
+			if(c->depth==MUSTACHE_MAX_DEPTH) return false;
+			op=mustache_add(c,kind=='#'?MUSTACHE_SECTION:MUSTACHE_INVERTED);
+			op->text=name;
+			c->open[c->depth++]=m->count-1;
+			return mustache_set_name(op,name);
+		case '/':
+			if(c->depth==0) return false;
+			section=&m->ops[c->open[--c->depth]];
+			if(!view_equal(section->text,name)) return false;
+			section->end=m->count;
+			return true;
+		case '{':
+		case '&':
+			return mustache_set_name(mustache_add(c,MUSTACHE_RAW),name);
+		default:
+			return mustache_set_name(mustache_add(c,MUSTACHE_VALUE),name);
+	}
+}
+
+static any mustache_get(any item, any key)
+{
+	if(item==NULL) return NULL;
+	if(item->type==TYPE_MAP) return map_get(item->map,key);
+	if(item->type==TYPE_RECORD) return record_get(item->rec,key->str);
+	return NULL;
+}
+
+/**
+* Finds a name in the items of the sections being rendered, from the innermost out;
+* the other parts of a dotted name are then looked up in what the first part found.
+* Items are maps or records.
+*/
+static any mustache_lookup(mustache_op op, any *stack, int depth)
+{
+	any value=NULL;
+	size_t k;
+	int d;
+	if(op->path==NULL) return stack[depth-1];
+	for(d=depth-1; d>=0 && value==NULL; d--) value=mustache_get(stack[d],op->path[0]);
+	for(k=1; k<op->path_size && value!=NULL; k++) value=mustache_get(value,op->path[k]);
+	return value;
+}
+
+static bool mustache_true(any value)
+{
+	if(value==NULL || value->type==TYPE_NULL) return false;
+	if(value->type==TYPE_BOOL) return value->bln;
+	if(value->type==TYPE_ARRAY) return value->arr->size>0;
+	return true;
+}
+
+static void mustache_write(buffer b, any value, bool escape)
+{
+	if(value==NULL) return;
+	switch(value->type)
+	{
+		case TYPE_STRING:
+			if(escape) escape_append(b,ESCAPE_HTML,view_from_string(value->str));
+			else buffer_appendstring(b,value->str);
+			break;
+		case TYPE_INT: buffer_append_long(b,value->i); break;
+		case TYPE_LONG: buffer_append_long(b,value->lng); break;
+		case TYPE_DOUBLE: buffer_append_double(b,value->dbl); break;
+		case TYPE_BOOL: buffer_appendstring(b,value->bln?"true":"false"); break;
+		default: break;
+	}
+}
+
+/**
+* Runs the instructions from 'begin' up to 'end'; 'stack' holds the data and the items of the sections being rendered.
+*/
+static void mustache_run(mustache m, size_t begin, size_t end, any *stack, int depth, buffer b)
+{
+	size_t i=begin, k;
+	while(i<end)
+	{
+		mustache_op op=&m->ops[i];
+		any value;
+		switch(op->op)
+		{
+			case MUSTACHE_TEXT:
+				buffer_append(b,op->text.data,op->text.size);
+				i++;
+				break;
+			case MUSTACHE_VALUE:
+			case MUSTACHE_RAW:
+				mustache_write(b,mustache_lookup(op,stack,depth),op->op==MUSTACHE_VALUE);
+				i++;
+				break;
+			case MUSTACHE_SECTION:
+				value=mustache_lookup(op,stack,depth);
+				if(mustache_true(value))
+				{
+					if(value->type==TYPE_ARRAY)
+					{
+						for(k=0; k<value->arr->size; k++)
+						{
+							stack[depth]=value->arr->items[k];
+							mustache_run(m,i+1,op->end,stack,depth+1,b);
+						}
+					}
+					else
+					{
+						stack[depth]=value;
+						mustache_run(m,i+1,op->end,stack,depth+1,b);
+					}
+				}
+				i=op->end;
+				break;
+			case MUSTACHE_INVERTED:
+				if(!mustache_true(mustache_lookup(op,stack,depth))) mustache_run(m,i+1,op->end,stack,depth,b);
+				i=op->end;
+				break;
+		}
+	}
+}
+
+//PRIVATE
+
+/**
+* Compiles a template; see mustache_compile_view().
+*
+* @param source the template.
+* @return A pointer to the compiled template; or NULL, if it is not valid.
+*/
+mustache mustache_compile(string source)
+{
+	return mustache_compile_view(view_from_string(source));
+}
+
+/**
+* Compiles a template into a list of instructions, once, so that rendering it only copies literals
+* and looks up values. The template language is a subset of mustache:
+* {{name}} writes a value escaped for HTML, {{{name}}} and {{&name}} write it as is;
+* {{#name}}...{{/name}} renders its content once per item of an array, or once for any other true value,
+* which is also the item of {{.}}; {{^name}}...{{/name}} renders its content if the value is false,
+* null, missing or an empty array; {{!comment}} is left out.
+* Names may be dotted, as in {{user.name}}: the first part is looked up in the items of the sections around
+* the tag, from the innermost out, and then in the data. A line holding only a section, closing or comment
+* tag, and spaces, is left out of the output. Partials and changing the delimiters are not supported.
+*
+* @param source the template; it is copied.
+* @return A pointer to the compiled template; or NULL, if a tag is not closed, a name is empty, sections
+* are not closed in order or nest deeper than MUSTACHE_MAX_DEPTH.
+*/
+mustache mustache_compile_view(view source)
+{
+	_mustache_compiler compiler;
+	mustache_compiler c=&compiler;
+	mustache m=(mustache)object_new(sizeof(_mustache));
+	const char *s, *end, *text, *open;
+	m->source=view_tostring(source);
+	m->ops=(mustache_op)object_new(MUSTACHE_OPS_CAPACITY*sizeof(_mustache_op));
+	c->m=m;
+	c->capacity=MUSTACHE_OPS_CAPACITY;
+	c->depth=0;
+	s=m->source;
+	end=s+source.size;
+	text=s;
+	while((open=mustache_find(text,end,"{{",2))!=NULL)
+	{
+		const char *tag=open+2, *close, *after, *line_start, *next;
+		char kind=tag<end?*tag:0;
+		bool triple=kind=='{';
+		close=mustache_find(tag,end,triple?"}}}":"}}",triple?3:2);
+		if(close==NULL) return NULL;
+		after=close+(triple?3:2);
+		if(kind!=0 && strchr("{&#^/!",kind)!=NULL) tag++;
+		if((kind=='#' || kind=='^' || kind=='/' || kind=='!') && mustache_standalone(s,end,open,after,&line_start,&next))
+		{
+			mustache_add_text(c,text,(size_t)(line_start-text));
+			text=next;
+		}
+		else
+		{
+			mustache_add_text(c,text,(size_t)(open-text));
+			text=after;
+		}
+		if(!mustache_tag(c,kind,kind=='!'?view_new(tag,0):mustache_trim(tag,(size_t)(close-tag)))) return NULL;
+	}
+	mustache_add_text(c,text,(size_t)(end-text));
+	if(c->depth>0) return NULL;
+	return m;
+}
+
+/**
+* Renders a template into a buffer. Room for the literals is reserved up front, the literals are copied
+* straight from the template, and values are written straight into the buffer: nothing is allocated
+* apart from the output. Strings are written as is or escaped; numbers in decimal; booleans as
+* "true" or "false"; null, missing values, arrays, maps and records as nothing.
+*
+* @param b the buffer to append to.
+* @param m the template.
+* @param data the data; usually a map or a record.
+*/
+void mustache_render(buffer b, mustache m, any data)
+{
+	any stack[MUSTACHE_MAX_DEPTH+1];
+	buffer_reserve(b,m->literal_size);
+	stack[0]=data;
+	mustache_run(m,0,m->count,stack,1,b);
+}
+
+/**
+* Renders a template into a new string; see mustache_render().
+*
+* @param m the template.
+* @param data the data.
+* @return A new string holding the output.
+*/
+string mustache_tostring(mustache m, any data)
+{
+	buffer b=buffer_new_capacity(m->literal_size+BUFFER_INIT_CAPACITY);
+	mustache_render(b,m,data);
+	return buffer_steal(b);
+}
@@ -0,0 +1,83 @@
+/**
+ *
+ * libscriptify
+ *
+ * @author  Erik Poupaert <erik@sankuru.biz>
+ *
+ * @section LICENSE
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU LGPL as
+ * published by the Free Software Foundation; either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * LGPL for more details at: http://www.gnu.org/licenses/lgpl.html
+ *
+ * @section DESCRIPTION
+ *
+ * Mustache-like text templates: a template is compiled once into a list of instructions,
+ * literal slices, lookups of names in maps and records, loops over arrays and conditionals,
+ * and rendered into a buffer as often as needed.
+ *
+ */
+#ifndef _MUSTACHE_H
+#define _MUSTACHE_H
+
+#include <stddef.h>
+#include <stdbool.h>
+#include "any.h"
+#include "view.h"
+#include "buffer.h"
+
+#ifdef __cplusplus
+	extern "C" {
+#endif
+
+/* maximum nesting of sections */
+#define MUSTACHE_MAX_DEPTH 64
+
+enum _MUSTACHE_OP
+{
+	  MUSTACHE_TEXT //copy a literal slice of the template
+	, MUSTACHE_VALUE //write a value, escaped for HTML
+	, MUSTACHE_RAW //write a value as is
+	, MUSTACHE_SECTION //render the section once per item of an array, or once for any other true value
+	, MUSTACHE_INVERTED //render the section once if the value is false, null, missing or an empty array
+};
+
+typedef enum _MUSTACHE_OP MUSTACHE_OP;
+
+typedef struct
+{
+	MUSTACHE_OP op;
+	view text; //MUSTACHE_TEXT: the literal, in the copy of the template; sections: the name
+	any *path; //the parts of a dotted name, as keys of maps and records; NULL for "."
+	size_t path_size;
+	size_t end; //MUSTACHE_SECTION and MUSTACHE_INVERTED: the instruction after the section
+} _mustache_op;
+
+typedef _mustache_op* mustache_op;
+
+typedef struct
+{
+	mustache_op ops;
+	size_t count;
+	size_t literal_size; //bytes of all literals, reserved in the output up front
+	string source; //copy of the template, which the literals point into
+} _mustache;
+
+typedef _mustache* mustache;
+
+mustache mustache_compile(string source);
+mustache mustache_compile_view(view source);
+void mustache_render(buffer b, mustache m, any data);
+string mustache_tostring(mustache m, any data);
+
+#ifdef __cplusplus
+	}
+#endif
+
+#endif // _MUSTACHE_H
@@ -0,0 +1,2130 @@
+/**
+ *
+ * libscriptify
+ *
+ * @author  Erik Poupaert <erik@sankuru.biz>
+ *
+ * @section LICENSE
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU LGPL as
+ * published by the Free Software Foundation; either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * LGPL for more details at: http://www.gnu.org/licenses/lgpl.html
+ *
+ * @section DESCRIPTION
+ *
+ * Conversion between numbers and their decimal text representation.
+ * Parsing works on a pointer plus length, needs no terminating zero, and does not depend on the locale.
+ *
+ */
+#define _GNU_SOURCE
+#include <string.h>
+#include <limits.h>
+#include <locale.h>
+#include <stdlib.h>
+#include <pthread.h>
+#include "object.h"
+#include "number.h"
+
+//PRIVATE
+
+#define NUMBER_SMALLEST_POWER10 -342
+#define NUMBER_LARGEST_POWER10 308
+#define NUMBER_MANTISSA_BITS 52
+#define NUMBER_MINIMUM_EXPONENT -1023
+#define NUMBER_INFINITE_POWER 0x7ff
+#define NUMBER_MAX_DIGITS 19
+#define NUMBER_G_MIN_K -324
+#define NUMBER_MASK_63 0x7fffffffffffffffull
+
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__==__ORDER_LITTLE_ENDIAN__
+#define NUMBER_SWAR 1
+#endif
+
+/**
+* 128-bit approximations of 5^q for q in [-342,308], as (high,low) pairs,
+* normalized so that the most significant bit is set.
+*/
+static const uint64_t number_power5[]=
+{
+	  0xeef453d6923bd65aull, 0x113faa2906a13b3full //5^-342
+	, 0x9558b4661b6565f8ull, 0x4ac7ca59a424c507ull //5^-341
+	, 0xbaaee17fa23ebf76ull, 0x5d79bcf00d2df649ull //5^-340
+	, 0xe95a99df8ace6f53ull, 0xf4d82c2c107973dcull //5^-339
+	, 0x91d8a02bb6c10594ull, 0x79071b9b8a4be869ull //5^-338
+	, 0xb64ec836a47146f9ull, 0x9748e2826cdee284ull //5^-337
+	, 0xe3e27a444d8d98b7ull, 0xfd1b1b2308169b25ull //5^-336
+	, 0x8e6d8c6ab0787f72ull, 0xfe30f0f5e50e20f7ull //5^-335
+	, 0xb208ef855c969f4full, 0xbdbd2d335e51a935ull //5^-334
+	, 0xde8b2b66b3bc4723ull, 0xad2c788035e61382ull //5^-333
+	, 0x8b16fb203055ac76ull, 0x4c3bcb5021afcc31ull //5^-332
+	, 0xaddcb9e83c6b1793ull, 0xdf4abe242a1bbf3dull //5^-331
+	, 0xd953e8624b85dd78ull, 0xd71d6dad34a2af0dull //5^-330
+	, 0x87d4713d6f33aa6bull, 0x8672648c40e5ad68ull //5^-329
+	, 0xa9c98d8ccb009506ull, 0x680efdaf511f18c2ull //5^-328
+	, 0xd43bf0effdc0ba48ull, 0x0212bd1b2566def2ull //5^-327
+	, 0x84a57695fe98746dull, 0x014bb630f7604b57ull //5^-326
+	, 0xa5ced43b7e3e9188ull, 0x419ea3bd35385e2dull //5^-325
+	, 0xcf42894a5dce35eaull, 0x52064cac828675b9ull //5^-324
+	, 0x818995ce7aa0e1b2ull, 0x7343efebd1940993ull //5^-323
+	, 0xa1ebfb4219491a1full, 0x1014ebe6c5f90bf8ull //5^-322
+	, 0xca66fa129f9b60a6ull, 0xd41a26e077774ef6ull //5^-321
+	, 0xfd00b897478238d0ull, 0x8920b098955522b4ull //5^-320
+	, 0x9e20735e8cb16382ull, 0x55b46e5f5d5535b0ull //5^-319
+	, 0xc5a890362fddbc62ull, 0xeb2189f734aa831dull //5^-318
+	, 0xf712b443bbd52b7bull, 0xa5e9ec7501d523e4ull //5^-317
+	, 0x9a6bb0aa55653b2dull, 0x47b233c92125366eull //5^-316
+	, 0xc1069cd4eabe89f8ull, 0x999ec0bb696e840aull //5^-315
+	, 0xf148440a256e2c76ull, 0xc00670ea43ca250dull //5^-314
+	, 0x96cd2a865764dbcaull, 0x380406926a5e5728ull //5^-313
+	, 0xbc807527ed3e12bcull, 0xc605083704f5ecf2ull //5^-312
+	, 0xeba09271e88d976bull, 0xf7864a44c633682eull //5^-311
+	, 0x93445b8731587ea3ull, 0x7ab3ee6afbe0211dull //5^-310
+	, 0xb8157268fdae9e4cull, 0x5960ea05bad82964ull //5^-309
+	, 0xe61acf033d1a45dfull, 0x6fb92487298e33bdull //5^-308
+	, 0x8fd0c16206306babull, 0xa5d3b6d479f8e056ull //5^-307
+	, 0xb3c4f1ba87bc8696ull, 0x8f48a4899877186cull //5^-306
+	, 0xe0b62e2929aba83cull, 0x331acdabfe94de87ull //5^-305
+	, 0x8c71dcd9ba0b4925ull, 0x9ff0c08b7f1d0b14ull //5^-304
+	, 0xaf8e5410288e1b6full, 0x07ecf0ae5ee44dd9ull //5^-303
+	, 0xdb71e91432b1a24aull, 0xc9e82cd9f69d6150ull //5^-302
+	, 0x892731ac9faf056eull, 0xbe311c083a225cd2ull //5^-301
+	, 0xab70fe17c79ac6caull, 0x6dbd630a48aaf406ull //5^-300
+	, 0xd64d3d9db981787dull, 0x092cbbccdad5b108ull //5^-299
+	, 0x85f0468293f0eb4eull, 0x25bbf56008c58ea5ull //5^-298
+	, 0xa76c582338ed2621ull, 0xaf2af2b80af6f24eull //5^-297
+	, 0xd1476e2c07286faaull, 0x1af5af660db4aee1ull //5^-296
+	, 0x82cca4db847945caull, 0x50d98d9fc890ed4dull //5^-295
+	, 0xa37fce126597973cull, 0xe50ff107bab528a0ull //5^-294
+	, 0xcc5fc196fefd7d0cull, 0x1e53ed49a96272c8ull //5^-293
+	, 0xff77b1fcbebcdc4full, 0x25e8e89c13bb0f7aull //5^-292
+	, 0x9faacf3df73609b1ull, 0x77b191618c54e9acull //5^-291
+	, 0xc795830d75038c1dull, 0xd59df5b9ef6a2417ull //5^-290
+	, 0xf97ae3d0d2446f25ull, 0x4b0573286b44ad1dull //5^-289
+	, 0x9becce62836ac577ull, 0x4ee367f9430aec32ull //5^-288
+	, 0xc2e801fb244576d5ull, 0x229c41f793cda73full //5^-287
+	, 0xf3a20279ed56d48aull, 0x6b43527578c1110full //5^-286
+	, 0x9845418c345644d6ull, 0x830a13896b78aaa9ull //5^-285
+	, 0xbe5691ef416bd60cull, 0x23cc986bc656d553ull //5^-284
+	, 0xedec366b11c6cb8full, 0x2cbfbe86b7ec8aa8ull //5^-283
+	, 0x94b3a202eb1c3f39ull, 0x7bf7d71432f3d6a9ull //5^-282
+	, 0xb9e08a83a5e34f07ull, 0xdaf5ccd93fb0cc53ull //5^-281
+	, 0xe858ad248f5c22c9ull, 0xd1b3400f8f9cff68ull //5^-280
+	, 0x91376c36d99995beull, 0x23100809b9c21fa1ull //5^-279
+	, 0xb58547448ffffb2dull, 0xabd40a0c2832a78aull //5^-278
+	, 0xe2e69915b3fff9f9ull, 0x16c90c8f323f516cull //5^-277
+	, 0x8dd01fad907ffc3bull, 0xae3da7d97f6792e3ull //5^-276
+	, 0xb1442798f49ffb4aull, 0x99cd11cfdf41779cull //5^-275
+	, 0xdd95317f31c7fa1dull, 0x40405643d711d583ull //5^-274
+	, 0x8a7d3eef7f1cfc52ull, 0x482835ea666b2572ull //5^-273
+	, 0xad1c8eab5ee43b66ull, 0xda3243650005eecfull //5^-272
+	, 0xd863b256369d4a40ull, 0x90bed43e40076a82ull //5^-271
+	, 0x873e4f75e2224e68ull, 0x5a7744a6e804a291ull //5^-270
+	, 0xa90de3535aaae202ull, 0x711515d0a205cb36ull //5^-269
+	, 0xd3515c2831559a83ull, 0x0d5a5b44ca873e03ull //5^-268
+	, 0x8412d9991ed58091ull, 0xe858790afe9486c2ull //5^-267
+	, 0xa5178fff668ae0b6ull, 0x626e974dbe39a872ull //5^-266
+	, 0xce5d73ff402d98e3ull, 0xfb0a3d212dc8128full //5^-265
+	, 0x80fa687f881c7f8eull, 0x7ce66634bc9d0b99ull //5^-264
+	, 0xa139029f6a239f72ull, 0x1c1fffc1ebc44e80ull //5^-263
+	, 0xc987434744ac874eull, 0xa327ffb266b56220ull //5^-262
+	, 0xfbe9141915d7a922ull, 0x4bf1ff9f0062baa8ull //5^-261
+	, 0x9d71ac8fada6c9b5ull, 0x6f773fc3603db4a9ull //5^-260
+	, 0xc4ce17b399107c22ull, 0xcb550fb4384d21d3ull //5^-259
+	, 0xf6019da07f549b2bull, 0x7e2a53a146606a48ull //5^-258
+	, 0x99c102844f94e0fbull, 0x2eda7444cbfc426dull //5^-257
+	, 0xc0314325637a1939ull, 0xfa911155fefb5308ull //5^-256
+	, 0xf03d93eebc589f88ull, 0x793555ab7eba27caull //5^-255
+	, 0x96267c7535b763b5ull, 0x4bc1558b2f3458deull //5^-254
+	, 0xbbb01b9283253ca2ull, 0x9eb1aaedfb016f16ull //5^-253
+	, 0xea9c227723ee8bcbull, 0x465e15a979c1cadcull //5^-252
+	, 0x92a1958a7675175full, 0x0bfacd89ec191ec9ull //5^-251
+	, 0xb749faed14125d36ull, 0xcef980ec671f667bull //5^-250
+	, 0xe51c79a85916f484ull, 0x82b7e12780e7401aull //5^-249
+	, 0x8f31cc0937ae58d2ull, 0xd1b2ecb8b0908810ull //5^-248
+	, 0xb2fe3f0b8599ef07ull, 0x861fa7e6dcb4aa15ull //5^-247
+	, 0xdfbdcece67006ac9ull, 0x67a791e093e1d49aull //5^-246
+	, 0x8bd6a141006042bdull, 0xe0c8bb2c5c6d24e0ull //5^-245
+	, 0xaecc49914078536dull, 0x58fae9f773886e18ull //5^-244
+	, 0xda7f5bf590966848ull, 0xaf39a475506a899eull //5^-243
+	, 0x888f99797a5e012dull, 0x6d8406c952429603ull //5^-242
+	, 0xaab37fd7d8f58178ull, 0xc8e5087ba6d33b83ull //5^-241
+	, 0xd5605fcdcf32e1d6ull, 0xfb1e4a9a90880a64ull //5^-240
+	, 0x855c3be0a17fcd26ull, 0x5cf2eea09a55067full //5^-239
+	, 0xa6b34ad8c9dfc06full, 0xf42faa48c0ea481eull //5^-238
+	, 0xd0601d8efc57b08bull, 0xf13b94daf124da26ull //5^-237
+	, 0x823c12795db6ce57ull, 0x76c53d08d6b70858ull //5^-236
+	, 0xa2cb1717b52481edull, 0x54768c4b0c64ca6eull //5^-235
+	, 0xcb7ddcdda26da268ull, 0xa9942f5dcf7dfd09ull //5^-234
+	, 0xfe5d54150b090b02ull, 0xd3f93b35435d7c4cull //5^-233
+	, 0x9efa548d26e5a6e1ull, 0xc47bc5014a1a6dafull //5^-232
+	, 0xc6b8e9b0709f109aull, 0x359ab6419ca1091bull //5^-231
+	, 0xf867241c8cc6d4c0ull, 0xc30163d203c94b62ull //5^-230
+	, 0x9b407691d7fc44f8ull, 0x79e0de63425dcf1dull //5^-229
+	, 0xc21094364dfb5636ull, 0x985915fc12f542e4ull //5^-228
+	, 0xf294b943e17a2bc4ull, 0x3e6f5b7b17b2939dull //5^-227
+	, 0x979cf3ca6cec5b5aull, 0xa705992ceecf9c42ull //5^-226
+	, 0xbd8430bd08277231ull, 0x50c6ff782a838353ull //5^-225
+	, 0xece53cec4a314ebdull, 0xa4f8bf5635246428ull //5^-224
+	, 0x940f4613ae5ed136ull, 0x871b7795e136be99ull //5^-223
+	, 0xb913179899f68584ull, 0x28e2557b59846e3full //5^-222
+	, 0xe757dd7ec07426e5ull, 0x331aeada2fe589cfull //5^-221
+	, 0x9096ea6f3848984full, 0x3ff0d2c85def7621ull //5^-220
+	, 0xb4bca50b065abe63ull, 0x0fed077a756b53a9ull //5^-219
+	, 0xe1ebce4dc7f16dfbull, 0xd3e8495912c62894ull //5^-218
+	, 0x8d3360f09cf6e4bdull, 0x64712dd7abbbd95cull //5^-217
+	, 0xb080392cc4349decull, 0xbd8d794d96aacfb3ull //5^-216
+	, 0xdca04777f541c567ull, 0xecf0d7a0fc5583a0ull //5^-215
+	, 0x89e42caaf9491b60ull, 0xf41686c49db57244ull //5^-214
+	, 0xac5d37d5b79b6239ull, 0x311c2875c522ced5ull //5^-213
+	, 0xd77485cb25823ac7ull, 0x7d633293366b828bull //5^-212
+	, 0x86a8d39ef77164bcull, 0xae5dff9c02033197ull //5^-211
+	, 0xa8530886b54dbdebull, 0xd9f57f830283fdfcull //5^-210
+	, 0xd267caa862a12d66ull, 0xd072df63c324fd7bull //5^-209
+	, 0x8380dea93da4bc60ull, 0x4247cb9e59f71e6dull //5^-208
+	, 0xa46116538d0deb78ull, 0x52d9be85f074e608ull //5^-207
+	, 0xcd795be870516656ull, 0x67902e276c921f8bull //5^-206
+	, 0x806bd9714632dff6ull, 0x00ba1cd8a3db53b6ull //5^-205
+	, 0xa086cfcd97bf97f3ull, 0x80e8a40eccd228a4ull //5^-204
+	, 0xc8a883c0fdaf7df0ull, 0x6122cd128006b2cdull //5^-203
+	, 0xfad2a4b13d1b5d6cull, 0x796b805720085f81ull //5^-202
+	, 0x9cc3a6eec6311a63ull, 0xcbe3303674053bb0ull //5^-201
+	, 0xc3f490aa77bd60fcull, 0xbedbfc4411068a9cull //5^-200
+	, 0xf4f1b4d515acb93bull, 0xee92fb5515482d44ull //5^-199
+	, 0x991711052d8bf3c5ull, 0x751bdd152d4d1c4aull //5^-198
+	, 0xbf5cd54678eef0b6ull, 0xd262d45a78a0635dull //5^-197
+	, 0xef340a98172aace4ull, 0x86fb897116c87c34ull //5^-196
+	, 0x9580869f0e7aac0eull, 0xd45d35e6ae3d4da0ull //5^-195
+	, 0xbae0a846d2195712ull, 0x8974836059cca109ull //5^-194
+	, 0xe998d258869facd7ull, 0x2bd1a438703fc94bull //5^-193
+	, 0x91ff83775423cc06ull, 0x7b6306a34627ddcfull //5^-192
+	, 0xb67f6455292cbf08ull, 0x1a3bc84c17b1d542ull //5^-191
+	, 0xe41f3d6a7377eecaull, 0x20caba5f1d9e4a93ull //5^-190
+	, 0x8e938662882af53eull, 0x547eb47b7282ee9cull //5^-189
+	, 0xb23867fb2a35b28dull, 0xe99e619a4f23aa43ull //5^-188
+	, 0xdec681f9f4c31f31ull, 0x6405fa00e2ec94d4ull //5^-187
+	, 0x8b3c113c38f9f37eull, 0xde83bc408dd3dd04ull //5^-186
+	, 0xae0b158b4738705eull, 0x9624ab50b148d445ull //5^-185
+	, 0xd98ddaee19068c76ull, 0x3badd624dd9b0957ull //5^-184
+	, 0x87f8a8d4cfa417c9ull, 0xe54ca5d70a80e5d6ull //5^-183
+	, 0xa9f6d30a038d1dbcull, 0x5e9fcf4ccd211f4cull //5^-182
+	, 0xd47487cc8470652bull, 0x7647c3200069671full //5^-181
+	, 0x84c8d4dfd2c63f3bull, 0x29ecd9f40041e073ull //5^-180
+	, 0xa5fb0a17c777cf09ull, 0xf468107100525890ull //5^-179
+	, 0xcf79cc9db955c2ccull, 0x7182148d4066eeb4ull //5^-178
+	, 0x81ac1fe293d599bfull, 0xc6f14cd848405530ull //5^-177
+	, 0xa21727db38cb002full, 0xb8ada00e5a506a7cull //5^-176
+	, 0xca9cf1d206fdc03bull, 0xa6d90811f0e4851cull //5^-175
+	, 0xfd442e4688bd304aull, 0x908f4a166d1da663ull //5^-174
+	, 0x9e4a9cec15763e2eull, 0x9a598e4e043287feull //5^-173
+	, 0xc5dd44271ad3cdbaull, 0x40eff1e1853f29fdull //5^-172
+	, 0xf7549530e188c128ull, 0xd12bee59e68ef47cull //5^-171
+	, 0x9a94dd3e8cf578b9ull, 0x82bb74f8301958ceull //5^-170
+	, 0xc13a148e3032d6e7ull, 0xe36a52363c1faf01ull //5^-169
+	, 0xf18899b1bc3f8ca1ull, 0xdc44e6c3cb279ac1ull //5^-168
+	, 0x96f5600f15a7b7e5ull, 0x29ab103a5ef8c0b9ull //5^-167
+	, 0xbcb2b812db11a5deull, 0x7415d448f6b6f0e7ull //5^-166
+	, 0xebdf661791d60f56ull, 0x111b495b3464ad21ull //5^-165
+	, 0x936b9fcebb25c995ull, 0xcab10dd900beec34ull //5^-164
+	, 0xb84687c269ef3bfbull, 0x3d5d514f40eea742ull //5^-163
+	, 0xe65829b3046b0afaull, 0x0cb4a5a3112a5112ull //5^-162
+	, 0x8ff71a0fe2c2e6dcull, 0x47f0e785eaba72abull //5^-161
+	, 0xb3f4e093db73a093ull, 0x59ed216765690f56ull //5^-160
+	, 0xe0f218b8d25088b8ull, 0x306869c13ec3532cull //5^-159
+	, 0x8c974f7383725573ull, 0x1e414218c73a13fbull //5^-158
+	, 0xafbd2350644eeacfull, 0xe5d1929ef90898faull //5^-157
+	, 0xdbac6c247d62a583ull, 0xdf45f746b74abf39ull //5^-156
+	, 0x894bc396ce5da772ull, 0x6b8bba8c328eb783ull //5^-155
+	, 0xab9eb47c81f5114full, 0x066ea92f3f326564ull //5^-154
+	, 0xd686619ba27255a2ull, 0xc80a537b0efefebdull //5^-153
+	, 0x8613fd0145877585ull, 0xbd06742ce95f5f36ull //5^-152
+	, 0xa798fc4196e952e7ull, 0x2c48113823b73704ull //5^-151
+	, 0xd17f3b51fca3a7a0ull, 0xf75a15862ca504c5ull //5^-150
+	, 0x82ef85133de648c4ull, 0x9a984d73dbe722fbull //5^-149
+	, 0xa3ab66580d5fdaf5ull, 0xc13e60d0d2e0ebbaull //5^-148
+	, 0xcc963fee10b7d1b3ull, 0x318df905079926a8ull //5^-147
+	, 0xffbbcfe994e5c61full, 0xfdf17746497f7052ull //5^-146
+	, 0x9fd561f1fd0f9bd3ull, 0xfeb6ea8bedefa633ull //5^-145
+	, 0xc7caba6e7c5382c8ull, 0xfe64a52ee96b8fc0ull //5^-144
+	, 0xf9bd690a1b68637bull, 0x3dfdce7aa3c673b0ull //5^-143
+	, 0x9c1661a651213e2dull, 0x06bea10ca65c084eull //5^-142
+	, 0xc31bfa0fe5698db8ull, 0x486e494fcff30a62ull //5^-141
+	, 0xf3e2f893dec3f126ull, 0x5a89dba3c3efccfaull //5^-140
+	, 0x986ddb5c6b3a76b7ull, 0xf89629465a75e01cull //5^-139
+	, 0xbe89523386091465ull, 0xf6bbb397f1135823ull //5^-138
+	, 0xee2ba6c0678b597full, 0x746aa07ded582e2cull //5^-137
+	, 0x94db483840b717efull, 0xa8c2a44eb4571cdcull //5^-136
+	, 0xba121a4650e4ddebull, 0x92f34d62616ce413ull //5^-135
+	, 0xe896a0d7e51e1566ull, 0x77b020baf9c81d17ull //5^-134
+	, 0x915e2486ef32cd60ull, 0x0ace1474dc1d122eull //5^-133
+	, 0xb5b5ada8aaff80b8ull, 0x0d819992132456baull //5^-132
+	, 0xe3231912d5bf60e6ull, 0x10e1fff697ed6c69ull //5^-131
+	, 0x8df5efabc5979c8full, 0xca8d3ffa1ef463c1ull //5^-130
+	, 0xb1736b96b6fd83b3ull, 0xbd308ff8a6b17cb2ull //5^-129
+	, 0xddd0467c64bce4a0ull, 0xac7cb3f6d05ddbdeull //5^-128
+	, 0x8aa22c0dbef60ee4ull, 0x6bcdf07a423aa96bull //5^-127
+	, 0xad4ab7112eb3929dull, 0x86c16c98d2c953c6ull //5^-126
+	, 0xd89d64d57a607744ull, 0xe871c7bf077ba8b7ull //5^-125
+	, 0x87625f056c7c4a8bull, 0x11471cd764ad4972ull //5^-124
+	, 0xa93af6c6c79b5d2dull, 0xd598e40d3dd89bcfull //5^-123
+	, 0xd389b47879823479ull, 0x4aff1d108d4ec2c3ull //5^-122
+	, 0x843610cb4bf160cbull, 0xcedf722a585139baull //5^-121
+	, 0xa54394fe1eedb8feull, 0xc2974eb4ee658828ull //5^-120
+	, 0xce947a3da6a9273eull, 0x733d226229feea32ull //5^-119
+	, 0x811ccc668829b887ull, 0x0806357d5a3f525full //5^-118
+	, 0xa163ff802a3426a8ull, 0xca07c2dcb0cf26f7ull //5^-117
+	, 0xc9bcff6034c13052ull, 0xfc89b393dd02f0b5ull //5^-116
+	, 0xfc2c3f3841f17c67ull, 0xbbac2078d443ace2ull //5^-115
+	, 0x9d9ba7832936edc0ull, 0xd54b944b84aa4c0dull //5^-114
+	, 0xc5029163f384a931ull, 0x0a9e795e65d4df11ull //5^-113
+	, 0xf64335bcf065d37dull, 0x4d4617b5ff4a16d5ull //5^-112
+	, 0x99ea0196163fa42eull, 0x504bced1bf8e4e45ull //5^-111
+	, 0xc06481fb9bcf8d39ull, 0xe45ec2862f71e1d6ull //5^-110
+	, 0xf07da27a82c37088ull, 0x5d767327bb4e5a4cull //5^-109
+	, 0x964e858c91ba2655ull, 0x3a6a07f8d510f86full //5^-108
+	, 0xbbe226efb628afeaull, 0x890489f70a55368bull //5^-107
+	, 0xeadab0aba3b2dbe5ull, 0x2b45ac74ccea842eull //5^-106
+	, 0x92c8ae6b464fc96full, 0x3b0b8bc90012929dull //5^-105
+	, 0xb77ada0617e3bbcbull, 0x09ce6ebb40173744ull //5^-104
+	, 0xe55990879ddcaabdull, 0xcc420a6a101d0515ull //5^-103
+	, 0x8f57fa54c2a9eab6ull, 0x9fa946824a12232dull //5^-102
+	, 0xb32df8e9f3546564ull, 0x47939822dc96abf9ull //5^-101
+	, 0xdff9772470297ebdull, 0x59787e2b93bc56f7ull //5^-100
+	, 0x8bfbea76c619ef36ull, 0x57eb4edb3c55b65aull //5^-99
+	, 0xaefae51477a06b03ull, 0xede622920b6b23f1ull //5^-98
+	, 0xdab99e59958885c4ull, 0xe95fab368e45ecedull //5^-97
+	, 0x88b402f7fd75539bull, 0x11dbcb0218ebb414ull //5^-96
+	, 0xaae103b5fcd2a881ull, 0xd652bdc29f26a119ull //5^-95
+	, 0xd59944a37c0752a2ull, 0x4be76d3346f0495full //5^-94
+	, 0x857fcae62d8493a5ull, 0x6f70a4400c562ddbull //5^-93
+	, 0xa6dfbd9fb8e5b88eull, 0xcb4ccd500f6bb952ull //5^-92
+	, 0xd097ad07a71f26b2ull, 0x7e2000a41346a7a7ull //5^-91
+	, 0x825ecc24c873782full, 0x8ed400668c0c28c8ull //5^-90
+	, 0xa2f67f2dfa90563bull, 0x728900802f0f32faull //5^-89
+	, 0xcbb41ef979346bcaull, 0x4f2b40a03ad2ffb9ull //5^-88
+	, 0xfea126b7d78186bcull, 0xe2f610c84987bfa8ull //5^-87
+	, 0x9f24b832e6b0f436ull, 0x0dd9ca7d2df4d7c9ull //5^-86
+	, 0xc6ede63fa05d3143ull, 0x91503d1c79720dbbull //5^-85
+	, 0xf8a95fcf88747d94ull, 0x75a44c6397ce912aull //5^-84
+	, 0x9b69dbe1b548ce7cull, 0xc986afbe3ee11abaull //5^-83
+	, 0xc24452da229b021bull, 0xfbe85badce996168ull //5^-82
+	, 0xf2d56790ab41c2a2ull, 0xfae27299423fb9c3ull //5^-81
+	, 0x97c560ba6b0919a5ull, 0xdccd879fc967d41aull //5^-80
+	, 0xbdb6b8e905cb600full, 0x5400e987bbc1c920ull //5^-79
+	, 0xed246723473e3813ull, 0x290123e9aab23b68ull //5^-78
+	, 0x9436c0760c86e30bull, 0xf9a0b6720aaf6521ull //5^-77
+	, 0xb94470938fa89bceull, 0xf808e40e8d5b3e69ull //5^-76
+	, 0xe7958cb87392c2c2ull, 0xb60b1d1230b20e04ull //5^-75
+	, 0x90bd77f3483bb9b9ull, 0xb1c6f22b5e6f48c2ull //5^-74
+	, 0xb4ecd5f01a4aa828ull, 0x1e38aeb6360b1af3ull //5^-73
+	, 0xe2280b6c20dd5232ull, 0x25c6da63c38de1b0ull //5^-72
+	, 0x8d590723948a535full, 0x579c487e5a38ad0eull //5^-71
+	, 0xb0af48ec79ace837ull, 0x2d835a9df0c6d851ull //5^-70
+	, 0xdcdb1b2798182244ull, 0xf8e431456cf88e65ull //5^-69
+	, 0x8a08f0f8bf0f156bull, 0x1b8e9ecb641b58ffull //5^-68
+	, 0xac8b2d36eed2dac5ull, 0xe272467e3d222f3full //5^-67
+	, 0xd7adf884aa879177ull, 0x5b0ed81dcc6abb0full //5^-66
+	, 0x86ccbb52ea94baeaull, 0x98e947129fc2b4e9ull //5^-65
+	, 0xa87fea27a539e9a5ull, 0x3f2398d747b36224ull //5^-64
+	, 0xd29fe4b18e88640eull, 0x8eec7f0d19a03aadull //5^-63
+	, 0x83a3eeeef9153e89ull, 0x1953cf68300424acull //5^-62
+	, 0xa48ceaaab75a8e2bull, 0x5fa8c3423c052dd7ull //5^-61
+	, 0xcdb02555653131b6ull, 0x3792f412cb06794dull //5^-60
+	, 0x808e17555f3ebf11ull, 0xe2bbd88bbee40bd0ull //5^-59
+	, 0xa0b19d2ab70e6ed6ull, 0x5b6aceaeae9d0ec4ull //5^-58
+	, 0xc8de047564d20a8bull, 0xf245825a5a445275ull //5^-57
+	, 0xfb158592be068d2eull, 0xeed6e2f0f0d56712ull //5^-56
+	, 0x9ced737bb6c4183dull, 0x55464dd69685606bull //5^-55
+	, 0xc428d05aa4751e4cull, 0xaa97e14c3c26b886ull //5^-54
+	, 0xf53304714d9265dfull, 0xd53dd99f4b3066a8ull //5^-53
+	, 0x993fe2c6d07b7fabull, 0xe546a8038efe4029ull //5^-52
+	, 0xbf8fdb78849a5f96ull, 0xde98520472bdd033ull //5^-51
+	, 0xef73d256a5c0f77cull, 0x963e66858f6d4440ull //5^-50
+	, 0x95a8637627989aadull, 0xdde7001379a44aa8ull //5^-49
+	, 0xbb127c53b17ec159ull, 0x5560c018580d5d52ull //5^-48
+	, 0xe9d71b689dde71afull, 0xaab8f01e6e10b4a6ull //5^-47
+	, 0x9226712162ab070dull, 0xcab3961304ca70e8ull //5^-46
+	, 0xb6b00d69bb55c8d1ull, 0x3d607b97c5fd0d22ull //5^-45
+	, 0xe45c10c42a2b3b05ull, 0x8cb89a7db77c506aull //5^-44
+	, 0x8eb98a7a9a5b04e3ull, 0x77f3608e92adb242ull //5^-43
+	, 0xb267ed1940f1c61cull, 0x55f038b237591ed3ull //5^-42
+	, 0xdf01e85f912e37a3ull, 0x6b6c46dec52f6688ull //5^-41
+	, 0x8b61313bbabce2c6ull, 0x2323ac4b3b3da015ull //5^-40
+	, 0xae397d8aa96c1b77ull, 0xabec975e0a0d081aull //5^-39
+	, 0xd9c7dced53c72255ull, 0x96e7bd358c904a21ull //5^-38
+	, 0x881cea14545c7575ull, 0x7e50d64177da2e54ull //5^-37
+	, 0xaa242499697392d2ull, 0xdde50bd1d5d0b9e9ull //5^-36
+	, 0xd4ad2dbfc3d07787ull, 0x955e4ec64b44e864ull //5^-35
+	, 0x84ec3c97da624ab4ull, 0xbd5af13bef0b113eull //5^-34
+	, 0xa6274bbdd0fadd61ull, 0xecb1ad8aeacdd58eull //5^-33
+	, 0xcfb11ead453994baull, 0x67de18eda5814af2ull //5^-32
+	, 0x81ceb32c4b43fcf4ull, 0x80eacf948770ced7ull //5^-31
+	, 0xa2425ff75e14fc31ull, 0xa1258379a94d028dull //5^-30
+	, 0xcad2f7f5359a3b3eull, 0x096ee45813a04330ull //5^-29
+	, 0xfd87b5f28300ca0dull, 0x8bca9d6e188853fcull //5^-28
+	, 0x9e74d1b791e07e48ull, 0x775ea264cf55347eull //5^-27
+	, 0xc612062576589ddaull, 0x95364afe032a819eull //5^-26
+	, 0xf79687aed3eec551ull, 0x3a83ddbd83f52205ull //5^-25
+	, 0x9abe14cd44753b52ull, 0xc4926a9672793543ull //5^-24
+	, 0xc16d9a0095928a27ull, 0x75b7053c0f178294ull //5^-23
+	, 0xf1c90080baf72cb1ull, 0x5324c68b12dd6339ull //5^-22
+	, 0x971da05074da7beeull, 0xd3f6fc16ebca5e04ull //5^-21
+	, 0xbce5086492111aeaull, 0x88f4bb1ca6bcf585ull //5^-20
+	, 0xec1e4a7db69561a5ull, 0x2b31e9e3d06c32e6ull //5^-19
+	, 0x9392ee8e921d5d07ull, 0x3aff322e62439fd0ull //5^-18
+	, 0xb877aa3236a4b449ull, 0x09befeb9fad487c3ull //5^-17
+	, 0xe69594bec44de15bull, 0x4c2ebe687989a9b4ull //5^-16
+	, 0x901d7cf73ab0acd9ull, 0x0f9d37014bf60a11ull //5^-15
+	, 0xb424dc35095cd80full, 0x538484c19ef38c95ull //5^-14
+	, 0xe12e13424bb40e13ull, 0x2865a5f206b06fbaull //5^-13
+	, 0x8cbccc096f5088cbull, 0xf93f87b7442e45d4ull //5^-12
+	, 0xafebff0bcb24aafeull, 0xf78f69a51539d749ull //5^-11
+	, 0xdbe6fecebdedd5beull, 0xb573440e5a884d1cull //5^-10
+	, 0x89705f4136b4a597ull, 0x31680a88f8953031ull //5^-9
+	, 0xabcc77118461cefcull, 0xfdc20d2b36ba7c3eull //5^-8
+	, 0xd6bf94d5e57a42bcull, 0x3d32907604691b4dull //5^-7
+	, 0x8637bd05af6c69b5ull, 0xa63f9a49c2c1b110ull //5^-6
+	, 0xa7c5ac471b478423ull, 0x0fcf80dc33721d54ull //5^-5
+	, 0xd1b71758e219652bull, 0xd3c36113404ea4a9ull //5^-4
+	, 0x83126e978d4fdf3bull, 0x645a1cac083126eaull //5^-3
+	, 0xa3d70a3d70a3d70aull, 0x3d70a3d70a3d70a4ull //5^-2
+	, 0xccccccccccccccccull, 0xcccccccccccccccdull //5^-1
+	, 0x8000000000000000ull, 0x0000000000000000ull //5^0
+	, 0xa000000000000000ull, 0x0000000000000000ull //5^1
+	, 0xc800000000000000ull, 0x0000000000000000ull //5^2
+	, 0xfa00000000000000ull, 0x0000000000000000ull //5^3
+	, 0x9c40000000000000ull, 0x0000000000000000ull //5^4
+	, 0xc350000000000000ull, 0x0000000000000000ull //5^5
+	, 0xf424000000000000ull, 0x0000000000000000ull //5^6
+	, 0x9896800000000000ull, 0x0000000000000000ull //5^7
+	, 0xbebc200000000000ull, 0x0000000000000000ull //5^8
+	, 0xee6b280000000000ull, 0x0000000000000000ull //5^9
+	, 0x9502f90000000000ull, 0x0000000000000000ull //5^10
+	, 0xba43b74000000000ull, 0x0000000000000000ull //5^11
+	, 0xe8d4a51000000000ull, 0x0000000000000000ull //5^12
+	, 0x9184e72a00000000ull, 0x0000000000000000ull //5^13
+	, 0xb5e620f480000000ull, 0x0000000000000000ull //5^14
+	, 0xe35fa931a0000000ull, 0x0000000000000000ull //5^15
+	, 0x8e1bc9bf04000000ull, 0x0000000000000000ull //5^16
+	, 0xb1a2bc2ec5000000ull, 0x0000000000000000ull //5^17
+	, 0xde0b6b3a76400000ull, 0x0000000000000000ull //5^18
+	, 0x8ac7230489e80000ull, 0x0000000000000000ull //5^19
+	, 0xad78ebc5ac620000ull, 0x0000000000000000ull //5^20
+	, 0xd8d726b7177a8000ull, 0x0000000000000000ull //5^21
+	, 0x878678326eac9000ull, 0x0000000000000000ull //5^22
+	, 0xa968163f0a57b400ull, 0x0000000000000000ull //5^23
+	, 0xd3c21bcecceda100ull, 0x0000000000000000ull //5^24
+	, 0x84595161401484a0ull, 0x0000000000000000ull //5^25
+	, 0xa56fa5b99019a5c8ull, 0x0000000000000000ull //5^26
+	, 0xcecb8f27f4200f3aull, 0x0000000000000000ull //5^27
+	, 0x813f3978f8940984ull, 0x4000000000000000ull //5^28
+	, 0xa18f07d736b90be5ull, 0x5000000000000000ull //5^29
+	, 0xc9f2c9cd04674edeull, 0xa400000000000000ull //5^30
+	, 0xfc6f7c4045812296ull, 0x4d00000000000000ull //5^31
+	, 0x9dc5ada82b70b59dull, 0xf020000000000000ull //5^32
+	, 0xc5371912364ce305ull, 0x6c28000000000000ull //5^33
+	, 0xf684df56c3e01bc6ull, 0xc732000000000000ull //5^34
+	, 0x9a130b963a6c115cull, 0x3c7f400000000000ull //5^35
+	, 0xc097ce7bc90715b3ull, 0x4b9f100000000000ull //5^36
+	, 0xf0bdc21abb48db20ull, 0x1e86d40000000000ull //5^37
+	, 0x96769950b50d88f4ull, 0x1314448000000000ull //5^38
+	, 0xbc143fa4e250eb31ull, 0x17d955a000000000ull //5^39
+	, 0xeb194f8e1ae525fdull, 0x5dcfab0800000000ull //5^40
+	, 0x92efd1b8d0cf37beull, 0x5aa1cae500000000ull //5^41
+	, 0xb7abc627050305adull, 0xf14a3d9e40000000ull //5^42
+	, 0xe596b7b0c643c719ull, 0x6d9ccd05d0000000ull //5^43
+	, 0x8f7e32ce7bea5c6full, 0xe4820023a2000000ull //5^44
+	, 0xb35dbf821ae4f38bull, 0xdda2802c8a800000ull //5^45
+	, 0xe0352f62a19e306eull, 0xd50b2037ad200000ull //5^46
+	, 0x8c213d9da502de45ull, 0x4526f422cc340000ull //5^47
+	, 0xaf298d050e4395d6ull, 0x9670b12b7f410000ull //5^48
+	, 0xdaf3f04651d47b4cull, 0x3c0cdd765f114000ull //5^49
+	, 0x88d8762bf324cd0full, 0xa5880a69fb6ac800ull //5^50
+	, 0xab0e93b6efee0053ull, 0x8eea0d047a457a00ull //5^51
+	, 0xd5d238a4abe98068ull, 0x72a4904598d6d880ull //5^52
+	, 0x85a36366eb71f041ull, 0x47a6da2b7f864750ull //5^53
+	, 0xa70c3c40a64e6c51ull, 0x999090b65f67d924ull //5^54
+	, 0xd0cf4b50cfe20765ull, 0xfff4b4e3f741cf6dull //5^55
+	, 0x82818f1281ed449full, 0xbff8f10e7a8921a4ull //5^56
+	, 0xa321f2d7226895c7ull, 0xaff72d52192b6a0dull //5^57
+	, 0xcbea6f8ceb02bb39ull, 0x9bf4f8a69f764490ull //5^58
+	, 0xfee50b7025c36a08ull, 0x02f236d04753d5b4ull //5^59
+	, 0x9f4f2726179a2245ull, 0x01d762422c946590ull //5^60
+	, 0xc722f0ef9d80aad6ull, 0x424d3ad2b7b97ef5ull //5^61
+	, 0xf8ebad2b84e0d58bull, 0xd2e0898765a7deb2ull //5^62
+	, 0x9b934c3b330c8577ull, 0x63cc55f49f88eb2full //5^63
+	, 0xc2781f49ffcfa6d5ull, 0x3cbf6b71c76b25fbull //5^64
+	, 0xf316271c7fc3908aull, 0x8bef464e3945ef7aull //5^65
+	, 0x97edd871cfda3a56ull, 0x97758bf0e3cbb5acull //5^66
+	, 0xbde94e8e43d0c8ecull, 0x3d52eeed1cbea317ull //5^67
+	, 0xed63a231d4c4fb27ull, 0x4ca7aaa863ee4bddull //5^68
+	, 0x945e455f24fb1cf8ull, 0x8fe8caa93e74ef6aull //5^69
+	, 0xb975d6b6ee39e436ull, 0xb3e2fd538e122b44ull //5^70
+	, 0xe7d34c64a9c85d44ull, 0x60dbbca87196b616ull //5^71
+	, 0x90e40fbeea1d3a4aull, 0xbc8955e946fe31cdull //5^72
+	, 0xb51d13aea4a488ddull, 0x6babab6398bdbe41ull //5^73
+	, 0xe264589a4dcdab14ull, 0xc696963c7eed2dd1ull //5^74
+	, 0x8d7eb76070a08aecull, 0xfc1e1de5cf543ca2ull //5^75
+	, 0xb0de65388cc8ada8ull, 0x3b25a55f43294bcbull //5^76
+	, 0xdd15fe86affad912ull, 0x49ef0eb713f39ebeull //5^77
+	, 0x8a2dbf142dfcc7abull, 0x6e3569326c784337ull //5^78
+	, 0xacb92ed9397bf996ull, 0x49c2c37f07965404ull //5^79
+	, 0xd7e77a8f87daf7fbull, 0xdc33745ec97be906ull //5^80
+	, 0x86f0ac99b4e8dafdull, 0x69a028bb3ded71a3ull //5^81
+	, 0xa8acd7c0222311bcull, 0xc40832ea0d68ce0cull //5^82
+	, 0xd2d80db02aabd62bull, 0xf50a3fa490c30190ull //5^83
+	, 0x83c7088e1aab65dbull, 0x792667c6da79e0faull //5^84
+	, 0xa4b8cab1a1563f52ull, 0x577001b891185938ull //5^85
+	, 0xcde6fd5e09abcf26ull, 0xed4c0226b55e6f86ull //5^86
+	, 0x80b05e5ac60b6178ull, 0x544f8158315b05b4ull //5^87
+	, 0xa0dc75f1778e39d6ull, 0x696361ae3db1c721ull //5^88
+	, 0xc913936dd571c84cull, 0x03bc3a19cd1e38e9ull //5^89
+	, 0xfb5878494ace3a5full, 0x04ab48a04065c723ull //5^90
+	, 0x9d174b2dcec0e47bull, 0x62eb0d64283f9c76ull //5^91
+	, 0xc45d1df942711d9aull, 0x3ba5d0bd324f8394ull //5^92
+	, 0xf5746577930d6500ull, 0xca8f44ec7ee36479ull //5^93
+	, 0x9968bf6abbe85f20ull, 0x7e998b13cf4e1ecbull //5^94
+	, 0xbfc2ef456ae276e8ull, 0x9e3fedd8c321a67eull //5^95
+	, 0xefb3ab16c59b14a2ull, 0xc5cfe94ef3ea101eull //5^96
+	, 0x95d04aee3b80ece5ull, 0xbba1f1d158724a12ull //5^97
+	, 0xbb445da9ca61281full, 0x2a8a6e45ae8edc97ull //5^98
+	, 0xea1575143cf97226ull, 0xf52d09d71a3293bdull //5^99
+	, 0x924d692ca61be758ull, 0x593c2626705f9c56ull //5^100
+	, 0xb6e0c377cfa2e12eull, 0x6f8b2fb00c77836cull //5^101
+	, 0xe498f455c38b997aull, 0x0b6dfb9c0f956447ull //5^102
+	, 0x8edf98b59a373fecull, 0x4724bd4189bd5eacull //5^103
+	, 0xb2977ee300c50fe7ull, 0x58edec91ec2cb657ull //5^104
+	, 0xdf3d5e9bc0f653e1ull, 0x2f2967b66737e3edull //5^105
+	, 0x8b865b215899f46cull, 0xbd79e0d20082ee74ull //5^106
+	, 0xae67f1e9aec07187ull, 0xecd8590680a3aa11ull //5^107
+	, 0xda01ee641a708de9ull, 0xe80e6f4820cc9495ull //5^108
+	, 0x884134fe908658b2ull, 0x3109058d147fdcddull //5^109
+	, 0xaa51823e34a7eedeull, 0xbd4b46f0599fd415ull //5^110
+	, 0xd4e5e2cdc1d1ea96ull, 0x6c9e18ac7007c91aull //5^111
+	, 0x850fadc09923329eull, 0x03e2cf6bc604ddb0ull //5^112
+	, 0xa6539930bf6bff45ull, 0x84db8346b786151cull //5^113
+	, 0xcfe87f7cef46ff16ull, 0xe612641865679a63ull //5^114
+	, 0x81f14fae158c5f6eull, 0x4fcb7e8f3f60c07eull //5^115
+	, 0xa26da3999aef7749ull, 0xe3be5e330f38f09dull //5^116
+	, 0xcb090c8001ab551cull, 0x5cadf5bfd3072cc5ull //5^117
+	, 0xfdcb4fa002162a63ull, 0x73d9732fc7c8f7f6ull //5^118
+	, 0x9e9f11c4014dda7eull, 0x2867e7fddcdd9afaull //5^119
+	, 0xc646d63501a1511dull, 0xb281e1fd541501b8ull //5^120
+	, 0xf7d88bc24209a565ull, 0x1f225a7ca91a4226ull //5^121
+	, 0x9ae757596946075full, 0x3375788de9b06958ull //5^122
+	, 0xc1a12d2fc3978937ull, 0x0052d6b1641c83aeull //5^123
+	, 0xf209787bb47d6b84ull, 0xc0678c5dbd23a49aull //5^124
+	, 0x9745eb4d50ce6332ull, 0xf840b7ba963646e0ull //5^125
+	, 0xbd176620a501fbffull, 0xb650e5a93bc3d898ull //5^126
+	, 0xec5d3fa8ce427affull, 0xa3e51f138ab4cebeull //5^127
+	, 0x93ba47c980e98cdfull, 0xc66f336c36b10137ull //5^128
+	, 0xb8a8d9bbe123f017ull, 0xb80b0047445d4184ull //5^129
+	, 0xe6d3102ad96cec1dull, 0xa60dc059157491e5ull //5^130
+	, 0x9043ea1ac7e41392ull, 0x87c89837ad68db2full //5^131
+	, 0xb454e4a179dd1877ull, 0x29babe4598c311fbull //5^132
+	, 0xe16a1dc9d8545e94ull, 0xf4296dd6fef3d67aull //5^133
+	, 0x8ce2529e2734bb1dull, 0x1899e4a65f58660cull //5^134
+	, 0xb01ae745b101e9e4ull, 0x5ec05dcff72e7f8full //5^135
+	, 0xdc21a1171d42645dull, 0x76707543f4fa1f73ull //5^136
+	, 0x899504ae72497ebaull, 0x6a06494a791c53a8ull //5^137
+	, 0xabfa45da0edbde69ull, 0x0487db9d17636892ull //5^138
+	, 0xd6f8d7509292d603ull, 0x45a9d2845d3c42b6ull //5^139
+	, 0x865b86925b9bc5c2ull, 0x0b8a2392ba45a9b2ull //5^140
+	, 0xa7f26836f282b732ull, 0x8e6cac7768d7141eull //5^141
+	, 0xd1ef0244af2364ffull, 0x3207d795430cd926ull //5^142
+	, 0x8335616aed761f1full, 0x7f44e6bd49e807b8ull //5^143
+	, 0xa402b9c5a8d3a6e7ull, 0x5f16206c9c6209a6ull //5^144
+	, 0xcd036837130890a1ull, 0x36dba887c37a8c0full //5^145
+	, 0x802221226be55a64ull, 0xc2494954da2c9789ull //5^146
+	, 0xa02aa96b06deb0fdull, 0xf2db9baa10b7bd6cull //5^147
+	, 0xc83553c5c8965d3dull, 0x6f92829494e5acc7ull //5^148
+	, 0xfa42a8b73abbf48cull, 0xcb772339ba1f17f9ull //5^149
+	, 0x9c69a97284b578d7ull, 0xff2a760414536efbull //5^150
+	, 0xc38413cf25e2d70dull, 0xfef5138519684abaull //5^151
+	, 0xf46518c2ef5b8cd1ull, 0x7eb258665fc25d69ull //5^152
+	, 0x98bf2f79d5993802ull, 0xef2f773ffbd97a61ull //5^153
+	, 0xbeeefb584aff8603ull, 0xaafb550ffacfd8faull //5^154
+	, 0xeeaaba2e5dbf6784ull, 0x95ba2a53f983cf38ull //5^155
+	, 0x952ab45cfa97a0b2ull, 0xdd945a747bf26183ull //5^156
+	, 0xba756174393d88dfull, 0x94f971119aeef9e4ull //5^157
+	, 0xe912b9d1478ceb17ull, 0x7a37cd5601aab85dull //5^158
+	, 0x91abb422ccb812eeull, 0xac62e055c10ab33aull //5^159
+	, 0xb616a12b7fe617aaull, 0x577b986b314d6009ull //5^160
+	, 0xe39c49765fdf9d94ull, 0xed5a7e85fda0b80bull //5^161
+	, 0x8e41ade9fbebc27dull, 0x14588f13be847307ull //5^162
+	, 0xb1d219647ae6b31cull, 0x596eb2d8ae258fc8ull //5^163
+	, 0xde469fbd99a05fe3ull, 0x6fca5f8ed9aef3bbull //5^164
+	, 0x8aec23d680043beeull, 0x25de7bb9480d5854ull //5^165
+	, 0xada72ccc20054ae9ull, 0xaf561aa79a10ae6aull //5^166
+	, 0xd910f7ff28069da4ull, 0x1b2ba1518094da04ull //5^167
+	, 0x87aa9aff79042286ull, 0x90fb44d2f05d0842ull //5^168
+	, 0xa99541bf57452b28ull, 0x353a1607ac744a53ull //5^169
+	, 0xd3fa922f2d1675f2ull, 0x42889b8997915ce8ull //5^170
+	, 0x847c9b5d7c2e09b7ull, 0x69956135febada11ull //5^171
+	, 0xa59bc234db398c25ull, 0x43fab9837e699095ull //5^172
+	, 0xcf02b2c21207ef2eull, 0x94f967e45e03f4bbull //5^173
+	, 0x8161afb94b44f57dull, 0x1d1be0eebac278f5ull //5^174
+	, 0xa1ba1ba79e1632dcull, 0x6462d92a69731732ull //5^175
+	, 0xca28a291859bbf93ull, 0x7d7b8f7503cfdcfeull //5^176
+	, 0xfcb2cb35e702af78ull, 0x5cda735244c3d43eull //5^177
+	, 0x9defbf01b061adabull, 0x3a0888136afa64a7ull //5^178
+	, 0xc56baec21c7a1916ull, 0x088aaa1845b8fdd0ull //5^179
+	, 0xf6c69a72a3989f5bull, 0x8aad549e57273d45ull //5^180
+	, 0x9a3c2087a63f6399ull, 0x36ac54e2f678864bull //5^181
+	, 0xc0cb28a98fcf3c7full, 0x84576a1bb416a7ddull //5^182
+	, 0xf0fdf2d3f3c30b9full, 0x656d44a2a11c51d5ull //5^183
+	, 0x969eb7c47859e743ull, 0x9f644ae5a4b1b325ull //5^184
+	, 0xbc4665b596706114ull, 0x873d5d9f0dde1feeull //5^185
+	, 0xeb57ff22fc0c7959ull, 0xa90cb506d155a7eaull //5^186
+	, 0x9316ff75dd87cbd8ull, 0x09a7f12442d588f2ull //5^187
+	, 0xb7dcbf5354e9beceull, 0x0c11ed6d538aeb2full //5^188
+	, 0xe5d3ef282a242e81ull, 0x8f1668c8a86da5faull //5^189
+	, 0x8fa475791a569d10ull, 0xf96e017d694487bcull //5^190
+	, 0xb38d92d760ec4455ull, 0x37c981dcc395a9acull //5^191
+	, 0xe070f78d3927556aull, 0x85bbe253f47b1417ull //5^192
+	, 0x8c469ab843b89562ull, 0x93956d7478ccec8eull //5^193
+	, 0xaf58416654a6babbull, 0x387ac8d1970027b2ull //5^194
+	, 0xdb2e51bfe9d0696aull, 0x06997b05fcc0319eull //5^195
+	, 0x88fcf317f22241e2ull, 0x441fece3bdf81f03ull //5^196
+	, 0xab3c2fddeeaad25aull, 0xd527e81cad7626c3ull //5^197
+	, 0xd60b3bd56a5586f1ull, 0x8a71e223d8d3b074ull //5^198
+	, 0x85c7056562757456ull, 0xf6872d5667844e49ull //5^199
+	, 0xa738c6bebb12d16cull, 0xb428f8ac016561dbull //5^200
+	, 0xd106f86e69d785c7ull, 0xe13336d701beba52ull //5^201
+	, 0x82a45b450226b39cull, 0xecc0024661173473ull //5^202
+	, 0xa34d721642b06084ull, 0x27f002d7f95d0190ull //5^203
+	, 0xcc20ce9bd35c78a5ull, 0x31ec038df7b441f4ull //5^204
+	, 0xff290242c83396ceull, 0x7e67047175a15271ull //5^205
+	, 0x9f79a169bd203e41ull, 0x0f0062c6e984d386ull //5^206
+	, 0xc75809c42c684dd1ull, 0x52c07b78a3e60868ull //5^207
+	, 0xf92e0c3537826145ull, 0xa7709a56ccdf8a82ull //5^208
+	, 0x9bbcc7a142b17ccbull, 0x88a66076400bb691ull //5^209
+	, 0xc2abf989935ddbfeull, 0x6acff893d00ea435ull //5^210
+	, 0xf356f7ebf83552feull, 0x0583f6b8c4124d43ull //5^211
+	, 0x98165af37b2153deull, 0xc3727a337a8b704aull //5^212
+	, 0xbe1bf1b059e9a8d6ull, 0x744f18c0592e4c5cull //5^213
+	, 0xeda2ee1c7064130cull, 0x1162def06f79df73ull //5^214
+	, 0x9485d4d1c63e8be7ull, 0x8addcb5645ac2ba8ull //5^215
+	, 0xb9a74a0637ce2ee1ull, 0x6d953e2bd7173692ull //5^216
+	, 0xe8111c87c5c1ba99ull, 0xc8fa8db6ccdd0437ull //5^217
+	, 0x910ab1d4db9914a0ull, 0x1d9c9892400a22a2ull //5^218
+	, 0xb54d5e4a127f59c8ull, 0x2503beb6d00cab4bull //5^219
+	, 0xe2a0b5dc971f303aull, 0x2e44ae64840fd61dull //5^220
+	, 0x8da471a9de737e24ull, 0x5ceaecfed289e5d2ull //5^221
+	, 0xb10d8e1456105dadull, 0x7425a83e872c5f47ull //5^222
+	, 0xdd50f1996b947518ull, 0xd12f124e28f77719ull //5^223
+	, 0x8a5296ffe33cc92full, 0x82bd6b70d99aaa6full //5^224
+	, 0xace73cbfdc0bfb7bull, 0x636cc64d1001550bull //5^225
+	, 0xd8210befd30efa5aull, 0x3c47f7e05401aa4eull //5^226
+	, 0x8714a775e3e95c78ull, 0x65acfaec34810a71ull //5^227
+	, 0xa8d9d1535ce3b396ull, 0x7f1839a741a14d0dull //5^228
+	, 0xd31045a8341ca07cull, 0x1ede48111209a050ull //5^229
+	, 0x83ea2b892091e44dull, 0x934aed0aab460432ull //5^230
+	, 0xa4e4b66b68b65d60ull, 0xf81da84d5617853full //5^231
+	, 0xce1de40642e3f4b9ull, 0x36251260ab9d668eull //5^232
+	, 0x80d2ae83e9ce78f3ull, 0xc1d72b7c6b426019ull //5^233
+	, 0xa1075a24e4421730ull, 0xb24cf65b8612f81full //5^234
+	, 0xc94930ae1d529cfcull, 0xdee033f26797b627ull //5^235
+	, 0xfb9b7cd9a4a7443cull, 0x169840ef017da3b1ull //5^236
+	, 0x9d412e0806e88aa5ull, 0x8e1f289560ee864eull //5^237
+	, 0xc491798a08a2ad4eull, 0xf1a6f2bab92a27e2ull //5^238
+	, 0xf5b5d7ec8acb58a2ull, 0xae10af696774b1dbull //5^239
+	, 0x9991a6f3d6bf1765ull, 0xacca6da1e0a8ef29ull //5^240
+	, 0xbff610b0cc6edd3full, 0x17fd090a58d32af3ull //5^241
+	, 0xeff394dcff8a948eull, 0xddfc4b4cef07f5b0ull //5^242
+	, 0x95f83d0a1fb69cd9ull, 0x4abdaf101564f98eull //5^243
+	, 0xbb764c4ca7a4440full, 0x9d6d1ad41abe37f1ull //5^244
+	, 0xea53df5fd18d5513ull, 0x84c86189216dc5edull //5^245
+	, 0x92746b9be2f8552cull, 0x32fd3cf5b4e49bb4ull //5^246
+	, 0xb7118682dbb66a77ull, 0x3fbc8c33221dc2a1ull //5^247
+	, 0xe4d5e82392a40515ull, 0x0fabaf3feaa5334aull //5^248
+	, 0x8f05b1163ba6832dull, 0x29cb4d87f2a7400eull //5^249
+	, 0xb2c71d5bca9023f8ull, 0x743e20e9ef511012ull //5^250
+	, 0xdf78e4b2bd342cf6ull, 0x914da9246b255416ull //5^251
+	, 0x8bab8eefb6409c1aull, 0x1ad089b6c2f7548eull //5^252
+	, 0xae9672aba3d0c320ull, 0xa184ac2473b529b1ull //5^253
+	, 0xda3c0f568cc4f3e8ull, 0xc9e5d72d90a2741eull //5^254
+	, 0x8865899617fb1871ull, 0x7e2fa67c7a658892ull //5^255
+	, 0xaa7eebfb9df9de8dull, 0xddbb901b98feeab7ull //5^256
+	, 0xd51ea6fa85785631ull, 0x552a74227f3ea565ull //5^257
+	, 0x8533285c936b35deull, 0xd53a88958f87275full //5^258
+	, 0xa67ff273b8460356ull, 0x8a892abaf368f137ull //5^259
+	, 0xd01fef10a657842cull, 0x2d2b7569b0432d85ull //5^260
+	, 0x8213f56a67f6b29bull, 0x9c3b29620e29fc73ull //5^261
+	, 0xa298f2c501f45f42ull, 0x8349f3ba91b47b8full //5^262
+	, 0xcb3f2f7642717713ull, 0x241c70a936219a73ull //5^263
+	, 0xfe0efb53d30dd4d7ull, 0xed238cd383aa0110ull //5^264
+	, 0x9ec95d1463e8a506ull, 0xf4363804324a40aaull //5^265
+	, 0xc67bb4597ce2ce48ull, 0xb143c6053edcd0d5ull //5^266
+	, 0xf81aa16fdc1b81daull, 0xdd94b7868e94050aull //5^267
+	, 0x9b10a4e5e9913128ull, 0xca7cf2b4191c8326ull //5^268
+	, 0xc1d4ce1f63f57d72ull, 0xfd1c2f611f63a3f0ull //5^269
+	, 0xf24a01a73cf2dccfull, 0xbc633b39673c8cecull //5^270
+	, 0x976e41088617ca01ull, 0xd5be0503e085d813ull //5^271
+	, 0xbd49d14aa79dbc82ull, 0x4b2d8644d8a74e18ull //5^272
+	, 0xec9c459d51852ba2ull, 0xddf8e7d60ed1219eull //5^273
+	, 0x93e1ab8252f33b45ull, 0xcabb90e5c942b503ull //5^274
+	, 0xb8da1662e7b00a17ull, 0x3d6a751f3b936243ull //5^275
+	, 0xe7109bfba19c0c9dull, 0x0cc512670a783ad4ull //5^276
+	, 0x906a617d450187e2ull, 0x27fb2b80668b24c5ull //5^277
+	, 0xb484f9dc9641e9daull, 0xb1f9f660802dedf6ull //5^278
+	, 0xe1a63853bbd26451ull, 0x5e7873f8a0396973ull //5^279
+	, 0x8d07e33455637eb2ull, 0xdb0b487b6423e1e8ull //5^280
+	, 0xb049dc016abc5e5full, 0x91ce1a9a3d2cda62ull //5^281
+	, 0xdc5c5301c56b75f7ull, 0x7641a140cc7810fbull //5^282
+	, 0x89b9b3e11b6329baull, 0xa9e904c87fcb0a9dull //5^283
+	, 0xac2820d9623bf429ull, 0x546345fa9fbdcd44ull //5^284
+	, 0xd732290fbacaf133ull, 0xa97c177947ad4095ull //5^285
+	, 0x867f59a9d4bed6c0ull, 0x49ed8eabcccc485dull //5^286
+	, 0xa81f301449ee8c70ull, 0x5c68f256bfff5a74ull //5^287
+	, 0xd226fc195c6a2f8cull, 0x73832eec6fff3111ull //5^288
+	, 0x83585d8fd9c25db7ull, 0xc831fd53c5ff7eabull //5^289
+	, 0xa42e74f3d032f525ull, 0xba3e7ca8b77f5e55ull //5^290
+	, 0xcd3a1230c43fb26full, 0x28ce1bd2e55f35ebull //5^291
+	, 0x80444b5e7aa7cf85ull, 0x7980d163cf5b81b3ull //5^292
+	, 0xa0555e361951c366ull, 0xd7e105bcc332621full //5^293
+	, 0xc86ab5c39fa63440ull, 0x8dd9472bf3fefaa7ull //5^294
+	, 0xfa856334878fc150ull, 0xb14f98f6f0feb951ull //5^295
+	, 0x9c935e00d4b9d8d2ull, 0x6ed1bf9a569f33d3ull //5^296
+	, 0xc3b8358109e84f07ull, 0x0a862f80ec4700c8ull //5^297
+	, 0xf4a642e14c6262c8ull, 0xcd27bb612758c0faull //5^298
+	, 0x98e7e9cccfbd7dbdull, 0x8038d51cb897789cull //5^299
+	, 0xbf21e44003acdd2cull, 0xe0470a63e6bd56c3ull //5^300
+	, 0xeeea5d5004981478ull, 0x1858ccfce06cac74ull //5^301
+	, 0x95527a5202df0ccbull, 0x0f37801e0c43ebc8ull //5^302
+	, 0xbaa718e68396cffdull, 0xd30560258f54e6baull //5^303
+	, 0xe950df20247c83fdull, 0x47c6b82ef32a2069ull //5^304
+	, 0x91d28b7416cdd27eull, 0x4cdc331d57fa5441ull //5^305
+	, 0xb6472e511c81471dull, 0xe0133fe4adf8e952ull //5^306
+	, 0xe3d8f9e563a198e5ull, 0x58180fddd97723a6ull //5^307
+	, 0x8e679c2f5e44ff8full, 0x570f09eaa7ea7648ull //5^308
+};
+
+static const double number_exact_power10[]=
+{
+	1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+	1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+};
+
+/**
+* 126-bit approximations g of 10^-k for k in [-324,292], as (g >> 63, g & (2^63-1)) pairs,
+* where 10^-k = b 2^r with 2^125 <= b < 2^126 and g = floor(b) + 1.
+*/
+static const uint64_t number_power10_g[]=
+{
+	  0x4f0cedc95a718dd4ull, 0x5b01e8b09aa0d1b5ull //10^324
+	, 0x7e7b160ef71c1621ull, 0x119ca780f767b5eeull //10^323
+	, 0x652f44d8c5b011b4ull, 0x0e16ec672c52f7f2ull //10^322
+	, 0x50f29d7a37c00e29ull, 0x581256b8f0425ff5ull //10^321
+	, 0x40c21794f96671baull, 0x79a84560c0351991ull //10^320
+	, 0x679cf287f570b5f7ull, 0x75da089acd21c281ull //10^319
+	, 0x52e3f5399126f7f9ull, 0x44ae6d48a41b0201ull //10^318
+	, 0x424ff76140ebf994ull, 0x36f1f106e9af34cdull //10^317
+	, 0x6a198bcece465c20ull, 0x57e981a4a918547bull //10^316
+	, 0x54e13ca571d1e34dull, 0x2cbace1d541376c9ull //10^315
+	, 0x43e763b78e4182a4ull, 0x23c8a4e44342c56eull //10^314
+	, 0x6ca56c58e39c043aull, 0x060dd4a06b9e08b0ull //10^313
+	, 0x56eabd13e9499cfbull, 0x1e7176e6bc7e6d59ull //10^312
+	, 0x458897432107b0c8ull, 0x7ec12bebc9febde1ull //10^311
+	, 0x6f40f20501a5e7a7ull, 0x7e01dfdfa9979635ull //10^310
+	, 0x5900c19d9aeb1fb9ull, 0x4b34b319547944f7ull //10^309
+	, 0x4733ce17af227fc7ull, 0x55c3c27aa9fa9d93ull //10^308
+	, 0x71ec7cf2b1d0cc72ull, 0x560603f7765dc8eaull //10^307
+	, 0x5b2397288e40a38eull, 0x7804cff92b7e3a55ull //10^306
+	, 0x48e945ba0b66e93full, 0x13370cc755fe9511ull //10^305
+	, 0x74a86f90123e41feull, 0x51f1ae0bbcca881bull //10^304
+	, 0x5d538c7341cb67feull, 0x74c1580963d539afull //10^303
+	, 0x4aa93d29016f8665ull, 0x43cde0078310faf3ull //10^302
+	, 0x77752ea8024c0a3cull, 0x0616333f381b2b1eull //10^301
+	, 0x5f90f22001d66e96ull, 0x3811c298f9af55b1ull //10^300
+	, 0x4c73f4e667debedeull, 0x600e35472e25de28ull //10^299
+	, 0x7a532170a6313164ull, 0x3349eed849d6303full //10^298
+	, 0x61dc1ac084f42783ull, 0x42a18be03b11c033ull //10^297
+	, 0x4e49af006a5cec69ull, 0x1bb46fe695a7ccf5ull //10^296
+	, 0x7d42b19a43c7e0a8ull, 0x2c53e63dbc3fae55ull //10^295
+	, 0x64355ae1cfd31a20ull, 0x237651cafcffbeaaull //10^294
+	, 0x502aaf1b0ca8e1b3ull, 0x35f8416f30cc9888ull //10^293
+	, 0x402225af3d53e7c2ull, 0x5e603458f3d6e06dull //10^292
+	, 0x669d0918621fd937ull, 0x4a3386f4b957cd7bull //10^291
+	, 0x52173a79e8197a92ull, 0x6e8f9f2a2ddfd796ull //10^290
+	, 0x41ac2ec7ece12edbull, 0x720c7f54f17fdfabull //10^289
+	, 0x69137e0cae3517c6ull, 0x1ce0cbbb1bffcc45ull //10^288
+	, 0x540f980a24f74638ull, 0x171a3c95afffd69eull //10^287
+	, 0x433facd4ea5f6b60ull, 0x127b63aaf3331218ull //10^286
+	, 0x6b991487dd657899ull, 0x6a5f05de51eb5026ull //10^285
+	, 0x5614106cb11dfa14ull, 0x5518d17ea7ef7352ull //10^284
+	, 0x44dcd9f08db194ddull, 0x2a7a41321ff2c2a8ull //10^283
+	, 0x6e2e2980e2b5bafbull, 0x5d906850331e043full //10^282
+	, 0x5824ee00b55e2f2full, 0x647386a68f4b3699ull //10^281
+	, 0x4683f19a2ab1bf59ull, 0x36c2d21ed908f87bull //10^280
+	, 0x70d31c29dde93228ull, 0x579e1cfe280e5a5dull //10^279
+	, 0x5a427cee4b20f4edull, 0x2c7e7d98200b7b7eull //10^278
+	, 0x483530bea280c3f1ull, 0x09fecae019a2c932ull //10^277
+	, 0x73884dfdd0ce064eull, 0x43314499c29e0eb6ull //10^276
+	, 0x5c6d0b3173d8050bull, 0x4f5a9d47cee4d891ull //10^275
+	, 0x49f0d5c129799da2ull, 0x72aee4397250ad41ull //10^274
+	, 0x764e22cea8c295d1ull, 0x377e39f583b44868ull //10^273
+	, 0x5ea4e8a553cede41ull, 0x12cb61913629d387ull //10^272
+	, 0x4bb72084430be500ull, 0x756f8140f8217605ull //10^271
+	, 0x792500d39e796e67ull, 0x6f18cece59cf233cull //10^270
+	, 0x60ea670fb1fabeb9ull, 0x3f470bd847d8e8fdull //10^269
+	, 0x4d885272f4c89894ull, 0x329f3cad064720caull //10^268
+	, 0x7c0d50b7ee0dc0edull, 0x37652de1a3a50143ull //10^267
+	, 0x633dda2cbe716724ull, 0x2c50f1814fb73436ull //10^266
+	, 0x4f64ae8a31f45283ull, 0x3d0d8e010c92902bull //10^265
+	, 0x7f077da9e986ea6bull, 0x7b48e334e0ea8045ull //10^264
+	, 0x659f97bb2138bb89ull, 0x49071c2a4d88669dull //10^263
+	, 0x514c796280fa2fa1ull, 0x20d27ceea46d1ee4ull //10^262
+	, 0x4109fab533fb594dull, 0x670eca58838a7f1dull //10^261
+	, 0x680ff788532bc216ull, 0x0b4add5a6c10cb62ull //10^260
+	, 0x533ff939dc2301abull, 0x22a24aaebcda3c4eull //10^259
+	, 0x4299942e49b59aefull, 0x354ea22563e1c9d8ull //10^258
+	, 0x6a8f537d42bc2b18ull, 0x554a9d089fcfa95aull //10^257
+	, 0x553f75fdcefcef46ull, 0x776ee406e63fbaaeull //10^256
+	, 0x4432c4cb0bfd8c38ull, 0x5f8be99f1e996225ull //10^255
+	, 0x6d1e07ab466279f4ull, 0x327975cb64289d08ull //10^254
+	, 0x574b3955d1e86190ull, 0x28612b091ced4a6dull //10^253
+	, 0x45d5c777db204e0dull, 0x06b4226db0bdd524ull //10^252
+	, 0x6fbc72595e9a167bull, 0x24536a491ac95506ull //10^251
+	, 0x59638eade54811fcull, 0x1d0f883a7bd44405ull //10^250
+	, 0x4782d88b1dd34196ull, 0x4a72d361fca9d004ull //10^249
+	, 0x726af411c952028aull, 0x43eaebcffaa94cd3ull //10^248
+	, 0x5b88c3416ddb353bull, 0x4fef230cc88770a9ull //10^247
+	, 0x493a35cdf17c2a96ull, 0x0cbf4f3d6d3926eeull //10^246
+	, 0x7529efafe8c6aa89ull, 0x61321862485b717cull //10^245
+	, 0x5dbb262653d22207ull, 0x675b46b506af8dfdull //10^244
+	, 0x4afc1e850fdb4e6cull, 0x52af6bc405593e64ull //10^243
+	, 0x77f9ca6e7fc54a47ull, 0x377f12d33bc1fd6dull //10^242
+	, 0x5ffb085866376e9full, 0x45ff42429634cabdull //10^241
+	, 0x4cc8d379eb5f8bb2ull, 0x6b329b68782a3bcbull //10^240
+	, 0x7adaebf64565ac51ull, 0x2b842bda59dd2c77ull //10^239
+	, 0x6248bcc5045156a7ull, 0x3c69bcaeae4a89f9ull //10^238
+	, 0x4ea0970403744552ull, 0x6387ca25583ba194ull //10^237
+	, 0x7dcdbe6cd253a21eull, 0x05a6103bc05f68edull //10^236
+	, 0x64a498570ea94e7eull, 0x37b80cfc99e5ed8aull //10^235
+	, 0x5083ad1272210b98ull, 0x2c933d96e184be08ull //10^234
+	, 0x40695741f4e73c79ull, 0x7075cadf1ad09807ull //10^233
+	, 0x670ef2032171fa5cull, 0x4d8944982ae759a4ull //10^232
+	, 0x52725b35b45b2eb0ull, 0x3e076a135585e150ull //10^231
+	, 0x41f515c49048f226ull, 0x64d2bb42aad1810dull //10^230
+	, 0x698822d41a0e503eull, 0x07b7920444826815ull //10^229
+	, 0x546ce8a9ae71d9cbull, 0x1fc60e69d0685344ull //10^228
+	, 0x438a53baf1f4ae3cull, 0x196b3ebb0d20429dull //10^227
+	, 0x6c1085f7e9877d2dull, 0x0f11fdf815006a94ull //10^226
+	, 0x56739e5fee05fdbdull, 0x58db319344005543ull //10^225
+	, 0x45294b7ff19e6497ull, 0x60af5adc3666aa9cull //10^224
+	, 0x6ea878ccb5ca3a8cull, 0x344bc4938a3dddc7ull //10^223
+	, 0x5886c70a2b082ed6ull, 0x5d096a0fa1cb17d2ull //10^222
+	, 0x46d238d4ef39bf12ull, 0x173abb3fb4a27975ull //10^221
+	, 0x71505aee4b8f981dull, 0x0b912b992103f588ull //10^220
+	, 0x5aa6af25093face4ull, 0x0940efadb4032ad3ull //10^219
+	, 0x488558ea6dcc8a50ull, 0x07672624900288a9ull //10^218
+	, 0x74088e43e2e0dd4cull, 0x723ea36db337410eull //10^217
+	, 0x5cd3a5031be71770ull, 0x5b654f8af5c5cda5ull //10^216
+	, 0x4a42ea68e31f45f3ull, 0x62b772d5916b0aebull //10^215
+	, 0x76d1770e38320986ull, 0x0458b7bc1bde77ddull //10^214
+	, 0x5f0df8d82cf4d46bull, 0x1d13c630164b9318ull //10^213
+	, 0x4c0b2d79bd90a9efull, 0x30dc9e8cdea2dc13ull //10^212
+	, 0x79ab7bf5fc1aa97full, 0x0160fdae31049351ull //10^211
+	, 0x6155fcc4c9aeedffull, 0x1ab3fe24f403a90eull //10^210
+	, 0x4dde63d0a158be65ull, 0x6229981d9002eda5ull //10^209
+	, 0x7c97061a9bc130a2ull, 0x69dc2695b337e2a1ull //10^208
+	, 0x63ac04e2163426e8ull, 0x54b01ede28f9821bull //10^207
+	, 0x4fbcd0b4de901f20ull, 0x43c018b1ba6134e2ull //10^206
+	, 0x7f9481216419cb67ull, 0x1f99c11c5d68549dull //10^205
+	, 0x6610674de9ae3c52ull, 0x4c7b00e37ded107eull //10^204
+	, 0x51a6b90b21583042ull, 0x09fc00b5fe574065ull //10^203
+	, 0x41522da2811359ceull, 0x3b3000919845cd1dull //10^202
+	, 0x68837c3734ebc2e3ull, 0x784ccdb5c06fae95ull //10^201
+	, 0x539c635f5d8968b6ull, 0x2d0a3e2b00595877ull //10^200
+	, 0x42e382b2b13aba2bull, 0x3da1cb5599e11393ull //10^199
+	, 0x6b059deab52ac378ull, 0x629c7888f634ec1eull //10^198
+	, 0x559e17eef755692dull, 0x3549fa072b5d89b1ull //10^197
+	, 0x447e798bf91120f1ull, 0x1107fb38ef7e07c1ull //10^196
+	, 0x6d9728dff4e834b5ull, 0x01a65ec17f300c68ull //10^195
+	, 0x57ac20b32a535d5dull, 0x4e1eb23465c009edull //10^194
+	, 0x46234d5c21dc4ab1ull, 0x24e55b5d1e333b24ull //10^193
+	, 0x70387bc69c93aab5ull, 0x216ef894fd1ec506ull //10^192
+	, 0x59c6c96bb076222aull, 0x4df2607730e56a6cull //10^191
+	, 0x47d23abc8d2b4e88ull, 0x3e5b805f5a5121f0ull //10^190
+	, 0x72e9f79415121740ull, 0x63c59a322a1b697full //10^189
+	, 0x5bee5fa9aa74df67ull, 0x03047b5b54e2baccull //10^188
+	, 0x498b7fbaeec3e5ecull, 0x0269fc4910b5623dull //10^187
+	, 0x75abff917e063cacull, 0x6a432d41b45569fbull //10^186
+	, 0x5e2332dacb38308aull, 0x21cf5767c37787fcull //10^185
+	, 0x4b4f5be23c2cf3a1ull, 0x67d912b9692c6ccaull //10^184
+	, 0x787ef969f9e185cfull, 0x595b5128a8471476ull //10^183
+	, 0x60659454c7e79e3full, 0x6115da86ed05a9f8ull //10^182
+	, 0x4d1e1043d31fb1ccull, 0x4dab1538bd9e2193ull //10^181
+	, 0x7b634d3951cc4fadull, 0x62ab552795c9cf52ull //10^180
+	, 0x62b5d7610e3d0c8bull, 0x0222aa86116e3f75ull //10^179
+	, 0x4ef7df80d830d6d5ull, 0x4e822204dabe992aull //10^178
+	, 0x7e59659af38157bcull, 0x17369cd49130f510ull //10^177
+	, 0x65145148c2cddfc9ull, 0x5f5ee3dd40f3f740ull //10^176
+	, 0x50dd0dd3cf0b196eull, 0x1918b64a9a5cc5cdull //10^175
+	, 0x40b0d7dca5a27abeull, 0x4746f83baeb09e3eull //10^174
+	, 0x678159610903f797ull, 0x253e59f91780fd2full //10^173
+	, 0x52cde11a6d9cc612ull, 0x50feae60df9a6426ull //10^172
+	, 0x423e4daebe1704dbull, 0x5a65584d7faeb685ull //10^171
+	, 0x69fd4917968b3af9ull, 0x10a226e265e4573bull //10^170
+	, 0x54caa0dfaba29594ull, 0x0d4e8581eb1d1295ull //10^169
+	, 0x43d54d7fbc821143ull, 0x243ed134bc174211ull //10^168
+	, 0x6c887bff94034ed2ull, 0x06cae85460253682ull //10^167
+	, 0x56d396661002a574ull, 0x6bd586a9e6842b9bull //10^166
+	, 0x457611eb40021df7ull, 0x09779eee52035616ull //10^165
+	, 0x6f234fdeccd02ff1ull, 0x5bf297e3b66bbcefull //10^164
+	, 0x58e90cb23d73598eull, 0x165bacb62b8963f3ull //10^163
+	, 0x4720d6f4fdf5e13eull, 0x451623c4efa11cc2ull //10^162
+	, 0x71ce24bb2fefcecaull, 0x3b569fa17f682e03ull //10^161
+	, 0x5b0b5095bff30bd5ull, 0x15dee61acc535803ull //10^160
+	, 0x48d5da11665c0977ull, 0x2b18b8157042accfull //10^159
+	, 0x74895ce8a3c6758bull, 0x5e8df355806aae18ull //10^158
+	, 0x5d3ab0ba1c9ec46full, 0x653e5c4466bbbe7aull //10^157
+	, 0x4a955a2e7d4bd059ull, 0x3765169d1efc9861ull //10^156
+	, 0x77555d172edfb3c2ull, 0x256e8a94fe60f3cfull //10^155
+	, 0x5f777dac257fc301ull, 0x6abed543feb3f63full //10^154
+	, 0x4c5f97bceacc9c01ull, 0x3bcbddcffef65e99ull //10^153
+	, 0x7a328c6177adc668ull, 0x5fac961997f0975bull //10^152
+	, 0x61c209e792f16b86ull, 0x7fbd44e1465a12afull //10^151
+	, 0x4e34d4b9425abc6bull, 0x7fca9d810514dbbfull //10^150
+	, 0x7d21545b9d5dfa46ull, 0x32ddc8ce6e87c5ffull //10^149
+	, 0x641aa9e2e44b2e9eull, 0x5be4a0a525396b32ull //10^148
+	, 0x501554b5836f587eull, 0x7cb6e6ea842def5cull //10^147
+	, 0x4011109135f2ad32ull, 0x30925255368b25e3ull //10^146
+	, 0x6681b41b89844850ull, 0x4db6ea21f0dea304ull //10^145
+	, 0x52015ce2d469d373ull, 0x57c5881b2718826aull //10^144
+	, 0x419ab0b576bb0f8full, 0x5fd139af527a01efull //10^143
+	, 0x68f781225791b27full, 0x4c81f5e550c3364aull //10^142
+	, 0x53f9341b79415b99ull, 0x239b2b1dda35c508ull //10^141
+	, 0x432dc3492dcde2e1ull, 0x02e288e4ae916a6dull //10^140
+	, 0x6b7c6ba849496b01ull, 0x516a74a1174f10aeull //10^139
+	, 0x55fd22ed076def34ull, 0x4121f6e745d8da25ull //10^138
+	, 0x44ca82573924bf5dull, 0x1a8192529e4714ebull //10^137
+	, 0x6e10d08b8ea1322eull, 0x5d9c1d50fd3e87ddull //10^136
+	, 0x580d73a2d880f4f2ull, 0x17b01773fdcb9fe4ull //10^135
+	, 0x4671294f139a5d8eull, 0x4626792997d61984ull //10^134
+	, 0x70b50ee4ec2a2f4aull, 0x3d0a5b75bfbcf59full //10^133
+	, 0x5a2a7250bcee8c3bull, 0x4a6eaf916630c47full //10^132
+	, 0x4821f50d63f209c9ull, 0x21f2260deb5a36ccull //10^131
+	, 0x736988156cb6760eull, 0x69837016455d247aull //10^130
+	, 0x5c546cddf091f80bull, 0x6e02c011d1175062ull //10^129
+	, 0x49dd23e4c074c66full, 0x719bccdb0dac404eull //10^128
+	, 0x762e9fd467213d7full, 0x68f947c4e2ad33b0ull //10^127
+	, 0x5e8bb3105280fdffull, 0x6d94396a4ef0f627ull //10^126
+	, 0x4ba2f5a6a8673199ull, 0x3e102deea58d91b9ull //10^125
+	, 0x7904bc3dda3eb5c2ull, 0x3019e3176f48e927ull //10^124
+	, 0x60d09697e1cbc49bull, 0x4014b5ac590720ecull //10^123
+	, 0x4d73abacb4a303afull, 0x4cdd5e237a6c1a57ull //10^122
+	, 0x7bec45e12104d2b2ull, 0x47c8969f2a46908aull //10^121
+	, 0x63236b1a80d0a88eull, 0x6ca0787f5505406full //10^120
+	, 0x4f4f88e200a6ed3full, 0x0a19f9ff773766bfull //10^119
+	, 0x7ee5a7d0010b1531ull, 0x5cf65ccbf1f23dfeull //10^118
+	, 0x6584864000d5aa8eull, 0x172b7d6ff4c1cb32ull //10^117
+	, 0x5136d1cccd77bba4ull, 0x78ef978cc3ce3c28ull //10^116
+	, 0x40f8a7d70ac62fb7ull, 0x13f2dfa3cfd83020ull //10^115
+	, 0x67f43fbe77a37f8bull, 0x398499061959e699ull //10^114
+	, 0x5329cc985fb5ffa2ull, 0x6136e0d1ade18548ull //10^113
+	, 0x4287d6e04c91994full, 0x00f8b3daf181376dull //10^112
+	, 0x6a72f166e0e8f54bull, 0x1b27862b1c01f247ull //10^111
+	, 0x5528c11f1a53f76full, 0x2f52d1bc1667f506ull //10^110
+	, 0x44209a7f48432c59ull, 0x0c424163451ff738ull //10^109
+	, 0x6d00f7320d3846f4ull, 0x7a039bd208332526ull //10^108
+	, 0x5733f8f4d76038c3ull, 0x7b361641a028ea85ull //10^107
+	, 0x45c32d90ac4cfa36ull, 0x2f5e78348020bb9eull //10^106
+	, 0x6f9eaf4de07b29f0ull, 0x4bca59ed99cdf8fcull //10^105
+	, 0x594bbf71806287f3ull, 0x563b7b247b0b2d96ull //10^104
+	, 0x476fcc5acd1b9ff6ull, 0x11c92f50626f57acull //10^103
+	, 0x724c7a2ae1c5ccbdull, 0x02db7ee703e55912ull //10^102
+	, 0x5b7061bbe7d17097ull, 0x1be2cbec031de0dcull //10^101
+	, 0x4926b496530df3acull, 0x164f09899c17e716ull //10^100
+	, 0x750aba8a1e7cb913ull, 0x3d4b4275c68ca4f0ull //10^99
+	, 0x5da22ed4e530940full, 0x4aa29b916ba3b726ull //10^98
+	, 0x4ae825771dc07672ull, 0x6ee87c74561c9285ull //10^97
+	, 0x77d9d58b62cd8a51ull, 0x3173fa53bcfa8408ull //10^96
+	, 0x5fe177a2b5713b74ull, 0x278ffb7630c869a0ull //10^95
+	, 0x4cb45fb55df42f90ull, 0x1fa662c4f3d387b3ull //10^94
+	, 0x7aba32bbc986b280ull, 0x32a3d13b1fb8d91full //10^93
+	, 0x622e8efca1388ecdull, 0x0ee9742f4c93e0e6ull //10^92
+	, 0x4e8ba596e760723dull, 0x58bac3590a0fe71eull //10^91
+	, 0x7dac3c24a5671d2full, 0x412ad228101971c9ull //10^90
+	, 0x6489c9b6eab8e426ull, 0x00ef0e8673478e3bull //10^89
+	, 0x506e3af8bbc71cebull, 0x1a58d86b8f6c71c9ull //10^88
+	, 0x40582f2d6305b0bcull, 0x1513e0560c56c16eull //10^87
+	, 0x66f37eaf04d5e793ull, 0x3b530089ad579be2ull //10^86
+	, 0x525c6558d0ab1fa9ull, 0x15dc006e2446164full //10^85
+	, 0x41e384470d55b2edull, 0x5e4999f1b69e783full //10^84
+	, 0x696c06d81555eb15ull, 0x7d428fe92430c065ull //10^83
+	, 0x54566be0111188deull, 0x31020cba835a3384ull //10^82
+	, 0x4378564cda746d7eull, 0x5a680a2ecf7b5c69ull //10^81
+	, 0x6bf3bd47c3ed7bfdull, 0x770cdd17b25efa42ull //10^80
+	, 0x565c976c9cbdfccbull, 0x1270b0dfc1e59502ull //10^79
+	, 0x4516df8a16fe63d5ull, 0x5b8d5a4c9b1e10ceull //10^78
+	, 0x6e8aff4357fd6c89ull, 0x127bc3adc4fce7b0ull //10^77
+	, 0x586f329c466456d4ull, 0x0ec96957d0ca52f3ull //10^76
+	, 0x46bf5bb038504576ull, 0x3f07877973d50f29ull //10^75
+	, 0x71322c4d26e6d58aull, 0x31a5a58f1fbb4b75ull //10^74
+	, 0x5a8e89d75252446eull, 0x5aeaead8e62f6f91ull //10^73
+	, 0x487207df750e9d25ull, 0x2f22557a51bf8c74ull //10^72
+	, 0x73e9a63254e42ea2ull, 0x1836ef2a1c65ad86ull //10^71
+	, 0x5cbaeb5b771cf21bull, 0x2cf8bf54e3848ad2ull //10^70
+	, 0x4a2f22af927d8e7cull, 0x23fa32aa4f9d3bdbull //10^69
+	, 0x76b1d118ea627d93ull, 0x5329eaaa18fb92f8ull //10^68
+	, 0x5ef4a74721e86476ull, 0x0f54bbbb472fa8c6ull //10^67
+	, 0x4bf6ec38e7ed1d2bull, 0x25dd62fc38f2ed6cull //10^66
+	, 0x798b138e3fe1c845ull, 0x22fbd1938e517bdfull //10^65
+	, 0x613c0fa4ffe7d36aull, 0x4f2fdadc71dac97full //10^64
+	, 0x4dc9a61d998642bbull, 0x58f3157d27e23accull //10^63
+	, 0x7c75d695c2706ac5ull, 0x74b82261d969f7adull //10^62
+	, 0x63917877cec0556bull, 0x10934eb4adee5fbeull //10^61
+	, 0x4fa793930bcd1122ull, 0x4075d8908b251965ull //10^60
+	, 0x7f7285b812e1b504ull, 0x00bc8db411d4f56eull //10^59
+	, 0x65f537c675815d9cull, 0x66fd3e29a7dd9125ull //10^58
+	, 0x5190f96b91344ae3ull, 0x6bfdcb54864ada84ull //10^57
+	, 0x4140c78940f6a24full, 0x6ffe3c439ea2486aull //10^56
+	, 0x6867a5a867f103b2ull, 0x7ffd2d38fdd073dcull //10^55
+	, 0x53861e2053273628ull, 0x6664242d97d9f64aull //10^54
+	, 0x42d1b1b375b8f820ull, 0x51e9b68adfe191d5ull //10^53
+	, 0x6ae91c5255f4c034ull, 0x1ca924116635b621ull //10^52
+	, 0x558749db77f70029ull, 0x63ba83411e915e81ull //10^51
+	, 0x446c3b15f9926687ull, 0x6962029a7edab201ull //10^50
+	, 0x6d79f82328ea3da6ull, 0x0f03375d97c45001ull //10^49
+	, 0x5794c6828721caebull, 0x259c2c4adfd04001ull //10^48
+	, 0x46109eced2816f22ull, 0x5149bd08b30d0001ull //10^47
+	, 0x701a97b150cf1837ull, 0x3542c80deb480001ull //10^46
+	, 0x59aedfc10d7279c5ull, 0x7768a00b22a00001ull //10^45
+	, 0x47bf19673df52e37ull, 0x79208008e8800001ull //10^44
+	, 0x72cb5bd86321e38cull, 0x5b67334174000001ull //10^43
+	, 0x5bd5e313828182d6ull, 0x7c528f6790000001ull //10^42
+	, 0x4977e8dc68679bdfull, 0x16a872b940000001ull //10^41
+	, 0x758ca7c70d7292feull, 0x5773eac200000001ull //10^40
+	, 0x5e0a1fd271287598ull, 0x45f6556800000001ull //10^39
+	, 0x4b3b4ca85a86c47aull, 0x04c5112000000001ull //10^38
+	, 0x785ee10d5da46d90ull, 0x07a1b50000000001ull //10^37
+	, 0x604be73de4838ad9ull, 0x52e7c40000000001ull //10^36
+	, 0x4d0985cb1d3608aeull, 0x0f1fd00000000001ull //10^35
+	, 0x7b426fab61f00de3ull, 0x31cc800000000001ull //10^34
+	, 0x629b8c891b267182ull, 0x5b0a000000000001ull //10^33
+	, 0x4ee2d6d415b85aceull, 0x7c08000000000001ull //10^32
+	, 0x7e37be2022c0914bull, 0x1340000000000001ull //10^31
+	, 0x64f964e68233a76full, 0x2900000000000001ull //10^30
+	, 0x50c783eb9b5c85f2ull, 0x5400000000000001ull //10^29
+	, 0x409f9cbc7c4a04c2ull, 0x1000000000000001ull //10^28
+	, 0x6765c793fa10079dull, 0x0000000000000001ull //10^27
+	, 0x52b7d2dcc80cd2e4ull, 0x0000000000000001ull //10^26
+	, 0x422ca8b0a00a4250ull, 0x0000000000000001ull //10^25
+	, 0x69e10de76676d080ull, 0x0000000000000001ull //10^24
+	, 0x54b40b1f852bda00ull, 0x0000000000000001ull //10^23
+	, 0x43c33c1937564800ull, 0x0000000000000001ull //10^22
+	, 0x6c6b935b8bbd4000ull, 0x0000000000000001ull //10^21
+	, 0x56bc75e2d6310000ull, 0x0000000000000001ull //10^20
+	, 0x4563918244f40000ull, 0x0000000000000001ull //10^19
+	, 0x6f05b59d3b200000ull, 0x0000000000000001ull //10^18
+	, 0x58d15e1762800000ull, 0x0000000000000001ull //10^17
+	, 0x470de4df82000000ull, 0x0000000000000001ull //10^16
+	, 0x71afd498d0000000ull, 0x0000000000000001ull //10^15
+	, 0x5af3107a40000000ull, 0x0000000000000001ull //10^14
+	, 0x48c2739500000000ull, 0x0000000000000001ull //10^13
+	, 0x746a528800000000ull, 0x0000000000000001ull //10^12
+	, 0x5d21dba000000000ull, 0x0000000000000001ull //10^11
+	, 0x4a817c8000000000ull, 0x0000000000000001ull //10^10
+	, 0x7735940000000000ull, 0x0000000000000001ull //10^9
+	, 0x5f5e100000000000ull, 0x0000000000000001ull //10^8
+	, 0x4c4b400000000000ull, 0x0000000000000001ull //10^7
+	, 0x7a12000000000000ull, 0x0000000000000001ull //10^6
+	, 0x61a8000000000000ull, 0x0000000000000001ull //10^5
+	, 0x4e20000000000000ull, 0x0000000000000001ull //10^4
+	, 0x7d00000000000000ull, 0x0000000000000001ull //10^3
+	, 0x6400000000000000ull, 0x0000000000000001ull //10^2
+	, 0x5000000000000000ull, 0x0000000000000001ull //10^1
+	, 0x4000000000000000ull, 0x0000000000000001ull //10^0
+	, 0x6666666666666666ull, 0x3333333333333334ull //10^-1
+	, 0x51eb851eb851eb85ull, 0x0f5c28f5c28f5c29ull //10^-2
+	, 0x4189374bc6a7ef9dull, 0x5916872b020c49bbull //10^-3
+	, 0x68db8bac710cb295ull, 0x74f0d844d013a92bull //10^-4
+	, 0x53e2d6238da3c211ull, 0x43f3e0370cdc8755ull //10^-5
+	, 0x431bde82d7b634daull, 0x698fe69270b06c44ull //10^-6
+	, 0x6b5fca6af2bd215eull, 0x0f4ca41d811a46d4ull //10^-7
+	, 0x55e63b88c230e77eull, 0x3f70834acdae9f10ull //10^-8
+	, 0x44b82fa09b5a52cbull, 0x4c5a02a23e254c0dull //10^-9
+	, 0x6df37f675ef6eadfull, 0x2d5cd10396a21347ull //10^-10
+	, 0x57f5ff85e592557full, 0x3de3da69454e75d3ull //10^-11
+	, 0x465e6604b7a84465ull, 0x7e4fe1edd10b9175ull //10^-12
+	, 0x709709a125da0709ull, 0x4a19697c81ac1befull //10^-13
+	, 0x5a126e1a84ae6c07ull, 0x54e1213067bce326ull //10^-14
+	, 0x480ebe7b9d58566cull, 0x43e74dc052fd8285ull //10^-15
+	, 0x734aca5f6226f0adull, 0x530baf9a1e626a6dull //10^-16
+	, 0x5c3bd5191b525a24ull, 0x426fbfae7eb521f1ull //10^-17
+	, 0x49c97747490eae83ull, 0x4ebfcc8b9890e7f4ull //10^-18
+	, 0x760f253edb4ab0d2ull, 0x4acc7a78f41b0cbaull //10^-19
+	, 0x5e72843249088d75ull, 0x223d2ec729af3d62ull //10^-20
+	, 0x4b8ed0283a6d3df7ull, 0x34fdbf05baf29781ull //10^-21
+	, 0x78e480405d7b9658ull, 0x54c931a2c4b758cfull //10^-22
+	, 0x60b6cd004ac94513ull, 0x5d6dc14f03c5e0a5ull //10^-23
+	, 0x4d5f0a66a23a9da9ull, 0x31249aa59c9e4d51ull //10^-24
+	, 0x7bcb43d769f762a8ull, 0x4ea0f76f60fd4882ull //10^-25
+	, 0x63090312bb2c4eedull, 0x254d92bf80caa068ull //10^-26
+	, 0x4f3a68dbc8f03f24ull, 0x1dd7a89933d54d20ull //10^-27
+	, 0x7ec3daf941806506ull, 0x62f2a75b86221500ull //10^-28
+	, 0x65697bfa9acd1d9full, 0x025bb91604e810cdull //10^-29
+	, 0x51212ffbaf0a7e18ull, 0x684960de6a5340a4ull //10^-30
+	, 0x40e7599625a1fe7aull, 0x203ab3e521dc33b6ull //10^-31
+	, 0x67d88f56a29cca5dull, 0x19f7863b696052bdull //10^-32
+	, 0x5313a5dee87d6eb0ull, 0x7b2c6b62bab37564ull //10^-33
+	, 0x42761e4bed31255aull, 0x2f56bc4efbc2c450ull //10^-34
+	, 0x6a5696dfe1e83bc3ull, 0x655793b192d13a1aull //10^-35
+	, 0x5512124cb4b9c969ull, 0x377942f475742e7bull //10^-36
+	, 0x440e750a2a2e3abaull, 0x5f9435905df68b96ull //10^-37
+	, 0x6ce3ee76a9e3912aull, 0x65b9ef4d63241289ull //10^-38
+	, 0x571cbec554b60dbbull, 0x6afb25d782834207ull //10^-39
+	, 0x45b0989ddd5e7163ull, 0x08c8eb12cecf6806ull //10^-40
+	, 0x6f80f42fc8971bd1ull, 0x5adb11b7b14bd9a3ull //10^-41
+	, 0x5933f68ca078e30eull, 0x157c0e2c8dd647b5ull //10^-42
+	, 0x475cc53d4d2d8271ull, 0x5dfcd823a4ab6c91ull //10^-43
+	, 0x722e086215159d82ull, 0x632e269f6ddf141bull //10^-44
+	, 0x5b5806b4ddaae468ull, 0x4f581ee5f17f4349ull //10^-45
+	, 0x49133890b1558386ull, 0x72ace584c1329c3bull //10^-46
+	, 0x74eb8db44eef38d7ull, 0x6aae3c079b842d2aull //10^-47
+	, 0x5d893e29d8bf60acull, 0x5558300616035755ull //10^-48
+	, 0x4ad431bb13cc4d56ull, 0x7779c004de6912abull //10^-49
+	, 0x77b9e92b52e07bbeull, 0x258f99a163db5111ull //10^-50
+	, 0x5fc7edbc424d2fcbull, 0x37a614811caf740dull //10^-51
+	, 0x4c9ff163683dbfd5ull, 0x7951aa00e3bf900bull //10^-52
+	, 0x7a998238a6c932efull, 0x754f7667d2cc19abull //10^-53
+	, 0x6214682d523a8f26ull, 0x2aa5f8530f09ae22ull //10^-54
+	, 0x4e76b9bddb620c1eull, 0x55519375a5a1581bull //10^-55
+	, 0x7d8ac2c95f034697ull, 0x3bb5b8bc3c3559c5ull //10^-56
+	, 0x646f023ab2690545ull, 0x7c9160969691149eull //10^-57
+	, 0x5058ce955b87376bull, 0x16dab3ababa743b2ull //10^-58
+	, 0x40470baaaf9f5f88ull, 0x78aef622efb902f5ull //10^-59
+	, 0x66d812aab29898dbull, 0x0de4bd04b2c19e54ull //10^-60
+	, 0x524675555bad4715ull, 0x57ea30d08f014b76ull //10^-61
+	, 0x41d1f7777c8a9f44ull, 0x4654f3da0c01092cull //10^-62
+	, 0x694ff258c7443207ull, 0x23bb1fc346680eacull //10^-63
+	, 0x543ff513d29cf4d2ull, 0x4fc8e635d1ecd88aull //10^-64
+	, 0x43665da9754a5d75ull, 0x263a51c4a7f0ad3bull //10^-65
+	, 0x6bd6fc425543c8bbull, 0x56c3b607731aaec4ull //10^-66
+	, 0x5645969b77696d62ull, 0x789c919f8f488bd0ull //10^-67
+	, 0x4504787c5f878ab5ull, 0x46e3a7b2d906d640ull //10^-68
+	, 0x6e6d8d93cc0c1122ull, 0x3e390c515b3e239aull //10^-69
+	, 0x5857a4763cd6741bull, 0x4b60d6a77c31b615ull //10^-70
+	, 0x46ac8391ca4529afull, 0x55e7121f968e2b44ull //10^-71
+	, 0x711405b6106ea919ull, 0x0971b698f0e3786dull //10^-72
+	, 0x5a766af80d255414ull, 0x078e2bad8d82c6bdull //10^-73
+	, 0x485ebbf9a41ddcdcull, 0x6c71bc8ad79bd231ull //10^-74
+	, 0x73cac65c39c96161ull, 0x2d82c7448c2c8382ull //10^-75
+	, 0x5ca23849c7d44de7ull, 0x3e023903a356cf9bull //10^-76
+	, 0x4a1b603b06437185ull, 0x7e682d9c82abd949ull //10^-77
+	, 0x76923391a39f1c09ull, 0x4a4048fa6aac8edbull //10^-78
+	, 0x5edb5c7482e5b007ull, 0x55003a61eef07249ull //10^-79
+	, 0x4be2b05d35848cd2ull, 0x773361e7f259f507ull //10^-80
+	, 0x796ab3c855a0e151ull, 0x3eb89ca6508fee71ull //10^-81
+	, 0x6122296d114d810dull, 0x7efa16eb73a6585bull //10^-82
+	, 0x4db4edf0daa4673eull, 0x3261abef8fb846afull //10^-83
+	, 0x7c54afe7c43a3ecaull, 0x1d691318e5f3a44bull //10^-84
+	, 0x6376f31fd02e98a1ull, 0x64540f471e5c836full //10^-85
+	, 0x4f925c1973587a1bull, 0x0376729f4b7d35f3ull //10^-86
+	, 0x7f50935bebc0c35eull, 0x38bd84321261efebull //10^-87
+	, 0x65da0f7cbc9a35e5ull, 0x13cad0280eb4bfefull //10^-88
+	, 0x517b3f96fd482b1dull, 0x5ca240200bc3ccbfull //10^-89
+	, 0x412f66126439bc17ull, 0x63b50019a3030a33ull //10^-90
+	, 0x684bd683d38f9359ull, 0x1f88002904d1a9eaull //10^-91
+	, 0x536fdecfdc72dc47ull, 0x32d3335403daee55ull //10^-92
+	, 0x42bfe57316c249d2ull, 0x5bdc291003158b77ull //10^-93
+	, 0x6acca251be03a951ull, 0x12f9db4cd1bc1258ull //10^-94
+	, 0x557081dafe695440ull, 0x7594af70a7c9a847ull //10^-95
+	, 0x445a017bfebaa9cdull, 0x4476f2c0863aed06ull //10^-96
+	, 0x6d5ccf2ccac442e2ull, 0x3a57eacda3917b3cull //10^-97
+	, 0x577d728a3bd03581ull, 0x7b7988a482dac8fdull //10^-98
+	, 0x45fdf53b630cf79bull, 0x15fad3b6cf156d97ull //10^-99
+	, 0x6ffcbb923814bf5eull, 0x565e1f8ae4ef15beull //10^-100
+	, 0x5996fc74f9aa32b2ull, 0x11e4e608b725aaffull //10^-101
+	, 0x47abfd2a6154f55bull, 0x27ea51a0928488ccull //10^-102
+	, 0x72acc843ceee555eull, 0x7310829a84074146ull //10^-103
+	, 0x5bbd6d030bf1dde5ull, 0x42739baed005cdd2ull //10^-104
+	, 0x49645735a327e4b7ull, 0x4ec2e2f24004a4a8ull //10^-105
+	, 0x756d5855d1d96df2ull, 0x4ad16b1d333aa10cull //10^-106
+	, 0x5df11377db1457f5ull, 0x2241227dc2954da3ull //10^-107
+	, 0x4b2742c648dd132aull, 0x4e9a81fe35443e1cull //10^-108
+	, 0x783ed13d4161b844ull, 0x175d9cc9eed39694ull //10^-109
+	, 0x603240fdcde7c69cull, 0x7917b0a18bdc7876ull //10^-110
+	, 0x4cf500cb0b1fd217ull, 0x1412f3b46fe39392ull //10^-111
+	, 0x7b219ade7832e9beull, 0x535185ed7fd285b6ull //10^-112
+	, 0x628148b1f9c25498ull, 0x42a79e57997537c5ull //10^-113
+	, 0x4ecdd3c1949b76e0ull, 0x3552e512e12a9304ull //10^-114
+	, 0x7e161f9c20f8be33ull, 0x6eeb081e3510eb39ull //10^-115
+	, 0x64de7fb01a609829ull, 0x3f226ce4f740bc2eull //10^-116
+	, 0x50b1ffc0151a1354ull, 0x3281f0b72c33c9beull //10^-117
+	, 0x408e66334414dc43ull, 0x42018d5f568fd498ull //10^-118
+	, 0x674a3d1ed354939full, 0x1ccf48988a7fba8dull //10^-119
+	, 0x52a1ca7f0f76dc7full, 0x30a5d3ad3b99620bull //10^-120
+	, 0x421b0865a5f8b065ull, 0x73b7dc8a96144e6full //10^-121
+	, 0x69c4da3c3cc11a3cull, 0x52bfc7442353b0b1ull //10^-122
+	, 0x549d7b6363cdae96ull, 0x756639034f7626f4ull //10^-123
+	, 0x43b12f82b63e2545ull, 0x4451c735d92b525dull //10^-124
+	, 0x6c4eb26abd303ba2ull, 0x3a1c71efc1deea2eull //10^-125
+	, 0x56a55b889759c94eull, 0x61b05b2634b254f2ull //10^-126
+	, 0x45511606df7b0772ull, 0x1af37c1e908eaa5bull //10^-127
+	, 0x6ee8233e325e7250ull, 0x2b1f2cfdb41776f8ull //10^-128
+	, 0x58b9b5cb5b7ec1d9ull, 0x6f4c23fe29ac5f2dull //10^-129
+	, 0x46faf7d5e2cbce47ull, 0x72a34ffe87bd18f1ull //10^-130
+	, 0x71918c896adfb073ull, 0x04387ffda5fb5b1bull //10^-131
+	, 0x5adad6d4557fc05cull, 0x0360666484c915afull //10^-132
+	, 0x48af1243779966b0ull, 0x02b3851d3707448cull //10^-133
+	, 0x744b506bf28f0ab3ull, 0x1dec082ebe720746ull //10^-134
+	, 0x5d090d2328726ef5ull, 0x64bcd358985b3905ull //10^-135
+	, 0x4a6da41c205b8bf7ull, 0x6a30a913ad15c738ull //10^-136
+	, 0x7715d36033c5acbfull, 0x5d1aa81f7b560b8cull //10^-137
+	, 0x5f44a919c3048a32ull, 0x7daeece5fc44d609ull //10^-138
+	, 0x4c36edae359d3b5bull, 0x7e258a51969d7808ull //10^-139
+	, 0x79f17c49ef61f893ull, 0x16a276e8f0fbf33full //10^-140
+	, 0x618dfd07f2b4c6dcull, 0x121b9253f3fcc299ull //10^-141
+	, 0x4e0b30d328909f16ull, 0x41afa84329970214ull //10^-142
+	, 0x7cdeb4850db431bdull, 0x4f7f739ea8f19cedull //10^-143
+	, 0x63e55d373e29c164ull, 0x3f99294bba5ae3f1ull //10^-144
+	, 0x4feab0f8fe87cde9ull, 0x7fadbaa2fb7be98dull //10^-145
+	, 0x7fdde7f4ca72e30full, 0x7f7c5dd1925fdc15ull //10^-146
+	, 0x664b1ff7085be8d9ull, 0x4c637e4141e649abull //10^-147
+	, 0x51d5b32c06afed7aull, 0x704f983434b83aefull //10^-148
+	, 0x4177c2899ef32462ull, 0x26a6135cf6f9c8bfull //10^-149
+	, 0x68bf9da8fe51d3d0ull, 0x3dd685618b294132ull //10^-150
+	, 0x53cc7e20cb74a973ull, 0x4b12044e08edcdc2ull //10^-151
+	, 0x4309fe80a2c3bac2ull, 0x6f419d0b3a57d7ceull //10^-152
+	, 0x6b4330cdd1392ad1ull, 0x320294dec3bfbfb0ull //10^-153
+	, 0x55cf5a3e40fa88a7ull, 0x419baa4bcfcc995aull //10^-154
+	, 0x44a5e1cb672ed3b9ull, 0x1ae2eea30ca3ade1ull //10^-155
+	, 0x6dd636123eb152c1ull, 0x77d17dd1add2afcfull //10^-156
+	, 0x57de91a832277567ull, 0x797464a7be42263full //10^-157
+	, 0x464ba7b9c1b92ab9ull, 0x4790508631ce84ffull //10^-158
+	, 0x70790c5c6928445cull, 0x0c1a1a704fb0d4ccull //10^-159
+	, 0x59fa7049edb9d049ull, 0x567b4859d95a43d6ull //10^-160
+	, 0x47fb8d07f161736eull, 0x11fc39e17aae9cabull //10^-161
+	, 0x732c14d98235857dull, 0x032d2968c44a9445ull //10^-162
+	, 0x5c2343e134f79dfdull, 0x4f575453d03ba9d1ull //10^-163
+	, 0x49b5cfe75d92e4caull, 0x72ac4376402fbb0eull //10^-164
+	, 0x75efb30bc8eb07abull, 0x0446d256cd192b49ull //10^-165
+	, 0x5e595c096d88d2efull, 0x1d0575123dadbc3aull //10^-166
+	, 0x4b7ab0078ad3dbf2ull, 0x4a6ac40e97be302full //10^-167
+	, 0x78c44cd8de1fc650ull, 0x771139b0f2c9e6b1ull //10^-168
+	, 0x609d0a4718196b73ull, 0x78da948d8f07ebc1ull //10^-169
+	, 0x4d4a6e9f467abc5cull, 0x60aedd3e0c065634ull //10^-170
+	, 0x7baa4a9870c46094ull, 0x344afb9679a3bd20ull //10^-171
+	, 0x62eea2138d69e6ddull, 0x103bfc78614fca80ull //10^-172
+	, 0x4f254e760abb1f17ull, 0x26966393810ca200ull //10^-173
+	, 0x7ea21723445e9825ull, 0x2423d2859b476999ull //10^-174
+	, 0x654e78e9037ee01dull, 0x69b642047c392148ull //10^-175
+	, 0x510b93ed9c658017ull, 0x6e2b680396941aa0ull //10^-176
+	, 0x40d60ff149eaccdfull, 0x71bc53361210154dull //10^-177
+	, 0x67bce64edcaae166ull, 0x1c6085235019bbaeull //10^-178
+	, 0x52fd850be3bbe784ull, 0x7d1a041c40149625ull //10^-179
+	, 0x42646a6fe9631f9dull, 0x4a7b367d0010781dull //10^-180
+	, 0x6a3a43e642383295ull, 0x5d91f0c8001a59c8ull //10^-181
+	, 0x54fb698501c68edeull, 0x17a7f3d3334847d4ull //10^-182
+	, 0x43fc546a67d20be4ull, 0x79532975c2a03976ull //10^-183
+	, 0x6cc6ed770c83463bull, 0x0eeb75893766c256ull //10^-184
+	, 0x57058ac5a39c382full, 0x25892ad42c523512ull //10^-185
+	, 0x459e089e1c7cf9bfull, 0x37a0ef102374f742ull //10^-186
+	, 0x6f6340fcfa618f98ull, 0x59017e8038bb2536ull //10^-187
+	, 0x591c33fd951ad946ull, 0x7a67986693c8ea91ull //10^-188
+	, 0x4749c33144157a9full, 0x151fad1edca0bba8ull //10^-189
+	, 0x720f9eb539bbf765ull, 0x0832ae97c76792a5ull //10^-190
+	, 0x5b3fb22a94965f84ull, 0x068ef21305ec7551ull //10^-191
+	, 0x48ffc1bbaa11e603ull, 0x1ed8c1a8d189f774ull //10^-192
+	, 0x74cc692c434fd66bull, 0x4af4690e1c0ff253ull //10^-193
+	, 0x5d705423690cab89ull, 0x225d20d816732843ull //10^-194
+	, 0x4ac0434f873d5607ull, 0x35174d79ab8f5369ull //10^-195
+	, 0x779a054c0b955672ull, 0x21bee25c45b21f0eull //10^-196
+	, 0x5fae6aa33c77785bull, 0x3498b5169e2818d8ull //10^-197
+	, 0x4c8b888296c5f9e2ull, 0x5d46f7454b534713ull //10^-198
+	, 0x7a78da6a8ad65c9dull, 0x7ba4bed545520b52ull //10^-199
+	, 0x61fa48553bdeb07eull, 0x2fb6ff110441a2a8ull //10^-200
+	, 0x4e61d37763188d31ull, 0x72f8cc0d9d014eedull //10^-201
+	, 0x7d6952589e8daeb6ull, 0x1e5ae015c80217e1ull //10^-202
+	, 0x645441e07ed7bef8ull, 0x1848b344a001acb4ull //10^-203
+	, 0x504367e6cbdfcbf9ull, 0x603a2903b3348a2aull //10^-204
+	, 0x4035ecb8a3196ffbull, 0x002e873628f6d4eeull //10^-205
+	, 0x66bcadf43828b32bull, 0x19e40b89db2487e3ull //10^-206
+	, 0x52308b29c686f5bcull, 0x14b66fa17c1d3983ull //10^-207
+	, 0x41c06f549ed25e30ull, 0x1091f2e7967dc79cull //10^-208
+	, 0x6933e554315096b3ull, 0x341cb7d8f0c93f5full //10^-209
+	, 0x542984435aa6def5ull, 0x767d5fe0c0a0ff80ull //10^-210
+	, 0x435469cf7bb8b25eull, 0x2b977fe70080cc66ull //10^-211
+	, 0x6bba42e592c11d63ull, 0x5f58cca4cd9ae0a3ull //10^-212
+	, 0x562e9beadbcdb11cull, 0x4c470a1d7148b3b6ull //10^-213
+	, 0x44f216557ca48db0ull, 0x3d05a1b1276d5c92ull //10^-214
+	, 0x6e5023bbfaa0e2b3ull, 0x7b3c35e83f1560e9ull //10^-215
+	, 0x58401c96621a4ef6ull, 0x2f635e5365aab3edull //10^-216
+	, 0x4699b0784e7b725eull, 0x591c4b75eaeef658ull //10^-217
+	, 0x70f5e726e3f8b6fdull, 0x74fa125644b18a26ull //10^-218
+	, 0x5a5e5285832d5f31ull, 0x43fb41de9d5ad4ebull //10^-219
+	, 0x484b75379c244c27ull, 0x4ffc34b2177bdd89ull //10^-220
+	, 0x73abeebf603a1372ull, 0x4cc6bab68bf96274ull //10^-221
+	, 0x5c898bcc4cfb42c2ull, 0x0a38955ed6611b90ull //10^-222
+	, 0x4a07a309d72f689bull, 0x21c6dde5784dafa7ull //10^-223
+	, 0x76729e762518a75eull, 0x693e2fd58d49190bull //10^-224
+	, 0x5ec2185e8413b918ull, 0x5431bfde0aa0e0d5ull //10^-225
+	, 0x4bce79e536762dadull, 0x29c1664b3bb3e711ull //10^-226
+	, 0x794a5ca1f0bd15e2ull, 0x0f9bd6dec5eca4e8ull //10^-227
+	, 0x61084a1b26fdab1bull, 0x2616457f04bd50baull //10^-228
+	, 0x4da03b48ebfe227cull, 0x1e783798d09773c8ull //10^-229
+	, 0x7c33920e46636a60ull, 0x30c058f480f252d9ull //10^-230
+	, 0x635c74d8384f884dull, 0x0d66ad9067284247ull //10^-231
+	, 0x4f7d2a469372d370ull, 0x711ef14052869b6cull //10^-232
+	, 0x7f2eaa0a85848581ull, 0x34fe4ecd50d75f14ull //10^-233
+	, 0x65beee6ed136d134ull, 0x2a650bd773df7f43ull //10^-234
+	, 0x51658b8bda9240f6ull, 0x551da312c319329cull //10^-235
+	, 0x411e093caedb672bull, 0x5db14f4235adc217ull //10^-236
+	, 0x68300ec77e2bd845ull, 0x7c4ee536bc49368aull //10^-237
+	, 0x5359a56c64efe037ull, 0x7d0bea92303a9208ull //10^-238
+	, 0x42ae1df050bfe693ull, 0x173cbba8269541a0ull //10^-239
+	, 0x6ab02fe6e79970ebull, 0x3ec792a6a422029aull //10^-240
+	, 0x5559bfebec7ac0bcull, 0x3239421ee9b4cee1ull //10^-241
+	, 0x4447ccbcbd2f0096ull, 0x5b6101b25490a581ull //10^-242
+	, 0x6d3fadfac84b3424ull, 0x2bce691d541aa268ull //10^-243
+	, 0x576624c8a03c29b6ull, 0x563eba7ddce21b87ull //10^-244
+	, 0x45eb50a08030215eull, 0x78322ecb171b4939ull //10^-245
+	, 0x6fdee76733803564ull, 0x59e9e47824f87527ull //10^-246
+	, 0x597f1f85c2ccf783ull, 0x6187e9f9b72d2a86ull //10^-247
+	, 0x4798e6049bd72c69ull, 0x346cbb2e2c242205ull //10^-248
+	, 0x728e3cd42c8b7a42ull, 0x20adf849e039d007ull //10^-249
+	, 0x5ba4fd768a092e9bull, 0x33be603b19c7d99full //10^-250
+	, 0x4950cac53b3a8bafull, 0x42feb3627b0647b3ull //10^-251
+	, 0x754e113b91f745e5ull, 0x5197856a5e7072b8ull //10^-252
+	, 0x5dd80dc941929e51ull, 0x27ac6abb7ec05bc6ull //10^-253
+	, 0x4b133e3a9adbb1daull, 0x52f05562cbcd1638ull //10^-254
+	, 0x781ec9f75e2c4fc4ull, 0x1e4d556adfae89f3ull //10^-255
+	, 0x6018a192b1bd0c9cull, 0x7ea444557fbed4c3ull //10^-256
+	, 0x4ce0814227ca707dull, 0x4bb69d1132ff109cull //10^-257
+	, 0x7b00ced03faa4d95ull, 0x5f8a94e851981a93ull //10^-258
+	, 0x62670bd9cc883e11ull, 0x32d543ed0e134875ull //10^-259
+	, 0x4eb8d647d6d364daull, 0x5bddcff0d80f6d2bull //10^-260
+	, 0x7df48a0c8aebd491ull, 0x12fc7fe7c018aeabull //10^-261
+	, 0x64c3a1a3a25643a7ull, 0x28c9ffec99ad5889ull //10^-262
+	, 0x509c814fb511cfb9ull, 0x0707fff07af113a1ull //10^-263
+	, 0x407d343fc40e3fc7ull, 0x1f39998d2f2742e7ull //10^-264
+	, 0x672eb9ffa016cc71ull, 0x7ec28f484b7204a4ull //10^-265
+	, 0x528bc7ffb345705bull, 0x189ba5d36f8e6a1dull //10^-266
+	, 0x42096ccc8f6ac048ull, 0x7a161e42bfa521b1ull //10^-267
+	, 0x69a8ae1418aacd41ull, 0x435696d132a1cf81ull //10^-268
+	, 0x5486f1a9ad557101ull, 0x1c454574288172ceull //10^-269
+	, 0x439f27baf1112734ull, 0x169dd129ba0128a5ull //10^-270
+	, 0x6c31d92b1b4ea520ull, 0x242fb50f9001daa1ull //10^-271
+	, 0x568e4755af721db3ull, 0x368c90d940017bb4ull //10^-272
+	, 0x453e9f77bf8e7e29ull, 0x120a0d7a999ac95dull //10^-273
+	, 0x6eca98bf98e3fd0eull, 0x50101590f5c47561ull //10^-274
+	, 0x58a213cc7a4ffda5ull, 0x26734473f7d05de8ull //10^-275
+	, 0x46e80fd6c83ffe1dull, 0x6b8f69f65fd9e4b9ull //10^-276
+	, 0x71734c8ad9fffcfcull, 0x45b24323cc8fd45cull //10^-277
+	, 0x5ac2a3a247fffd96ull, 0x6af502830a0ca9e3ull //10^-278
+	, 0x489bb61b6ccccadfull, 0x08c402026e7087e9ull //10^-279
+	, 0x742c569247ae1164ull, 0x746cd003e3e73fdbull //10^-280
+	, 0x5cf04541d2f1a783ull, 0x76bd73364fec3315ull //10^-281
+	, 0x4a59d101758e1f9cull, 0x5efdf5c50cbcf5abull //10^-282
+	, 0x76f61b3588e365c7ull, 0x4b2fefa1adfb22abull //10^-283
+	, 0x5f2b48f7a0b5eb06ull, 0x08f3261af195b555ull //10^-284
+	, 0x4c22a0c61a2b226bull, 0x20c284e25ade2aabull //10^-285
+	, 0x79d1013cf6ab6a45ull, 0x1ad0d49d5e304444ull //10^-286
+	, 0x617400fd9222bb6aull, 0x48a7107de4f369d0ull //10^-287
+	, 0x4df6673141b562bbull, 0x53b8d9fe50c2bb0dull //10^-288
+	, 0x7cbd71e869223792ull, 0x52c15cca1ad12b48ull //10^-289
+	, 0x63cac186ba81c60eull, 0x75677d6e7bda8906ull //10^-290
+	, 0x4fd5679efb9b04d8ull, 0x5dec645863153a6cull //10^-291
+	, 0x7fbbd8fe5f5e6e27ull, 0x497a3a2704eec3dfull //10^-292
+};
+
+static const char number_digit_pairs[]=
+	"00010203040506070809"
+	"10111213141516171819"
+	"20212223242526272829"
+	"30313233343536373839"
+	"40414243444546474849"
+	"50515253545556575859"
+	"60616263646566676869"
+	"70717273747576777879"
+	"80818283848586878889"
+	"90919293949596979899";
+
+typedef struct
+{
+	uint64_t mantissa;
+	int64_t exponent; //value is mantissa * 10^exponent
+	bool negative;
+	bool truncated; //mantissa holds only the first 19 significant digits
+} number_decimal;
+
+static locale_t number_c_locale;
+static pthread_once_t number_c_locale_once=PTHREAD_ONCE_INIT;
+
+static void number_c_locale_init()
+{
+	number_c_locale=newlocale(LC_ALL_MASK,"C",(locale_t)0);
+}
+
+static inline bool number_isdigit(char c)
+{
+	return (unsigned char)(c-'0')<10;
+}
+
+#ifdef NUMBER_SWAR
+static inline uint64_t number_read8(const char *p)
+{
+	uint64_t v;
+	memcpy(&v,p,8);
+	return v;
+}
+
+/**
+* Checks that all 8 bytes of a little-endian word are ASCII digits.
+*/
+static inline bool number_is8digits(uint64_t v)
+{
+	return !(((v+0x4646464646464646ull)|(v-0x3030303030303030ull))&0x8080808080808080ull);
+}
+
+/**
+* Converts 8 ASCII digits held in a little-endian word, in three multiplications.
+*/
+static inline uint32_t number_parse8digits(uint64_t v)
+{
+	const uint64_t mask=0x000000ff000000ffull;
+	const uint64_t mul1=0x000f424000000064ull; //100 + (1000000 << 32)
+	const uint64_t mul2=0x0000271000000001ull; //1 + (10000 << 32)
+	v-=0x3030303030303030ull;
+	v=(v*10)+(v>>8);
+	v=(((v&mask)*mul1)+(((v>>16)&mask)*mul2))>>32;
+	return (uint32_t)v;
+}
+#endif
+
+/**
+* Accumulates the decimal digits starting at 'p' into '*value', eight at a time where possible.
+* The accumulation wraps around silently; callers count digits to detect overflow.
+*
+* @return the position of the first byte that is not a digit.
+*/
+static const char *number_digits(const char *p, const char *end, uint64_t *value)
+{
+	uint64_t v=*value;
+#ifdef NUMBER_SWAR
+	while(end-p>=8)
+	{
+		uint64_t chunk=number_read8(p);
+		if(!number_is8digits(chunk)) break;
+		v=v*100000000+number_parse8digits(chunk);
+		p+=8;
+	}
+#endif
+	while(p<end && number_isdigit(*p))
+	{
+		v=v*10+(uint64_t)(*p-'0');
+		p++;
+	}
+	*value=v;
+	return p;
+}
+
+/**
+* Compares 'p' case-insensitively with a lowercase ASCII word of the same length.
+*/
+static bool number_word(const char *p, const char *end, const char *word)
+{
+	size_t len=strlen(word);
+	size_t i;
+	if((size_t)(end-p)!=len) return false;
+	for(i=0; i<len; i++)
+		if((p[i]|0x20)!=word[i]) return false;
+	return true;
+}
+
+/**
+* Splits a decimal number into sign, mantissa and power of ten.
+* The whole input must be a number: [+-] digits [. digits] [(e|E) [+-] digits].
+*
+* @return true if the input is a well-formed number; false, if not.
+*/
+static bool number_parse_decimal(const char *p, const char *end, number_decimal *d)
+{
+	const char *int_start, *int_end, *frac_start=NULL, *frac_end=NULL;
+	int64_t digit_count, exp_number=0;
+	uint64_t i=0;
+	d->negative=false;
+	d->truncated=false;
+	if(p<end && (*p=='-' || *p=='+'))
+	{
+		d->negative=(*p=='-');
+		p++;
+	}
+	int_start=p;
+	p=number_digits(p,end,&i);
+	int_end=p;
+	digit_count=int_end-int_start;
+	if(p<end && *p=='.')
+	{
+		p++;
+		frac_start=p;
+		p=number_digits(p,end,&i);
+		frac_end=p;
+		digit_count+=frac_end-frac_start;
+	}
+	if(digit_count==0) return false;
+	if(p<end && (*p=='e' || *p=='E'))
+	{
+		bool negative_exponent=false;
+		p++;
+		if(p<end && (*p=='-' || *p=='+'))
+		{
+			negative_exponent=(*p=='-');
+			p++;
+		}
+		if(p==end || !number_isdigit(*p)) return false;
+		while(p<end && number_isdigit(*p))
+		{
+			//anything beyond this saturates to zero or infinity anyway
+			if(exp_number<0x10000000) exp_number=exp_number*10+(*p-'0');
+			p++;
+		}
+		if(negative_exponent) exp_number=-exp_number;
+	}
+	if(p!=end) return false;
+	d->mantissa=i;
+	d->exponent=exp_number-(frac_start!=NULL?frac_end-frac_start:0);
+	if(digit_count>NUMBER_MAX_DIGITS)
+	{
+		//leading zeros do not count as significant digits
+		const char *q=int_start;
+		while(q<end && (*q=='0' || *q=='.'))
+		{
+			if(*q=='0') digit_count--;
+			q++;
+		}
+		if(digit_count>NUMBER_MAX_DIGITS)
+		{
+			const uint64_t minimal_nineteen_digits=1000000000000000000ull;
+			d->truncated=true;
+			i=0;
+			q=int_start;
+			while(i<minimal_nineteen_digits && q!=int_end)
+			{
+				i=i*10+(uint64_t)(*q-'0');
+				q++;
+			}
+			if(i>=minimal_nineteen_digits)
+			{
+				d->exponent=(int_end-q)+exp_number;
+			}
+			else
+			{
+				q=frac_start;
+				while(i<minimal_nineteen_digits && q!=frac_end)
+				{
+					i=i*10+(uint64_t)(*q-'0');
+					q++;
+				}
+				d->exponent=(frac_start-q)+exp_number;
+			}
+			d->mantissa=i;
+		}
+	}
+	return true;
+}
+
+static inline void number_mul128(uint64_t a, uint64_t b, uint64_t *low, uint64_t *high)
+{
+#ifdef __SIZEOF_INT128__
+	__uint128_t r=(__uint128_t)a*b;
+	*low=(uint64_t)r;
+	*high=(uint64_t)(r>>64);
+#else
+	uint64_t ha=a>>32, hb=b>>32, la=(uint32_t)a, lb=(uint32_t)b;
+	uint64_t ll=la*lb, lh=la*hb, hl=ha*lb, hh=ha*hb;
+	uint64_t mid=(ll>>32)+(uint32_t)lh+(uint32_t)hl;
+	*low=(mid<<32)|(uint32_t)ll;
+	*high=hh+(lh>>32)+(hl>>32)+(mid>>32);
+#endif
+}
+
+static inline int number_leading_zeros(uint64_t v)
+{
+	return __builtin_clzll(v);
+}
+
+/**
+* Converts mantissa * 10^exponent into the bits of the nearest double (Eisel-Lemire).
+* A 128-bit truncated product with the power of five is sufficient for every
+* mantissa of at most 19 digits (Mushtak and Lemire, "Fast number parsing without fallback").
+*
+* @return the biased exponent and the 52-bit fraction, combined into double bits without sign.
+*/
+static uint64_t number_eisel_lemire(uint64_t w, int64_t q)
+{
+	uint64_t low, high, mantissa;
+	int lz, upperbit, shift;
+	int64_t power2;
+	const uint64_t precision_mask=0xffffffffffffffffull>>(NUMBER_MANTISSA_BITS+3);
+	if(w==0 || q<NUMBER_SMALLEST_POWER10) return 0;
+	if(q>NUMBER_LARGEST_POWER10) return (uint64_t)NUMBER_INFINITE_POWER<<NUMBER_MANTISSA_BITS;
+	lz=number_leading_zeros(w);
+	w<<=lz;
+	size_t index=2*(size_t)(q-NUMBER_SMALLEST_POWER10);
+	number_mul128(w,number_power5[index],&low,&high);
+	if((high&precision_mask)==precision_mask)
+	{
+		uint64_t low2, high2;
+		number_mul128(w,number_power5[index+1],&low2,&high2);
+		low+=high2;
+		if(high2>low) high++;
+	}
+	upperbit=(int)(high>>63);
+	shift=upperbit+64-NUMBER_MANTISSA_BITS-3;
+	mantissa=high>>shift;
+	power2=(((152170+65536)*q)>>16)+63+upperbit-lz-NUMBER_MINIMUM_EXPONENT;
+	if(power2<=0)
+	{
+		//subnormal
+		if(-power2+1>=64) return 0;
+		mantissa>>=-power2+1;
+		mantissa+=(mantissa&1);
+		mantissa>>=1;
+		power2=(mantissa<(1ull<<NUMBER_MANTISSA_BITS))?0:1;
+		return ((uint64_t)power2<<NUMBER_MANTISSA_BITS)|(mantissa&((1ull<<NUMBER_MANTISSA_BITS)-1));
+	}
+	//exactly halfway between two doubles: round to even instead of up
+	if(low<=1 && q>=-4 && q<=23 && (mantissa&3)==1)
+	{
+		if((mantissa<<shift)==high) mantissa&=~1ull;
+	}
+	mantissa+=(mantissa&1);
+	mantissa>>=1;
+	if(mantissa>=(2ull<<NUMBER_MANTISSA_BITS))
+	{
+		mantissa=1ull<<NUMBER_MANTISSA_BITS;
+		power2++;
+	}
+	mantissa&=~(1ull<<NUMBER_MANTISSA_BITS);
+	if(power2>=NUMBER_INFINITE_POWER) return (uint64_t)NUMBER_INFINITE_POWER<<NUMBER_MANTISSA_BITS;
+	return ((uint64_t)power2<<NUMBER_MANTISSA_BITS)|mantissa;
+}
+
+/**
+* Parses with strtod in the C locale, for the rare inputs with more than 19 significant digits
+* that lie too close to a rounding boundary to decide from the first 19.
+*/
+static bool number_strtod(const char *data, size_t size, double *result)
+{
+	char local[128];
+	char *copy=size<sizeof(local)?local:(char *)object_new_atomic(size+1);
+	char *endptr;
+	memcpy(copy,data,size);
+	copy[size]=0;
+	pthread_once(&number_c_locale_once,number_c_locale_init);
+	*result=strtod_l(copy,&endptr,number_c_locale);
+	return endptr==copy+size;
+}
+
+/**
+* Writes the decimal digits of 'value' backwards, ending just before 'end', two at a time.
+*
+* @return the position of the first digit written.
+*/
+static char *number_digits_backwards(char *end, uint64_t value)
+{
+	while(value>=100)
+	{
+		unsigned pair=(unsigned)(value%100)*2;
+		value/=100;
+		end-=2;
+		end[0]=number_digit_pairs[pair];
+		end[1]=number_digit_pairs[pair+1];
+	}
+	if(value>=10)
+	{
+		end-=2;
+		end[0]=number_digit_pairs[value*2];
+		end[1]=number_digit_pairs[value*2+1];
+	}
+	else
+	{
+		*--end=(char)('0'+value);
+	}
+	return end;
+}
+
+static inline uint64_t number_mulhigh(uint64_t a, uint64_t b)
+{
+	uint64_t low, high;
+	number_mul128(a,b,&low,&high);
+	return high;
+}
+
+/* floor(log10(2^e)) */
+static inline int number_flog10pow2(int e)
+{
+	return (int)(((int64_t)e*661971961083ll)>>41);
+}
+
+/* floor(log10(3/4 2^e)) */
+static inline int number_flog10threequarterspow2(int e)
+{
+	return (int)(((int64_t)e*661971961083ll-274743187321ll)>>41);
+}
+
+/* floor(log2(10^e)) */
+static inline int number_flog2pow10(int e)
+{
+	return (int)(((int64_t)e*913124641741ll)>>38);
+}
+
+/**
+* Computes the rounded-to-odd value of cp g 2^-127 (Schubfach, figure 8).
+*/
+static inline uint64_t number_round_to_odd(uint64_t g1, uint64_t g0, uint64_t cp)
+{
+	uint64_t x1=number_mulhigh(g0,cp);
+	uint64_t y0=g1*cp;
+	uint64_t y1=number_mulhigh(g1,cp);
+	uint64_t z=(y0>>1)+x1;
+	uint64_t vbp=y1+(z>>63);
+	return vbp|(((z&NUMBER_MASK_63)+NUMBER_MASK_63)>>63);
+}
+
+/**
+* Finds the shortest decimal f 10^e that rounds back to c 2^q, choosing the one closest
+* to c 2^q when there are several (Giulietti's Schubfach algorithm).
+*/
+static void number_shortest(int q, uint64_t c, uint64_t *f, int *e)
+{
+	int out=(int)(c&1);
+	uint64_t cb=c<<2;
+	uint64_t cbr=cb+2;
+	uint64_t cbl;
+	int k, h;
+	if(c!=(1ull<<NUMBER_MANTISSA_BITS) || q==-1074)
+	{
+		//regular spacing
+		cbl=cb-2;
+		k=number_flog10pow2(q);
+	}
+	else
+	{
+		//irregular spacing, at the bottom of a binade
+		cbl=cb-1;
+		k=number_flog10threequarterspow2(q);
+	}
+	h=q+number_flog2pow10(-k)+2;
+	size_t index=2*(size_t)(k-NUMBER_G_MIN_K);
+	uint64_t g1=number_power10_g[index];
+	uint64_t g0=number_power10_g[index+1];
+	uint64_t vb=number_round_to_odd(g1,g0,cb<<h);
+	uint64_t vbl=number_round_to_odd(g1,g0,cbl<<h);
+	uint64_t vbr=number_round_to_odd(g1,g0,cbr<<h);
+	uint64_t s=vb>>2;
+	if(s>=100)
+	{
+		//try one digit less first: s' = floor(s / 10)
+		uint64_t sp10=10*number_mulhigh(s,115292150460684698ull<<4);
+		uint64_t tp10=sp10+10;
+		bool upin=vbl+out<=sp10<<2;
+		bool wpin=(tp10<<2)+out<=vbr;
+		if(upin!=wpin)
+		{
+			*f=upin?sp10:tp10;
+			*e=k;
+			return;
+		}
+	}
+	uint64_t t=s+1;
+	bool uin=vbl+out<=s<<2;
+	bool win=(t<<2)+out<=vbr;
+	if(uin!=win)
+	{
+		*f=uin?s:t;
+		*e=k;
+		return;
+	}
+	//both are in the rounding interval: take the closest, ties to even
+	int64_t cmp=(int64_t)(vb-((s+t)<<1));
+	*f=(cmp<0 || (cmp==0 && (s&1)==0))?s:t;
+	*e=k;
+}
+
+/**
+* Drops further digits from f 10^e as long as the result still reads back as 'bits'.
+* Schubfach tries at most one digit less than the precision of c, which is not enough
+* for subnormals with very few significant bits.
+*/
+static void number_shorten(uint64_t bits, uint64_t *f, int *e)
+{
+	uint64_t f0=*f, p10=1;
+	int e0=*e, j=0;
+	while(f0/p10>=10)
+	{
+		uint64_t lo, hi;
+		bool loin, hiin;
+		p10*=10;
+		j++;
+		lo=f0/p10;
+		hi=lo+1;
+		loin=lo!=0 && number_eisel_lemire(lo,e0+j)==bits;
+		hiin=number_eisel_lemire(hi,e0+j)==bits;
+		if(!loin && !hiin) break;
+		*f=(loin && (!hiin || f0-lo*p10<=hi*p10-f0))?lo:hi;
+		*e=e0+j;
+	}
+}
+
+/**
+* Lays out the decimal f 10^e the way JavaScript does: plain notation for
+* decimal exponents from -7 to 20, scientific notation outside that range.
+*
+* @return the number of bytes written.
+*/
+static size_t number_layout(char *dest, bool negative, uint64_t f, int e)
+{
+	char digits[24];
+	char *end=digits+sizeof(digits);
+	char *first;
+	char *p=dest;
+	int n, point, i;
+	while(f!=0 && f%10==0)
+	{
+		f/=10;
+		e++;
+	}
+	first=number_digits_backwards(end,f);
+	n=(int)(end-first);
+	point=n+e; //position of the decimal point, counted from the first digit
+	if(negative) *p++='-';
+	if(point>0 && point<=21)
+	{
+		if(e>=0)
+		{
+			memcpy(p,first,n);
+			p+=n;
+			for(i=0; i<e; i++) *p++='0';
+		}
+		else
+		{
+			memcpy(p,first,point);
+			p+=point;
+			*p++='.';
+			memcpy(p,first+point,n-point);
+			p+=n-point;
+		}
+	}
+	else if(point<=0 && point>-6)
+	{
+		*p++='0';
+		*p++='.';
+		for(i=0; i<-point; i++) *p++='0';
+		memcpy(p,first,n);
+		p+=n;
+	}
+	else
+	{
+		*p++=first[0];
+		if(n>1)
+		{
+			*p++='.';
+			memcpy(p,first+1,n-1);
+			p+=n-1;
+		}
+		*p++='e';
+		*p++=(point-1<0)?'-':'+';
+		char exponent[8];
+		char *eend=exponent+sizeof(exponent);
+		char *efirst=number_digits_backwards(eend,(uint64_t)(point-1<0?1-point:point-1));
+		memcpy(p,efirst,eend-efirst);
+		p+=eend-efirst;
+	}
+	return (size_t)(p-dest);
+}
+
+//PRIVATE
+
+/**
+* Parses a decimal integer from the 'size' bytes at 'data', which need not be null-terminated.
+* Accepts an optional sign followed by digits only; no whitespace, no base prefixes.
+* Does not depend on the locale.
+*
+* @param data the text to parse.
+* @param size the number of bytes.
+* @param result receives the value.
+* @return true, if the whole text is an integer that fits in a long; false, if not.
+*/
+bool string_to_long(const char *data, size_t size, long *result)
+{
+	const char *p=data, *end=data+size, *digits, *significant;
+	bool negative=false;
+	uint64_t v=0;
+	if(p<end && (*p=='-' || *p=='+'))
+	{
+		negative=(*p=='-');
+		p++;
+	}
+	digits=p;
+	while(p<end && *p=='0') p++;
+	significant=p;
+	p=number_digits(p,end,&v);
+	if(p!=end || p==digits) return false;
+	//19 digits always fit in 64 bits without wrapping
+	if(p-significant>NUMBER_MAX_DIGITS) return false;
+	if(negative)
+	{
+		if(v>(uint64_t)LONG_MAX+1) return false;
+		*result=(v==(uint64_t)LONG_MAX+1)?LONG_MIN:-(long)v;
+	}
+	else
+	{
+		if(v>(uint64_t)LONG_MAX) return false;
+		*result=(long)v;
+	}
+	return true;
+}
+
+/**
+* Parses a decimal floating-point number from the 'size' bytes at 'data', which need not be
+* null-terminated, and rounds it correctly to the nearest double.
+* Accepts [+-] digits [. digits] [(e|E) [+-] digits], as well as "inf", "infinity" and "nan"
+* in any case. The decimal separator is always '.', whatever the locale.
+* Values too large for a double become infinity; values too small become zero.
+*
+* @param data the text to parse.
+* @param size the number of bytes.
+* @param result receives the value.
+* @return true, if the whole text is a number; false, if not.
+*/
+bool string_to_double(const char *data, size_t size, double *result)
+{
+	number_decimal d;
+	uint64_t bits;
+	double value;
+	if(!number_parse_decimal(data,data+size,&d))
+	{
+		const char *p=data, *end=data+size;
+		bool negative=false;
+		if(p<end && (*p=='-' || *p=='+'))
+		{
+			negative=(*p=='-');
+			p++;
+		}
+		if(number_word(p,end,"inf") || number_word(p,end,"infinity")) value=__builtin_inf();
+		else if(number_word(p,end,"nan")) value=__builtin_nan("");
+		else return false;
+		*result=negative?-value:value;
+		return true;
+	}
+	if(!d.truncated && d.mantissa<=(1ull<<53) && d.exponent>=-22 && d.exponent<=22)
+	{
+		//both operands are exact, so a single correctly rounded operation suffices (Clinger)
+		value=(double)d.mantissa;
+		if(d.exponent<0) value/=number_exact_power10[-d.exponent];
+		else value*=number_exact_power10[d.exponent];
+		*result=d.negative?-value:value;
+		return true;
+	}
+	bits=number_eisel_lemire(d.mantissa,d.exponent);
+	if(d.truncated && bits!=number_eisel_lemire(d.mantissa+1,d.exponent))
+		return number_strtod(data,size,result);
+	if(d.negative) bits|=1ull<<63;
+	memcpy(&value,&bits,sizeof(value));
+	*result=value;
+	return true;
+}
+
+/**
+* Parses a decimal integer from a view. See string_to_long().
+*
+* @param v the text to parse.
+* @param result receives the value.
+* @return true, if the whole view is an integer that fits in a long; false, if not.
+*/
+bool view_to_long(view v, long *result)
+{
+	return string_to_long(v.data,v.size,result);
+}
+
+/**
+* Parses a decimal floating-point number from a view. See string_to_double().
+*
+* @param v the text to parse.
+* @param result receives the value.
+* @return true, if the whole view is a number; false, if not.
+*/
+bool view_to_double(view v, double *result)
+{
+	return string_to_double(v.data,v.size,result);
+}
+
+/**
+* Writes the decimal representation of a long, without terminating zero.
+* 'dest' must have room for NUMBER_MAX_LENGTH bytes.
+*
+* @param dest where to write the digits.
+* @param value the value.
+* @return the number of bytes written.
+*/
+size_t number_write_long(char *dest, long value)
+{
+	char digits[24];
+	char *end=digits+sizeof(digits);
+	char *first;
+	size_t n;
+	uint64_t magnitude=value<0?-(uint64_t)value:(uint64_t)value;
+	first=number_digits_backwards(end,magnitude);
+	if(value<0) *--first='-';
+	n=(size_t)(end-first);
+	memcpy(dest,first,n);
+	return n;
+}
+
+/**
+* Writes the shortest decimal representation of a double that reads back as the same double,
+* without terminating zero. Integral values below 2^53 are written without fraction,
+* very large and very small values in scientific notation ("1e+21", "1.5e-7"),
+* and the special values as "NaN", "Infinity" and "-Infinity".
+* The decimal separator is always '.', whatever the locale.
+* 'dest' must have room for NUMBER_MAX_LENGTH bytes.
+*
+* @param dest where to write the characters.
+* @param value the value.
+* @return the number of bytes written.
+*/
+size_t number_write_double(char *dest, double value)
+{
+	uint64_t bits, t, c, f;
+	int bq, e;
+	bool negative;
+	memcpy(&bits,&value,sizeof(bits));
+	negative=(bits>>63)!=0;
+	bq=(int)((bits>>NUMBER_MANTISSA_BITS)&NUMBER_INFINITE_POWER);
+	t=bits&((1ull<<NUMBER_MANTISSA_BITS)-1);
+	if(bq==NUMBER_INFINITE_POWER)
+	{
+		if(t!=0)
+		{
+			memcpy(dest,"NaN",3);
+			return 3;
+		}
+		if(negative)
+		{
+			memcpy(dest,"-Infinity",9);
+			return 9;
+		}
+		memcpy(dest,"Infinity",8);
+		return 8;
+	}
+	if(bq!=0)
+	{
+		int mq=1075-bq; //the value is c 2^-mq
+		c=(1ull<<NUMBER_MANTISSA_BITS)|t;
+		if(mq>0 && mq<53 && ((c>>mq)<<mq)==c)
+		{
+			//an integer below 2^53 is its own shortest representation
+			return number_layout(dest,negative,c>>mq,0);
+		}
+		number_shortest(-mq,c,&f,&e);
+		return number_layout(dest,negative,f,e);
+	}
+	if(t!=0)
+	{
+		//subnormal
+		number_shortest(-1074,t,&f,&e);
+		number_shorten(t,&f,&e);
+		return number_layout(dest,negative,f,e);
+	}
+	if(negative)
+	{
+		memcpy(dest,"-0",2);
+		return 2;
+	}
+	*dest='0';
+	return 1;
+}
+
+/**
+* Writes an unsigned long in decimal, without terminating zero.
+* 'dest' must have room for NUMBER_MAX_LENGTH bytes.
+*
+* @param dest where to write the characters.
+* @param value the value.
+* @return the number of bytes written.
+*/
+size_t number_write_ulong(char *dest, unsigned long value)
+{
+	char digits[24];
+	char *end=digits+sizeof(digits);
+	char *first=number_digits_backwards(end,value);
+	size_t n=(size_t)(end-first);
+	memcpy(dest,first,n);
+	return n;
+}
+
+/**
+* Writes a double with a fixed number of decimals, exactly like printf("%.*f") does
+* in the C locale: the exact binary value is rounded half to even.
+* Only handles finite values below 1e15 and at most NUMBER_MAX_FIXED_PRECISION decimals;
+* for anything else, nothing is written and the caller must fall back on printf.
+* 'dest' must have room for NUMBER_MAX_LENGTH bytes.
+*
+* @param dest where to write the characters.
+* @param value the value.
+* @param precision the number of decimals.
+* @return the number of bytes written; or 0 if the value was not handled.
+*/
+size_t number_write_fixed(char *dest, double value, int precision)
+{
+#ifdef __SIZEOF_INT128__
+	static const uint64_t scale[NUMBER_MAX_FIXED_PRECISION+1]=
+		{1ull,10ull,100ull,1000ull,10000ull,100000ull,1000000ull,10000000ull,100000000ull,1000000000ull};
+	uint64_t bits, m, whole, fraction;
+	__uint128_t product, q, rest, half;
+	int be, shift, i;
+	char *p=dest;
+	if(precision<0 || precision>NUMBER_MAX_FIXED_PRECISION) return 0;
+	if(!(value>-1e15 && value<1e15)) return 0;
+	memcpy(&bits,&value,sizeof(bits));
+	be=(int)((bits>>NUMBER_MANTISSA_BITS)&NUMBER_INFINITE_POWER);
+	m=bits&((1ull<<NUMBER_MANTISSA_BITS)-1);
+	if(be!=0) m|=1ull<<NUMBER_MANTISSA_BITS;
+	else be=1;
+	//value=m*2^shift; the scaled value, value*10^precision, stays below 1e24
+	shift=be-1075;
+	product=(__uint128_t)m*scale[precision];
+	if(shift>=0)
+	{
+		q=product<<shift;
+	}
+	else if(shift<=-90)
+	{
+		q=0; //less than half a unit of the last decimal
+	}
+	else
+	{
+		q=product>>-shift;
+		rest=product&((((__uint128_t)1)<<-shift)-1);
+		half=((__uint128_t)1)<<(-shift-1);
+		if(rest>half || (rest==half && (q&1)!=0)) q++;
+	}
+	whole=(uint64_t)(q/scale[precision]);
+	fraction=(uint64_t)(q%scale[precision]);
+	if((bits>>63)!=0) *p++='-';
+	p+=number_write_ulong(p,whole);
+	if(precision>0)
+	{
+		*p++='.';
+		for(i=precision-1; i>=0; i--)
+		{
+			p[i]=(char)('0'+fraction%10);
+			fraction/=10;
+		}
+		p+=precision;
+	}
+	return (size_t)(p-dest);
+#else
+	return 0;
+#endif
+}
@@ -0,0 +1,55 @@
+/**
+ *
+ * libscriptify
+ *
+ * @author  Erik Poupaert <erik@sankuru.biz>
+ *
+ * @section LICENSE
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU LGPL as
+ * published by the Free Software Foundation; either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * LGPL for more details at: http://www.gnu.org/licenses/lgpl.html
+ *
+ * @section DESCRIPTION
+ *
+ * Conversion between numbers and their decimal text representation.
+ * Parsing works on a pointer plus length, needs no terminating zero, and does not depend on the locale.
+ *
+ */
+#ifndef _NUMBER_H
+#define _NUMBER_H
+
+#include <stddef.h>
+#include <stdbool.h>
+#include "view.h"
+
+#ifdef __cplusplus
+	extern "C" {
+#endif
+
+/* parsing */
+bool string_to_long(const char *data, size_t size, long *result);
+bool string_to_double(const char *data, size_t size, double *result);
+bool view_to_long(view v, long *result);
+bool view_to_double(view v, double *result);
+
+/* formatting */
+#define NUMBER_MAX_LENGTH 32
+#define NUMBER_MAX_FIXED_PRECISION 9
+
+size_t number_write_long(char *dest, long value);
+size_t number_write_ulong(char *dest, unsigned long value);
+size_t number_write_double(char *dest, double value);
+size_t number_write_fixed(char *dest, double value, int precision);
+
+#ifdef __cplusplus
+	}
+#endif
+
+#endif // _NUMBER_H
@@ -24,8 +24,29 @@
  *
  */
 #include "object.h"
+//threads started through object_thread_create() must be known to the collector
+#define GC_THREADS
 #include <gc/gc.h>
 
+static pthread_once_t object_once=PTHREAD_ONCE_INIT;
+
+static void object_init_once()
+{
+	GC_INIT();
+	GC_allow_register_threads();
+}
+
+/**
+* Initializes the collector for use by several threads.
+* Call it at the start of the program, before the first allocation, if the program
+* starts threads that use objects. It is called automatically before the first thread
+* is started or registered; calling it more than once does no harm.
+*/
+void object_init()
+{
+	pthread_once(&object_once,object_init_once);
+}
+
 object object_new(size_t size)
 {
 	return GC_malloc(size);
@@ -36,3 +57,129 @@ object object_resize(object obj, size_t size)
 	return GC_realloc(obj,size);
 }
 
+/**
+* Allocates memory that the collector will not scan for pointers,
+* such as character data or tables of hidden pointers.
+* Unlike object_new(), the memory is not cleared.
+*
+* @param size the number of bytes to allocate.
+* @return A pointer to the new memory.
+*/
+object object_new_atomic(size_t size)
+{
+	return GC_malloc_atomic(size);
+}
+
+/**
+* Points a weak reference at an object.
+* The reference does not keep the object alive; once the object becomes unreachable
+* otherwise, the collector reclaims it and clears the reference.
+* The reference itself must stay at the same address until it is cleared.
+*
+* @param ref the weak reference to set.
+* @param obj the object to refer to.
+*/
+void object_weakref_set(object_weakref *ref, object obj)
+{
+	*ref=(object_weakref)GC_HIDE_POINTER(obj);
+	GC_general_register_disappearing_link((void **)ref,obj);
+}
+
+static void *object_weakref_reveal(void *ref)
+{
+	object_weakref hidden=*(object_weakref *)ref;
+	return hidden==0?NULL:GC_REVEAL_POINTER(hidden);
+}
+
+/**
+* Retrieves the object a weak reference points to.
+* The pointer returned is a strong reference again, for as long as the caller holds it.
+*
+* @param ref the weak reference.
+* @return the object; or NULL if it has been reclaimed or the reference was never set.
+*/
+object object_weakref_get(object_weakref *ref)
+{
+	//revealing races with the collector clearing the link, unless done under its lock
+	return GC_call_with_alloc_lock(object_weakref_reveal,ref);
+}
+
+/**
+* Detaches a weak reference from its object, so that the memory holding
+* the reference may be reused or released.
+*
+* @param ref the weak reference to clear.
+*/
+void object_weakref_clear(object_weakref *ref)
+{
+	if(*ref!=0) GC_unregister_disappearing_link((void **)ref);
+	*ref=0;
+}
+
+/**
+* Registers a function that the collector calls once an object has become unreachable,
+* before reclaiming it; for example, to release a resource the object owns outside the heap.
+* Registering NULL removes the finalizer again.
+*
+* @param obj the object, as returned by object_new().
+* @param finalizer the function to call with the object.
+* @param data passed on to the finalizer.
+*/
+void object_set_finalizer(object obj, object_finalizer finalizer, void *data)
+{
+	GC_register_finalizer(obj,(GC_finalization_proc)finalizer,data,NULL,NULL);
+}
+
+/**
+* Starts a thread that the collector knows about, so that the objects referenced
+* from its stack and registers are not reclaimed under its feet.
+* Every thread that allocates objects or holds references to them must be started this way.
+*
+* @param thread receives the id of the new thread.
+* @param start the function the thread runs.
+* @param arg passed on to 'start'.
+* @return 0 on success; otherwise an error number, as for pthread_create().
+*/
+int object_thread_create(pthread_t *thread, void *(*start)(void *), void *arg)
+{
+	object_init();
+	return pthread_create(thread,NULL,start,arg);
+}
+
+/**
+* Waits for a thread started with object_thread_create() to finish.
+*
+* @param thread the id of the thread.
+* @param result receives the value the thread returned; may be NULL.
+* @return 0 on success; otherwise an error number, as for pthread_join().
+*/
+int object_thread_join(pthread_t thread, void **result)
+{
+	return pthread_join(thread,result);
+}
+
+/**
+* Registers the calling thread with the collector, for threads that were not started
+* with object_thread_create(), such as threads started by another library.
+* Registering a thread that is registered already does no harm.
+*
+* @return true, if the thread is registered; false, if registration failed.
+*/
+bool object_thread_register()
+{
+	struct GC_stack_base base;
+	object_init();
+	if(GC_thread_is_registered()) return true;
+	if(GC_get_stack_base(&base)!=GC_SUCCESS) return false;
+	GC_register_my_thread(&base);
+	return true;
+}
+
+/**
+* Unregisters the calling thread from the collector, before it exits.
+* Only for threads registered with object_thread_register().
+*/
+void object_thread_unregister()
+{
+	GC_unregister_my_thread();
+}
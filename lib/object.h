@@ -27,6 +27,8 @@
 #define _OBJECT_H
 
 #include <stddef.h>
+#include <stdbool.h>
+#include <pthread.h>
 
 #ifdef __cplusplus
 	extern "C" {
@@ -34,8 +36,27 @@
 
 typedef void* object;
 
+/* a weak reference holds an object without keeping it alive */
+typedef size_t object_weakref;
+
+/* called by the collector before it reclaims an object */
+typedef void (*object_finalizer)(object obj, void *data);
+
+void object_init();
 object object_new(size_t size);
+object object_new_atomic(size_t size);
 object object_resize(object obj, size_t size);
+void object_set_finalizer(object obj, object_finalizer finalizer, void *data);
+
+/* threads that allocate objects or hold references to them */
+int object_thread_create(pthread_t *thread, void *(*start)(void *), void *arg);
+int object_thread_join(pthread_t thread, void **result);
+bool object_thread_register();
+void object_thread_unregister();
+
+void object_weakref_set(object_weakref *ref, object obj);
+object object_weakref_get(object_weakref *ref);
+void object_weakref_clear(object_weakref *ref);
 
 #ifdef __cplusplus
 	}
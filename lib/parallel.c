@@ -0,0 +1,349 @@
+/**
+ *
+ * libscriptify
+ *
+ * @author  Erik Poupaert <erik@sankuru.biz>
+ *
+ * @section LICENSE
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU LGPL as
+ * published by the Free Software Foundation; either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * LGPL for more details at: http://www.gnu.org/licenses/lgpl.html
+ *
+ * @section DESCRIPTION
+ *
+ * Processing of large inputs on all cores: the input is cut into chunks that end on a record boundary,
+ * the records of each chunk are processed by worker threads, and the results per chunk are merged.
+ *
+ */
+#define _GNU_SOURCE
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <pthread.h>
+#include "object.h"
+#include "string_utf8.h"
+#include "mapped_file.h"
+#include "threadpool.h"
+#include "parallel.h"
+
+//PRIVATE
+
+typedef struct _parallel_chunk
+{
+	struct _parallel_chunk *next;
+	const char *data;
+	size_t size;
+	size_t index; //position of the chunk in the input
+	object state;
+	struct _parallel_run *run;
+} _parallel_chunk;
+
+typedef _parallel_chunk* parallel_chunk;
+
+typedef struct _parallel_run
+{
+	parallel_job job;
+	threadpool pool;
+	threadpool_group group;
+	pthread_mutex_t lock;
+	pthread_cond_t done; //signalled when a chunk is finished
+	parallel_chunk finished; //chunks processed but not merged yet
+	size_t finishes; //number of chunks processed so far
+	size_t in_flight; //chunks spawned, and not merged yet
+	size_t limit; //maximum number of chunks in flight, which bounds the memory used
+	size_t next_index;
+	size_t next_merge; //ordered merges: index of the next chunk to merge
+	bool private_pool; //the pool was created for this run, with job->threads workers
+} _parallel_run;
+
+typedef _parallel_run* parallel_run;
+
+/**
+* Runs the callbacks of a job over the records of a chunk.
+*/
+static void parallel_process(parallel_job job, parallel_chunk chunk)
+{
+	const char *p=chunk->data;
+	const char *end=p+chunk->size;
+	object state=job->init!=NULL?job->init(job->data):NULL;
+	while(p<end)
+	{
+		const char *found=(const char *)memchr(p,job->delimiter,(size_t)(end-p));
+		view record=view_new(p,found!=NULL?(size_t)(found-p):(size_t)(end-p));
+		if(job->delimiter==CHAR_LF && record.size>0 && record.data[record.size-1]==CHAR_CR) record.size--;
+		job->record(record,state,job->data);
+		p=found!=NULL?found+1:end;
+	}
+	chunk->state=state;
+}
+
+static void parallel_chunk_task(void *arg)
+{
+	parallel_chunk chunk=(parallel_chunk)arg;
+	parallel_run run=chunk->run;
+	parallel_process(run->job,chunk);
+	pthread_mutex_lock(&run->lock);
+	chunk->next=run->finished;
+	run->finished=chunk;
+	run->finishes++;
+	pthread_cond_signal(&run->done);
+	pthread_mutex_unlock(&run->lock);
+}
+
+/**
+* Takes the finished chunks that may be merged now off the finished list, whose lock is held.
+* Ordered merges only take the chunks that come next in the input, in input order.
+*/
+static parallel_chunk parallel_take_mergeable(parallel_run run)
+{
+	parallel_chunk taken=NULL, *tail=&taken, *link;
+	if(!run->job->ordered)
+	{
+		taken=run->finished;
+		run->finished=NULL;
+		return taken;
+	}
+	link=&run->finished;
+	while(*link!=NULL)
+	{
+		if((*link)->index==run->next_merge)
+		{
+			parallel_chunk chunk=*link;
+			*link=chunk->next;
+			chunk->next=NULL;
+			*tail=chunk;
+			tail=&chunk->next;
+			run->next_merge++;
+			//an earlier chunk in the list may be next now
+			link=&run->finished;
+		}
+		else link=&(*link)->next;
+	}
+	return taken;
+}
+
+/**
+* Merges finished chunks on the calling thread until at most 'max_in_flight' chunks are left in flight.
+* While no chunk can be merged, the calling thread runs tasks of the shared pool; it blocks
+* when there are none left to run, until another chunk is finished. Chunks finished out of
+* order do not wake it up for nothing, since they are only merged after the chunks before them.
+*/
+static void parallel_collect(parallel_run run, size_t max_in_flight)
+{
+	parallel_chunk chunk;
+	size_t merged;
+	pthread_mutex_lock(&run->lock);
+	while(run->in_flight>max_in_flight)
+	{
+		chunk=parallel_take_mergeable(run);
+		if(chunk==NULL)
+		{
+			size_t finishes=run->finishes;
+			bool helped=false;
+			if(!run->private_pool)
+			{
+				pthread_mutex_unlock(&run->lock);
+				helped=threadpool_help(run->pool);
+				pthread_mutex_lock(&run->lock);
+			}
+			//no chunk finished while the lock was released: nothing can have become mergeable
+			if(!helped && run->finishes==finishes) pthread_cond_wait(&run->done,&run->lock);
+			continue;
+		}
+		pthread_mutex_unlock(&run->lock);
+		for(merged=0; chunk!=NULL; chunk=chunk->next, merged++)
+			if(run->job->merge!=NULL) run->job->merge(chunk->state,run->job->data);
+		pthread_mutex_lock(&run->lock);
+		run->in_flight-=merged;
+	}
+	pthread_mutex_unlock(&run->lock);
+}
+
+static parallel_run parallel_start(parallel_job job)
+{
+	parallel_run run=(parallel_run)object_new(sizeof(_parallel_run));
+	int concurrency;
+	run->job=job;
+	run->private_pool=job->threads>0;
+	run->pool=run->private_pool?threadpool_new(job->threads):threadpool_default();
+	run->group=threadpool_group_new(run->pool);
+	pthread_mutex_init(&run->lock,NULL);
+	pthread_cond_init(&run->done,NULL);
+	concurrency=threadpool_size(run->pool);
+	run->limit=2*(size_t)concurrency;
+	return run;
+}
+
+/**
+* Hands a chunk to the thread pool, after waiting while too many chunks are in flight.
+*/
+static void parallel_submit(parallel_run run, const char *data, size_t size)
+{
+	parallel_chunk chunk=(parallel_chunk)object_new(sizeof(_parallel_chunk));
+	chunk->data=data;
+	chunk->size=size;
+	chunk->index=run->next_index++;
+	chunk->run=run;
+	parallel_collect(run,run->limit-1);
+	pthread_mutex_lock(&run->lock);
+	run->in_flight++;
+	pthread_mutex_unlock(&run->lock);
+	threadpool_group_spawn(run->group,parallel_chunk_task,chunk);
+}
+
+/**
+* Waits for all chunks and merges them.
+*/
+static void parallel_finish(parallel_run run)
+{
+	parallel_collect(run,0);
+	threadpool_group_wait(run->group);
+	if(run->private_pool) threadpool_stop(run->pool);
+	pthread_cond_destroy(&run->done);
+	pthread_mutex_destroy(&run->lock);
+}
+
+//PRIVATE
+
+/**
+* Creates a new job that calls 'record' for every line of its input.
+* Set the other fields of the job before running it to change the defaults:
+* the default thread pool, PARALLEL_CHUNK_SIZE bytes per chunk, lines as records,
+* no per-chunk state and unordered merges.
+*
+* @param record the function to call for every record.
+* @param data passed on to all callbacks.
+* @return A pointer to the new job.
+*/
+parallel_job parallel_job_new(parallel_record_fn record, void *data)
+{
+	parallel_job job=(parallel_job)object_new(sizeof(_parallel_job));
+	job->record=record;
+	job->data=data;
+	job->chunk_size=PARALLEL_CHUNK_SIZE;
+	job->delimiter=CHAR_LF;
+	return job;
+}
+
+/**
+* Runs a job over the records of a block of memory, such as a mapped file.
+* The input is cut into chunks of about 'chunk_size' bytes, each ending at a delimiter,
+* and the chunks are processed by the default thread pool at the same time.
+* Each chunk gets its own state from 'init', so 'record' needs no locking as long as it
+* only touches that state. The states are handed to 'merge' on the calling thread,
+* one at a time, in input order if 'ordered' is set.
+* When the delimiter is CHAR_LF, a CR before it is dropped from the record as well.
+*
+* @param job the job.
+* @param input the records.
+* @return true.
+*/
+bool parallel_run_view(parallel_job job, view input)
+{
+	parallel_run run=parallel_start(job);
+	size_t start=0, end;
+	size_t chunk_size=job->chunk_size>0?job->chunk_size:PARALLEL_CHUNK_SIZE;
+	while(start<input.size)
+	{
+		end=start+chunk_size;
+		if(end>=input.size)
+		{
+			end=input.size;
+		}
+		else
+		{
+			const char *found=(const char *)memchr(input.data+end,job->delimiter,input.size-end);
+			end=found!=NULL?(size_t)(found-input.data)+1:input.size;
+		}
+		parallel_submit(run,input.data+start,end-start);
+		start=end;
+	}
+	parallel_finish(run);
+	return true;
+}
+
+/**
+* Runs a job over the records of a file, which is mapped into memory; see parallel_run_view().
+*
+* @param job the job.
+* @param path the file.
+* @return true, if the file could be mapped and processed; false, if not, with errno set.
+*/
+bool parallel_run_file(parallel_job job, const char *path)
+{
+	mapped_file file=string_map_file(path,MAPPED_FILE_NORMAL);
+	if(file==NULL) return false;
+	parallel_run_view(job,mapped_file_view(file));
+	mapped_file_close(file);
+	return true;
+}
+
+/**
+* Runs a job over the records read from a file descriptor, such as a pipe; see parallel_run_view().
+* The input is read chunk by chunk while the workers process the previous chunks,
+* with at most two chunks per worker held in memory.
+*
+* @param job the job.
+* @param fd the file descriptor to read from; it is not closed.
+* @return true, if all input was read; false, if a read failed, with errno set.
+*/
+bool parallel_run_fd(parallel_job job, int fd)
+{
+	parallel_run run=parallel_start(job);
+	size_t chunk_size=job->chunk_size>0?job->chunk_size:PARALLEL_CHUNK_SIZE;
+	const char *carry=NULL;
+	size_t carry_size=0;
+	bool eof=false, ok=true;
+	int error=0;
+	while(!eof)
+	{
+		//a record longer than a chunk is carried over into a larger one
+		size_t capacity=carry_size<chunk_size?chunk_size:2*carry_size;
+		char *data=(char *)object_new_atomic(capacity);
+		size_t size=carry_size;
+		const char *last;
+		if(carry_size>0) memcpy(data,carry,carry_size);
+		while(size<capacity)
+		{
+			ssize_t n=read(fd,data+size,capacity-size);
+			if(n>0)
+			{
+				size+=(size_t)n;
+				continue;
+			}
+			if(n<0 && errno==EINTR) continue;
+			if(n<0)
+			{
+				ok=false;
+				error=errno;
+			}
+			eof=true;
+			break;
+		}
+		if(eof)
+		{
+			if(size>0) parallel_submit(run,data,size);
+			break;
+		}
+		last=(const char *)memrchr(data,job->delimiter,size);
+		if(last==NULL)
+		{
+			carry=data;
+			carry_size=size;
+			continue;
+		}
+		parallel_submit(run,data,(size_t)(last-data)+1);
+		carry=last+1;
+		carry_size=size-((size_t)(last-data)+1);
+	}
+	parallel_finish(run);
+	if(!ok) errno=error;
+	return ok;
+}
@@ -0,0 +1,70 @@
+/**
+ *
+ * libscriptify
+ *
+ * @author  Erik Poupaert <erik@sankuru.biz>
+ *
+ * @section LICENSE
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU LGPL as
+ * published by the Free Software Foundation; either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * LGPL for more details at: http://www.gnu.org/licenses/lgpl.html
+ *
+ * @section DESCRIPTION
+ *
+ * Processing of large inputs on all cores: the input is cut into chunks that end on a record boundary,
+ * the records of each chunk are processed by worker threads, and the results per chunk are merged.
+ *
+ */
+#ifndef _PARALLEL_H
+#define _PARALLEL_H
+
+#include <stddef.h>
+#include <stdbool.h>
+#include "object.h"
+#include "view.h"
+
+#ifdef __cplusplus
+	extern "C" {
+#endif
+
+/* default number of bytes per chunk */
+#define PARALLEL_CHUNK_SIZE (4*1024*1024)
+
+/* creates the state of a chunk; runs on a worker thread */
+typedef object (*parallel_init_fn)(void *data);
+/* processes one record of a chunk; runs on a worker thread */
+typedef void (*parallel_record_fn)(view record, object state, void *data);
+/* merges the state of a finished chunk into the result; runs on the calling thread */
+typedef void (*parallel_merge_fn)(object state, void *data);
+
+typedef struct
+{
+	parallel_init_fn init; //NULL: the state of every chunk is NULL
+	parallel_record_fn record;
+	parallel_merge_fn merge; //NULL: states are not merged
+	void *data; //passed on to the callbacks
+	int threads; //number of worker threads, in a pool of the run's own; 0 for the default thread pool. At most twice as many chunks are in memory at once
+	size_t chunk_size; //approximate number of bytes per chunk
+	char delimiter; //the byte that ends a record; CHAR_LF for lines
+	bool ordered; //merge the chunks in input order
+} _parallel_job;
+
+typedef _parallel_job* parallel_job;
+
+parallel_job parallel_job_new(parallel_record_fn record, void *data);
+bool parallel_run_view(parallel_job job, view input);
+bool parallel_run_file(parallel_job job, const char *path);
+bool parallel_run_fd(parallel_job job, int fd);
+
+#ifdef __cplusplus
+	}
+#endif
+
+#endif // _PARALLEL_H
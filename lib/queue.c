@@ -0,0 +1,336 @@
+/**
+ *
+ * libscriptify
+ *
+ * @author  Erik Poupaert <erik@sankuru.biz>
+ *
+ * @section LICENSE
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU LGPL as
+ * published by the Free Software Foundation; either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * LGPL for more details at: http://www.gnu.org/licenses/lgpl.html
+ *
+ * @section DESCRIPTION
+ *
+ * A bounded lock-free queue of any values for passing work between threads,
+ * with any number of producers and consumers, in the style of Dmitry Vyukov's ring queue.
+ *
+ */
+#include <limits.h>
+#include <sched.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+#include "object.h"
+#include "queue.h"
+
+//PRIVATE
+
+/* number of times a blocking call tries again before it sleeps */
+#define QUEUE_SPINS 64
+
+static void queue_futex_wait(int *word, int seen)
+{
+	syscall(SYS_futex,word,FUTEX_WAIT_PRIVATE,seen,NULL,NULL,0);
+}
+
+/**
+* Wakes up to 'count' threads sleeping on 'word', if there are any.
+* The fence orders the cells just written before the check of 'waiters',
+* so that a thread that is about to sleep either sees the cells, or gets woken.
+*/
+static void queue_wake(int *word, int *waiters, int count)
+{
+	__atomic_thread_fence(__ATOMIC_SEQ_CST);
+	if(__atomic_load_n(waiters,__ATOMIC_RELAXED)==0) return;
+	__atomic_add_fetch(word,1,__ATOMIC_SEQ_CST);
+	syscall(SYS_futex,word,FUTEX_WAKE_PRIVATE,count,NULL,NULL,0);
+}
+
+/**
+* Claims up to 'count' consecutive cells at the front or the back of the queue with a single
+* compare-and-swap. A cell can be claimed when its sequence is its position plus 'lag':
+* 0 for cells free to push into, 1 for cells filled and ready to pop.
+*
+* @return the number of cells claimed, starting at position '*start'; 0, if there are none.
+*/
+static size_t queue_claim(queue q, size_t *position, size_t lag, size_t count, size_t *start)
+{
+	size_t pos=__atomic_load_n(position,__ATOMIC_RELAXED);
+	for(;;)
+	{
+		queue_cell cell=&q->cells[pos&q->mask];
+		size_t seq=__atomic_load_n(&cell->sequence,__ATOMIC_ACQUIRE);
+		long diff=(long)(seq-(pos+lag));
+		size_t n;
+		if(diff<0) return 0;
+		if(diff>0)
+		{
+			//another thread claimed this cell first
+			pos=__atomic_load_n(position,__ATOMIC_RELAXED);
+			continue;
+		}
+		for(n=1; n<count; n++)
+		{
+			cell=&q->cells[(pos+n)&q->mask];
+			if(__atomic_load_n(&cell->sequence,__ATOMIC_ACQUIRE)!=pos+n+lag) break;
+		}
+		if(__atomic_compare_exchange_n(position,&pos,pos+n,true,__ATOMIC_RELAXED,__ATOMIC_RELAXED))
+		{
+			*start=pos;
+			return n;
+		}
+	}
+}
+
+//PRIVATE
+
+/**
+* Creates a new empty queue.
+*
+* @param capacity the maximum number of values in the queue; it is rounded up to a power of two,
+* and is at least 2.
+* @return A pointer to the new queue.
+*/
+queue queue_new(size_t capacity)
+{
+	queue q=(queue)object_new(sizeof(_queue));
+	size_t size=2, i;
+	while(size<capacity) size*=2;
+	q->cells=(queue_cell)object_new(size*sizeof(_queue_cell));
+	q->mask=size-1;
+	for(i=0; i<size; i++) q->cells[i].sequence=i;
+	return q;
+}
+
+/**
+* Returns the maximum number of values in a queue.
+*
+* @param q the queue.
+* @return the capacity.
+*/
+size_t queue_capacity(queue q)
+{
+	return q->mask+1;
+}
+
+/**
+* Returns the number of values in a queue. While other threads push and pop,
+* it is only an estimate.
+*
+* @param q the queue.
+* @return the number of values.
+*/
+size_t queue_size(queue q)
+{
+	size_t dequeue_pos=__atomic_load_n(&q->dequeue_pos,__ATOMIC_ACQUIRE);
+	size_t enqueue_pos=__atomic_load_n(&q->enqueue_pos,__ATOMIC_ACQUIRE);
+	long size=(long)(enqueue_pos-dequeue_pos);
+	if(size<0) return 0;
+	if((size_t)size>q->mask+1) return q->mask+1;
+	return (size_t)size;
+}
+
+/**
+* Pushes a value at the back of a queue, without waiting.
+*
+* @param q the queue.
+* @param value the value.
+* @return true, if the value was pushed; false, if the queue is full or closed.
+*/
+bool queue_push(queue q, any value)
+{
+	return queue_push_batch(q,&value,1)==1;
+}
+
+/**
+* Pops the value at the front of a queue, without waiting.
+*
+* @param q the queue.
+* @param value receives the value.
+* @return true, if a value was popped; false, if the queue is empty.
+*/
+bool queue_pop(queue q, any *value)
+{
+	return queue_pop_batch(q,value,1)==1;
+}
+
+/**
+* Pushes as many values as fit at the back of a queue, without waiting.
+* The values are claimed with a single atomic operation, and stay together and in order.
+*
+* @param q the queue.
+* @param values the values.
+* @param count the number of values.
+* @return the number of values pushed, from the start of 'values'; 0, if the queue is full or closed.
+*/
+size_t queue_push_batch(queue q, any *values, size_t count)
+{
+	size_t start, n, i;
+	if(count==0 || queue_is_closed(q)) return 0;
+	n=queue_claim(q,&q->enqueue_pos,0,count,&start);
+	for(i=0; i<n; i++)
+	{
+		queue_cell cell=&q->cells[(start+i)&q->mask];
+		cell->value=values[i];
+		__atomic_store_n(&cell->sequence,start+i+1,__ATOMIC_RELEASE);
+	}
+	if(n>0) queue_wake(&q->pushed,&q->pop_waiters,n<INT_MAX?(int)n:INT_MAX);
+	return n;
+}
+
+/**
+* Pops up to 'max' values from the front of a queue, without waiting.
+* The cells of the values popped are cleared, so that the queue does not keep them alive.
+*
+* @param q the queue.
+* @param values receives the values, in order.
+* @param max the maximum number of values to pop.
+* @return the number of values popped; 0, if the queue is empty.
+*/
+size_t queue_pop_batch(queue q, any *values, size_t max)
+{
+	size_t start, n, i;
+	if(max==0) return 0;
+	n=queue_claim(q,&q->dequeue_pos,1,max,&start);
+	for(i=0; i<n; i++)
+	{
+		queue_cell cell=&q->cells[(start+i)&q->mask];
+		values[i]=cell->value;
+		cell->value=NULL;
+		__atomic_store_n(&cell->sequence,start+i+q->mask+1,__ATOMIC_RELEASE);
+	}
+	if(n>0) queue_wake(&q->popped,&q->push_waiters,n<INT_MAX?(int)n:INT_MAX);
+	return n;
+}
+
+/**
+* Pushes a value at the back of a queue, and waits while the queue is full.
+*
+* @param q the queue.
+* @param value the value.
+* @return true, if the value was pushed; false, if the queue is closed.
+*/
+bool queue_push_wait(queue q, any value)
+{
+	return queue_push_batch_wait(q,&value,1);
+}
+
+/**
+* Pops the value at the front of a queue, and waits while the queue is empty.
+*
+* @param q the queue.
+* @param value receives the value.
+* @return true, if a value was popped; false, if the queue is closed and empty.
+*/
+bool queue_pop_wait(queue q, any *value)
+{
+	return queue_pop_batch_wait(q,value,1)==1;
+}
+
+/**
+* Pushes all values at the back of a queue, and waits whenever the queue is full.
+* A waiting thread spins for a while, and then sleeps on a futex until values are popped.
+*
+* @param q the queue.
+* @param values the values.
+* @param count the number of values.
+* @return true, if all values were pushed; false, if the queue was closed first.
+*/
+bool queue_push_batch_wait(queue q, any *values, size_t count)
+{
+	int spins=0;
+	while(count>0)
+	{
+		size_t n=queue_push_batch(q,values,count);
+		int seen;
+		if(n>0)
+		{
+			values+=n;
+			count-=n;
+			spins=0;
+			continue;
+		}
+		if(queue_is_closed(q)) return false;
+		if(++spins<QUEUE_SPINS)
+		{
+			sched_yield();
+			continue;
+		}
+		seen=__atomic_load_n(&q->popped,__ATOMIC_SEQ_CST);
+		__atomic_add_fetch(&q->push_waiters,1,__ATOMIC_SEQ_CST);
+		n=queue_push_batch(q,values,count);
+		if(n==0 && !queue_is_closed(q)) queue_futex_wait(&q->popped,seen);
+		__atomic_sub_fetch(&q->push_waiters,1,__ATOMIC_SEQ_CST);
+		values+=n;
+		count-=n;
+	}
+	return true;
+}
+
+/**
+* Pops between 1 and 'max' values from the front of a queue, and waits while the queue is empty.
+* A waiting thread spins for a while, and then sleeps on a futex until values are pushed.
+* Once the queue is closed, the values still in it are popped before it reports the end.
+*
+* @param q the queue.
+* @param values receives the values, in order.
+* @param max the maximum number of values to pop.
+* @return the number of values popped; 0, if the queue is closed and empty.
+*/
+size_t queue_pop_batch_wait(queue q, any *values, size_t max)
+{
+	int spins=0;
+	if(max==0) return 0;
+	for(;;)
+	{
+		size_t n=queue_pop_batch(q,values,max);
+		int seen;
+		if(n>0) return n;
+		//values pushed before the queue was closed are still popped
+		if(queue_is_closed(q)) return queue_pop_batch(q,values,max);
+		if(++spins<QUEUE_SPINS)
+		{
+			sched_yield();
+			continue;
+		}
+		seen=__atomic_load_n(&q->pushed,__ATOMIC_SEQ_CST);
+		__atomic_add_fetch(&q->pop_waiters,1,__ATOMIC_SEQ_CST);
+		n=queue_pop_batch(q,values,max);
+		if(n==0 && !queue_is_closed(q)) queue_futex_wait(&q->pushed,seen);
+		__atomic_sub_fetch(&q->pop_waiters,1,__ATOMIC_SEQ_CST);
+		if(n>0) return n;
+	}
+}
+
+/**
+* Closes a queue: pushes fail from now on, and consumers that find the queue empty stop waiting.
+* Typically called by the last producer of a pipeline stage.
+*
+* @param q the queue.
+*/
+void queue_close(queue q)
+{
+	__atomic_store_n(&q->closed,true,__ATOMIC_SEQ_CST);
+	__atomic_add_fetch(&q->pushed,1,__ATOMIC_SEQ_CST);
+	__atomic_add_fetch(&q->popped,1,__ATOMIC_SEQ_CST);
+	syscall(SYS_futex,&q->pushed,FUTEX_WAKE_PRIVATE,INT_MAX,NULL,NULL,0);
+	syscall(SYS_futex,&q->popped,FUTEX_WAKE_PRIVATE,INT_MAX,NULL,NULL,0);
+}
+
+/**
+* Checks if a queue is closed.
+*
+* @param q the queue.
+* @return true, if the queue is closed; false, if not.
+*/
+bool queue_is_closed(queue q)
+{
+	return __atomic_load_n(&q->closed,__ATOMIC_SEQ_CST);
+}
@@ -0,0 +1,81 @@
+/**
+ *
+ * libscriptify
+ *
+ * @author  Erik Poupaert <erik@sankuru.biz>
+ *
+ * @section LICENSE
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU LGPL as
+ * published by the Free Software Foundation; either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * LGPL for more details at: http://www.gnu.org/licenses/lgpl.html
+ *
+ * @section DESCRIPTION
+ *
+ * A bounded lock-free queue of any values for passing work between threads,
+ * with any number of producers and consumers, in the style of Dmitry Vyukov's ring queue.
+ *
+ */
+#ifndef _QUEUE_H
+#define _QUEUE_H
+
+#include <stddef.h>
+#include <stdbool.h>
+#include "object.h"
+#include "any.h"
+
+#ifdef __cplusplus
+	extern "C" {
+#endif
+
+typedef struct
+{
+	size_t sequence; //position of the cell in the queue, telling whether it is free or filled
+	any value;
+} _queue_cell;
+
+typedef _queue_cell* queue_cell;
+
+typedef struct
+{
+	queue_cell cells;
+	size_t mask; //the capacity minus one; the capacity is a power of two
+	char padding1[64-sizeof(queue_cell)-sizeof(size_t)];
+	size_t enqueue_pos; //written by producers only
+	char padding2[64-sizeof(size_t)];
+	size_t dequeue_pos; //written by consumers only
+	char padding3[64-sizeof(size_t)];
+	int pushed; //futex word: changes when waiting consumers must check again
+	int popped; //futex word: changes when waiting producers must check again
+	int pop_waiters;
+	int push_waiters;
+	bool closed;
+} _queue;
+
+typedef _queue* queue;
+
+queue queue_new(size_t capacity);
+size_t queue_capacity(queue q);
+size_t queue_size(queue q);
+bool queue_push(queue q, any value);
+bool queue_pop(queue q, any *value);
+size_t queue_push_batch(queue q, any *values, size_t count);
+size_t queue_pop_batch(queue q, any *values, size_t max);
+bool queue_push_wait(queue q, any value);
+bool queue_pop_wait(queue q, any *value);
+bool queue_push_batch_wait(queue q, any *values, size_t count);
+size_t queue_pop_batch_wait(queue q, any *values, size_t max);
+void queue_close(queue q);
+bool queue_is_closed(queue q);
+
+#ifdef __cplusplus
+	}
+#endif
+
+#endif // _QUEUE_H
@@ -0,0 +1,180 @@
+/**
+ *
+ * libscriptify
+ *
+ * @author  Erik Poupaert <erik@sankuru.biz>
+ *
+ * @section LICENSE
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU LGPL as
+ * published by the Free Software Foundation; either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * LGPL for more details at: http://www.gnu.org/licenses/lgpl.html
+ *
+ * @section DESCRIPTION
+ *
+ * A reader returns the input from a file descriptor or stream line by line, or record by record,
+ * as views into a refill buffer, without allocating anything per record.
+ *
+ */
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include "object.h"
+#include "string_utf8.h"
+#include "reader.h"
+
+//PRIVATE
+
+static reader reader_new(int fd, FILE *file)
+{
+	reader r=(reader)object_new(sizeof(_reader));
+	r->fd=fd;
+	r->file=file;
+	r->data=(char *)object_new_atomic(READER_INIT_CAPACITY);
+	r->capacity=READER_INIT_CAPACITY;
+	return r;
+}
+
+//PRIVATE
+
+/**
+* Creates a new reader over a file descriptor.
+* A reader returns the input record by record, as views into its own buffer.
+* The descriptor is not closed by the reader.
+*
+* @param fd the file descriptor to read from.
+* @return A pointer to the new reader.
+*/
+reader reader_new_fd(int fd)
+{
+	return reader_new(fd,NULL);
+}
+
+/**
+* Creates a new reader over a stdio stream.
+* Bytes already buffered by the stream are not lost, since the reader reads through fread().
+* The stream is not closed by the reader.
+*
+* @param file the stream to read from.
+* @return A pointer to the new reader.
+*/
+reader reader_new_file(FILE *file)
+{
+	return reader_new(-1,file);
+}
+
+/**
+* Returns the next record, up to but not including the delimiter.
+* The record is a view into the buffer of the reader: it stays valid until the next call only,
+* and nothing is allocated for it. The last record need not end with a delimiter.
+* The delimiter is searched with memchr(), which the C library vectorizes.
+*
+* @param r the reader.
+* @param delimiter the byte that ends a record.
+* @param record receives the record.
+* @return true, if a record was returned; false, at the end of the input or after a read error, see reader_error().
+*/
+bool reader_next_record(reader r, char delimiter, view *record)
+{
+	while(1)
+	{
+		char *from=r->data+r->start+r->scanned;
+		char *found=(char *)memchr(from,delimiter,r->end-r->start-r->scanned);
+		if(found!=NULL)
+		{
+			record->data=r->data+r->start;
+			record->size=(size_t)(found-record->data);
+			r->start+=record->size+1;
+			r->scanned=0;
+			return true;
+		}
+		r->scanned=r->end-r->start;
+		if(r->eof || !reader_fill(r))
+		{
+			if(r->start==r->end) return false;
+			record->data=r->data+r->start;
+			record->size=r->end-r->start;
+			r->start=r->end;
+			r->scanned=0;
+			return true;
+		}
+	}
+}
+
+/**
+* Returns the next line, without its line ending.
+* Lines end with LF; a CR right before the LF is dropped as well, so CRLF files read the same.
+* See reader_next_record() for how long the line stays valid.
+*
+* @param r the reader.
+* @param line receives the line.
+* @return true, if a line was returned; false, at the end of the input or after a read error, see reader_error().
+*/
+bool reader_next_line(reader r, view *line)
+{
+	if(!reader_next_record(r,CHAR_LF,line)) return false;
+	if(line->size>0 && line->data[line->size-1]==CHAR_CR) line->size--;
+	return true;
+}
+
+/**
+* Returns the error that ended the input of a reader early.
+*
+* @param r the reader.
+* @return the errno value of the read that failed; or 0, if none did.
+*/
+int reader_error(reader r)
+{
+	return r->error;
+}
+
+/**
+* Reads more bytes behind the ones not returned yet.
+* The bytes not returned yet are first moved to the front of the buffer;
+* the buffer only grows when they fill it entirely, that is, for records longer than the buffer.
+* Parsers that find their own record boundaries, such as the CSV reader, use this
+* together with the 'start' and 'end' of the reader.
+*
+* @param r the reader.
+* @return false, at the end of the input or after a read error.
+*/
+bool reader_fill(reader r)
+{
+	ssize_t n;
+	if(r->start>0)
+	{
+		memmove(r->data,r->data+r->start,r->end-r->start);
+		r->end-=r->start;
+		r->start=0;
+	}
+	if(r->end==r->capacity)
+	{
+		r->capacity*=2;
+		r->data=(char *)object_resize(r->data,r->capacity);
+	}
+	while(1)
+	{
+		if(r->file!=NULL)
+		{
+			n=(ssize_t)fread(r->data+r->end,1,r->capacity-r->end,r->file);
+			if(n==0 && ferror(r->file)) n=-1;
+		}
+		else
+		{
+			n=read(r->fd,r->data+r->end,r->capacity-r->end);
+		}
+		if(n>0) break;
+		if(n<0 && errno==EINTR) continue;
+		if(n<0) r->error=errno!=0?errno:EIO;
+		r->eof=true;
+		return false;
+	}
+	r->end+=(size_t)n;
+	return true;
+}
@@ -0,0 +1,65 @@
+/**
+ *
+ * libscriptify
+ *
+ * @author  Erik Poupaert <erik@sankuru.biz>
+ *
+ * @section LICENSE
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU LGPL as
+ * published by the Free Software Foundation; either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * LGPL for more details at: http://www.gnu.org/licenses/lgpl.html
+ *
+ * @section DESCRIPTION
+ *
+ * A reader returns the input from a file descriptor or stream line by line, or record by record,
+ * as views into a refill buffer, without allocating anything per record.
+ *
+ */
+#ifndef _READER_H
+#define _READER_H
+
+#include <stddef.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include "view.h"
+
+#ifdef __cplusplus
+	extern "C" {
+#endif
+
+#define READER_INIT_CAPACITY 65536
+
+typedef struct
+{
+	int fd; //-1 when reading from a FILE*
+	FILE *file; //NULL when reading from a file descriptor
+	char *data; //the refill buffer
+	size_t capacity;
+	size_t start; //first byte not returned yet
+	size_t end; //end of the bytes read so far
+	size_t scanned; //bytes from 'start' on known not to hold the delimiter
+	bool eof;
+	int error; //errno of the read that failed; 0 if none did
+} _reader;
+
+typedef _reader* reader;
+
+reader reader_new_fd(int fd);
+reader reader_new_file(FILE *file);
+bool reader_next_record(reader r, char delimiter, view *record);
+bool reader_next_line(reader r, view *line);
+int reader_error(reader r);
+bool reader_fill(reader r);
+
+#ifdef __cplusplus
+	}
+#endif
+
+#endif // _READER_H
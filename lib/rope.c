@@ -0,0 +1,402 @@
+/**
+ *
+ * libscriptify
+ *
+ * @author  Erik Poupaert <erik@sankuru.biz>
+ *
+ * @section LICENSE
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU LGPL as
+ * published by the Free Software Foundation; either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * LGPL for more details at: http://www.gnu.org/licenses/lgpl.html
+ *
+ * @section DESCRIPTION
+ *
+ * A rope is an immutable string made of chunks held in a balanced tree.
+ * Concatenation, insertion, deletion and substrings cost O(log n) and copy no content.
+ *
+ */
+#include <string.h>
+#include "object.h"
+#include "rope.h"
+
+//PRIVATE
+
+static rope rope_leaf(const char *data, size_t size)
+{
+	rope r=(rope)object_new(sizeof(_rope));
+	r->data=data;
+	r->size=size;
+	return r;
+}
+
+/**
+* Creates a concatenation node without rebalancing.
+*/
+static rope rope_node(rope left, rope right)
+{
+	rope r=(rope)object_new(sizeof(_rope));
+	r->left=left;
+	r->right=right;
+	r->size=left->size+right->size;
+	r->height=1+(left->height>right->height?left->height:right->height);
+	return r;
+}
+
+static inline bool rope_isleaf(rope r)
+{
+	return r->left==NULL;
+}
+
+/**
+* node(a,node(b,c)) becomes node(node(a,b),c)
+*/
+static rope rope_rotate_left(rope r)
+{
+	return rope_node(rope_node(r->left,r->right->left),r->right->right);
+}
+
+/**
+* node(node(a,b),c) becomes node(a,node(b,c))
+*/
+static rope rope_rotate_right(rope r)
+{
+	return rope_node(r->left->left,rope_node(r->left->right,r->right));
+}
+
+/**
+* Joins 'l' and 'r' when 'l' is more than one level taller, by descending the right spine of 'l'
+* to a subtree of about the height of 'r' and rotating on the way back up (AVL join).
+*/
+static rope rope_join_right(rope l, rope r)
+{
+	rope c=l->right;
+	rope t;
+	if(c->height<=r->height+1)
+	{
+		t=rope_node(c,r);
+		if(t->height<=l->left->height+1) return rope_node(l->left,t);
+		return rope_rotate_left(rope_node(l->left,rope_rotate_right(t)));
+	}
+	t=rope_join_right(c,r);
+	if(t->height<=l->left->height+1) return rope_node(l->left,t);
+	return rope_rotate_left(rope_node(l->left,t));
+}
+
+/**
+* Mirror image of rope_join_right(), for when 'r' is more than one level taller.
+*/
+static rope rope_join_left(rope l, rope r)
+{
+	rope c=r->left;
+	rope t;
+	if(c->height<=l->height+1)
+	{
+		t=rope_node(l,c);
+		if(t->height<=r->right->height+1) return rope_node(t,r->right);
+		return rope_rotate_right(rope_node(rope_rotate_left(t),r->right));
+	}
+	t=rope_join_left(l,c);
+	if(t->height<=r->right->height+1) return rope_node(t,r->right);
+	return rope_rotate_right(rope_node(t,r->right));
+}
+
+/**
+* Concatenates two ropes, keeping the result height-balanced.
+* Costs O(difference in height) new nodes.
+*/
+static rope rope_join(rope l, rope r)
+{
+	if(l->size==0) return r;
+	if(r->size==0) return l;
+	if(l->height>r->height+1) return rope_join_right(l,r);
+	if(r->height>l->height+1) return rope_join_left(l,r);
+	return rope_node(l,r);
+}
+
+/**
+* Copies two short leaves into a single new leaf.
+*/
+static rope rope_leaf_merge(rope l, rope r)
+{
+	string s=string_new(l->size+r->size);
+	memcpy(s,l->data,l->size);
+	memcpy(s+l->size,r->data,r->size);
+	s[l->size+r->size]=0;
+	rope merged=rope_leaf(s,l->size+r->size);
+	merged->flat=s;
+	return merged;
+}
+
+/**
+* Splits a rope at byte position 'index' into the part before and the part from 'index' on.
+* Leaves are split by slicing, without copying their bytes.
+*/
+static void rope_split(rope r, size_t index, rope *left, rope *right)
+{
+	rope part;
+	if(index==0)
+	{
+		*left=rope_new();
+		*right=r;
+	}
+	else if(index>=r->size)
+	{
+		*left=r;
+		*right=rope_new();
+	}
+	else if(rope_isleaf(r))
+	{
+		*left=rope_leaf(r->data,index);
+		*right=rope_leaf(r->data+index,r->size-index);
+	}
+	else if(index<r->left->size)
+	{
+		rope_split(r->left,index,left,&part);
+		*right=rope_join(part,r->right);
+	}
+	else if(index==r->left->size)
+	{
+		*left=r->left;
+		*right=r->right;
+	}
+	else
+	{
+		rope_split(r->right,index-r->left->size,&part,right);
+		*left=rope_join(r->left,part);
+	}
+}
+
+//PRIVATE
+
+/**
+* Creates a new, empty rope.
+*
+* @return A pointer to the new rope.
+*/
+rope rope_new()
+{
+	return rope_leaf("",0);
+}
+
+/**
+* Creates a new rope consisting of a single string.
+* The rope refers to the string instead of copying it, so the string must not be modified afterwards.
+*
+* @param str the string.
+* @return A pointer to the new rope.
+*/
+rope rope_new_string(string str)
+{
+	rope r=rope_leaf(str,strlen(str));
+	r->flat=str;
+	return r;
+}
+
+/**
+* Creates a new rope with a copy of the 'size' bytes at 'data'.
+*
+* @param data the bytes.
+* @param size the number of bytes.
+* @return A pointer to the new rope.
+*/
+rope rope_new_bytes(const char *data, size_t size)
+{
+	string s=string_new(size);
+	memcpy(s,data,size);
+	s[size]=0;
+	return rope_new_string(s);
+}
+
+/**
+* Returns the length of a rope in bytes.
+*
+* @param r the rope.
+* @return the length in bytes.
+*/
+size_t rope_length(rope r)
+{
+	return r->size;
+}
+
+/**
+* Concatenates two ropes in O(log n), without copying their content.
+* Ropes are never modified, so both arguments remain valid and unchanged.
+* A short leaf appended after another short leaf is merged with it,
+* so that building a rope from many small pieces does not end up with one node per piece.
+*
+* @param r1 the first rope.
+* @param r2 the rope to append to it.
+* @return the concatenation of r1 and r2.
+*/
+rope rope_concat(rope r1, rope r2)
+{
+	if(r1->size==0) return r2;
+	if(r2->size==0) return r1;
+	if(rope_isleaf(r2) && r2->size<=ROPE_SHORT_LIMIT)
+	{
+		if(rope_isleaf(r1) && r1->size+r2->size<=ROPE_SHORT_LIMIT)
+			return rope_leaf_merge(r1,r2);
+		if(!rope_isleaf(r1) && rope_isleaf(r1->right) && r1->right->size+r2->size<=ROPE_SHORT_LIMIT)
+			return rope_join(r1->left,rope_leaf_merge(r1->right,r2));
+	}
+	return rope_join(r1,r2);
+}
+
+/**
+* Appends a string to a rope, without copying it.
+*
+* @param r the rope.
+* @param str the string to append; it must not be modified afterwards.
+* @return the new rope.
+*/
+rope rope_append(rope r, string str)
+{
+	return rope_concat(r,rope_new_string(str));
+}
+
+/**
+* Computes a subrope starting at byte position 'start' and
+* with maximum number of bytes 'size', in O(log n) and without copying content.
+*
+* @param r the rope.
+* @param start the byte at which the subrope starts.
+* @param size the maximum number of bytes.
+* @return the subrope.
+*/
+rope rope_substr(rope r, size_t start, size_t size)
+{
+	rope before, after, middle, rest;
+	rope_split(r,start,&before,&after);
+	rope_split(after,size,&middle,&rest);
+	return middle;
+}
+
+/**
+* Inserts a rope at byte position 'index' in O(log n).
+*
+* @param r the rope to insert into.
+* @param index the byte position at which 'other' will start.
+* @param other the rope to insert.
+* @return the new rope.
+*/
+rope rope_insert(rope r, size_t index, rope other)
+{
+	rope before, after;
+	rope_split(r,index,&before,&after);
+	return rope_concat(rope_concat(before,other),after);
+}
+
+/**
+* Deletes 'size' bytes starting at byte position 'start' in O(log n).
+*
+* @param r the rope to delete from.
+* @param start the first byte to delete.
+* @param size the number of bytes to delete.
+* @return the new rope.
+*/
+rope rope_delete(rope r, size_t start, size_t size)
+{
+	rope before, after, middle, rest;
+	rope_split(r,start,&before,&after);
+	rope_split(after,size,&middle,&rest);
+	return rope_concat(before,rest);
+}
+
+/**
+* Returns the byte at position 'index', in O(log n).
+*
+* @param r the rope.
+* @param index the byte position.
+* @return the byte; or 0 if 'index' is out of bounds.
+*/
+char rope_charat(rope r, size_t index)
+{
+	if(index>=r->size) return 0;
+	while(!rope_isleaf(r))
+	{
+		if(index<r->left->size)
+		{
+			r=r->left;
+		}
+		else
+		{
+			index-=r->left->size;
+			r=r->right;
+		}
+	}
+	return r->data[index];
+}
+
+/**
+* Returns a null-terminated string with the content of a rope.
+* The rope is flattened on first use only; later calls return the same string,
+* which must therefore not be modified.
+*
+* @param r the rope.
+* @return the content of the rope.
+*/
+string rope_tostring(rope r)
+{
+	const char *data;
+	size_t size, offset=0;
+	string s;
+	if(r->flat!=NULL) return r->flat;
+	s=string_new(r->size);
+	rope_iterator it=rope_iterator_new(r);
+	while(rope_iterator_next(it,&data,&size))
+	{
+		memcpy(s+offset,data,size);
+		offset+=size;
+	}
+	s[offset]=0;
+	r->flat=s;
+	return s;
+}
+
+/**
+* Creates an iterator over the chunks of a rope, from left to right.
+* The chunks can, for example, be collected into a struct iovec array for writev().
+*
+* @param r the rope to iterate.
+* @return A pointer to the new iterator.
+*/
+rope_iterator rope_iterator_new(rope r)
+{
+	rope_iterator it=(rope_iterator)object_new(sizeof(_rope_iterator));
+	it->stack[0]=r;
+	it->depth=1;
+	return it;
+}
+
+/**
+* Moves to the next chunk of a rope. Empty chunks are skipped.
+*
+* @param it the iterator.
+* @param data receives the address of the chunk; the bytes are not null-terminated.
+* @param size receives the size of the chunk.
+* @return true, if a chunk was returned; false, at the end of the rope.
+*/
+bool rope_iterator_next(rope_iterator it, const char **data, size_t *size)
+{
+	while(it->depth>0)
+	{
+		rope r=it->stack[--it->depth];
+		if(r->size==0) continue;
+		if(rope_isleaf(r))
+		{
+			*data=r->data;
+			*size=r->size;
+			return true;
+		}
+		it->stack[it->depth++]=r->right;
+		it->stack[it->depth++]=r->left;
+	}
+	return false;
+}
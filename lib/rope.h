@@ -0,0 +1,81 @@
+/**
+ *
+ * libscriptify
+ *
+ * @author  Erik Poupaert <erik@sankuru.biz>
+ *
+ * @section LICENSE
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU LGPL as
+ * published by the Free Software Foundation; either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * LGPL for more details at: http://www.gnu.org/licenses/lgpl.html
+ *
+ * @section DESCRIPTION
+ *
+ * A rope is an immutable string made of chunks held in a balanced tree.
+ * Concatenation, insertion, deletion and substrings cost O(log n) and copy no content.
+ *
+ */
+#ifndef _ROPE_H
+#define _ROPE_H
+
+#include <stddef.h>
+#include <stdbool.h>
+#include "string_utf8.h"
+
+#ifdef __cplusplus
+	extern "C" {
+#endif
+
+/* leaves up to this many bytes are merged when concatenated */
+#define ROPE_SHORT_LIMIT 64
+/* deeper than any balanced rope that fits in memory */
+#define ROPE_MAX_DEPTH 128
+
+typedef struct _rope
+{
+	struct _rope *left; //NULL for leaves
+	struct _rope *right; //NULL for leaves
+	const char *data; //leaves only: the bytes, not null-terminated
+	size_t size;
+	int height; //0 for leaves
+	string flat; //cached result of rope_tostring()
+} _rope;
+
+typedef _rope* rope;
+
+typedef struct
+{
+	rope stack[ROPE_MAX_DEPTH];
+	int depth;
+} _rope_iterator;
+
+typedef _rope_iterator* rope_iterator;
+
+rope rope_new();
+rope rope_new_string(string str);
+rope rope_new_bytes(const char *data, size_t size);
+size_t rope_length(rope r);
+rope rope_concat(rope r1, rope r2);
+rope rope_append(rope r, string str);
+rope rope_substr(rope r, size_t start, size_t size);
+rope rope_insert(rope r, size_t index, rope other);
+rope rope_delete(rope r, size_t start, size_t size);
+char rope_charat(rope r, size_t index);
+string rope_tostring(rope r);
+
+/* iteration over the chunks, from left to right */
+rope_iterator rope_iterator_new(rope r);
+bool rope_iterator_next(rope_iterator it, const char **data, size_t *size);
+
+#ifdef __cplusplus
+	}
+#endif
+
+#endif // _ROPE_H
@@ -0,0 +1,287 @@
+/**
+ *
+ * libscriptify
+ *
+ * @author  Erik Poupaert <erik@sankuru.biz>
+ *
+ * @section LICENSE
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU LGPL as
+ * published by the Free Software Foundation; either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * LGPL for more details at: http://www.gnu.org/licenses/lgpl.html
+ *
+ * @section DESCRIPTION
+ *
+ * Records with named properties laid out by shapes, or hidden classes: records built by adding
+ * the same properties in the same order share a shape, which maps each name to a slot, so that
+ * a property is read from a record at a fixed position, remembered by an inline cache.
+ *
+ */
+#include <string.h>
+#include <pthread.h>
+#include "object.h"
+#include "string_utf8.h"
+#include "shape.h"
+
+//PRIVATE
+
+/* slots of a new record; they grow as needed */
+#define SHAPE_SLOTS_CAPACITY 4
+
+static shape shape_root;
+static pthread_once_t shape_once=PTHREAD_ONCE_INIT;
+static pthread_mutex_t shape_lock=PTHREAD_MUTEX_INITIALIZER; //taken by writers of transitions only
+
+static void shape_init()
+{
+	shape_root=(shape)object_new(sizeof(_shape));
+}
+
+/**
+* Finds the shape that adds the interned 'name' to 's'. Transitions are filled before they are published,
+* and never change afterwards, so that readers take no lock.
+*/
+static shape shape_find_transition(shape s, string name)
+{
+	shape t;
+	for(t=__atomic_load_n(&s->transitions,__ATOMIC_ACQUIRE); t!=NULL; t=t->sibling)
+		if(t->names[t->count-1]==name) return t;
+	return NULL;
+}
+
+static void shape_index(shape s)
+{
+	size_t size=SHAPE_INDEX_MIN*2, i, k;
+	while(size<2*s->count) size*=2;
+	s->index=(int32_t *)object_new_atomic(size*sizeof(int32_t));
+	memset(s->index,0xff,size*sizeof(int32_t));
+	s->index_mask=size-1;
+	for(i=0; i<s->count; i++)
+	{
+		for(k=string_hash(s->names[i])&s->index_mask; s->index[k]>=0; k=(k+1)&s->index_mask);
+		s->index[k]=(int32_t)i;
+	}
+}
+
+static shape shape_new_transition(shape parent, string name)
+{
+	shape s=(shape)object_new(sizeof(_shape));
+	s->parent=parent;
+	s->count=parent->count+1;
+	s->names=(string *)object_new(s->count*sizeof(string));
+	if(parent->count>0) memcpy(s->names,parent->names,parent->count*sizeof(string));
+	s->names[parent->count]=name;
+	if(s->count>SHAPE_INDEX_MIN) shape_index(s);
+	return s;
+}
+
+static void record_reserve(record r, size_t count)
+{
+	size_t capacity=r->capacity;
+	if(count<=capacity) return;
+	while(capacity<count) capacity*=2;
+	r->slots=(manyany)object_resize(r->slots,capacity*sizeof(any));
+	memset(r->slots+r->capacity,0,(capacity-r->capacity)*sizeof(any));
+	r->capacity=capacity;
+}
+
+//PRIVATE
+
+/**
+* Returns the empty shape, which all records start from.
+*
+* @return the shape without properties.
+*/
+shape shape_empty()
+{
+	pthread_once(&shape_once,shape_init);
+	return shape_root;
+}
+
+/**
+* Returns the shape of a record with the properties of 's' followed by 'name'. The first call for a name
+* creates the shape; later calls, from any thread, return the same one, so that records that add
+* the same properties in the same order share their shape.
+*
+* @param s the shape.
+* @param name the name of the property; it is interned.
+* @return The shape with the property added; or 's', if it already has the property.
+*/
+shape shape_add(shape s, string name)
+{
+	shape t;
+	if(shape_slot(s,name)>=0) return s;
+	name=string_intern(name);
+	t=shape_find_transition(s,name);
+	if(t!=NULL) return t;
+	pthread_mutex_lock(&shape_lock);
+	t=shape_find_transition(s,name);
+	if(t==NULL)
+	{
+		t=shape_new_transition(s,name);
+		t->sibling=s->transitions;
+		__atomic_store_n(&s->transitions,t,__ATOMIC_RELEASE);
+	}
+	pthread_mutex_unlock(&shape_lock);
+	return t;
+}
+
+/**
+* Finds the slot of a property. Interned names are matched by address first;
+* shapes with more than SHAPE_INDEX_MIN properties look the name up in their hash index.
+*
+* @param s the shape.
+* @param name the name of the property.
+* @return The slot; or -1, if the shape does not have the property.
+*/
+long shape_slot(shape s, string name)
+{
+	size_t i;
+	int32_t slot;
+	if(s->index==NULL)
+	{
+		for(i=0; i<s->count; i++)
+			if(s->names[i]==name) return (long)i;
+		for(i=0; i<s->count; i++)
+			if(strcmp(s->names[i],name)==0) return (long)i;
+		return -1;
+	}
+	for(i=string_hash(name)&s->index_mask; (slot=s->index[i])>=0; i=(i+1)&s->index_mask)
+		if(s->names[slot]==name || strcmp(s->names[slot],name)==0) return slot;
+	return -1;
+}
+
+/**
+* Creates a record without properties.
+* A record may be read by many threads, but only be changed by one at a time. A new property
+* is filled in before the shape with it is published, so readers that run alongside a put
+* see the record either without the property or with its value.
+*
+* @return A pointer to the new record.
+*/
+record record_new()
+{
+	return record_new_shape(shape_empty());
+}
+
+/**
+* Creates a record with the properties of a shape, all null; filling in records built
+* from one shape, such as the rows of a table, never changes their shape.
+*
+* @param s the shape.
+* @return A pointer to the new record.
+*/
+record record_new_shape(shape s)
+{
+	record r=(record)object_new(sizeof(_record));
+	r->shape=s;
+	r->capacity=s->count>SHAPE_SLOTS_CAPACITY?s->count:SHAPE_SLOTS_CAPACITY;
+	r->slots=(manyany)object_new(r->capacity*sizeof(any));
+	return r;
+}
+
+/**
+* Returns the number of properties of a record.
+*
+* @param r the record.
+* @return the number of properties.
+*/
+size_t record_size(record r)
+{
+	return __atomic_load_n(&r->shape,__ATOMIC_ACQUIRE)->count;
+}
+
+/**
+* Gets a property of a record; see record_get_cached() for sites that get the same property repeatedly.
+*
+* @param r the record.
+* @param name the name of the property.
+* @return The value; or NULL, if the record does not have the property or it is not set.
+*/
+any record_get(record r, string name)
+{
+	long slot=shape_slot(__atomic_load_n(&r->shape,__ATOMIC_ACQUIRE),name);
+	return slot>=0?r->slots[slot]:NULL;
+}
+
+/**
+* Sets a property of a record. Adding a property moves the record to the shape with it added.
+* Properties stay in the order they were first added; removing one is not supported, but it can be set to NULL.
+*
+* @param r the record.
+* @param name the name of the property.
+* @param value the value.
+*/
+void record_put(record r, string name, any value)
+{
+	long slot=shape_slot(r->shape,name);
+	if(slot<0)
+	{
+		shape s=shape_add(r->shape,name);
+		record_reserve(r,s->count);
+		r->slots[s->count-1]=value;
+		__atomic_store_n(&r->shape,s,__ATOMIC_RELEASE);
+		return;
+	}
+	r->slots[slot]=value;
+}
+
+/**
+* Gets a property of a record through an inline cache: when the record has the shape the cache
+* last saw, the value is read from the remembered slot, without looking up the name.
+* Each site keeps its own cache, zeroed at first, for one property name.
+*
+* @param r the record.
+* @param name the name of the property.
+* @param cache the cache of the site.
+* @return The value; or NULL, if the record does not have the property or it is not set.
+*/
+any record_get_cached(record r, string name, shape_cache cache)
+{
+	shape s=__atomic_load_n(&r->shape,__ATOMIC_ACQUIRE);
+	long slot;
+	if(s==cache->shape && cache->transition==NULL) return r->slots[cache->slot];
+	slot=shape_slot(s,name);
+	if(slot<0) return NULL;
+	cache->shape=s;
+	cache->transition=NULL;
+	cache->slot=(size_t)slot;
+	return r->slots[slot];
+}
+
+/**
+* Sets a property of a record through an inline cache; see record_get_cached().
+* The cache also remembers adding the property, so that records built alike move to
+* their next shape without looking it up.
+*
+* @param r the record.
+* @param name the name of the property.
+* @param value the value.
+* @param cache the cache of the site.
+*/
+void record_put_cached(record r, string name, any value, shape_cache cache)
+{
+	shape s=r->shape;
+	long slot;
+	if(s!=cache->shape)
+	{
+		slot=shape_slot(s,name);
+		cache->shape=s;
+		cache->transition=slot<0?shape_add(s,name):NULL;
+		cache->slot=slot<0?cache->transition->count-1:(size_t)slot;
+	}
+	if(cache->transition!=NULL)
+	{
+		record_reserve(r,cache->transition->count);
+		r->slots[cache->slot]=value;
+		__atomic_store_n(&r->shape,cache->transition,__ATOMIC_RELEASE);
+		return;
+	}
+	r->slots[cache->slot]=value;
+}
@@ -0,0 +1,92 @@
+/**
+ *
+ * libscriptify
+ *
+ * @author  Erik Poupaert <erik@sankuru.biz>
+ *
+ * @section LICENSE
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU LGPL as
+ * published by the Free Software Foundation; either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * LGPL for more details at: http://www.gnu.org/licenses/lgpl.html
+ *
+ * @section DESCRIPTION
+ *
+ * Records with named properties laid out by shapes, or hidden classes: records built by adding
+ * the same properties in the same order share a shape, which maps each name to a slot, so that
+ * a property is read from a record at a fixed position, remembered by an inline cache.
+ *
+ */
+#ifndef _SHAPE_H
+#define _SHAPE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include "object.h"
+#include "any.h"
+
+#ifdef __cplusplus
+	extern "C" {
+#endif
+
+/* shapes with more properties than this find them through a hash index rather than a scan */
+#define SHAPE_INDEX_MIN 8
+
+/* a hidden class: the names of the properties of records, in slot order, shared by all records built alike */
+typedef struct _shape
+{
+	struct _shape *parent; //the shape without the last property; NULL for the empty shape
+	string *names; //the interned names of the properties, by slot
+	size_t count; //the number of properties
+	int32_t *index; //slots by hash of the name, -1 if empty; NULL for shapes of up to SHAPE_INDEX_MIN properties
+	size_t index_mask;
+	struct _shape *transitions; //the shapes with one more property, linked through 'sibling'
+	struct _shape *sibling;
+} _shape;
+
+typedef _shape* shape;
+
+/* an object with named properties: its shape says which slot holds which property */
+typedef struct _record
+{
+	struct _shape *shape;
+	manyany slots;
+	size_t capacity; //the number of slots allocated
+} _record;
+
+typedef _record* record;
+
+/* an inline cache, kept by one site that gets or puts one property name; not to be shared between threads */
+typedef struct
+{
+	struct _shape *shape; //the shape of the last record seen; NULL while empty
+	struct _shape *transition; //puts: the shape after adding the property; NULL if the shape has it
+	size_t slot;
+} _shape_cache;
+
+typedef _shape_cache* shape_cache;
+
+shape shape_empty();
+shape shape_add(shape s, string name);
+long shape_slot(shape s, string name);
+
+record record_new();
+record record_new_shape(shape s);
+size_t record_size(record r);
+any record_get(record r, string name);
+void record_put(record r, string name, any value);
+any record_get_cached(record r, string name, shape_cache cache);
+void record_put_cached(record r, string name, any value, shape_cache cache);
+
+#ifdef __cplusplus
+	}
+#endif
+
+#endif // _SHAPE_H
@@ -0,0 +1,427 @@
+/**
+ *
+ * libscriptify
+ *
+ * @author  Erik Poupaert <erik@sankuru.biz>
+ *
+ * @section LICENSE
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU LGPL as
+ * published by the Free Software Foundation; either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * LGPL for more details at: http://www.gnu.org/licenses/lgpl.html
+ *
+ * @section DESCRIPTION
+ *
+ * Operations on whole columns of strings at once: case conversion, validation, hashing
+ * and trimming of arrays of views, split across the thread pool for large batches.
+ *
+ */
+#include <string.h>
+#include <wctype.h>
+#include "object.h"
+#include "buffer.h"
+#include "hash.h"
+#include "threadpool.h"
+#include "string_batch.h"
+
+//PRIVATE
+
+/* how many items ahead the data of the next items is prefetched */
+#define STRING_BATCH_PREFETCH 8
+
+typedef struct
+{
+	const view *items;
+	string *strings;
+	string *converted; //case conversions: the strings that are not all ASCII, fully converted
+	view *views;
+	bool *valid;
+	uint64_t *hashes;
+	bool upper;
+	bool left;
+	bool right;
+} _string_batch;
+
+typedef _string_batch* string_batch;
+
+/**
+* Runs 'fn' over all items of a batch: on the calling thread for small batches,
+* and split into tasks of STRING_BATCH_GRAIN items on the default thread pool for large ones.
+*/
+static void string_batch_run(string_batch batch, size_t count, threadpool_range_fn fn)
+{
+	if(count<STRING_BATCH_PARALLEL_MIN) fn(0,count,batch);
+	else threadpool_for(threadpool_default(),0,count,STRING_BATCH_GRAIN,fn,batch);
+}
+
+static void string_batch_prefetch(const view *items, size_t i, size_t end)
+{
+	if(i+STRING_BATCH_PREFETCH<end) __builtin_prefetch(items[i+STRING_BATCH_PREFETCH].data);
+}
+
+static void string_batch_views_range(size_t begin, size_t end, void *arg)
+{
+	string_batch batch=(string_batch)arg;
+	size_t i;
+	for(i=begin; i<end; i++) batch->views[i]=view_from_string(batch->strings[i]);
+}
+
+static bool string_batch_ascii(view v)
+{
+	const unsigned char *src=(const unsigned char *)v.data;
+	unsigned char seen=0;
+	size_t i;
+	//no branches in the loop, so that the compiler can vectorize it
+	for(i=0; i<v.size; i++) seen|=src[i];
+	return seen<0x80;
+}
+
+/**
+* Converts the case of the ASCII letters of a view into 'dest'.
+*/
+static void string_batch_case_ascii(view v, char *dest, bool upper)
+{
+	const unsigned char *src=(const unsigned char *)v.data;
+	unsigned char first=upper?'a':'A';
+	size_t i;
+	for(i=0; i<v.size; i++)
+	{
+		unsigned char c=src[i];
+		dest[i]=(char)(c^(((unsigned char)(c-first)<26)<<5));
+	}
+	dest[v.size]=0;
+}
+
+/**
+* Measures the valid utf-8 sequence at 'p': no overlong encodings, no surrogates,
+* nothing above U+10FFFF, and no truncated sequences.
+*
+* @return the number of bytes of the sequence; or 0, if it is not valid.
+*/
+static int string_batch_sequence(const unsigned char *p, const unsigned char *end)
+{
+	unsigned char c=*p;
+	unsigned char low=0x80, high=0xbf;
+	int tail;
+	if(c<0x80) return 1;
+	if(c>=0xc2 && c<=0xdf) tail=1;
+	else if(c>=0xe0 && c<=0xef)
+	{
+		tail=2;
+		if(c==0xe0) low=0xa0; //overlong
+		if(c==0xed) high=0x9f; //surrogates
+	}
+	else if(c>=0xf0 && c<=0xf4)
+	{
+		tail=3;
+		if(c==0xf0) low=0x90; //overlong
+		if(c==0xf4) high=0x8f; //above U+10FFFF
+	}
+	else return 0;
+	if(end-p<=tail) return 0;
+	if(p[1]<low || p[1]>high) return 0;
+	if(tail>1 && (p[2]&0xc0)!=0x80) return 0;
+	if(tail>2 && (p[3]&0xc0)!=0x80) return 0;
+	return tail+1;
+}
+
+static void string_batch_append_code_point(buffer b, uint32_t c)
+{
+	if(c<0x80) buffer_appendchar(b,(char)c);
+	else if(c<0x800)
+	{
+		buffer_appendchar(b,(char)(0xc0|(c>>6)));
+		buffer_appendchar(b,(char)(0x80|(c&0x3f)));
+	}
+	else if(c<0x10000)
+	{
+		buffer_appendchar(b,(char)(0xe0|(c>>12)));
+		buffer_appendchar(b,(char)(0x80|((c>>6)&0x3f)));
+		buffer_appendchar(b,(char)(0x80|(c&0x3f)));
+	}
+	else
+	{
+		buffer_appendchar(b,(char)(0xf0|(c>>18)));
+		buffer_appendchar(b,(char)(0x80|((c>>12)&0x3f)));
+		buffer_appendchar(b,(char)(0x80|((c>>6)&0x3f)));
+		buffer_appendchar(b,(char)(0x80|(c&0x3f)));
+	}
+}
+
+/**
+* Converts the case of a view that is not all ASCII, one code point at a time, into a buffer that
+* grows with the result, since a case mapping may take more or fewer bytes than the original.
+* Bytes that are not valid utf-8 are copied unchanged.
+*/
+static string string_batch_case_utf8(view v, bool upper)
+{
+	const unsigned char *p=(const unsigned char *)v.data, *end=p+v.size;
+	buffer b=buffer_new_capacity(v.size+1);
+	while(p<end)
+	{
+		int size=string_batch_sequence(p,end);
+		uint32_t c, mapped;
+		if(size==0)
+		{
+			buffer_appendchar(b,(char)*p++);
+			continue;
+		}
+		if(size==1) c=p[0];
+		else if(size==2) c=((uint32_t)(p[0]&0x1f)<<6)|(p[1]&0x3f);
+		else if(size==3) c=((uint32_t)(p[0]&0x0f)<<12)|((uint32_t)(p[1]&0x3f)<<6)|(p[2]&0x3f);
+		else c=((uint32_t)(p[0]&0x07)<<18)|((uint32_t)(p[1]&0x3f)<<12)|((uint32_t)(p[2]&0x3f)<<6)|(p[3]&0x3f);
+		mapped=(uint32_t)(upper?towupper((wint_t)c):towlower((wint_t)c));
+		//a mapping that is not a character keeps the original
+		if(mapped>0x10ffff || (mapped>=0xd800 && mapped<=0xdfff)) buffer_append(b,(const char *)p,(size_t)size);
+		else string_batch_append_code_point(b,mapped);
+		p+=size;
+	}
+	return buffer_steal(b);
+}
+
+/**
+* First pass of a case conversion: converts the strings that are not all ASCII in full,
+* since their case mapping may change their number of bytes.
+*/
+static void string_batch_convert_range(size_t begin, size_t end, void *arg)
+{
+	string_batch batch=(string_batch)arg;
+	size_t i;
+	for(i=begin; i<end; i++)
+	{
+		view v=batch->items[i];
+		string_batch_prefetch(batch->items,i,end);
+		if(string_batch_ascii(v)) continue;
+		batch->converted[i]=string_batch_case_utf8(v,batch->upper);
+	}
+}
+
+/**
+* Second pass of a case conversion: writes every result into its place in the block.
+*/
+static void string_batch_case_range(size_t begin, size_t end, void *arg)
+{
+	string_batch batch=(string_batch)arg;
+	size_t i;
+	for(i=begin; i<end; i++)
+	{
+		string_batch_prefetch(batch->items,i,end);
+		if(batch->converted[i]!=NULL) strcpy(batch->strings[i],batch->converted[i]);
+		else string_batch_case_ascii(batch->items[i],batch->strings[i],batch->upper);
+	}
+}
+
+/**
+* Converts the case of a batch into one block of memory holding all results one after another.
+* The strings that are not all ASCII are converted first, so that the block can be laid out
+* with the real size of every result.
+*/
+static string *string_batch_case(const view *items, size_t count, bool upper)
+{
+	_string_batch batch;
+	size_t i, total=0;
+	char *block;
+	memset(&batch,0,sizeof(batch));
+	batch.items=items;
+	batch.upper=upper;
+	batch.strings=(string *)object_new(count*sizeof(string));
+	batch.converted=(string *)object_new(count*sizeof(string));
+	string_batch_run(&batch,count,string_batch_convert_range);
+	for(i=0; i<count; i++) total+=(batch.converted[i]!=NULL?strlen(batch.converted[i]):items[i].size)+1;
+	block=(char *)object_new_atomic(total);
+	for(i=0; i<count; i++)
+	{
+		batch.strings[i]=block;
+		block+=(batch.converted[i]!=NULL?strlen(batch.converted[i]):items[i].size)+1;
+	}
+	string_batch_run(&batch,count,string_batch_case_range);
+	return batch.strings;
+}
+
+/**
+* Checks a sequence of bytes for valid UTF-8; see string_batch_sequence().
+* Runs of ASCII are skipped eight bytes at a time.
+*/
+static bool string_batch_valid_view(view v)
+{
+	const unsigned char *p=(const unsigned char *)v.data;
+	const unsigned char *end=p+v.size;
+	while(p<end)
+	{
+		int size;
+		if(end-p>=8)
+		{
+			uint64_t word;
+			memcpy(&word,p,8);
+			if((word&0x8080808080808080ULL)==0)
+			{
+				p+=8;
+				continue;
+			}
+		}
+		size=string_batch_sequence(p,end);
+		if(size==0) return false;
+		p+=size;
+	}
+	return true;
+}
+
+static void string_batch_valid_range(size_t begin, size_t end, void *arg)
+{
+	string_batch batch=(string_batch)arg;
+	size_t i;
+	for(i=begin; i<end; i++)
+	{
+		string_batch_prefetch(batch->items,i,end);
+		batch->valid[i]=string_batch_valid_view(batch->items[i]);
+	}
+}
+
+static void string_batch_hash_range(size_t begin, size_t end, void *arg)
+{
+	string_batch batch=(string_batch)arg;
+	size_t i;
+	for(i=begin; i<end; i++)
+	{
+		string_batch_prefetch(batch->items,i,end);
+		batch->hashes[i]=view_hash(batch->items[i]);
+	}
+}
+
+static bool string_batch_isspace(char c)
+{
+	return c==' ' || (c>='\t' && c<='\r');
+}
+
+static void string_batch_trim_range(size_t begin, size_t end, void *arg)
+{
+	string_batch batch=(string_batch)arg;
+	size_t i;
+	for(i=begin; i<end; i++)
+	{
+		view v=batch->items[i];
+		string_batch_prefetch(batch->items,i,end);
+		if(batch->left)
+		{
+			while(v.size>0 && string_batch_isspace(v.data[0]))
+			{
+				v.data++;
+				v.size--;
+			}
+		}
+		if(batch->right)
+		{
+			while(v.size>0 && string_batch_isspace(v.data[v.size-1])) v.size--;
+		}
+		batch->views[i]=v;
+	}
+}
+
+//PRIVATE
+
+/**
+* Creates views on a batch of strings, so that the other batch operations can work on them.
+*
+* @param strings the strings.
+* @param count the number of strings.
+* @return A new array with a view on every string.
+*/
+view *string_batch_views(string *strings, size_t count)
+{
+	_string_batch batch;
+	memset(&batch,0,sizeof(batch));
+	batch.strings=strings;
+	batch.views=(view *)object_new(count*sizeof(view));
+	string_batch_run(&batch,count,string_batch_views_range);
+	return batch.views;
+}
+
+/**
+* Converts a batch of utf-8 strings entirely to lowercase.
+* Strings with only ASCII characters are converted in place in the result, without any setup;
+* the others are converted per character with towlower(), and may grow or shrink.
+* Bytes that are not valid utf-8 are kept unchanged.
+* All results are stored one after another in a single block of memory,
+* which stays alive as long as any of them is referenced.
+*
+* @param items the strings to convert.
+* @param count the number of strings.
+* @return A new array with the strings in lowercase.
+*/
+string *string_batch_tolower(const view *items, size_t count)
+{
+	return string_batch_case(items,count,false);
+}
+
+/**
+* Converts a batch of utf-8 strings entirely to uppercase; see string_batch_tolower().
+*
+* @param items the strings to convert.
+* @param count the number of strings.
+* @return A new array with the strings in uppercase.
+*/
+string *string_batch_toupper(const view *items, size_t count)
+{
+	return string_batch_case(items,count,true);
+}
+
+/**
+* Checks a batch of strings for valid utf-8.
+* Overlong encodings, surrogates, characters above U+10FFFF and truncated sequences are invalid.
+*
+* @param items the strings to check.
+* @param count the number of strings.
+* @param valid receives, for every string, true if it is valid utf-8; false if not.
+*/
+void string_batch_valid_utf8(const view *items, size_t count, bool *valid)
+{
+	_string_batch batch;
+	memset(&batch,0,sizeof(batch));
+	batch.items=items;
+	batch.valid=valid;
+	string_batch_run(&batch,count,string_batch_valid_range);
+}
+
+/**
+* Computes the hash values of a batch of strings; they are equal to those of view_hash().
+*
+* @param items the strings to hash.
+* @param count the number of strings.
+* @param hashes receives the hash value of every string.
+*/
+void string_batch_hash(const view *items, size_t count, uint64_t *hashes)
+{
+	_string_batch batch;
+	memset(&batch,0,sizeof(batch));
+	batch.items=items;
+	batch.hashes=hashes;
+	string_batch_run(&batch,count,string_batch_hash_range);
+}
+
+/**
+* Removes leading (left) and/or trailing whitespace from a batch of strings.
+* Whitespace is the ASCII space, tab, newline, vertical tab, form feed and carriage return.
+* Nothing is copied: the results are views on the original strings.
+*
+* @param items the strings to trim.
+* @param count the number of strings.
+* @param left if true, remove leading whitespace.
+* @param right if true, remove trailing whitespace.
+* @param trimmed receives the trimmed view of every string; may be the same array as 'items'.
+*/
+void string_batch_trim(const view *items, size_t count, bool left, bool right, view *trimmed)
+{
+	_string_batch batch;
+	memset(&batch,0,sizeof(batch));
+	batch.items=items;
+	batch.views=trimmed;
+	batch.left=left;
+	batch.right=right;
+	string_batch_run(&batch,count,string_batch_trim_range);
+}
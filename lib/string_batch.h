@@ -0,0 +1,54 @@
+/**
+ *
+ * libscriptify
+ *
+ * @author  Erik Poupaert <erik@sankuru.biz>
+ *
+ * @section LICENSE
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU LGPL as
+ * published by the Free Software Foundation; either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * LGPL for more details at: http://www.gnu.org/licenses/lgpl.html
+ *
+ * @section DESCRIPTION
+ *
+ * Operations on whole columns of strings at once: case conversion, validation, hashing
+ * and trimming of arrays of views, split across the thread pool for large batches.
+ *
+ */
+#ifndef _STRING_BATCH_H
+#define _STRING_BATCH_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include "string_utf8.h"
+#include "view.h"
+
+#ifdef __cplusplus
+	extern "C" {
+#endif
+
+/* batches with fewer items run on the calling thread */
+#define STRING_BATCH_PARALLEL_MIN 16384
+/* number of items per task when a batch is split across the thread pool */
+#define STRING_BATCH_GRAIN 4096
+
+view *string_batch_views(string *strings, size_t count);
+string *string_batch_tolower(const view *items, size_t count);
+string *string_batch_toupper(const view *items, size_t count);
+void string_batch_valid_utf8(const view *items, size_t count, bool *valid);
+void string_batch_hash(const view *items, size_t count, uint64_t *hashes);
+void string_batch_trim(const view *items, size_t count, bool left, bool right, view *trimmed);
+
+#ifdef __cplusplus
+	}
+#endif
+
+#endif // _STRING_BATCH_H
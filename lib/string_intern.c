@@ -0,0 +1,230 @@
+/**
+ *
+ * libscriptify
+ *
+ * @author  Erik Poupaert <erik@sankuru.biz>
+ *
+ * @section LICENSE
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU LGPL as
+ * published by the Free Software Foundation; either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * LGPL for more details at: http://www.gnu.org/licenses/lgpl.html
+ *
+ * @section DESCRIPTION
+ *
+ * The intern pool keeps one canonical copy of every distinct string handed to string_intern().
+ * Interned strings can be compared by address, and carry a mark that tells them apart from
+ * other strings without a lookup. The pool only holds weak references: a canonical copy that
+ * is no longer referenced anywhere else is reclaimed by the collector.
+ *
+ */
+#include <string.h>
+#include <pthread.h>
+#include "object.h"
+#include "string_utf8.h"
+#include "hash.h"
+
+//PRIVATE
+
+#define INTERN_SHARD_BITS 6
+#define INTERN_SHARDS (1<<INTERN_SHARD_BITS)
+#define INTERN_INIT_CAPACITY 64
+
+/* a canonical copy follows a word holding its own address xored with this mark */
+#define INTERN_MARK ((uintptr_t)0x9e3779b97f4a7c15ULL)
+/* the collector aligns objects to two words, so a canonical copy always starts one word into such a block */
+#define INTERN_ALIGN (2*sizeof(uintptr_t))
+
+typedef struct
+{
+	object_weakref ref; //the block holding the mark and the canonical copy; 0 once reclaimed
+	uint64_t hash; //0 marks a slot that was never used
+	size_t size;
+} _intern_entry;
+
+typedef struct
+{
+	pthread_mutex_t lock;
+	_intern_entry *entries;
+	size_t capacity;
+	size_t used; //live and reclaimed entries, which both lengthen probe sequences
+} _intern_shard;
+
+static _intern_shard intern_shards[INTERN_SHARDS];
+static pthread_once_t intern_once=PTHREAD_ONCE_INIT;
+
+static void intern_init()
+{
+	int i;
+	for(i=0; i<INTERN_SHARDS; i++)
+	{
+		pthread_mutex_init(&intern_shards[i].lock,NULL);
+		intern_shards[i].entries=NULL;
+		intern_shards[i].capacity=0;
+		intern_shards[i].used=0;
+	}
+}
+
+/**
+* The shard is chosen by the top bits of the hash, the slot by the bottom bits,
+* so that both stay independent.
+*/
+static _intern_shard *intern_shard_for(uint64_t hash)
+{
+	pthread_once(&intern_once,intern_init);
+	return &intern_shards[hash>>(64-INTERN_SHARD_BITS)];
+}
+
+static _intern_entry *intern_entries_new(size_t capacity)
+{
+	_intern_entry *entries=(_intern_entry *)object_new_atomic(capacity*sizeof(_intern_entry));
+	memset(entries,0,capacity*sizeof(_intern_entry));
+	return entries;
+}
+
+/**
+* Looks up a string in a shard whose lock is held.
+*
+* @return the canonical copy; or NULL if there is none.
+*/
+static string intern_find(_intern_shard *shard, const char *data, size_t size, uint64_t hash)
+{
+	size_t mask, i;
+	if(shard->capacity==0) return NULL;
+	mask=shard->capacity-1;
+	for(i=hash&mask; shard->entries[i].hash!=0; i=(i+1)&mask)
+	{
+		_intern_entry *entry=&shard->entries[i];
+		if(entry->hash==hash && entry->size==size)
+		{
+			char *block=(char *)object_weakref_get(&entry->ref);
+			if(block!=NULL && memcmp(block+sizeof(uintptr_t),data,size)==0) return block+sizeof(uintptr_t);
+		}
+	}
+	return NULL;
+}
+
+/**
+* Rebuilds the table of a shard whose lock is held, dropping the entries
+* the collector has reclaimed in the meantime.
+*/
+static void intern_rehash(_intern_shard *shard)
+{
+	size_t i, live=0;
+	_intern_entry *old=shard->entries;
+	size_t oldcapacity=shard->capacity;
+	size_t capacity;
+	for(i=0; i<oldcapacity; i++)
+		if(old[i].ref!=0) live++;
+	capacity=INTERN_INIT_CAPACITY;
+	while(capacity<live*2+2) capacity*=2;
+	shard->entries=intern_entries_new(capacity);
+	shard->capacity=capacity;
+	shard->used=0;
+	for(i=0; i<oldcapacity; i++)
+	{
+		object canonical=object_weakref_get(&old[i].ref);
+		object_weakref_clear(&old[i].ref);
+		if(canonical!=NULL)
+		{
+			size_t j=old[i].hash&(capacity-1);
+			while(shard->entries[j].hash!=0) j=(j+1)&(capacity-1);
+			shard->entries[j].hash=old[i].hash;
+			shard->entries[j].size=old[i].size;
+			object_weakref_set(&shard->entries[j].ref,canonical);
+			shard->used++;
+		}
+	}
+}
+
+/**
+* Adds a canonical copy to a shard whose lock is held, behind its mark.
+* The caller has made sure the string is not in the shard yet.
+*/
+static string intern_add(_intern_shard *shard, const char *data, size_t size, uint64_t hash)
+{
+	size_t mask, i;
+	char *block;
+	string canonical;
+	uintptr_t mark;
+	if((shard->used+1)*4>shard->capacity*3) intern_rehash(shard);
+	mask=shard->capacity-1;
+	//reuse the first reclaimed slot on the probe sequence, or else the empty slot ending it
+	for(i=hash&mask; shard->entries[i].hash!=0 && shard->entries[i].ref!=0; i=(i+1)&mask);
+	if(shard->entries[i].hash==0) shard->used++;
+	block=(char *)object_new_atomic(sizeof(uintptr_t)+size+1);
+	canonical=block+sizeof(uintptr_t);
+	mark=(uintptr_t)canonical^INTERN_MARK;
+	memcpy(block,&mark,sizeof(mark));
+	memcpy(canonical,data,size);
+	canonical[size]=0;
+	shard->entries[i].hash=hash;
+	shard->entries[i].size=size;
+	object_weakref_set(&shard->entries[i].ref,block);
+	return canonical;
+}
+
+static inline uint64_t intern_hash(const char *data, size_t size)
+{
+	//0 is reserved for unused slots
+	return hash_bytes(data,size)|1;
+}
+
+//PRIVATE
+
+/**
+* Returns the canonical copy of a string.
+* Equal strings intern to the same pointer, so that string_equal() on two interned strings
+* reduces to an address comparison. The canonical copy must not be modified.
+* This function is safe to call from several threads at the same time.
+*
+* @param str the string to intern.
+* @return the canonical copy of the string.
+*/
+string string_intern(string str)
+{
+	return string_intern_bytes(str,strlen(str));
+}
+
+/**
+* Returns the canonical copy of the string made of the 'size' bytes at 'data'.
+* The bytes need not be null-terminated; the canonical copy is.
+*
+* @param data the bytes to intern.
+* @param size the number of bytes.
+* @return the canonical copy of the string.
+*/
+string string_intern_bytes(const char *data, size_t size)
+{
+	uint64_t hash=intern_hash(data,size);
+	_intern_shard *shard=intern_shard_for(hash);
+	string canonical;
+	pthread_mutex_lock(&shard->lock);
+	canonical=intern_find(shard,data,size,hash);
+	if(canonical==NULL) canonical=intern_add(shard,data,size,hash);
+	pthread_mutex_unlock(&shard->lock);
+	return canonical;
+}
+
+/**
+* Checks if a string is the canonical copy held by the intern pool, by its mark, without a lookup.
+* A string with the same content as an interned one, but at another address, is not interned.
+* Only strings one word into a block of two words can be canonical; the word before them
+* lies in the same block, and thus in the same page, so that it can always be read.
+*
+* @param str the string to check.
+* @return true, if 'str' is the canonical copy; false, if not.
+*/
+bool string_is_interned(string str)
+{
+	uintptr_t mark;
+	if((uintptr_t)str%INTERN_ALIGN!=sizeof(uintptr_t)) return false;
+	memcpy(&mark,str-sizeof(uintptr_t),sizeof(mark));
+	return mark==((uintptr_t)str^INTERN_MARK);
+}
@@ -25,6 +25,8 @@
 #include "string_utf8.h"
 #include "object.h"
 #include "buffer.h"
+#include "hash.h"
+#include "format.h"
 #include <stdlib.h>
 #include <stdarg.h>
 #include <string.h>
@@ -105,7 +107,7 @@ UTF8_CHARTYPE string_utf8_getbytetype(char c)
 	struct _utf8_range range=utf8_ranges[i];
 	//loop through the allowable ranges of bytes in the UTF-8 sequence
 	while (range.code != UTF8_ERROR) {
-		if (c>=range.start && c<=range.end) 
+		if ((unsigned char)c>=range.start && (unsigned char)c<=range.end) 
 		{
 		   //the byte falls in a valid range: stop searching
  	           break;
@@ -244,7 +246,7 @@ string string_tolower_utf8(string str)
     byte_length = strlen(str);
     char_length = string_length_utf8(str) + 1;
     s = string_new(byte_length);
-    wstr = wptr = malloc(sizeof(wchar_t) * char_length);
+    wstr = wptr = malloc(sizeof(wchar_t) * (char_length + 1));
     
     utf8_to_wchar(str, byte_length, wstr, char_length, 0);
     wstr[char_length]=0;
@@ -274,7 +276,7 @@ string string_toupper_utf8(string str)
     byte_length = strlen(str);
     char_length = string_length_utf8(str) + 1;
     s = string_new(byte_length);
-    wstr = wptr = malloc(sizeof(wchar_t) * char_length);
+    wstr = wptr = malloc(sizeof(wchar_t) * (char_length + 1));
     
     utf8_to_wchar(str, byte_length, wstr, char_length, 0);
     wstr[char_length]=0;
@@ -338,6 +340,8 @@ bool string_valid_utf8(string str)
 * Checks if two strings are equal.
 * if you want to check if both strings are equal, ignoring case, 
 * convert both strings to uppercase (or lowercase) before checking.
+* Two interned strings are equal exactly when they are the same pointer:
+* when both carry the mark of the intern pool, no characters are compared.
 *
 * @param str1 the first string.
 * @param str2 the second string.
@@ -345,6 +349,8 @@ bool string_valid_utf8(string str)
 */
 bool string_equal(string str1, string str2)
 {
+	if(str1==str2) return true;
+	if(string_is_interned(str1) && string_is_interned(str2)) return false;
 	return (strcmp(str1,str2)==0);
 }
 
@@ -502,36 +508,36 @@ string string_trim_utf8(string str, bool left, bool right)
 }
 
 /**
-* Formats a string according the 'format'.
+* Formats a string according the 'fmt'.
+* The format string is compiled on first use and cached, see format_cached(),
+* and the result is built in a buffer sized from the compiled format up front, without a final copy.
 *
-* @param format the string format.
+* @param fmt the string format.
 * @param ... the variables in the format.
-* @return A new string formatted according to 'format'.
+* @return A new string formatted according to 'fmt'.
 */
-string string_format(string format, ...)
+string string_format(string fmt, ...)
 {
 	va_list args;
-	int allocated;
 	buffer abuffer;
-
-	/*
-		//XXX
-		create a buffer with double the capacity of the format string
-	*/   
-	abuffer = buffer_new();	
-	while(1)
-	{
-		va_start(args, format);
-		allocated = vsnprintf(abuffer->data, abuffer->capacity, format, args);
-		va_end(args);
-		if (allocated > -1 && allocated < abuffer->capacity) 
-		{
-	            break;
-	        }
-		buffer_doublesize(abuffer);
-	}
-
-    abuffer->size = allocated;
-    return buffer_tostring(abuffer);
+	format compiled=format_cached(fmt);
+
+	abuffer = buffer_new_capacity(compiled!=NULL?compiled->estimate:2*strlen(fmt)+1);
+	va_start(args, fmt);
+	if(compiled!=NULL) format_vrender(compiled, abuffer, args);
+	else buffer_vprintf(abuffer, fmt, args);
+	va_end(args);
+	return buffer_steal(abuffer);
 }
 
+/**
+* Computes the hash value of a string, with the process-wide seed.
+* Equal strings always have equal hash values within the same process.
+*
+* @param str the string to hash.
+* @return the 64-bit hash value.
+*/
+uint64_t string_hash(string str)
+{
+	return hash_bytes(str,strlen(str));
+}
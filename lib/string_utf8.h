@@ -27,6 +27,7 @@
 
 #include <stdbool.h>
 #include <stddef.h>
+#include <stdint.h>
 
 #ifdef __cplusplus
 	extern "C" {
@@ -34,9 +35,9 @@
 
 typedef char* string;
 
-#define UTF8_FAIL -1;
-#define CHAR_LF 0x0a;
-#define CHAR_CR 0x0d;
+#define UTF8_FAIL (-1)
+#define CHAR_LF 0x0a
+#define CHAR_CR 0x0d
 
 enum _UTF8_CHARTYPE
 {
@@ -73,7 +74,13 @@ string string_tolower(string str);
 string string_toupper(string str);
 char string_charat(string str, size_t index);
 string string_trim(string str, bool left, bool right);
-string string_format(string format, ...);
+string string_format(string fmt, ...);
+uint64_t string_hash(string str);
+
+/* interning */
+string string_intern(string str);
+string string_intern_bytes(const char *data, size_t size);
+bool string_is_interned(string str);
 
 #ifdef __cplusplus
 	}
@@ -0,0 +1,449 @@
+/**
+ *
+ * libscriptify
+ *
+ * @author  Erik Poupaert <erik@sankuru.biz>
+ *
+ * @section LICENSE
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU LGPL as
+ * published by the Free Software Foundation; either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * LGPL for more details at: http://www.gnu.org/licenses/lgpl.html
+ *
+ * @section DESCRIPTION
+ *
+ * A work-stealing thread pool: every worker has its own deque of tasks, and idle workers
+ * steal from the others. Offers fork/join groups of tasks and a parallel for loop.
+ *
+ */
+#include <string.h>
+#include <sched.h>
+#include <unistd.h>
+#include "object.h"
+#include "threadpool.h"
+
+//PRIVATE
+
+/* failed attempts to find work before an idle worker goes to sleep */
+#define THREADPOOL_SPINS 64
+
+static __thread threadpool_worker threadpool_current=NULL;
+static threadpool threadpool_default_pool=NULL;
+static pthread_once_t threadpool_default_once=PTHREAD_ONCE_INIT;
+
+typedef struct
+{
+	size_t begin;
+	size_t end;
+	size_t grain;
+	threadpool_range_fn fn;
+	void *arg;
+	threadpool_group group;
+} _threadpool_range;
+
+typedef _threadpool_range* threadpool_range;
+
+static threadpool_array threadpool_array_new(long capacity)
+{
+	threadpool_array array=(threadpool_array)object_new(sizeof(_threadpool_array)+capacity*sizeof(threadpool_task));
+	array->capacity=capacity;
+	return array;
+}
+
+/**
+* Replaces the array of a deque by one twice as large. Only the owner does this.
+* Thieves may still be reading the old array; the collector keeps it alive for them.
+*/
+static threadpool_array threadpool_deque_grow(_threadpool_deque *deque, threadpool_array old, long top, long bottom)
+{
+	threadpool_array array=threadpool_array_new(old->capacity*2);
+	long i;
+	for(i=top; i<bottom; i++)
+		array->items[i&(array->capacity-1)]=__atomic_load_n(&old->items[i&(old->capacity-1)],__ATOMIC_RELAXED);
+	__atomic_store_n(&deque->array,array,__ATOMIC_RELEASE);
+	return array;
+}
+
+static void threadpool_deque_push(_threadpool_deque *deque, threadpool_task task)
+{
+	long bottom=__atomic_load_n(&deque->bottom,__ATOMIC_RELAXED);
+	long top=__atomic_load_n(&deque->top,__ATOMIC_ACQUIRE);
+	threadpool_array array=__atomic_load_n(&deque->array,__ATOMIC_RELAXED);
+	if(bottom-top>array->capacity-1) array=threadpool_deque_grow(deque,array,top,bottom);
+	__atomic_store_n(&array->items[bottom&(array->capacity-1)],task,__ATOMIC_RELAXED);
+	__atomic_thread_fence(__ATOMIC_RELEASE);
+	__atomic_store_n(&deque->bottom,bottom+1,__ATOMIC_RELAXED);
+}
+
+static threadpool_task threadpool_deque_pop(_threadpool_deque *deque)
+{
+	long bottom=__atomic_load_n(&deque->bottom,__ATOMIC_RELAXED)-1;
+	threadpool_array array=__atomic_load_n(&deque->array,__ATOMIC_RELAXED);
+	long top;
+	threadpool_task task=NULL;
+	__atomic_store_n(&deque->bottom,bottom,__ATOMIC_RELAXED);
+	__atomic_thread_fence(__ATOMIC_SEQ_CST);
+	top=__atomic_load_n(&deque->top,__ATOMIC_RELAXED);
+	if(top<=bottom)
+	{
+		task=__atomic_load_n(&array->items[bottom&(array->capacity-1)],__ATOMIC_RELAXED);
+		if(top==bottom)
+		{
+			//the last task: race the thieves for it
+			if(!__atomic_compare_exchange_n(&deque->top,&top,top+1,false,__ATOMIC_SEQ_CST,__ATOMIC_RELAXED))
+				task=NULL;
+			__atomic_store_n(&deque->bottom,bottom+1,__ATOMIC_RELAXED);
+		}
+	}
+	else
+	{
+		__atomic_store_n(&deque->bottom,bottom+1,__ATOMIC_RELAXED);
+	}
+	return task;
+}
+
+static threadpool_task threadpool_deque_steal(_threadpool_deque *deque)
+{
+	long top=__atomic_load_n(&deque->top,__ATOMIC_ACQUIRE);
+	long bottom;
+	threadpool_task task;
+	__atomic_thread_fence(__ATOMIC_SEQ_CST);
+	bottom=__atomic_load_n(&deque->bottom,__ATOMIC_ACQUIRE);
+	if(top>=bottom) return NULL;
+	threadpool_array array=__atomic_load_n(&deque->array,__ATOMIC_ACQUIRE);
+	task=__atomic_load_n(&array->items[top&(array->capacity-1)],__ATOMIC_RELAXED);
+	if(!__atomic_compare_exchange_n(&deque->top,&top,top+1,false,__ATOMIC_SEQ_CST,__ATOMIC_RELAXED))
+		return NULL;
+	return task;
+}
+
+static threadpool_task threadpool_take_injected(threadpool pool)
+{
+	threadpool_task task;
+	if(__atomic_load_n(&pool->injected,__ATOMIC_RELAXED)==0) return NULL;
+	pthread_mutex_lock(&pool->lock);
+	task=pool->injected_head;
+	if(task!=NULL)
+	{
+		pool->injected_head=task->next;
+		if(pool->injected_head==NULL) pool->injected_tail=NULL;
+		__atomic_sub_fetch(&pool->injected,1,__ATOMIC_RELAXED);
+	}
+	pthread_mutex_unlock(&pool->lock);
+	return task;
+}
+
+/**
+* Finds a task to run: first from the own deque, newest first, then from the tasks spawned
+* from outside the pool, and finally by stealing the oldest task of another worker.
+*
+* @param self the worker looking for work; NULL for a thread outside the pool.
+*/
+static threadpool_task threadpool_find(threadpool pool, threadpool_worker self)
+{
+	threadpool_task task;
+	unsigned int seed;
+	int i, start;
+	if(self!=NULL)
+	{
+		task=threadpool_deque_pop(&self->deque);
+		if(task!=NULL) return task;
+	}
+	task=threadpool_take_injected(pool);
+	if(task!=NULL) return task;
+	seed=self!=NULL?self->seed:(unsigned int)(size_t)&task;
+	seed=seed*1103515245u+12345u;
+	if(self!=NULL) self->seed=seed;
+	start=(int)((seed>>16)%(unsigned int)pool->size);
+	for(i=0; i<pool->size; i++)
+	{
+		threadpool_worker victim=pool->workers[(start+i)%pool->size];
+		if(victim==self) continue;
+		task=threadpool_deque_steal(&victim->deque);
+		if(task!=NULL) return task;
+	}
+	return NULL;
+}
+
+/**
+* Runs a task, and wakes up the thread waiting for its group if it was the last one.
+* The count and the flag of the waiter are both sequentially consistent, so that either
+* the waiter sees the count drop, or the last task sees the waiter.
+*/
+static void threadpool_run(threadpool_task task)
+{
+	threadpool_group group=task->group;
+	task->fn(task->arg);
+	if(__atomic_sub_fetch(&group->pending,1,__ATOMIC_SEQ_CST)==0 && __atomic_load_n(&group->waiting,__ATOMIC_SEQ_CST))
+	{
+		pthread_mutex_lock(&group->lock);
+		pthread_cond_broadcast(&group->done);
+		pthread_mutex_unlock(&group->lock);
+	}
+}
+
+/**
+* Announces a task pushed on a deque, and wakes up a sleeping worker to steal it. A worker counts
+* itself as sleeping before it checks the count of pushed tasks a last time, so that either
+* the worker sees the task, or the task sees the worker.
+*/
+static void threadpool_wake(threadpool pool)
+{
+	__atomic_add_fetch(&pool->pushed,1,__ATOMIC_SEQ_CST);
+	if(__atomic_load_n(&pool->sleeping,__ATOMIC_SEQ_CST)==0) return;
+	pthread_mutex_lock(&pool->lock);
+	pthread_cond_signal(&pool->wake);
+	pthread_mutex_unlock(&pool->lock);
+}
+
+/**
+* The loop of a worker: runs tasks while there are any, spins briefly when there are none,
+* and then sleeps until a task is spawned or the pool stops.
+*/
+static void *threadpool_worker_main(void *arg)
+{
+	threadpool_worker self=(threadpool_worker)arg;
+	threadpool pool=self->pool;
+	int spins=0;
+	threadpool_current=self;
+	while(!__atomic_load_n(&pool->stopping,__ATOMIC_ACQUIRE))
+	{
+		long pushed=__atomic_load_n(&pool->pushed,__ATOMIC_SEQ_CST);
+		threadpool_task task=threadpool_find(pool,self);
+		if(task!=NULL)
+		{
+			threadpool_run(task);
+			spins=0;
+			continue;
+		}
+		if(++spins<THREADPOOL_SPINS)
+		{
+			sched_yield();
+			continue;
+		}
+		spins=0;
+		pthread_mutex_lock(&pool->lock);
+		__atomic_add_fetch(&pool->sleeping,1,__ATOMIC_SEQ_CST);
+		//tasks spawned from outside come with the lock held, tasks pushed on deques bump the count
+		if(!pool->stopping && pool->injected==0 && __atomic_load_n(&pool->pushed,__ATOMIC_SEQ_CST)==pushed)
+			pthread_cond_wait(&pool->wake,&pool->lock);
+		__atomic_sub_fetch(&pool->sleeping,1,__ATOMIC_SEQ_CST);
+		pthread_mutex_unlock(&pool->lock);
+	}
+	threadpool_current=NULL;
+	return NULL;
+}
+
+static void threadpool_range_task(void *arg)
+{
+	threadpool_range range=(threadpool_range)arg;
+	//split off the upper halves for others to steal, and keep the lower part
+	while(range->end-range->begin>range->grain)
+	{
+		threadpool_range upper=(threadpool_range)object_new(sizeof(_threadpool_range));
+		*upper=*range;
+		upper->begin=range->begin+(range->end-range->begin)/2;
+		range->end=upper->begin;
+		threadpool_group_spawn(range->group,threadpool_range_task,upper);
+	}
+	range->fn(range->begin,range->end,range->arg);
+}
+
+static void threadpool_default_init()
+{
+	long size=sysconf(_SC_NPROCESSORS_ONLN);
+	threadpool_default_pool=threadpool_new(size>0?(int)size:1);
+}
+
+//PRIVATE
+
+/**
+* Creates a new thread pool with 'size' worker threads.
+* Each worker keeps its own deque of tasks; idle workers steal from the others,
+* so that work spawned recursively spreads over all workers by itself.
+* The workers are registered with the collector, so tasks can allocate objects freely.
+*
+* @param size the number of worker threads; at least 1.
+* @return A pointer to the new thread pool.
+*/
+threadpool threadpool_new(int size)
+{
+	threadpool pool=(threadpool)object_new(sizeof(_threadpool));
+	int i;
+	if(size<1) size=1;
+	pthread_mutex_init(&pool->lock,NULL);
+	pthread_cond_init(&pool->wake,NULL);
+	pool->workers=(threadpool_worker *)object_new(size*sizeof(threadpool_worker));
+	for(i=0; i<size; i++)
+	{
+		threadpool_worker worker=(threadpool_worker)object_new(sizeof(_threadpool_worker));
+		worker->pool=pool;
+		worker->index=i;
+		worker->seed=(unsigned int)i*2654435761u+1;
+		worker->deque.array=threadpool_array_new(THREADPOOL_DEQUE_CAPACITY);
+		pool->workers[i]=worker;
+	}
+	//all workers exist before any can try to steal from them
+	pool->size=size;
+	for(i=0; i<size; i++)
+		object_thread_create(&pool->workers[i]->thread,threadpool_worker_main,pool->workers[i]);
+	return pool;
+}
+
+/**
+* Returns the thread pool shared by the whole library, with one worker per processor.
+* It is created on first use and lives as long as the process.
+*
+* @return the default thread pool.
+*/
+threadpool threadpool_default()
+{
+	pthread_once(&threadpool_default_once,threadpool_default_init);
+	return threadpool_default_pool;
+}
+
+/**
+* Returns the number of worker threads of a thread pool.
+*
+* @param pool the thread pool.
+* @return the number of workers.
+*/
+int threadpool_size(threadpool pool)
+{
+	return pool->size;
+}
+
+/**
+* Runs one pending task of a thread pool on the calling thread, if there is one.
+* Threads that wait for tasks to finish call this, instead of blocking,
+* so that waiting inside a task can never starve the pool.
+*
+* @param pool the thread pool.
+* @return true, if a task was run; false, if there was nothing to do.
+*/
+bool threadpool_help(threadpool pool)
+{
+	threadpool_worker self=threadpool_current!=NULL && threadpool_current->pool==pool?threadpool_current:NULL;
+	threadpool_task task=threadpool_find(pool,self);
+	if(task==NULL) return false;
+	threadpool_run(task);
+	return true;
+}
+
+/**
+* Stops the workers of a thread pool, once they finish the task they are running.
+* Tasks not started yet are dropped. Must not be called from a worker of the pool itself,
+* nor on the default thread pool.
+*
+* @param pool the thread pool.
+*/
+void threadpool_stop(threadpool pool)
+{
+	int i;
+	pthread_mutex_lock(&pool->lock);
+	__atomic_store_n(&pool->stopping,true,__ATOMIC_RELEASE);
+	pthread_cond_broadcast(&pool->wake);
+	pthread_mutex_unlock(&pool->lock);
+	for(i=0; i<pool->size; i++) object_thread_join(pool->workers[i]->thread,NULL);
+}
+
+/**
+* Creates a new group of tasks, which can be waited for together.
+*
+* @param pool the thread pool that runs the tasks.
+* @return A pointer to the new group.
+*/
+threadpool_group threadpool_group_new(threadpool pool)
+{
+	threadpool_group group=(threadpool_group)object_new(sizeof(_threadpool_group));
+	group->pool=pool;
+	pthread_mutex_init(&group->lock,NULL);
+	pthread_cond_init(&group->done,NULL);
+	return group;
+}
+
+/**
+* Spawns a task in a group: 'fn' will be called with 'arg' on some worker.
+* Tasks spawned by a worker go on its own deque, where they cost no locking;
+* tasks spawned from other threads go through a shared queue.
+*
+* @param group the group.
+* @param fn the function to run.
+* @param arg passed on to 'fn'.
+*/
+void threadpool_group_spawn(threadpool_group group, threadpool_fn fn, void *arg)
+{
+	threadpool pool=group->pool;
+	threadpool_task task=(threadpool_task)object_new(sizeof(_threadpool_task));
+	task->fn=fn;
+	task->arg=arg;
+	task->group=group;
+	__atomic_add_fetch(&group->pending,1,__ATOMIC_RELAXED);
+	if(threadpool_current!=NULL && threadpool_current->pool==pool)
+	{
+		threadpool_deque_push(&threadpool_current->deque,task);
+		threadpool_wake(pool);
+		return;
+	}
+	pthread_mutex_lock(&pool->lock);
+	if(pool->injected_tail==NULL) pool->injected_head=task;
+	else pool->injected_tail->next=task;
+	pool->injected_tail=task;
+	__atomic_add_fetch(&pool->injected,1,__ATOMIC_RELAXED);
+	pthread_cond_signal(&pool->wake);
+	pthread_mutex_unlock(&pool->lock);
+}
+
+/**
+* Waits until all tasks of a group have finished, including the tasks they spawned in the group.
+* The calling thread runs pending tasks of the pool while there are any; once there are none,
+* the remaining tasks of the group are running elsewhere, and it sleeps until the last one finishes.
+*
+* @param group the group.
+*/
+void threadpool_group_wait(threadpool_group group)
+{
+	while(__atomic_load_n(&group->pending,__ATOMIC_ACQUIRE)>0)
+	{
+		if(threadpool_help(group->pool)) continue;
+		pthread_mutex_lock(&group->lock);
+		__atomic_store_n(&group->waiting,true,__ATOMIC_SEQ_CST);
+		while(__atomic_load_n(&group->pending,__ATOMIC_SEQ_CST)>0) pthread_cond_wait(&group->done,&group->lock);
+		pthread_mutex_unlock(&group->lock);
+	}
+}
+
+/**
+* Calls 'fn' over the range [begin,end) in parallel, in pieces of at most 'grain' indexes.
+* The range is split in halves recursively, so that idle workers steal large pieces first.
+* Returns when all pieces are done.
+*
+* @param pool the thread pool.
+* @param begin the first index.
+* @param end one past the last index.
+* @param grain the largest piece handed to 'fn' at once; 0 to choose one from the size of the pool.
+* @param fn called with the bounds of every piece.
+* @param arg passed on to 'fn'.
+*/
+void threadpool_for(threadpool pool, size_t begin, size_t end, size_t grain, threadpool_range_fn fn, void *arg)
+{
+	threadpool_range range;
+	if(end<=begin) return;
+	if(grain==0) grain=(end-begin)/(8*(size_t)pool->size);
+	if(grain==0) grain=1;
+	range=(threadpool_range)object_new(sizeof(_threadpool_range));
+	range->begin=begin;
+	range->end=end;
+	range->grain=grain;
+	range->fn=fn;
+	range->arg=arg;
+	range->group=threadpool_group_new(pool);
+	threadpool_range_task(range);
+	threadpool_group_wait(range->group);
+}
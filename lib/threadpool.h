@@ -0,0 +1,127 @@
+/**
+ *
+ * libscriptify
+ *
+ * @author  Erik Poupaert <erik@sankuru.biz>
+ *
+ * @section LICENSE
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU LGPL as
+ * published by the Free Software Foundation; either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * LGPL for more details at: http://www.gnu.org/licenses/lgpl.html
+ *
+ * @section DESCRIPTION
+ *
+ * A work-stealing thread pool: every worker has its own deque of tasks, and idle workers
+ * steal from the others. Offers fork/join groups of tasks and a parallel for loop.
+ *
+ */
+#ifndef _THREADPOOL_H
+#define _THREADPOOL_H
+
+#include <stddef.h>
+#include <stdbool.h>
+#include <pthread.h>
+#include "object.h"
+
+#ifdef __cplusplus
+	extern "C" {
+#endif
+
+/* initial number of tasks a worker deque can hold; it grows as needed */
+#define THREADPOOL_DEQUE_CAPACITY 64
+
+typedef void (*threadpool_fn)(void *arg);
+typedef void (*threadpool_range_fn)(size_t begin, size_t end, void *arg);
+
+struct _threadpool;
+struct _threadpool_group;
+
+typedef struct _threadpool_task
+{
+	threadpool_fn fn;
+	void *arg;
+	struct _threadpool_group *group;
+	struct _threadpool_task *next; //only used in the queue of tasks spawned from outside the pool
+} _threadpool_task;
+
+typedef _threadpool_task* threadpool_task;
+
+typedef struct
+{
+	long capacity; //a power of two
+	threadpool_task items[];
+} _threadpool_array;
+
+typedef _threadpool_array* threadpool_array;
+
+/* Chase-Lev deque: the owner pushes and pops at the bottom, thieves steal from the top */
+typedef struct
+{
+	long top;
+	char padding[64-sizeof(long)]; //keeps 'top' and 'bottom' in separate cache lines
+	long bottom;
+	threadpool_array array;
+} _threadpool_deque;
+
+typedef struct
+{
+	struct _threadpool *pool;
+	int index;
+	unsigned int seed; //for picking victims to steal from
+	pthread_t thread;
+	_threadpool_deque deque;
+} _threadpool_worker;
+
+typedef _threadpool_worker* threadpool_worker;
+
+typedef struct _threadpool
+{
+	int size;
+	threadpool_worker *workers;
+	pthread_mutex_t lock;
+	pthread_cond_t wake;
+	threadpool_task injected_head; //tasks spawned from threads outside the pool
+	threadpool_task injected_tail;
+	long injected;
+	long pushed; //counts tasks pushed on deques, so that workers going to sleep notice them
+	int sleeping;
+	bool stopping;
+} _threadpool;
+
+typedef _threadpool* threadpool;
+
+typedef struct _threadpool_group
+{
+	threadpool pool;
+	long pending; //tasks spawned and not finished yet
+	pthread_mutex_t lock;
+	pthread_cond_t done; //signalled when 'pending' drops to zero while someone waits
+	bool waiting;
+} _threadpool_group;
+
+typedef _threadpool_group* threadpool_group;
+
+threadpool threadpool_new(int size);
+threadpool threadpool_default();
+int threadpool_size(threadpool pool);
+bool threadpool_help(threadpool pool);
+void threadpool_stop(threadpool pool);
+void threadpool_for(threadpool pool, size_t begin, size_t end, size_t grain, threadpool_range_fn fn, void *arg);
+
+/* fork/join */
+threadpool_group threadpool_group_new(threadpool pool);
+void threadpool_group_spawn(threadpool_group group, threadpool_fn fn, void *arg);
+void threadpool_group_wait(threadpool_group group);
+
+#ifdef __cplusplus
+	}
+#endif
+
+#endif // _THREADPOOL_H
@@ -0,0 +1,104 @@
+/**
+ *
+ * libscriptify
+ *
+ * @author  Erik Poupaert <erik@sankuru.biz>
+ *
+ * @section LICENSE
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU LGPL as
+ * published by the Free Software Foundation; either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * LGPL for more details at: http://www.gnu.org/licenses/lgpl.html
+ *
+ * @section DESCRIPTION
+ *
+ * A view refers to a run of bytes owned by someone else, such as part of a string or a buffer.
+ * Views make it possible to pass substrings around without copying them.
+ *
+ */
+#include <string.h>
+#include "view.h"
+#include "hash.h"
+
+/**
+* Creates a view on the 'size' bytes at 'data'.
+* Nothing is copied: the bytes must outlive the view.
+*
+* @param data the first byte.
+* @param size the number of bytes.
+* @return the view.
+*/
+view view_new(const char *data, size_t size)
+{
+	view v;
+	v.data=data;
+	v.size=size;
+	return v;
+}
+
+/**
+* Creates a view on a whole string, without its terminating zero.
+*
+* @param str the string.
+* @return the view.
+*/
+view view_from_string(string str)
+{
+	return view_new(str,strlen(str));
+}
+
+/**
+* Copies the bytes of a view into a new null-terminated string.
+*
+* @param v the view.
+* @return A pointer to the new string.
+*/
+string view_tostring(view v)
+{
+	string s=string_new(v.size);
+	memcpy(s,v.data,v.size);
+	s[v.size]=0;
+	return s;
+}
+
+/**
+* Checks if two views hold the same bytes.
+*
+* @param v1 the first view.
+* @param v2 the second view.
+* @return true if v1 is equal to v2; false, if not.
+*/
+bool view_equal(view v1, view v2)
+{
+	return v1.size==v2.size && (v1.data==v2.data || memcmp(v1.data,v2.data,v1.size)==0);
+}
+
+/**
+* Checks if a view holds the same bytes as a string.
+*
+* @param v the view.
+* @param str the string.
+* @return true if v is equal to str; false, if not.
+*/
+bool view_equal_string(view v, string str)
+{
+	return strlen(str)==v.size && memcmp(v.data,str,v.size)==0;
+}
+
+/**
+* Computes the hash value of a view.
+* A view hashes like a string with the same content.
+*
+* @param v the view to hash.
+* @return the 64-bit hash value.
+*/
+uint64_t view_hash(view v)
+{
+	return hash_bytes(v.data,v.size);
+}
@@ -0,0 +1,55 @@
+/**
+ *
+ * libscriptify
+ *
+ * @author  Erik Poupaert <erik@sankuru.biz>
+ *
+ * @section LICENSE
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU LGPL as
+ * published by the Free Software Foundation; either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * LGPL for more details at: http://www.gnu.org/licenses/lgpl.html
+ *
+ * @section DESCRIPTION
+ *
+ * A view refers to a run of bytes owned by someone else, such as part of a string or a buffer.
+ * Views make it possible to pass substrings around without copying them.
+ *
+ */
+#ifndef _VIEW_H
+#define _VIEW_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include "string_utf8.h"
+
+#ifdef __cplusplus
+	extern "C" {
+#endif
+
+/* views are passed by value; they do not own the bytes they refer to */
+typedef struct
+{
+	const char *data;
+	size_t size;
+} view;
+
+view view_new(const char *data, size_t size);
+view view_from_string(string str);
+string view_tostring(view v);
+bool view_equal(view v1, view v2);
+bool view_equal_string(view v, string str);
+uint64_t view_hash(view v);
+
+#ifdef __cplusplus
+	}
+#endif
+
+#endif // _VIEW_H
@@ -21,6 +21,7 @@
  * Unit test for the 'any' data type.
  *
  */
+#include <math.h>
 #include "test.h"
 #include "any.h"
 #include "string_utf8.h"
@@ -58,10 +59,78 @@ START_TEST (test_any_object)
 }
 END_TEST
 
+START_TEST (test_any_string_copy)
+{
+	string str=string_new_copy("id");
+	any shortone=any_new_string_copy(str);
+	any longone=any_new_string_copy("a string that does not fit inline");
+	str[0]='x';
+	fail_unless (string_equal(any_string(shortone),"id"), "copying short string");
+	fail_unless (any_string_is_inline(shortone), "short string is inline");
+	fail_unless (string_equal(any_string(longone),"a string that does not fit inline"), "copying long string");
+	fail_unless (!any_string_is_inline(longone), "long string is not inline");
+	fail_unless (string_equal(any_new_string_bytes("okay",2)->str,"ok"), "copying bytes");
+}
+END_TEST
+
+START_TEST (test_any_hash)
+{
+	fail_unless (any_hash(any_new_int(5))==any_hash(any_new_long(5)), "hashing int and long");
+	fail_unless (any_hash(any_new_double(0.0))==any_hash(any_new_double(-0.0)), "hashing zero");
+	fail_unless (any_hash(any_new_double(-NAN))==any_hash(any_new_double(NAN)), "hashing NaN");
+	fail_unless (any_hash(any_new_string("hello"))==string_hash("hello"), "hashing string");
+	fail_unless (any_hash(any_new_int(5))!=any_hash(any_new_int(6)), "hashing different ints");
+}
+END_TEST
+
+START_TEST (test_any_parse_number)
+{
+	any a=any_parse_number("42",2);
+	fail_unless (a->type==TYPE_INT && a->i==42, "parsing int");
+	a=any_parse_number("-12345678901",12);
+	fail_unless (a->type==TYPE_LONG && a->lng==-12345678901L, "parsing long");
+	a=any_parse_number("2.5e1",5);
+	fail_unless (a->type==TYPE_DOUBLE && a->dbl==25.0, "parsing double");
+	fail_unless (any_parse_number("12ab",4)==NULL, "parsing garbage");
+}
+END_TEST
+
+START_TEST (test_any_to_string)
+{
+	fail_unless (string_equal(any_to_string(any_new_int(-42)),"-42"), "int to string");
+	fail_unless (string_equal(any_to_string(any_new_long(12345678901L)),"12345678901"), "long to string");
+	fail_unless (string_equal(any_to_string(any_new_double(2.5)),"2.5"), "double to string");
+	fail_unless (string_equal(any_to_string(any_new_string("hello")),"hello"), "string to string");
+}
+END_TEST
+
+START_TEST (test_any_bool_null_array)
+{
+	manyany items=(manyany)object_new(2*sizeof(any));
+	any arr;
+	items[0]=any_new_bool(true);
+	items[1]=any_new_null();
+	arr=any_new_array(items,2);
+	fail_unless (arr->type==TYPE_ARRAY && arr->arr->size==2, "any_new_array failed");
+	fail_unless (any_equal(arr->arr->items[0],any_new_bool(true)), "booleans differ");
+	fail_unless (!any_equal(any_new_bool(true),any_new_bool(false)), "booleans equal");
+	fail_unless (any_equal(any_new_null(),any_new_null()), "nulls differ");
+	fail_unless (any_hash(any_new_null())==any_hash(items[1]), "nulls hash differently");
+	fail_unless (any_equal(any_new_int(7),any_new_long(7)), "an int and a long differ");
+	fail_unless (string_equal(any_to_string(items[0]),"true"), "any_to_string failed on a boolean");
+	fail_unless (string_equal(any_to_string(items[1]),"null"), "any_to_string failed on null");
+}
+END_TEST
+
 TEST_HEADER
 	tcase_add_test (tc, test_any_int);
 	tcase_add_test (tc, test_any_long);
 	tcase_add_test (tc, test_any_string);
 	tcase_add_test (tc, test_any_object);
+	tcase_add_test (tc, test_any_string_copy);
+	tcase_add_test (tc, test_any_hash);
+	tcase_add_test (tc, test_any_parse_number);
+	tcase_add_test (tc, test_any_to_string);
+	tcase_add_test (tc, test_any_bool_null_array);
 TEST_FOOTER("ANY")
 
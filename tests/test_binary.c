@@ -0,0 +1,159 @@
+/**
+ *
+ * libscriptify
+ *
+ * @author  Erik Poupaert <erik@sankuru.biz>
+ *
+ * @section LICENSE
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU LGPL as
+ * published by the Free Software Foundation; either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * LGPL for more details at: http://www.gnu.org/licenses/lgpl.html
+ *
+ * @section DESCRIPTION
+ *
+ * Unit test for the binary encoding.
+ *
+ */
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include "test.h"
+#include "object.h"
+#include "json.h"
+#include "shape.h"
+#include "binary.h"
+
+static const char *sample="{\"name\":\"libscriptify\",\"version\":2,\"big\":-12345678901,\"ratio\":0.25,"
+	"\"tags\":[\"a\",\"b\",\"a\",[],{}],\"ok\":true,\"no\":false,\"none\":null,"
+	"\"k0\":0,\"k1\":1,\"k2\":2,\"k3\":3,\"k4\":4,\"k5\":5,\"k6\":6,\"k7\":7,\"k8\":8,\"k9\":9}";
+
+START_TEST (test_binary_round_trip)
+{
+	any doc=json_parse((string)sample);
+	buffer b=buffer_new();
+	binary_doc bin;
+	buffer_appendstring(b,"prefix");
+	fail_unless (binary_write(b,doc), "binary_write failed");
+	bin=binary_open(view_new(b->data+6,b->size-6));
+	fail_unless (bin!=NULL, "binary_open failed");
+	fail_unless (string_equal(json_tostring(binary_to_any(binary_root(bin)),0),(string)sample), "values changed");
+}
+END_TEST
+
+START_TEST (test_binary_lazy)
+{
+	any doc=json_parse((string)sample);
+	buffer b=buffer_new();
+	binary_value root, tags, value;
+	binary_write(b,doc);
+	root=binary_root(binary_open(view_new(b->data,b->size)));
+	fail_unless (binary_type(root)==TYPE_MAP && binary_size(root)==18, "wrong root");
+	fail_unless (binary_get(root,"k7",&value) && binary_long(value)==7, "indexed lookup failed");
+	fail_unless (binary_get(root,"big",&value) && binary_type(value)==TYPE_LONG && binary_long(value)==-12345678901L, "wrong long");
+	fail_unless (!binary_get(root,"missing",&value), "found a missing key");
+	fail_unless (string_equal(binary_string(binary_map_key(root,0)),"name"), "entries out of order");
+	fail_unless (binary_get(root,"tags",&tags) && binary_size(tags)==5, "wrong array");
+	fail_unless (binary_string(binary_at(tags,0))==binary_string(binary_at(tags,2)), "strings not shared");
+	fail_unless (binary_type(binary_at(tags,5))==TYPE_NULL, "item past the end not null");
+	fail_unless (binary_get(root,"ratio",&value) && binary_double(value)==0.25, "wrong double");
+	fail_unless (binary_get(root,"ok",&value) && binary_bool(value), "wrong boolean");
+	fail_unless (binary_get(binary_map_value(root,4),"x",&value)==false, "lookup in an array succeeded");
+}
+END_TEST
+
+START_TEST (test_binary_file)
+{
+	char path[]="/tmp/test_binary_XXXXXX";
+	int fd=mkstemp(path);
+	buffer b=buffer_new();
+	binary_doc bin;
+	binary_value value;
+	size_t i;
+	binary_write(b,json_parse((string)sample));
+	fail_unless (write(fd,b->data,b->size)==(ssize_t)b->size, "write failed");
+	close(fd);
+	bin=binary_open_file(path);
+	unlink(path);
+	fail_unless (bin!=NULL, "binary_open_file failed");
+	fail_unless (binary_get(binary_root(bin),"name",&value) && string_equal(binary_string(value),"libscriptify"), "wrong string");
+	fail_unless (binary_open(view_new(b->data,b->size-1))==NULL, "truncated document opened");
+	//damaged documents must not crash
+	for(i=8; i<b->size-32; i++)
+	{
+		char saved=b->data[i];
+		b->data[i]^=0x5a;
+		bin=binary_open(view_new(b->data,b->size));
+		if(bin!=NULL) binary_to_any(binary_root(bin));
+		b->data[i]=saved;
+	}
+}
+END_TEST
+
+START_TEST (test_binary_damaged_index)
+{
+	const char *keys[]={"a", "b", "c", "d", "e", "f", "g", "h", "i", "missing"};
+	const unsigned char masks[]={0x5a, 0xff, 0x01};
+	buffer b=buffer_new();
+	binary_value value;
+	size_t i, k, m;
+	binary_write(b,json_parse("{\"a\":1,\"b\":2,\"c\":3,\"d\":4,\"e\":5,\"f\":6,\"g\":7,\"h\":8,\"i\":9}"));
+	//a copy of the exact size, so that reading past the end is caught
+	for(i=8; i<b->size-32; i++)
+		for(m=0; m<sizeof(masks); m++)
+		{
+			char *copy=(char *)object_new_atomic(b->size);
+			binary_doc bin;
+			memcpy(copy,b->data,b->size);
+			copy[i]^=masks[m];
+			bin=binary_open(view_new(copy,b->size));
+			if(bin==NULL) continue;
+			for(k=0; k<sizeof(keys)/sizeof(keys[0]); k++) binary_get(binary_root(bin),(string)keys[k],&value);
+		}
+}
+END_TEST
+
+START_TEST (test_binary_record)
+{
+	record r=record_new(), inner=record_new();
+	buffer b=buffer_new();
+	binary_value root, value;
+	int i;
+	for(i=0; i<10; i++) record_put(r,string_format("f%d",i),any_new_int(i));
+	record_put(inner,"ok",any_new_bool(true));
+	record_put(r,"inner",any_new_record(inner));
+	fail_unless (binary_write(b,any_new_record(r)), "binary_write of a record failed");
+	root=binary_root(binary_open(view_new(b->data,b->size)));
+	fail_unless (binary_type(root)==TYPE_MAP && binary_size(root)==11, "record not written as a map");
+	fail_unless (binary_get(root,"f7",&value) && binary_long(value)==7, "property of a record failed");
+	fail_unless (string_equal(json_tostring(binary_to_any(binary_map_value(root,10)),0),"{\"ok\":true}"), "nested record failed");
+	record_put(inner,"self",any_new_record(inner));
+	b=buffer_new();
+	fail_unless (!binary_write(b,any_new_record(r)) && b->size==0, "cycle through a record not detected");
+}
+END_TEST
+
+START_TEST (test_binary_cycle)
+{
+	manyany items=(manyany)object_new(sizeof(any));
+	any arr=any_new_array(items,1);
+	buffer b=buffer_new();
+	items[0]=arr;
+	fail_unless (!binary_write(b,arr) && b->size==0, "cycle not detected");
+}
+END_TEST
+
+TEST_HEADER
+	tcase_add_test (tc, test_binary_round_trip);
+	tcase_add_test (tc, test_binary_lazy);
+	tcase_add_test (tc, test_binary_file);
+	tcase_add_test (tc, test_binary_damaged_index);
+	tcase_add_test (tc, test_binary_record);
+	tcase_add_test (tc, test_binary_cycle);
+TEST_FOOTER("BINARY")
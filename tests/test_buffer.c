@@ -52,6 +52,71 @@ START_TEST (test_buffer_append)
 }
 END_TEST
 
+START_TEST (test_buffer_hash)
+{
+    buffer buf = buffer_new();
+    buffer_appendstring(buf, "Hello");
+    buffer_appendchar(buf, ' ');
+    buffer_appendstring(buf, "World");
+	fail_unless (buffer_hash(buf) == string_hash("Hello World"), "hashing buffer");
+}
+END_TEST
+
+START_TEST (test_buffer_append_number)
+{
+    buffer buf = buffer_new();
+    int i;
+    for (i=0; i<20; i++) {
+        buffer_append_long(buf, -1234567890123L);
+        buffer_appendchar(buf, ',');
+        buffer_append_double(buf, 0.3);
+        buffer_appendchar(buf, ';');
+    }
+    string bufstr = buffer_tostring(buf);
+	fail_unless (strncmp(bufstr, "-1234567890123,0.3;-1234567890123,0.3;", 38) == 0, "appending numbers");
+	fail_unless (strlen(bufstr) == 20*19, "appending numbers");
+}
+END_TEST
+
+START_TEST (test_buffer_binary)
+{
+    buffer buf = buffer_new_capacity(4);
+    buffer_append(buf, "a\0b", 3);
+    buffer_append_view(buf, view_new("xyz", 2));
+	fail_unless (buf->size == 5 && memcmp(buf->data, "a\0bxy", 5) == 0, "binary append");
+    string copy = buffer_tostring(buf);
+	fail_unless (memcmp(copy, "a\0bxy", 6) == 0, "binary tostring");
+}
+END_TEST
+
+START_TEST (test_buffer_reserve)
+{
+    buffer buf = buffer_new_capacity(1000);
+    memset(buf->data, 'x', 1000);
+	fail_unless (buf->capacity == 1000, "new capacity");
+    buffer_appendchar(buf, 'a');
+    buffer_reserve(buf, 100000);
+    size_t capacity = buf->capacity;
+	fail_unless (capacity >= 100001, "reserve");
+    int i;
+    for (i=0; i<100000; i++) buffer_appendchar(buf, 'b');
+	fail_unless (buf->capacity == capacity, "reserve grew the buffer once");
+}
+END_TEST
+
+START_TEST (test_buffer_steal)
+{
+    buffer buf = buffer_new();
+    buffer_appendstring(buf, "hello");
+    string data = buf->data;
+    string s = buffer_steal(buf);
+	fail_unless (s == data && string_equal(s, "hello"), "steal without copy");
+	fail_unless (buf->size == 0, "steal empties the buffer");
+    buffer_appendstring(buf, "world");
+	fail_unless (string_equal(s, "hello") && string_equal(buffer_tostring(buf), "world"), "append after steal");
+}
+END_TEST
+
 /*	----------------------
 	REGISTER TESTS AND RUN
 	---------------------- 
@@ -59,5 +124,10 @@ END_TEST
 
 TEST_HEADER
 	tcase_add_test (tc, test_buffer_append);
+	tcase_add_test (tc, test_buffer_hash);
+	tcase_add_test (tc, test_buffer_append_number);
+	tcase_add_test (tc, test_buffer_binary);
+	tcase_add_test (tc, test_buffer_reserve);
+	tcase_add_test (tc, test_buffer_steal);
 TEST_FOOTER("BUFFER")
 
@@ -0,0 +1,117 @@
+/**
+ *
+ * libscriptify
+ *
+ * @author  Erik Poupaert <erik@sankuru.biz>
+ *
+ * @section LICENSE
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU LGPL as
+ * published by the Free Software Foundation; either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * LGPL for more details at: http://www.gnu.org/licenses/lgpl.html
+ *
+ * @section DESCRIPTION
+ *
+ * Unit test for buffer chains.
+ *
+ */
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include "test.h"
+#include "buffer_chain.h"
+#include "string_utf8.h"
+
+START_TEST (test_buffer_chain_append)
+{
+	buffer_chain chain=buffer_chain_new();
+	string big=string_new(1000);
+	memset(big,'x',1000);
+	big[1000]=0;
+	buffer_chain_append_string(chain,"HTTP/1.1 200 OK\r\n");
+	buffer_chain_append(chain,"Length: ",8);
+	buffer_chain_append_long(chain,1000);
+	buffer_chain_append_string(chain,"\r\n\r\n");
+	buffer_chain_append_string(chain,big);
+	fail_unless (buffer_chain_size(chain)==17+8+4+4+1000, "buffer_chain_size failed");
+	fail_unless (chain->head==chain->tail->next || chain->head->next==chain->tail, "small fragments were not coalesced");
+	fail_unless (chain->tail->data==big, "large fragment was copied");
+	fail_unless (strncmp(buffer_chain_tostring(chain),"HTTP/1.1 200 OK\r\nLength: 1000\r\n\r\nxxx",36)==0, "buffer_chain_tostring failed");
+}
+END_TEST
+
+START_TEST (test_buffer_chain_writev)
+{
+	int fds[2];
+	char out[64];
+	buffer_chain chain=buffer_chain_new();
+	buffer b=buffer_new();
+	buffer_appendstring(b,"from a buffer;");
+	buffer_chain_append_buffer(chain,b);
+	buffer_chain_append_double(chain,0.5);
+	fail_unless (pipe(fds)==0, "pipe failed");
+	fail_unless (buffer_chain_writev(chain,fds[1])==17, "buffer_chain_writev failed");
+	fail_unless (buffer_chain_size(chain)==0, "buffer_chain_writev did not empty the chain");
+	fail_unless (read(fds[0],out,sizeof(out))==17 && memcmp(out,"from a buffer;0.5",17)==0, "buffer_chain_writev wrote wrong bytes");
+	close(fds[0]);
+	close(fds[1]);
+}
+END_TEST
+
+START_TEST (test_buffer_chain_partial)
+{
+	int fds[2];
+	size_t size=1<<20, got=0, i;
+	char *in=string_new(size);
+	char *out=string_new(size);
+	ssize_t n;
+	buffer_chain chain=buffer_chain_new();
+	for(i=0; i<size; i++) in[i]=(char)(i*7);
+	for(i=0; i<size; i+=4096) buffer_chain_append_ref(chain,in+i,4096);
+	fail_unless (pipe(fds)==0, "pipe failed");
+	fcntl(fds[1],F_SETFL,O_NONBLOCK);
+	fcntl(fds[0],F_SETFL,O_NONBLOCK);
+	while(buffer_chain_size(chain)>0)
+	{
+		n=buffer_chain_writev(chain,fds[1]);
+		fail_unless (n>0 || errno==EAGAIN, "buffer_chain_writev failed");
+		while((n=read(fds[0],out+got,size-got))>0) got+=n;
+	}
+	while((n=read(fds[0],out+got,size-got))>0) got+=n;
+	fail_unless (got==size && memcmp(in,out,size)==0, "partial writes lost or reordered bytes");
+	close(fds[0]);
+	close(fds[1]);
+}
+END_TEST
+
+START_TEST (test_buffer_chain_after_ref)
+{
+	buffer_chain chain=buffer_chain_new();
+	string big=string_new(299);
+	string out;
+	memset(big,'x',299);
+	big[299]=0;
+	buffer_chain_append_string(chain,big);
+	buffer_chain_append(chain,"tail",4);
+	fail_unless (chain->tail->data==chain->tail->inline_data && chain->head->data==big, "small fragment written into a reference");
+	buffer_chain_append_string(chain,big);
+	buffer_chain_append_long(chain,42);
+	out=buffer_chain_tostring(chain);
+	fail_unless (buffer_chain_size(chain)==2*299+6 && strlen(out)==2*299+6, "sizes after a reference failed");
+	fail_unless (memcmp(out+299,"tail",4)==0 && strcmp(out+2*299+4,"42")==0, "content after a reference failed");
+}
+END_TEST
+
+TEST_HEADER
+	tcase_add_test (tc, test_buffer_chain_append);
+	tcase_add_test (tc, test_buffer_chain_writev);
+	tcase_add_test (tc, test_buffer_chain_partial);
+	tcase_add_test (tc, test_buffer_chain_after_ref);
+TEST_FOOTER("BUFFER_CHAIN")
@@ -0,0 +1,150 @@
+/**
+ *
+ * libscriptify
+ *
+ * @author  Erik Poupaert <erik@sankuru.biz>
+ *
+ * @section LICENSE
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU LGPL as
+ * published by the Free Software Foundation; either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * LGPL for more details at: http://www.gnu.org/licenses/lgpl.html
+ *
+ * @section DESCRIPTION
+ *
+ * Unit test for the hex and base64 codecs.
+ *
+ */
+#include <stdlib.h>
+#include <string.h>
+#include "test.h"
+#include "object.h"
+#include "codec.h"
+
+static const CODEC codecs[]={CODEC_HEX, CODEC_BASE64, CODEC_BASE64_URL};
+
+static string encode(CODEC codec, const char *data)
+{
+	buffer b=buffer_new();
+	codec_encode_append(b,codec,view_from_string((string)data));
+	return buffer_tostring(b);
+}
+
+static string decode(CODEC codec, const char *text)
+{
+	buffer b=buffer_new();
+	if(!codec_decode_append(b,codec,view_from_string((string)text))) return NULL;
+	return buffer_tostring(b);
+}
+
+START_TEST (test_codec_vectors)
+{
+	const char *plain[]={"", "f", "fo", "foo", "foob", "fooba", "foobar"};
+	const char *base64[]={"", "Zg==", "Zm8=", "Zm9v", "Zm9vYg==", "Zm9vYmE=", "Zm9vYmFy"};
+	const char *url[]={"", "Zg", "Zm8", "Zm9v", "Zm9vYg", "Zm9vYmE", "Zm9vYmFy"};
+	size_t i;
+	for(i=0; i<7; i++)
+	{
+		fail_unless (strcmp(encode(CODEC_BASE64,plain[i]),base64[i])==0, "base64 encode failed");
+		fail_unless (strcmp(encode(CODEC_BASE64_URL,plain[i]),url[i])==0, "base64url encode failed");
+		fail_unless (strcmp(decode(CODEC_BASE64,base64[i]),plain[i])==0, "base64 decode failed");
+		fail_unless (strcmp(decode(CODEC_BASE64,url[i]),plain[i])==0, "unpadded base64 decode failed");
+		fail_unless (strcmp(decode(CODEC_BASE64_URL,base64[i]),plain[i])==0, "padded base64url decode failed");
+		fail_unless (codec_encoded_size(CODEC_BASE64,strlen(plain[i]))==strlen(base64[i]), "base64 size failed");
+		fail_unless (codec_encoded_size(CODEC_BASE64_URL,strlen(plain[i]))==strlen(url[i]), "base64url size failed");
+		fail_unless (codec_decoded_size(CODEC_BASE64,base64[i],strlen(base64[i]))==strlen(plain[i]), "decoded size failed");
+	}
+	fail_unless (strcmp(encode(CODEC_BASE64,"\xfb\xff"),"+/8=")==0 && strcmp(encode(CODEC_BASE64_URL,"\xfb\xff"),"-_8")==0, "alphabets failed");
+	fail_unless (strcmp(encode(CODEC_HEX,"\x01\xab\xff"),"01abff")==0, "hex encode failed");
+	fail_unless (strcmp(decode(CODEC_HEX,"01ABfF"),"\x01\xab\xff")==0, "hex decode failed");
+}
+END_TEST
+
+START_TEST (test_codec_invalid)
+{
+	const char *base64[]={"Z", "Zm9vY", "Zm9v=", "Zg=a", "Z===", "Zg==Zg==", "Zm 9v", "-_8=", "Zm9v\n"};
+	size_t i;
+	buffer b=buffer_new();
+	for(i=0; i<sizeof(base64)/sizeof(base64[0]); i++)
+		fail_unless (decode(CODEC_BASE64,base64[i])==NULL, "invalid base64 failed");
+	fail_unless (decode(CODEC_BASE64_URL,"+/8=")==NULL, "wrong alphabet failed");
+	fail_unless (decode(CODEC_HEX,"abc")==NULL && decode(CODEC_HEX,"0g")==NULL, "invalid hex failed");
+	buffer_appendstring(b,"kept");
+	fail_unless (!codec_decode_append(b,CODEC_HEX,view_from_string("zz")) && b->size==4, "failed decode changed the buffer");
+}
+END_TEST
+
+START_TEST (test_codec_round_trip)
+{
+	char data[1024];
+	size_t i, size, c, written;
+	for(i=0; i<sizeof(data); i++) data[i]=(char)(rand()&0xff);
+	for(c=0; c<3; c++)
+	{
+		for(size=0; size<=sizeof(data); size+=size<100?1:37)
+		{
+			size_t encoded_size=codec_encoded_size(codecs[c],size);
+			char *text=(char *)malloc(encoded_size+1);
+			char *back;
+			fail_unless (codec_encode(codecs[c],text,data,size)==encoded_size, "encoded size failed");
+			back=(char *)malloc(codec_decoded_size(codecs[c],text,encoded_size)+1);
+			fail_unless (codec_decoded_size(codecs[c],text,encoded_size)==size, "exact decoded size failed");
+			fail_unless (codec_decode(codecs[c],back,text,encoded_size,&written) && written==size, "decode failed");
+			fail_unless (memcmp(back,data,size)==0, "round trip failed");
+			//a bad character anywhere is found, also inside the blocks of the vector kernels
+			if(encoded_size>0)
+			{
+				text[encoded_size/2]='*';
+				fail_unless (!codec_decode(codecs[c],back,text,encoded_size,&written), "bad character failed");
+			}
+			free(text);
+			free(back);
+		}
+	}
+}
+END_TEST
+
+START_TEST (test_codec_stream)
+{
+	char data[2000];
+	size_t i, c, step;
+	for(i=0; i<sizeof(data); i++) data[i]=(char)(i*7+i/13);
+	for(c=0; c<3; c++)
+	{
+		for(step=1; step<=70; step+=step<8?1:31)
+		{
+			codec_stream s=codec_stream_new(codecs[c]);
+			buffer text=buffer_new(), back=buffer_new(), whole=buffer_new();
+			for(i=0; i<sizeof(data); i+=step)
+				codec_stream_encode(s,text,view_new(data+i,i+step<=sizeof(data)?step:sizeof(data)-i));
+			codec_stream_encode_end(s,text);
+			codec_encode_append(whole,codecs[c],view_new(data,sizeof(data)));
+			fail_unless (text->size==whole->size && memcmp(text->data,whole->data,whole->size)==0, "chunked encode failed");
+			s=codec_stream_new(codecs[c]);
+			for(i=0; i<text->size; i+=step)
+				fail_unless (codec_stream_decode(s,back,view_new(text->data+i,i+step<=text->size?step:text->size-i)), "chunked decode failed");
+			fail_unless (codec_stream_decode_end(s,back), "end of chunked decode failed");
+			fail_unless (back->size==sizeof(data) && memcmp(back->data,data,sizeof(data))==0, "chunked round trip failed");
+		}
+	}
+	codec_stream s=codec_stream_new(CODEC_BASE64);
+	buffer b=buffer_new();
+	fail_unless (codec_stream_decode(s,b,view_from_string("Zg")) && codec_stream_decode(s,b,view_from_string("==")), "padding across chunks failed");
+	fail_unless (!codec_stream_decode(s,b,view_from_string("Zg==")), "input after padding failed");
+	s=codec_stream_new(CODEC_BASE64);
+	fail_unless (codec_stream_decode(s,b,view_from_string("Zm9vY")) && !codec_stream_decode_end(s,b), "incomplete group failed");
+}
+END_TEST
+
+TEST_HEADER
+	tcase_add_test (tc, test_codec_vectors);
+	tcase_add_test (tc, test_codec_invalid);
+	tcase_add_test (tc, test_codec_round_trip);
+	tcase_add_test (tc, test_codec_stream);
+TEST_FOOTER("CODEC")
@@ -0,0 +1,197 @@
+/**
+ *
+ * libscriptify
+ *
+ * @author  Erik Poupaert <erik@sankuru.biz>
+ *
+ * @section LICENSE
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU LGPL as
+ * published by the Free Software Foundation; either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * LGPL for more details at: http://www.gnu.org/licenses/lgpl.html
+ *
+ * @section DESCRIPTION
+ *
+ * Unit test for the CSV reader.
+ *
+ */
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include "test.h"
+#include "object.h"
+#include "buffer.h"
+#include "map.h"
+#include "csv.h"
+
+/* collects all fields of all records, one per line, records separated by '|' */
+static string csv_dump(csv c)
+{
+	buffer b=buffer_new();
+	size_t i;
+	while(csv_next(c))
+	{
+		for(i=0; i<c->count; i++)
+		{
+			buffer_append_view(b,c->fields[i]);
+			buffer_appendchar(b,'\n');
+		}
+		buffer_appendchar(b,'|');
+	}
+	return buffer_tostring(b);
+}
+
+START_TEST (test_csv_fields)
+{
+	const char *text="a,b,c\r\n1,\"x,y\",\"he said \"\"hi\"\"\"\n\"multi\nline\",,last,\n\n\"q\"";
+	csv c=csv_new_view(view_new(text,strlen(text)),',');
+	fail_unless (csv_next(c) && c->count==3, "first record failed");
+	fail_unless (view_equal_string(c->fields[0],"a") && view_equal_string(c->fields[2],"c"), "CRLF record failed");
+	fail_unless (csv_next(c) && c->count==3, "quoted record failed");
+	fail_unless (view_equal_string(c->fields[1],"x,y"), "quoted delimiter failed");
+	fail_unless (c->fields[1].data==text+10, "quoted field is not a view into the input");
+	fail_unless (view_equal_string(c->fields[2],"he said \"hi\""), "doubled quotes failed");
+	fail_unless (csv_next(c) && c->count==4, "trailing delimiter failed");
+	fail_unless (view_equal_string(c->fields[0],"multi\nline"), "embedded newline failed");
+	fail_unless (c->fields[1].size==0 && c->fields[3].size==0, "empty fields failed");
+	fail_unless (csv_next(c) && c->count==1 && view_equal_string(c->fields[0],"q"), "empty line was not skipped");
+	fail_unless (!csv_next(c) && !c->malformed, "end of input failed");
+	fail_unless (c->records==4, "record count failed");
+
+	c=csv_new_view(view_from_string("\"open,ended\nrest"),',');
+	fail_unless (csv_next(c) && c->count==1 && view_equal_string(c->fields[0],"open,ended\nrest"), "unclosed quote failed");
+	fail_unless (c->malformed, "unclosed quote not flagged");
+	c=csv_new_view(view_from_string("\"a\"b,c\r"),',');
+	fail_unless (csv_next(c) && c->count==2 && view_equal_string(c->fields[0],"ab"), "bytes after quote failed");
+	fail_unless (c->malformed, "bytes after quote not flagged");
+
+	c=csv_new_view(view_from_string("a\t\"b\"\tc d\n"),'\t');
+	c->quote=0;
+	fail_unless (csv_next(c) && c->count==3 && view_equal_string(c->fields[1],"\"b\""), "TSV without quoting failed");
+}
+END_TEST
+
+START_TEST (test_csv_rows)
+{
+	csv_type types[]={CSV_STRING,CSV_DOUBLE};
+	csv c=csv_new_view(view_from_string("id,score,ok,name\n007,1,true,ann\n8,x,false,\n"),',');
+	any row;
+	fail_unless (csv_read_header(c) && c->names_count==4, "csv_read_header failed");
+	csv_set_types(c,types,2);
+	fail_unless (csv_next(c), "csv_next failed");
+	row=csv_row(c);
+	fail_unless (row->type==TYPE_ARRAY && row->arr->size==4, "csv_row failed");
+	fail_unless (row->arr->items[0]->type==TYPE_STRING && string_equal(row->arr->items[0]->str,"007"), "declared string failed");
+	fail_unless (row->arr->items[1]->type==TYPE_DOUBLE && row->arr->items[1]->dbl==1.0, "declared double failed");
+	fail_unless (row->arr->items[2]->type==TYPE_BOOL && row->arr->items[2]->bln, "inferred bool failed");
+	fail_unless (row->arr->items[3]->type==TYPE_STRING, "inferred string failed");
+	fail_unless (csv_next(c), "csv_next failed");
+	row=csv_row_map(c);
+	fail_unless (row->type==TYPE_MAP && map_size(row->map)==4, "csv_row_map failed");
+	fail_unless (map_get_string(row->map,"id")->type==TYPE_STRING, "declared string failed");
+	fail_unless (map_get_string(row->map,"score")->type==TYPE_NULL, "unparsable field failed");
+	fail_unless (map_get_string(row->map,"ok")->type==TYPE_BOOL && !map_get_string(row->map,"ok")->bln, "false failed");
+	fail_unless (map_get_string(row->map,"name")->type==TYPE_NULL, "empty field failed");
+
+	c=csv_new_view(view_from_string("12,-3.5,1e3,+,abc"),',');
+	fail_unless (csv_next(c), "csv_next failed");
+	row=csv_row(c);
+	fail_unless (row->arr->items[0]->type==TYPE_LONG && row->arr->items[0]->lng==12, "inferred long failed");
+	fail_unless (row->arr->items[1]->type==TYPE_DOUBLE && row->arr->items[1]->dbl==-3.5, "inferred double failed");
+	fail_unless (row->arr->items[2]->type==TYPE_DOUBLE && row->arr->items[2]->dbl==1000.0, "exponent failed");
+	fail_unless (row->arr->items[3]->type==TYPE_STRING && row->arr->items[4]->type==TYPE_STRING, "non-numbers failed");
+}
+END_TEST
+
+START_TEST (test_csv_columns)
+{
+	csv c=csv_new_view(view_from_string("a,b,c,d\n1,1,true,\n2,2.5,3,\n,3,x,y\n4\n"),',');
+	csv_table table;
+	fail_unless (csv_read_header(c), "csv_read_header failed");
+	table=csv_read_columns(c);
+	fail_unless (table->count==4 && table->rows==4, "table size failed");
+	fail_unless (string_equal(table->columns[1].name,"b"), "column name failed");
+	fail_unless (table->columns[0].type==CSV_LONG && table->columns[0].longs[3]==4, "long column failed");
+	fail_unless (!table->columns[0].present[2], "empty field failed");
+	fail_unless (table->columns[1].type==CSV_DOUBLE, "widening to double failed");
+	fail_unless (table->columns[1].doubles[0]==1.0 && table->columns[1].doubles[1]==2.5, "converted doubles failed");
+	fail_unless (!table->columns[1].present[3], "short row failed");
+	fail_unless (table->columns[2].type==CSV_STRING, "widening to string failed");
+	fail_unless (string_equal(table->columns[2].strings[0],"true") && string_equal(table->columns[2].strings[2],"x"), "converted strings failed");
+	fail_unless (table->columns[3].type==CSV_STRING && !table->columns[3].present[0] && table->columns[3].present[2], "late column failed");
+	fail_unless (table->columns[3].size==4, "padding failed");
+}
+END_TEST
+
+START_TEST (test_csv_stream)
+{
+	int fds[2];
+	size_t i, count=0;
+	FILE *f=tmpfile();
+	fprintf(f,"n,text\n");
+	for(i=0; i<20000; i++) fprintf(f,"%zu,\"line\n%zu, \"\"quoted\"\"\"\r\n",i,i);
+	rewind(f);
+	csv c=csv_new_file(f,',');
+	fail_unless (csv_read_header(c), "csv_read_header failed");
+	while(csv_next(c))
+	{
+		any row=csv_row(c);
+		fail_unless (row->arr->items[0]->lng==(long)count, "streamed number failed");
+		fail_unless (string_equal(row->arr->items[1]->str,string_format("line\n%zu, \"quoted\"",count)), "streamed field failed");
+		count++;
+	}
+	fail_unless (count==20000 && csv_error(c)==0, "streamed record count failed");
+	fclose(f);
+
+	fail_unless (pipe(fds)==0, "pipe failed");
+	fail_unless (write(fds[1],"x,\"y\"\r",6)==6, "write failed");
+	close(fds[1]);
+	c=csv_new_fd(fds[0],',');
+	fail_unless (csv_next(c) && c->count==2 && view_equal_string(c->fields[1],"y"), "CR at end of input failed");
+	fail_unless (!csv_next(c), "end of input failed");
+	close(fds[0]);
+}
+END_TEST
+
+START_TEST (test_csv_split)
+{
+	buffer b=buffer_new();
+	view chunks[16], input;
+	size_t i, n;
+	string serial;
+	buffer joined=buffer_new();
+	for(i=0; i<5000; i++)
+	{
+		if(i%7==0) buffer_appendstring(b,"\"quoted\nacross\nlines, \"\"with\"\" quotes\",");
+		buffer_append_long(b,(long)i);
+		buffer_appendstring(b,",plain\n");
+	}
+	input=view_new(b->data,b->size);
+	serial=csv_dump(csv_new_view(input,','));
+	n=csv_split(input,'"',16,chunks);
+	fail_unless (n>1 && n<=16, "csv_split failed");
+	for(i=0; i<n; i++)
+	{
+		fail_unless (i==0 || chunks[i].data==chunks[i-1].data+chunks[i-1].size, "chunks are not contiguous");
+		buffer_appendstring(joined,csv_dump(csv_new_view(chunks[i],',')));
+	}
+	fail_unless (chunks[n-1].data+chunks[n-1].size==input.data+input.size, "chunks do not cover the input");
+	fail_unless (string_equal(buffer_tostring(joined),serial), "parsing chunks differs from parsing the whole");
+	fail_unless (csv_split(view_from_string("a,b"),'"',8,chunks)==1, "small input failed");
+	fail_unless (csv_split(view_new("",0),'"',8,chunks)==0, "empty input failed");
+}
+END_TEST
+
+TEST_HEADER
+	tcase_add_test (tc, test_csv_fields);
+	tcase_add_test (tc, test_csv_rows);
+	tcase_add_test (tc, test_csv_columns);
+	tcase_add_test (tc, test_csv_stream);
+	tcase_add_test (tc, test_csv_split);
+TEST_FOOTER("CSV")
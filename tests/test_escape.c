@@ -0,0 +1,123 @@
+/**
+ *
+ * libscriptify
+ *
+ * @author  Erik Poupaert <erik@sankuru.biz>
+ *
+ * @section LICENSE
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU LGPL as
+ * published by the Free Software Foundation; either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * LGPL for more details at: http://www.gnu.org/licenses/lgpl.html
+ *
+ * @section DESCRIPTION
+ *
+ * Unit test for escaping and unescaping.
+ *
+ */
+#include <string.h>
+#include "test.h"
+#include "object.h"
+#include "escape.h"
+
+START_TEST (test_escape_clean)
+{
+	string clean="a clean string that is longer than sixteen bytes";
+	fail_unless (escape_string(ESCAPE_JSON,clean)==clean, "clean JSON was copied");
+	fail_unless (escape_string(ESCAPE_HTML,clean)==clean, "clean HTML was copied");
+	fail_unless (escape_string(ESCAPE_URL,"Az09-_.~")!=NULL && strcmp(escape_string(ESCAPE_URL,"Az09-_.~"),"Az09-_.~")==0, "unreserved failed");
+	fail_unless (escape_string(ESCAPE_SHELL,"/usr/bin/file-1.2_x@y%z+=:,")[0]=='/', "safe shell word failed");
+	fail_unless (unescape_string(ESCAPE_JSON,clean)==clean, "unescaped JSON was copied");
+	fail_unless (unescape_string(ESCAPE_SHELL,clean)==clean, "unquoted shell word was copied");
+}
+END_TEST
+
+START_TEST (test_escape_json)
+{
+	string text="0123456789abcdef \"quoted\" \\ tab\t nl\n bell\x07 \xc3\xa9";
+	string escaped=escape_string(ESCAPE_JSON,text);
+	fail_unless (strcmp(escaped,"0123456789abcdef \\\"quoted\\\" \\\\ tab\\t nl\\n bell\\u0007 \xc3\xa9")==0, "escape failed");
+	fail_unless (strcmp(unescape_string(ESCAPE_JSON,escaped),text)==0, "round trip failed");
+	fail_unless (strcmp(unescape_string(ESCAPE_JSON,"\\u00e9\\ud83d\\ude00\\/"),"\xc3\xa9\xf0\x9f\x98\x80/")==0, "\\u escapes failed");
+	fail_unless (unescape_string(ESCAPE_JSON,"bad \\x")==NULL, "invalid escape failed");
+	fail_unless (unescape_string(ESCAPE_JSON,"\\ud83d")==NULL, "lone surrogate failed");
+	fail_unless (unescape_string(ESCAPE_JSON,"\\u00")==NULL, "short escape failed");
+	fail_unless (unescape_string(ESCAPE_JSON,"end\\")==NULL, "trailing backslash failed");
+}
+END_TEST
+
+START_TEST (test_escape_html)
+{
+	string escaped=escape_string(ESCAPE_HTML,"<a href=\"x\">Tom & Jerry's</a>");
+	fail_unless (strcmp(escaped,"&lt;a href=&quot;x&quot;&gt;Tom &amp; Jerry&#39;s&lt;/a&gt;")==0, "escape failed");
+	fail_unless (strcmp(unescape_string(ESCAPE_HTML,escaped),"<a href=\"x\">Tom & Jerry's</a>")==0, "round trip failed");
+	fail_unless (strcmp(unescape_string(ESCAPE_HTML,"&#x41;&#66;&apos;&nbsp;"),"AB'\xc2\xa0")==0, "references failed");
+	fail_unless (strcmp(unescape_string(ESCAPE_HTML,"a & b &unknown; &#xZZ; &"),"a & b &unknown; &#xZZ; &")==0, "unknown references failed");
+	fail_unless (strcmp(unescape_string(ESCAPE_HTML,"&#0;"),"\xef\xbf\xbd")==0, "invalid code point failed");
+}
+END_TEST
+
+START_TEST (test_escape_url)
+{
+	buffer b=buffer_new();
+	string escaped=escape_string(ESCAPE_URL,"a b/c?d=e&f \xc3\xa9~");
+	fail_unless (strcmp(escaped,"a%20b%2Fc%3Fd%3De%26f%20%C3%A9~")==0, "escape failed");
+	fail_unless (strcmp(unescape_string(ESCAPE_URL,escaped),"a b/c?d=e&f \xc3\xa9~")==0, "round trip failed");
+	fail_unless (strcmp(unescape_string(ESCAPE_URL,"%2f+%2F"),"/+/")==0, "lowercase hex failed");
+	fail_unless (unescape_string(ESCAPE_URL,"100%")==NULL && unescape_string(ESCAPE_URL,"%zz")==NULL, "invalid escape failed");
+	buffer_appendstring(b,"kept");
+	fail_unless (!unescape_append(b,ESCAPE_URL,view_from_string("x%4")) && b->size==4, "failed unescape changed the buffer");
+	fail_unless (unescape_append(b,ESCAPE_URL,view_new("%00",3)) && b->size==5 && b->data[4]==0, "null byte failed");
+}
+END_TEST
+
+START_TEST (test_escape_shell)
+{
+	string words[]={"", "it's", "a b", "$HOME `x` \"q\" \\", "line\nbreak"};
+	size_t i;
+	fail_unless (strcmp(escape_string(ESCAPE_SHELL,""),"''")==0, "empty word failed");
+	fail_unless (strcmp(escape_string(ESCAPE_SHELL,"it's"),"'it'\\''s'")==0, "single quote failed");
+	for(i=0; i<sizeof(words)/sizeof(words[0]); i++)
+		fail_unless (strcmp(unescape_string(ESCAPE_SHELL,escape_string(ESCAPE_SHELL,words[i])),words[i])==0, "round trip failed");
+	fail_unless (strcmp(unescape_string(ESCAPE_SHELL,"a\\ b\"c\\$d\\e\"'f\\g'"),"a bc$d\\ef\\g")==0, "quoting failed");
+	fail_unless (unescape_string(ESCAPE_SHELL,"'open")==NULL && unescape_string(ESCAPE_SHELL,"\"open")==NULL, "unclosed quote failed");
+	fail_unless (unescape_string(ESCAPE_SHELL,"end\\")==NULL, "trailing backslash failed");
+}
+END_TEST
+
+START_TEST (test_escape_long)
+{
+	buffer text=buffer_new(), out=buffer_new();
+	size_t i;
+	string escaped;
+	for(i=0; i<4096; i++) buffer_appendchar(text,(char)(i%7==0?'<':'a'+i%26));
+	escaped=escape_string(ESCAPE_HTML,buffer_tostring(text));
+	fail_unless (strlen(escaped)==4096+3*((4096+6)/7), "long escape failed");
+	fail_unless (unescape_append(out,ESCAPE_HTML,view_from_string(escaped)), "long unescape failed");
+	fail_unless (out->size==text->size && memcmp(out->data,text->data,text->size)==0, "long round trip failed");
+	//every byte, escaped and unescaped, in every context
+	buffer_steal(text);
+	for(i=1; i<256; i++) buffer_appendchar(text,(char)i);
+	for(i=0; i<4; i++)
+	{
+		string all=buffer_tostring(text);
+		string back=unescape_string((ESCAPE_CONTEXT)i,escape_string((ESCAPE_CONTEXT)i,all));
+		fail_unless (back!=NULL && strcmp(back,all)==0, "round trip of all bytes failed");
+	}
+}
+END_TEST
+
+TEST_HEADER
+	tcase_add_test (tc, test_escape_clean);
+	tcase_add_test (tc, test_escape_json);
+	tcase_add_test (tc, test_escape_html);
+	tcase_add_test (tc, test_escape_url);
+	tcase_add_test (tc, test_escape_shell);
+	tcase_add_test (tc, test_escape_long);
+TEST_FOOTER("ESCAPE")
@@ -0,0 +1,211 @@
+/**
+ *
+ * libscriptify
+ *
+ * @author  Erik Poupaert <erik@sankuru.biz>
+ *
+ * @section LICENSE
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU LGPL as
+ * published by the Free Software Foundation; either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * LGPL for more details at: http://www.gnu.org/licenses/lgpl.html
+ *
+ * @section DESCRIPTION
+ *
+ * Unit test for expressions.
+ *
+ */
+#include <string.h>
+#include <limits.h>
+#include "test.h"
+#include "object.h"
+#include "map.h"
+#include "json.h"
+#include "shape.h"
+#include "expr.h"
+
+static any eval(const char *source, const char *record)
+{
+	expr e=expr_compile((string)source);
+	fail_unless (e!=NULL, "expr_compile failed");
+	return expr_eval(e,record!=NULL?json_parse((string)record):NULL);
+}
+
+static long eval_long(const char *source)
+{
+	any value=eval(source,NULL);
+	fail_unless (value->type==TYPE_LONG, "long expected");
+	return value->lng;
+}
+
+static bool eval_bool(const char *source, const char *record)
+{
+	any value=eval(source,record);
+	fail_unless (value->type==TYPE_BOOL, "bool expected");
+	return value->bln;
+}
+
+START_TEST (test_expr_arithmetic)
+{
+	any value;
+	fail_unless (eval_long("1 + 2 * 3")==7, "precedence failed");
+	fail_unless (eval_long("(1 + 2) * 3")==9, "parentheses failed");
+	fail_unless (eval_long("7 / 2")==3 && eval_long("-7 % 3")==-1 && eval_long("- -4")==4, "integer division failed");
+	fail_unless (eval_long("10 - 2 - 3")==5, "left associativity failed");
+	value=eval("7 / 2.0",NULL);
+	fail_unless (value->type==TYPE_DOUBLE && value->dbl==3.5, "double division failed");
+	value=eval("9223372036854775807 + 1",NULL);
+	fail_unless (value->type==TYPE_DOUBLE && value->dbl==9223372036854775808.0, "overflow failed");
+	fail_unless (eval("1 / 0",NULL)->type==TYPE_NULL && eval("1 + 'a' * 2",NULL)->type==TYPE_NULL, "null failed");
+	value=eval("'n=' + 3 + \"\\t\" + true",NULL);
+	fail_unless (value->type==TYPE_STRING && strcmp(value->str,"n=3\ttrue")==0, "concatenation failed");
+	value=eval("price * qty - 1","{\"price\":2.5,\"qty\":4}");
+	fail_unless (value->type==TYPE_DOUBLE && value->dbl==9.0, "fields failed");
+}
+END_TEST
+
+START_TEST (test_expr_logic)
+{
+	any value;
+	fail_unless (eval_bool("1 < 2 && 2 <= 2 and 3 > 2 && 3 >= 4 == false",NULL), "comparisons failed");
+	fail_unless (eval_bool("'abc' < 'abd' && 1 == 1.0 && 'a' != 1 && !(null < 1)",NULL), "mixed comparisons failed");
+	fail_unless (!eval_bool("9007199254740993 == 9007199254740992.0",NULL) && eval_bool("9007199254740993 > 9007199254740992.0",NULL), "exact mixed comparisons failed");
+	fail_unless (eval_bool("9223372036854775807 < 9223372036854775808.0 && -9223372036854775807 > -9223372036854775808.0 && 2 > 1.5 && -2 < -1.5",NULL), "exact mixed comparisons failed");
+	fail_unless (eval_bool("min(9007199254740993, 9007199254740992.0) == 9007199254740992.0 && 3.0 == 3",NULL), "exact mixed comparisons failed");
+	value=eval("-9223372036854775808",NULL);
+	fail_unless (value->type==TYPE_LONG && value->lng==LONG_MIN, "negated literal failed");
+	value=eval("-9223372036854775809",NULL);
+	fail_unless (value->type==TYPE_DOUBLE && eval("- 9223372036854775808.0",NULL)->type==TYPE_DOUBLE, "negated literal failed");
+	fail_unless (eval_bool("a || b","{\"a\":0,\"b\":\"x\"}") && !eval_bool("a && b","{\"a\":0,\"b\":1}"), "and or failed");
+	fail_unless (eval_bool("missing.field == null || 1 / 0","{}"), "short-circuit failed");
+	fail_unless (eval_bool("not '' && !0 && !0.0 && !null && !a","{\"a\":[]}") && !eval_bool("!'x' || !b","{\"b\":[0]}"), "truthiness failed");
+	value=eval("n > 10 ? 'big' : n > 5 ? 'medium' : 'small'","{\"n\":7}");
+	fail_unless (value->type==TYPE_STRING && strcmp(value->str,"medium")==0, "conditional failed");
+	value=eval("true ? n : 0","{\"n\":7}");
+	fail_unless (value->type==TYPE_LONG && value->lng==7, "constant conditional failed");
+}
+END_TEST
+
+START_TEST (test_expr_access)
+{
+	const char *record="{\"user\":{\"name\":\"Ann\",\"tags\":[\"a\",\"b\",\"c\"]},\"key\":\"name\"}";
+	any value=eval("user.name + '/' + user.tags[1] + user.tags[-1] + user[key]",record);
+	fail_unless (value->type==TYPE_STRING && strcmp(value->str,"Ann/bcAnn")==0, "access failed");
+	fail_unless (eval("user.tags[3]",record)->type==TYPE_NULL && eval("key.x",record)->type==TYPE_NULL, "missing failed");
+	fail_unless (eval("nothing",record)->type==TYPE_NULL && eval("x",NULL)->type==TYPE_NULL, "missing field failed");
+}
+END_TEST
+
+START_TEST (test_expr_functions)
+{
+	const char *record="{\"s\":\"Héllo\",\"a\":[1,2,3],\"m\":{\"k\":1}}";
+	any value;
+	fail_unless (eval_bool("len(s) == 5 && len(a) == 3 && len(m) == 1",record), "len failed");
+	fail_unless (eval_bool("upper('Hello') == 'HELLO' && lower('HeLLo') == 'hello'",record), "case failed");
+	fail_unless (eval_bool("contains(s, 'll') && contains(a, 2) && contains(m, 'k') && !contains(a, 4)",record), "contains failed");
+	fail_unless (eval_bool("starts_with(s, 'Hé') && ends_with(s, 'lo') && !ends_with('o', 'lo')",record), "affixes failed");
+	fail_unless (eval_bool("abs(-3) == 3 && min(4, a[0], 2) == 1 && max(1, 2.5) == 2.5",record), "numbers failed");
+	fail_unless (eval_bool("int('42') == 42 && int(-2.7) == -2 && float('1.5') == 1.5 && str(12) == '12'",record), "conversions failed");
+	fail_unless (eval("int(9.25e18)",record)->type==TYPE_NULL && eval("int(-9.25e18)",record)->type==TYPE_NULL, "int out of range failed");
+	fail_unless (eval("int('9250000000000000000')",record)->type==TYPE_NULL && eval("int(9223372036854775808.0)",record)->type==TYPE_NULL, "int out of range failed");
+	fail_unless (eval_bool("int(-9223372036854775808.0) == -9223372036854775807 - 1 && int(9223372036854774784.0) == 9223372036854774784",record), "int at the edges failed");
+	value=eval("str(a)",record);
+	fail_unless (value->type==TYPE_STRING, "str failed");
+}
+END_TEST
+
+START_TEST (test_expr_folding)
+{
+	expr e=expr_compile("(1 + 2) * 3 > 8 && len(upper('ab')) == 2 ? 'yes' + '!' : x");
+	any value;
+	fail_unless (e!=NULL && e->count==2, "folding failed");
+	value=expr_eval(e,NULL);
+	fail_unless (value->type==TYPE_STRING && strcmp(value->str,"yes!")==0, "folded value failed");
+	e=expr_compile("false && x || 2 * 2 == 4");
+	fail_unless (e!=NULL && e->count==2 && expr_test(e,NULL), "folding logic failed");
+	e=expr_compile("x + 2 * 3");
+	fail_unless (e!=NULL && e->count==4, "partial folding failed");
+	fail_unless (!eval_bool("true && x","{\"x\":0}") && eval_bool("false || x","{\"x\":1}"), "constant left side failed");
+	fail_unless (!eval_bool("1 && x == 1","{\"x\":0}") && eval_bool("1 && x","{\"x\":[1]}"), "constant left side failed");
+	value=eval("(true && x) + 1","{\"x\":0}");
+	fail_unless (value->type==TYPE_NULL, "constant left side failed");
+}
+END_TEST
+
+START_TEST (test_expr_records)
+{
+	expr e=expr_compile("price * qty + inner.bonus + inner['bonus'] + len(name)");
+	record rows[3], inner=record_new();
+	any value;
+	int i;
+	fail_unless (e!=NULL, "expr_compile failed");
+	record_put(inner,"bonus",any_new_long(1));
+	for(i=0; i<3; i++)
+	{
+		rows[i]=record_new();
+		record_put(rows[i],"name",any_new_string("ab"));
+		//the last row has another shape, which the caches must notice
+		if(i==2) record_put(rows[i],"extra",any_new_null());
+		record_put(rows[i],"qty",any_new_long(i+1));
+		record_put(rows[i],"price",any_new_long(10));
+		record_put(rows[i],"inner",any_new_record(inner));
+	}
+	for(i=0; i<3; i++)
+	{
+		value=expr_eval(e,any_new_record(rows[i]));
+		fail_unless (value->type==TYPE_LONG && value->lng==10*(i+1)+4, "record fields failed");
+	}
+	fail_unless (rows[0]->shape==rows[1]->shape && e->caches[0].shape!=NULL, "record fields were not cached");
+	fail_unless (expr_eval(expr_compile("x.y"),any_new_record(rows[0]))->type==TYPE_NULL && expr_eval(expr_compile("name.x"),any_new_record(rows[0]))->type==TYPE_NULL, "missing record field failed");
+}
+END_TEST
+
+START_TEST (test_expr_invalid)
+{
+	const char *invalid[]={"", "1 +", "(1", "1)", "a.", "a[1", "f(1)", "len()", "len(1, 2)", "'abc", "1 ? 2", "a b", "1 | 2", "2x"};
+	size_t i;
+	buffer deep=buffer_new();
+	for(i=0; i<sizeof(invalid)/sizeof(invalid[0]); i++)
+		fail_unless (expr_compile((string)invalid[i])==NULL, "invalid expression failed");
+	for(i=0; i<=EXPR_MAX_DEPTH; i++) buffer_appendstring(deep,"(");
+	buffer_appendstring(deep,"1");
+	for(i=0; i<=EXPR_MAX_DEPTH; i++) buffer_appendstring(deep,")");
+	fail_unless (expr_compile(buffer_tostring(deep))==NULL, "nesting too deep failed");
+}
+END_TEST
+
+START_TEST (test_expr_filter)
+{
+	expr e=expr_compile("status == 'active' && (age >= 18 || guardian) && score * 1.5 > 50");
+	size_t i, passed=0;
+	fail_unless (e!=NULL, "expr_compile failed");
+	for(i=0; i<1000; i++)
+	{
+		map record=map_new();
+		map_put_string(record,"status",any_new_string(i%2==0?"active":"inactive"));
+		map_put_string(record,"age",any_new_long((long)(i%30)));
+		map_put_string(record,"guardian",any_new_bool(i%3==0));
+		map_put_string(record,"score",any_new_long((long)(i%100)));
+		if(expr_test(e,any_new_map(record))) passed++;
+		if(i%2==0 && (i%30>=18 || i%3==0) && (i%100)*1.5>50) passed--;
+	}
+	fail_unless (passed==0, "filter failed");
+}
+END_TEST
+
+TEST_HEADER
+	tcase_add_test (tc, test_expr_arithmetic);
+	tcase_add_test (tc, test_expr_logic);
+	tcase_add_test (tc, test_expr_access);
+	tcase_add_test (tc, test_expr_functions);
+	tcase_add_test (tc, test_expr_folding);
+	tcase_add_test (tc, test_expr_records);
+	tcase_add_test (tc, test_expr_invalid);
+	tcase_add_test (tc, test_expr_filter);
+TEST_FOOTER("EXPR")
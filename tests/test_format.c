@@ -0,0 +1,107 @@
+/**
+ *
+ * libscriptify
+ *
+ * @author  Erik Poupaert <erik@sankuru.biz>
+ *
+ * @section LICENSE
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU LGPL as
+ * published by the Free Software Foundation; either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * LGPL for more details at: http://www.gnu.org/licenses/lgpl.html
+ *
+ * @section DESCRIPTION
+ *
+ * Unit test for compiled format strings.
+ *
+ */
+#include <stdio.h>
+#include <stdint.h>
+#include "test.h"
+#include "format.h"
+#include "buffer.h"
+#include "string_utf8.h"
+
+START_TEST (test_format_compile)
+{
+	format f=format_compile("id=%d name=%s %%done");
+	fail_unless (f!=NULL, "format_compile failed");
+	fail_unless (f->count==5, "format_compile op count failed");
+	fail_unless (f->ops[0].type==FORMAT_LITERAL && f->ops[1].type==FORMAT_INT && f->ops[3].type==FORMAT_STRING, "format_compile op types failed");
+	fail_unless (format_compile("%-5d")->ops[0].type==FORMAT_GENERIC, "format_compile flags failed");
+	fail_unless (format_compile("%n")==NULL, "format_compile unsupported conversion failed");
+	fail_unless (format_compile("trailing %")==NULL, "format_compile incomplete conversion failed");
+}
+END_TEST
+
+START_TEST (test_format_cached)
+{
+	const char *fmt="%s=%d";
+	char copy[16];
+	fail_unless (format_cached(fmt)==format_cached(fmt), "format_cached did not cache");
+	fail_unless (string_equal(format_tostring(format_cached(fmt),"x",1),"x=1"), "format_tostring failed");
+	//same address, different content
+	strcpy(copy,"%d");
+	format first=format_cached(copy);
+	strcpy(copy,"<%s>");
+	fail_unless (format_cached(copy)!=first, "format_cached returned a stale format");
+	fail_unless (string_equal(format_tostring(format_cached(copy),"x"),"<x>"), "format_cached returned a stale format");
+	//unsupported, and cached as such, until the content at the address changes
+	strcpy(copy,"%n");
+	fail_unless (format_cached(copy)==NULL && format_cached(copy)==NULL, "format_cached accepted an unsupported format");
+	strcpy(copy,"[%s]");
+	fail_unless (string_equal(format_tostring(format_cached(copy),"x"),"[x]"), "format_cached kept an unsupported format");
+}
+END_TEST
+
+START_TEST (test_format_render)
+{
+	char expected[256];
+	buffer buf=buffer_new();
+	format_render(format_cached("%d|%ld|%u|%lu|%s|%c|%f|%.2f|%.0f|%%"), buf,
+		-42, -1234567890123L, 4000000000u, 18446744073709551615ul, "str", 'c', 3.14159, -0.005, 2.5);
+	snprintf(expected, sizeof(expected), "%d|%ld|%u|%lu|%s|%c|%f|%.2f|%.0f|%%",
+		-42, -1234567890123L, 4000000000u, 18446744073709551615ul, "str", 'c', 3.14159, -0.005, 2.5);
+	fail_unless (string_equal(buffer_tostring(buf),expected), "format_render fast paths failed");
+}
+END_TEST
+
+START_TEST (test_format_generic)
+{
+	char expected[256];
+	buffer buf=buffer_new();
+	format_render(format_cached("[%-6d][%+5.3d][%08.3f][%*s][%.*s][%x][%#o][%hhd][%lld][%zu][%e][%g][%p][%lf][%20.15f][%.12f]"), buf,
+		42, 7, -3.14159, 6, "ab", 2, "abcdef", 255u, 8u, 300, -5LL, (size_t)17, 12345.678, 0.0001, (void *)buf, 1.5, 1e20, 1e15);
+	snprintf(expected, sizeof(expected), "[%-6d][%+5.3d][%08.3f][%*s][%.*s][%x][%#o][%hhd][%lld][%zu][%e][%g][%p][%lf][%20.15f][%.12f]",
+		42, 7, -3.14159, 6, "ab", 2, "abcdef", 255u, 8u, 300, -5LL, (size_t)17, 12345.678, 0.0001, (void *)buf, 1.5, 1e20, 1e15);
+	fail_unless (string_equal(buffer_tostring(buf),expected), "format_render generic conversions failed");
+}
+END_TEST
+
+START_TEST (test_buffer_appendf)
+{
+	int i;
+	buffer buf=buffer_new();
+	for(i=0; i<100; i++) buffer_appendf(buf, "%d,", i);
+	buffer_appendf(buf, "%s", "end");
+	string s=buffer_tostring(buf);
+	fail_unless (strncmp(s,"0,1,2,",6)==0, "buffer_appendf failed");
+	fail_unless (strlen(s)==10*2+90*3+3, "buffer_appendf failed");
+	fail_unless (string_equal(string_format("%d-%s", 5, "x"),"5-x"), "string_format failed");
+	fail_unless (string_equal(string_format("%m%d", 5),string_format("%m5")), "string_format fallback failed");
+}
+END_TEST
+
+TEST_HEADER
+	tcase_add_test (tc, test_format_compile);
+	tcase_add_test (tc, test_format_cached);
+	tcase_add_test (tc, test_format_render);
+	tcase_add_test (tc, test_format_generic);
+	tcase_add_test (tc, test_buffer_appendf);
+TEST_FOOTER("FORMAT")
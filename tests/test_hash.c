@@ -0,0 +1,93 @@
+/**
+ *
+ * libscriptify
+ *
+ * @author  Erik Poupaert <erik@sankuru.biz>
+ *
+ * @section LICENSE
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU LGPL as
+ * published by the Free Software Foundation; either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * LGPL for more details at: http://www.gnu.org/licenses/lgpl.html
+ *
+ * @section DESCRIPTION
+ *
+ * Unit test for hashing.
+ *
+ */
+#include "test.h"
+#include "hash.h"
+#include "string_utf8.h"
+
+START_TEST (test_hash_seeded)
+{
+	string s="The quick brown fox jumps over the lazy dog";
+	fail_unless (hash_bytes_seeded(s,strlen(s),1)==hash_bytes_seeded(s,strlen(s),1), "hash is deterministic");
+	fail_unless (hash_bytes_seeded(s,strlen(s),1)!=hash_bytes_seeded(s,strlen(s),2), "seed changes hash");
+	fail_unless (hash_bytes(s,strlen(s))==hash_bytes_seeded(s,strlen(s),hash_seed()), "process seed");
+}
+END_TEST
+
+START_TEST (test_hash_lengths)
+{
+	char data[300];
+	size_t i, j;
+	for(i=0; i<sizeof(data); i++) data[i]=(char)(i*7+3);
+	//every prefix length hashes differently from its neighbours
+	for(i=1; i<sizeof(data); i++)
+		fail_unless (hash_bytes(data,i)!=hash_bytes(data,i-1), "prefix lengths");
+	//flipping any single byte changes the hash
+	for(j=0; j<100; j++)
+	{
+		uint64_t h=hash_bytes(data,100);
+		data[j]^=1;
+		fail_unless (hash_bytes(data,100)!=h, "single byte flip");
+		data[j]^=1;
+	}
+}
+END_TEST
+
+START_TEST (test_hash_streaming)
+{
+	char data[300];
+	size_t len, split;
+	for(len=0; len<sizeof(data); len++) data[len]=(char)(len*13+1);
+	for(len=0; len<=sizeof(data); len+=7)
+	{
+		for(split=0; split<=len; split+=5)
+		{
+			hash_state st=hash_state_new();
+			hash_update(st,data,split);
+			hash_update(st,data+split,len-split);
+			fail_unless (hash_final(st)==hash_bytes(data,len), "streaming matches one-shot");
+		}
+	}
+}
+END_TEST
+
+START_TEST (test_hash_streaming_bytewise)
+{
+	char data[200];
+	size_t len, i;
+	for(i=0; i<sizeof(data); i++) data[i]=(char)(i*31+5);
+	for(len=0; len<=sizeof(data); len++)
+	{
+		hash_state st=hash_state_new_seeded(42);
+		for(i=0; i<len; i++) hash_update(st,data+i,1);
+		fail_unless (hash_final(st)==hash_bytes_seeded(data,len,42), "bytewise streaming matches one-shot");
+	}
+}
+END_TEST
+
+TEST_HEADER
+	tcase_add_test (tc, test_hash_seeded);
+	tcase_add_test (tc, test_hash_lengths);
+	tcase_add_test (tc, test_hash_streaming);
+	tcase_add_test (tc, test_hash_streaming_bytewise);
+TEST_FOOTER("HASH")
@@ -0,0 +1,194 @@
+/**
+ *
+ * libscriptify
+ *
+ * @author  Erik Poupaert <erik@sankuru.biz>
+ *
+ * @section LICENSE
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU LGPL as
+ * published by the Free Software Foundation; either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * LGPL for more details at: http://www.gnu.org/licenses/lgpl.html
+ *
+ * @section DESCRIPTION
+ *
+ * Unit test for the JSON parser.
+ *
+ */
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include "test.h"
+#include "object.h"
+#include "buffer.h"
+#include "json.h"
+
+static bool count_line(any value, size_t line, void *data)
+{
+	long *counts=(long *)data;
+	if(value==NULL) counts[1]=(long)line;
+	else counts[0]+=value->map!=NULL?map_get_string(value->map,"n")->i:0;
+	return true;
+}
+
+START_TEST (test_json_parse)
+{
+	any doc=json_parse("{\"name\": \"libscriptify\", \"version\": 2, \"ratio\": -1.5e2,"
+		" \"big\": 12345678901, \"tags\": [\"a\", \"b\", []], \"ok\": true, \"no\": false, \"none\": null, \"empty\": {}}");
+	any tags;
+	fail_unless (doc!=NULL && doc->type==TYPE_MAP, "json_parse failed");
+	fail_unless (map_size(doc->map)==9, "wrong number of keys");
+	fail_unless (string_equal(map_get_string(doc->map,"name")->str,"libscriptify"), "wrong string");
+	fail_unless (map_get_string(doc->map,"version")->type==TYPE_INT, "wrong int");
+	fail_unless (map_get_string(doc->map,"ratio")->dbl==-150.0, "wrong double");
+	fail_unless (map_get_string(doc->map,"big")->type==TYPE_LONG, "wrong long");
+	tags=map_get_string(doc->map,"tags");
+	fail_unless (tags->type==TYPE_ARRAY && tags->arr->size==3, "wrong array");
+	fail_unless (string_equal(tags->arr->items[1]->str,"b"), "wrong array item");
+	fail_unless (tags->arr->items[2]->arr->size==0, "wrong empty array");
+	fail_unless (map_get_string(doc->map,"ok")->bln && !map_get_string(doc->map,"no")->bln, "wrong booleans");
+	fail_unless (map_get_string(doc->map,"none")->type==TYPE_NULL, "wrong null");
+	fail_unless (map_size(map_get_string(doc->map,"empty")->map)==0, "wrong empty object");
+	fail_unless (json_parse(" 42 ")->i==42, "scalar document failed");
+}
+END_TEST
+
+START_TEST (test_json_strings)
+{
+	any s=json_parse("\"tab\\there \\\"quoted\\\" \\\\ \\/ \\u00e9\\u20ac\\ud83d\\ude00\"");
+	fail_unless (s!=NULL && string_equal(s->str,"tab\there \"quoted\" \\ / \xc3\xa9\xe2\x82\xac\xf0\x9f\x98\x80"), "escapes not decoded");
+	fail_unless (json_parse("\"\\ud83d\"")==NULL, "lone surrogate accepted");
+	fail_unless (json_parse("\"\\x\"")==NULL, "invalid escape accepted");
+}
+END_TEST
+
+START_TEST (test_json_blocks)
+{
+	//escapes and strings across the boundaries of the 64-byte blocks of the index
+	int offset;
+	for(offset=0; offset<140; offset++)
+	{
+		buffer b=buffer_new();
+		any doc;
+		int i;
+		buffer_appendstring(b,"[");
+		for(i=0; i<offset; i++) buffer_appendstring(b," ");
+		buffer_appendstring(b,"\"a\\\\\\\"b\\\\\", 7, \"x\\\"\", true]");
+		doc=json_parse(buffer_tostring(b));
+		fail_unless (doc!=NULL && doc->arr->size==4, "index failed at a block boundary");
+		fail_unless (string_equal(doc->arr->items[0]->str,"a\\\"b\\"), "escapes failed at a block boundary");
+		fail_unless (string_equal(doc->arr->items[2]->str,"x\""), "escapes failed at a block boundary");
+		fail_unless (doc->arr->items[3]->bln, "literal failed at a block boundary");
+	}
+}
+END_TEST
+
+START_TEST (test_json_invalid)
+{
+	const char *invalid[]={"", "  ", "[1,]", "{\"a\" 1}", "{\"a\":1,}", "[1 2]", "\"open", "[\"a\nb\"]",
+		"tru", "truex", "nul", "01", "1.", "-", "1e", "[1]]", "{1:2}", "[1}", "{\"a\":}", "+1"};
+	size_t i;
+	char deep[2*JSON_MAX_DEPTH+10];
+	for(i=0; i<sizeof(invalid)/sizeof(invalid[0]); i++)
+		fail_unless (json_parse((string)invalid[i])==NULL, "invalid JSON accepted");
+	memset(deep,'[',JSON_MAX_DEPTH+1);
+	memset(deep+JSON_MAX_DEPTH+1,']',JSON_MAX_DEPTH+1);
+	deep[2*JSON_MAX_DEPTH+2]=0;
+	fail_unless (json_parse(deep)==NULL, "nesting deeper than JSON_MAX_DEPTH accepted");
+	deep[2*JSON_MAX_DEPTH+1]=0;
+	fail_unless (json_parse(deep+1)!=NULL, "nesting of JSON_MAX_DEPTH rejected");
+}
+END_TEST
+
+START_TEST (test_json_lines)
+{
+	int fds[2];
+	long counts[2]={0, 0};
+	const char *text="{\"n\": 1}\n\n{\"n\": 2}\r\n{\"n\": \n{\"n\": 3}";
+	fail_unless (pipe(fds)==0, "pipe failed");
+	fail_unless (write(fds[1],text,strlen(text))==(ssize_t)strlen(text), "write failed");
+	close(fds[1]);
+	fail_unless (json_parse_lines(reader_new_fd(fds[0]),count_line,counts), "json_parse_lines failed");
+	close(fds[0]);
+	fail_unless (counts[0]==6, "values of lines lost");
+	fail_unless (counts[1]==4, "invalid line not reported");
+}
+END_TEST
+
+START_TEST (test_json_write)
+{
+	const char *text="{\"name\":\"a\\\"b\\\\c\\n\\u0001\u00e9\",\"n\":[1,-2.5,1.0,1e+21,true,false,null,[],{}],\"x\":{\"y\":12345678901}}";
+	any doc=json_parse((string)text);
+	string pretty;
+	fail_unless (doc!=NULL, "json_parse failed");
+	fail_unless (string_equal(json_tostring(doc,0),(string)text), "compact output differs from the input");
+	pretty=json_tostring(doc,2);
+	fail_unless (strstr(pretty,"{\n  \"name\": ")==pretty, "pretty output not indented");
+	fail_unless (strstr(pretty,"\n    [],\n    {}\n  ],\n")!=NULL, "empty containers not compact");
+	fail_unless (string_equal(json_tostring(json_parse(pretty),0),(string)text), "pretty output does not parse back");
+	fail_unless (string_equal(json_tostring(any_new_double(0.0/0.0),0),"null"), "NaN not written as null");
+}
+END_TEST
+
+START_TEST (test_json_write_cycle)
+{
+	manyany items=(manyany)object_new(2*sizeof(any));
+	any arr=any_new_array(items,2);
+	map m=map_new();
+	items[0]=any_new_int(1);
+	items[1]=arr;
+	fail_unless (json_tostring(arr,0)==NULL, "cycle through an array not detected");
+	items[1]=any_new_map(m);
+	map_put_string(m,"self",items[1]);
+	fail_unless (json_tostring(arr,0)==NULL, "cycle through a map not detected");
+	map_put_string(m,"self",any_new_null());
+	map_put_string(m,"a",any_new_string("x"));
+	map_put_string(m,"b",any_new_string("x"));
+	fail_unless (string_equal(json_tostring(arr,0),"[1,{\"self\":null,\"a\":\"x\",\"b\":\"x\"}]"), "shared values taken for a cycle");
+}
+END_TEST
+
+START_TEST (test_json_write_chain)
+{
+	size_t i, n=50000;
+	manyany items=(manyany)object_new(n*sizeof(any));
+	any arr=any_new_array(items,n);
+	buffer_chain chain=buffer_chain_new();
+	for(i=0; i<n; i++) items[i]=any_new_string("line\twith \"escapes\"");
+	fail_unless (json_write_chain(chain,arr,1), "json_write_chain failed");
+	fail_unless (string_equal(buffer_chain_tostring(chain),json_tostring(arr,1)), "chain output differs");
+}
+END_TEST
+
+START_TEST (test_json_write_chain_small_tail)
+{
+	size_t i, n=12776; //the output is flushed once, before the last item
+	manyany items=(manyany)object_new(n*sizeof(any));
+	any arr=any_new_array(items,n);
+	buffer_chain chain=buffer_chain_new();
+	string expected;
+	for(i=0; i<n; i++) items[i]=any_new_int((int)i);
+	expected=json_tostring(arr,0);
+	fail_unless (json_write_chain(chain,arr,0), "json_write_chain failed");
+	fail_unless (chain->head!=chain->tail && chain->tail->data==chain->tail->inline_data, "the output does not end in a small tail");
+	fail_unless (string_equal(buffer_chain_tostring(chain),expected), "chain output with a small tail differs");
+}
+END_TEST
+
+TEST_HEADER
+	tcase_add_test (tc, test_json_parse);
+	tcase_add_test (tc, test_json_strings);
+	tcase_add_test (tc, test_json_blocks);
+	tcase_add_test (tc, test_json_invalid);
+	tcase_add_test (tc, test_json_lines);
+	tcase_add_test (tc, test_json_write);
+	tcase_add_test (tc, test_json_write_cycle);
+	tcase_add_test (tc, test_json_write_chain);
+	tcase_add_test (tc, test_json_write_chain_small_tail);
+TEST_FOOTER("JSON")
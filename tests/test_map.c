@@ -0,0 +1,126 @@
+/**
+ *
+ * libscriptify
+ *
+ * @author  Erik Poupaert <erik@sankuru.biz>
+ *
+ * @section LICENSE
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU LGPL as
+ * published by the Free Software Foundation; either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * LGPL for more details at: http://www.gnu.org/licenses/lgpl.html
+ *
+ * @section DESCRIPTION
+ *
+ * Unit test for the concurrent map.
+ *
+ */
+#include <string.h>
+#include <math.h>
+#include "test.h"
+#include "object.h"
+#include "map.h"
+
+#define READERS 4
+#define KEYS 2000
+
+static map shared;
+
+static void collect_keys(any key, any value, void *data)
+{
+	long *order=(long *)data;
+	order[order[0]+1]=key->lng;
+	order[0]++;
+}
+
+static void *read_keys(void *arg)
+{
+	long *misses=(long *)arg;
+	int round, i;
+	for(round=0; round<20; round++)
+		for(i=0; i<KEYS; i++)
+		{
+			any value=map_get(shared,any_new_int(i));
+			if(value==NULL || value->i!=i*2) (*misses)++;
+		}
+	return NULL;
+}
+
+static void *write_keys(void *arg)
+{
+	int i;
+	for(i=KEYS; i<4*KEYS; i++) map_put(shared,any_new_int(i),any_new_int(i*2));
+	for(i=KEYS; i<4*KEYS; i+=2) map_remove(shared,any_new_int(i));
+	return NULL;
+}
+
+START_TEST (test_map_put_get)
+{
+	map m=map_new();
+	fail_unless (map_get(m,any_new_int(1))==NULL, "found a key in an empty map");
+	fail_unless (map_put(m,any_new_int(1),any_new_string("one"))==NULL, "map_put failed");
+	fail_unless (map_put_string(m,"two",any_new_int(2))==NULL, "map_put_string failed");
+	fail_unless (string_equal(map_get(m,any_new_long(1))->str,"one"), "an int and a long key differ");
+	fail_unless (map_get_string(m,"two")->i==2, "map_get_string failed");
+	fail_unless (map_get(m,any_new_string("two"))->i==2, "string keys compared by address");
+	fail_unless (map_put(m,any_new_int(1),any_new_int(11))!=NULL, "map_put did not return the previous value");
+	fail_unless (map_put_if_absent(m,any_new_int(1),any_new_int(111))->i==11, "map_put_if_absent replaced a value");
+	fail_unless (map_size(m)==2, "map_size failed");
+	fail_unless (map_remove_string(m,"two")->i==2, "map_remove_string failed");
+	fail_unless (!map_has(m,any_new_string("two")), "removed key still found");
+	fail_unless (map_size(m)==1, "map_size failed after removal");
+	fail_unless (any_equal(any_new_double(0.0/0.0),any_new_double(0.0/0.0)), "NaN keys differ");
+	map_put(m,any_new_double(NAN),any_new_int(3));
+	fail_unless (map_get(m,any_new_double(-NAN))!=NULL && map_get(m,any_new_double(0.0/0.0))->i==3, "NaN keys of other bit patterns not found");
+}
+END_TEST
+
+START_TEST (test_map_order)
+{
+	map m=map_new();
+	long order[KEYS+1];
+	int i;
+	for(i=0; i<KEYS; i++) map_put(m,any_new_long(KEYS-i),any_new_int(i));
+	for(i=0; i<KEYS; i+=3) map_remove(m,any_new_long(KEYS-i));
+	map_put(m,any_new_long(KEYS),any_new_int(0));
+	order[0]=0;
+	map_foreach(m,collect_keys,order);
+	fail_unless (order[0]==(long)map_size(m), "map_foreach missed entries");
+	for(i=1; i<order[0]-1; i++)
+		if(order[i]<=order[i+1]) break;
+	fail_unless (i==order[0]-1, "entries out of insertion order");
+	fail_unless (order[order[0]]==KEYS, "a key put again is not last");
+}
+END_TEST
+
+START_TEST (test_map_threads)
+{
+	pthread_t readers[READERS], writer;
+	long misses[READERS];
+	int i;
+	shared=map_new_striped(0);
+	for(i=0; i<KEYS; i++) map_put(shared,any_new_int(i),any_new_int(i*2));
+	memset(misses,0,sizeof(misses));
+	for(i=0; i<READERS; i++) object_thread_create(&readers[i],read_keys,&misses[i]);
+	object_thread_create(&writer,write_keys,NULL);
+	object_thread_join(writer,NULL);
+	for(i=0; i<READERS; i++)
+	{
+		object_thread_join(readers[i],NULL);
+		fail_unless (misses[i]==0, "lookups failed while another thread wrote");
+	}
+	fail_unless (map_size(shared)==KEYS+3*KEYS/2, "map_size failed after concurrent writes");
+}
+END_TEST
+
+TEST_HEADER
+	tcase_add_test (tc, test_map_put_get);
+	tcase_add_test (tc, test_map_order);
+	tcase_add_test (tc, test_map_threads);
+TEST_FOOTER("MAP")
@@ -0,0 +1,113 @@
+/**
+ *
+ * libscriptify
+ *
+ * @author  Erik Poupaert <erik@sankuru.biz>
+ *
+ * @section LICENSE
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU LGPL as
+ * published by the Free Software Foundation; either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * LGPL for more details at: http://www.gnu.org/licenses/lgpl.html
+ *
+ * @section DESCRIPTION
+ *
+ * Unit test for mapped files.
+ *
+ */
+#define GC_THREADS
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <gc/gc.h>
+#include "test.h"
+#include "object.h"
+#include "mapped_file.h"
+#include "string_utf8.h"
+
+static void write_file(const char *path, const char *data, size_t size)
+{
+	FILE *f=fopen(path,"wb");
+	fwrite(data,1,size,f);
+	fclose(f);
+}
+
+START_TEST (test_mapped_file_map)
+{
+	char path[]="/tmp/test_mapped_fileXXXXXX";
+	close(mkstemp(path));
+	write_file(path,"hello\nworld\n",12);
+	mapped_file file=string_map_file(path,MAPPED_FILE_SEQUENTIAL);
+	fail_unless (file!=NULL && file->mapping!=NULL, "string_map_file failed");
+	fail_unless (mapped_file_size(file)==12, "mapped_file_size failed");
+	fail_unless (string_equal(mapped_file_string(file),"hello\nworld\n"), "mapped content failed");
+	fail_unless (string_length_utf8(mapped_file_string(file))==12, "string function on mapped content failed");
+	fail_unless (string_valid_utf8(mapped_file_string(file)), "string function on mapped content failed");
+	fail_unless (mapped_file_advise(file,MAPPED_FILE_RANDOM), "mapped_file_advise failed");
+	mapped_file_close(file);
+	mapped_file_close(file);
+	fail_unless (mapped_file_size(file)==0, "mapped_file_close failed");
+	unlink(path);
+}
+END_TEST
+
+START_TEST (test_mapped_file_page_multiple)
+{
+	char path[]="/tmp/test_mapped_fileXXXXXX";
+	size_t size=(size_t)sysconf(_SC_PAGESIZE)*2;
+	char *data=string_new(size);
+	memset(data,'a',size);
+	close(mkstemp(path));
+	write_file(path,data,size);
+	mapped_file file=string_map_file(path,MAPPED_FILE_NORMAL);
+	fail_unless (file!=NULL, "string_map_file failed");
+	fail_unless (strlen(mapped_file_string(file))==size, "mapped content of whole pages is not null-terminated");
+	fail_unless (mapped_file_view(file).size==size, "mapped_file_view failed");
+	unlink(path);
+}
+END_TEST
+
+START_TEST (test_mapped_file_empty)
+{
+	char path[]="/tmp/test_mapped_fileXXXXXX";
+	close(mkstemp(path));
+	mapped_file file=string_map_file(path,MAPPED_FILE_NORMAL);
+	fail_unless (file!=NULL && string_equal(mapped_file_string(file),""), "mapping an empty file failed");
+	unlink(path);
+	fail_unless (string_map_file(path,MAPPED_FILE_NORMAL)==NULL, "mapping a missing file did not fail");
+}
+END_TEST
+
+START_TEST (test_mapped_file_unreachable)
+{
+	char path[]="/tmp/test_mapped_fileXXXXXX";
+	mapped_file file;
+	view content;
+	int i;
+	close(mkstemp(path));
+	write_file(path,"kept after the handle",21);
+	file=string_map_file(path,MAPPED_FILE_NORMAL);
+	unlink(path);
+	fail_unless (file!=NULL && file->mapping!=NULL, "string_map_file failed");
+	content=mapped_file_view(file);
+	file=NULL;
+	for(i=0; i<100; i++) object_new(1<<16);
+	GC_gcollect();
+	GC_invoke_finalizers();
+	//only the view is left, and the collector does not unmap what it points into
+	fail_unless (content.size==21 && memcmp(content.data,"kept after the handle",21)==0, "a mapping in use was released");
+}
+END_TEST
+
+TEST_HEADER
+	tcase_add_test (tc, test_mapped_file_map);
+	tcase_add_test (tc, test_mapped_file_page_multiple);
+	tcase_add_test (tc, test_mapped_file_empty);
+	tcase_add_test (tc, test_mapped_file_unreachable);
+TEST_FOOTER("MAPPED_FILE")
@@ -0,0 +1,123 @@
+/**
+ *
+ * libscriptify
+ *
+ * @author  Erik Poupaert <erik@sankuru.biz>
+ *
+ * @section LICENSE
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU LGPL as
+ * published by the Free Software Foundation; either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * LGPL for more details at: http://www.gnu.org/licenses/lgpl.html
+ *
+ * @section DESCRIPTION
+ *
+ * Unit test for the template engine.
+ *
+ */
+#include <string.h>
+#include "test.h"
+#include "object.h"
+#include "map.h"
+#include "json.h"
+#include "shape.h"
+#include "mustache.h"
+
+static string render(const char *source, const char *data)
+{
+	mustache m=mustache_compile((string)source);
+	fail_unless (m!=NULL, "mustache_compile failed");
+	return mustache_tostring(m,json_parse((string)data));
+}
+
+START_TEST (test_mustache_values)
+{
+	fail_unless (strcmp(render("Hello, {{ name }}!","{\"name\":\"World\"}"),"Hello, World!")==0, "variable failed");
+	fail_unless (strcmp(render("{{a}}|{{{a}}}|{{&a}}","{\"a\":\"<b>&'\"}"),"&lt;b&gt;&amp;&#39;|<b>&'|<b>&'")==0, "escaping failed");
+	fail_unless (strcmp(render("{{n}} {{d}} {{t}} {{z}} [{{missing}}]","{\"n\":42,\"d\":1.5,\"t\":true,\"z\":null}"),"42 1.5 true  []")==0, "scalars failed");
+	fail_unless (strcmp(render("{{user.name.first}} {{user.age.x}}","{\"user\":{\"name\":{\"first\":\"Ann\"},\"age\":3}}"),"Ann ")==0, "dotted names failed");
+	fail_unless (strcmp(render("a{{! ignored }}b","{}"),"ab")==0, "comment failed");
+	fail_unless (strcmp(render("no tags { } }}","{}"),"no tags { } }}")==0, "plain text failed");
+}
+END_TEST
+
+START_TEST (test_mustache_sections)
+{
+	const char *data="{\"items\":[{\"name\":\"a\",\"tags\":[1,2]},{\"name\":\"b\",\"tags\":[]}],\"title\":\"T\",\"on\":true,\"off\":false,\"none\":[]}";
+	fail_unless (strcmp(render("{{#items}}{{name}}({{#tags}}{{.}}{{/tags}}{{^tags}}-{{/tags}}){{title}};{{/items}}",data),"a(12)T;b(-)T;")==0, "loops failed");
+	fail_unless (strcmp(render("{{#on}}yes{{/on}}{{#off}}no{{/off}}{{^off}}not{{/off}}{{^none}}empty{{/none}}{{#missing}}x{{/missing}}",data),"yesnotempty")==0, "conditionals failed");
+	fail_unless (strcmp(render("{{#user}}{{name}} {{title}}{{/user}}","{\"user\":{\"name\":\"Ann\"},\"title\":\"Dr\"}"),"Ann Dr")==0, "map section failed");
+}
+END_TEST
+
+START_TEST (test_mustache_standalone)
+{
+	const char *source="<ul>\n  {{#items}}\n  <li>{{.}}</li>\n  {{/items}}\r\n{{! note }}\n</ul>\n{{#items}}{{.}}{{/items}}\n";
+	fail_unless (strcmp(render(source,"{\"items\":[1,2]}"),"<ul>\n  <li>1</li>\n  <li>2</li>\n</ul>\n12\n")==0, "standalone lines failed");
+}
+END_TEST
+
+START_TEST (test_mustache_invalid)
+{
+	const char *invalid[]={"{{name", "{{{name}}", "{{}}", "{{a..b}}", "{{#a}}", "{{/a}}", "{{#a}}{{/b}}", "{{#a}}{{#b}}{{/a}}{{/b}}"};
+	size_t i;
+	buffer deep=buffer_new();
+	for(i=0; i<sizeof(invalid)/sizeof(invalid[0]); i++)
+		fail_unless (mustache_compile((string)invalid[i])==NULL, "invalid template failed");
+	for(i=0; i<=MUSTACHE_MAX_DEPTH; i++) buffer_appendstring(deep,"{{#a}}");
+	for(i=0; i<=MUSTACHE_MAX_DEPTH; i++) buffer_appendstring(deep,"{{/a}}");
+	fail_unless (mustache_compile(buffer_tostring(deep))==NULL, "nesting too deep failed");
+}
+END_TEST
+
+START_TEST (test_mustache_reuse)
+{
+	mustache m=mustache_compile("{{#rows}}{{id}},{{/rows}}");
+	buffer b=buffer_new();
+	map data=map_new();
+	manyany rows=(manyany)object_new(1000*sizeof(any));
+	size_t i;
+	for(i=0; i<1000; i++)
+	{
+		map row=map_new();
+		map_put_string(row,"id",any_new_long((long)i));
+		rows[i]=any_new_map(row);
+	}
+	map_put_string(data,"rows",any_new_array(rows,1000));
+	mustache_render(b,m,any_new_map(data));
+	mustache_render(b,m,any_new_map(data));
+	fail_unless (strncmp(buffer_tostring(b),"0,1,2,",6)==0 && b->size==2*(10*2+90*3+900*4), "repeated render failed");
+}
+END_TEST
+
+START_TEST (test_mustache_records)
+{
+	mustache m=mustache_compile("{{name}} {{user.name}}{{#user}} {{age}} {{title}}{{/user}} [{{missing}}]");
+	record user=record_new(), data=record_new();
+	map outer=map_new();
+	record_put(user,"name",any_new_string("Ann"));
+	record_put(user,"age",any_new_long(30));
+	record_put(data,"name",any_new_string("Doc"));
+	record_put(data,"user",any_new_record(user));
+	record_put(data,"title",any_new_string("Dr"));
+	fail_unless (m!=NULL && strcmp(mustache_tostring(m,any_new_record(data)),"Doc Ann 30 Dr []")==0, "record fields failed");
+	map_put_string(outer,"name",any_new_string("Map"));
+	map_put_string(outer,"user",any_new_record(user));
+	fail_unless (strcmp(mustache_tostring(m,any_new_map(outer)),"Map Ann 30  []")==0, "records in maps failed");
+}
+END_TEST
+
+TEST_HEADER
+	tcase_add_test (tc, test_mustache_values);
+	tcase_add_test (tc, test_mustache_sections);
+	tcase_add_test (tc, test_mustache_standalone);
+	tcase_add_test (tc, test_mustache_invalid);
+	tcase_add_test (tc, test_mustache_reuse);
+	tcase_add_test (tc, test_mustache_records);
+TEST_FOOTER("MUSTACHE")
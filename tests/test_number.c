@@ -0,0 +1,161 @@
+/**
+ *
+ * libscriptify
+ *
+ * @author  Erik Poupaert <erik@sankuru.biz>
+ *
+ * @section LICENSE
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU LGPL as
+ * published by the Free Software Foundation; either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * LGPL for more details at: http://www.gnu.org/licenses/lgpl.html
+ *
+ * @section DESCRIPTION
+ *
+ * Unit test for number parsing and formatting.
+ *
+ */
+#include <math.h>
+#include <limits.h>
+#include "test.h"
+#include "number.h"
+#include "any.h"
+
+START_TEST (test_string_to_long)
+{
+	long l;
+	fail_unless (string_to_long("12345",5,&l) && l==12345, "string_to_long failed");
+	fail_unless (string_to_long("-42xyz",3,&l) && l==-42, "string_to_long without terminating zero failed");
+	fail_unless (string_to_long("+0012345678901234",17,&l) && l==12345678901234L, "string_to_long with long digit run failed");
+	fail_unless (string_to_long("-9223372036854775808",20,&l) && l==LONG_MIN, "string_to_long minimum failed");
+	fail_unless (!string_to_long("9223372036854775808",19,&l), "string_to_long overflow failed");
+	fail_unless (!string_to_long("12a",3,&l), "string_to_long trailing garbage failed");
+	fail_unless (!string_to_long("",0,&l), "string_to_long empty failed");
+	fail_unless (!string_to_long("-",1,&l), "string_to_long sign only failed");
+}
+END_TEST
+
+START_TEST (test_string_to_double)
+{
+	double d;
+	fail_unless (string_to_double("3.25",4,&d) && d==3.25, "string_to_double failed");
+	fail_unless (string_to_double("0.1",3,&d) && d==0.1, "string_to_double 0.1 failed");
+	fail_unless (string_to_double("-1.5e-3",7,&d) && d==-1.5e-3, "string_to_double exponent failed");
+	fail_unless (string_to_double("1e23",4,&d) && d==1e23, "string_to_double 1e23 failed");
+	fail_unless (string_to_double("2.2250738585072011e-308",23,&d) && d==2.2250738585072011e-308, "string_to_double subnormal boundary failed");
+	fail_unless (string_to_double("4.9e-324",8,&d) && d==4.9e-324, "string_to_double smallest subnormal failed");
+	fail_unless (string_to_double("1e400",5,&d) && isinf(d), "string_to_double overflow failed");
+	fail_unless (string_to_double("1e-400",6,&d) && d==0.0, "string_to_double underflow failed");
+	fail_unless (string_to_double("-Infinity",9,&d) && isinf(d) && d<0, "string_to_double infinity failed");
+	fail_unless (!string_to_double("1.5.",4,&d), "string_to_double trailing garbage failed");
+	fail_unless (!string_to_double("1e",2,&d), "string_to_double missing exponent failed");
+}
+END_TEST
+
+START_TEST (test_string_to_double_many_digits)
+{
+	double d;
+	string halfway="9007199254740993.0000000000000000000000000001";
+	fail_unless (string_to_double(halfway,strlen(halfway),&d) && d==9007199254740994.0, "string_to_double above halfway failed");
+	halfway="9007199254740993";
+	fail_unless (string_to_double(halfway,strlen(halfway),&d) && d==9007199254740992.0, "string_to_double halfway failed");
+	string pi="3.14159265358979323846264338327950288419716939937510";
+	fail_unless (string_to_double(pi,strlen(pi),&d) && d==3.141592653589793, "string_to_double long mantissa failed");
+}
+END_TEST
+
+START_TEST (test_view_to_number)
+{
+	long l;
+	double d;
+	view v=view_new("17,2.5",6);
+	fail_unless (view_to_long(view_new(v.data,2),&l) && l==17, "view_to_long failed");
+	fail_unless (view_to_double(view_new(v.data+3,3),&d) && d==2.5, "view_to_double failed");
+}
+END_TEST
+
+START_TEST (test_number_write_long)
+{
+	char out[NUMBER_MAX_LENGTH+1];
+	out[number_write_long(out,0)]=0;
+	fail_unless (string_equal(out,"0"), "number_write_long zero failed");
+	out[number_write_long(out,-1234567)]=0;
+	fail_unless (string_equal(out,"-1234567"), "number_write_long negative failed");
+	out[number_write_long(out,LONG_MIN)]=0;
+	fail_unless (string_equal(out,"-9223372036854775808"), "number_write_long minimum failed");
+}
+END_TEST
+
+START_TEST (test_number_write_double)
+{
+	char out[NUMBER_MAX_LENGTH+1];
+	out[number_write_double(out,0.1)]=0;
+	fail_unless (string_equal(out,"0.1"), "number_write_double 0.1 failed");
+	out[number_write_double(out,5.0)]=0;
+	fail_unless (string_equal(out,"5"), "number_write_double integral failed");
+	out[number_write_double(out,-1234.5)]=0;
+	fail_unless (string_equal(out,"-1234.5"), "number_write_double negative failed");
+	out[number_write_double(out,1e21)]=0;
+	fail_unless (string_equal(out,"1e+21"), "number_write_double large failed");
+	out[number_write_double(out,1.5e-7)]=0;
+	fail_unless (string_equal(out,"1.5e-7"), "number_write_double small failed");
+	out[number_write_double(out,5e-324)]=0;
+	fail_unless (string_equal(out,"5e-324"), "number_write_double subnormal failed");
+	out[number_write_double(out,1.7976931348623157e308)]=0;
+	fail_unless (string_equal(out,"1.7976931348623157e+308"), "number_write_double maximum failed");
+	out[number_write_double(out,-0.0)]=0;
+	fail_unless (string_equal(out,"-0"), "number_write_double negative zero failed");
+	out[number_write_double(out,-1.0/0.0)]=0;
+	fail_unless (string_equal(out,"-Infinity"), "number_write_double infinity failed");
+}
+END_TEST
+
+START_TEST (test_number_round_trip)
+{
+	char out[NUMBER_MAX_LENGTH];
+	double d, back;
+	uint64_t bits=0x123456789abcdefull;
+	int i;
+	for(i=0; i<100000; i++)
+	{
+		bits=bits*6364136223846793005ull+1442695040888963407ull;
+		memcpy(&d,&bits,sizeof(d));
+		if(isnan(d)) continue;
+		fail_unless (string_to_double(out,number_write_double(out,d),&back) && memcmp(&d,&back,sizeof(d))==0, "round trip failed");
+	}
+}
+END_TEST
+
+START_TEST (test_number_write_fixed)
+{
+	char out[NUMBER_MAX_LENGTH+1];
+	out[number_write_fixed(out,2.5,0)]=0;
+	fail_unless (string_equal(out,"2"), "number_write_fixed ties to even failed");
+	out[number_write_fixed(out,0.125,2)]=0;
+	fail_unless (string_equal(out,"0.12"), "number_write_fixed exact tie failed");
+	out[number_write_fixed(out,0.1,9)]=0;
+	fail_unless (string_equal(out,"0.100000000"), "number_write_fixed precision failed");
+	out[number_write_fixed(out,-0.0001,3)]=0;
+	fail_unless (string_equal(out,"-0.000"), "number_write_fixed negative failed");
+	fail_unless (number_write_fixed(out,1e15,2)==0, "number_write_fixed range failed");
+	out[number_write_ulong(out,18446744073709551615ul)]=0;
+	fail_unless (string_equal(out,"18446744073709551615"), "number_write_ulong failed");
+}
+END_TEST
+
+TEST_HEADER
+	tcase_add_test (tc, test_string_to_long);
+	tcase_add_test (tc, test_string_to_double);
+	tcase_add_test (tc, test_string_to_double_many_digits);
+	tcase_add_test (tc, test_view_to_number);
+	tcase_add_test (tc, test_number_write_long);
+	tcase_add_test (tc, test_number_write_double);
+	tcase_add_test (tc, test_number_round_trip);
+	tcase_add_test (tc, test_number_write_fixed);
+TEST_FOOTER("NUMBER")
@@ -28,6 +28,18 @@ START_TEST (test_object_resize)
 }
 END_TEST
 
+START_TEST (test_object_weakref)
+{
+	object obj=object_new(16);
+	object_weakref ref=0;
+	fail_unless (object_weakref_get(&ref)==NULL, "unset weak reference");
+	object_weakref_set(&ref,obj);
+	fail_unless (object_weakref_get(&ref)==obj, "weak reference to live object");
+	object_weakref_clear(&ref);
+	fail_unless (object_weakref_get(&ref)==NULL, "cleared weak reference");
+}
+END_TEST
+
 /*	----------------------
 	REGISTER TESTS AND RUN
 	---------------------- 
@@ -36,5 +48,6 @@ END_TEST
 TEST_HEADER
 	tcase_add_test (tc, test_object_new);
 	tcase_add_test (tc, test_object_resize);
+	tcase_add_test (tc, test_object_weakref);
 TEST_FOOTER("OBJECT")
 
@@ -0,0 +1,133 @@
+/**
+ *
+ * libscriptify
+ *
+ * @author  Erik Poupaert <erik@sankuru.biz>
+ *
+ * @section LICENSE
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU LGPL as
+ * published by the Free Software Foundation; either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * LGPL for more details at: http://www.gnu.org/licenses/lgpl.html
+ *
+ * @section DESCRIPTION
+ *
+ * Unit test for parallel processing of records.
+ *
+ */
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include "test.h"
+#include "parallel.h"
+#include "buffer.h"
+#include "number.h"
+#include "string_utf8.h"
+
+typedef struct
+{
+	long count;
+	long sum;
+	long first; //first number seen by the chunk
+	long last;
+} totals;
+
+typedef struct
+{
+	totals all;
+	bool in_order;
+} results;
+
+static object totals_new(void *data)
+{
+	totals *t=(totals *)object_new(sizeof(totals));
+	t->first=-1;
+	return t;
+}
+
+static void count_record(view record, object state, void *data)
+{
+	totals *t=(totals *)state;
+	long value;
+	if(!view_to_long(record,&value)) return;
+	if(t->first<0) t->first=value;
+	t->last=value;
+	t->count++;
+	t->sum+=value;
+}
+
+static void merge_totals(object state, void *data)
+{
+	totals *t=(totals *)state;
+	results *r=(results *)data;
+	if(t->count==0) return;
+	if(t->first!=r->all.last+1 && r->all.count>0) r->in_order=false;
+	r->all.count+=t->count;
+	r->all.sum+=t->sum;
+	r->all.last=t->last;
+}
+
+static buffer numbers(long n)
+{
+	buffer b=buffer_new();
+	long i;
+	for(i=0; i<n; i++)
+	{
+		buffer_append_long(b,i);
+		buffer_appendstring(b,i%2==0?"\n":"\r\n");
+	}
+	return b;
+}
+
+START_TEST (test_parallel_view)
+{
+	results r;
+	buffer b=numbers(200000);
+	memset(&r,0,sizeof(r));
+	r.in_order=true;
+	parallel_job job=parallel_job_new(count_record,&r);
+	job->init=totals_new;
+	job->merge=merge_totals;
+	job->threads=4;
+	job->chunk_size=4096;
+	job->ordered=true;
+	fail_unless (parallel_run_view(job,view_new(b->data,b->size)), "parallel_run_view failed");
+	fail_unless (r.all.count==200000, "record count failed");
+	fail_unless (r.all.sum==200000L*199999/2, "record sum failed");
+	fail_unless (r.in_order, "ordered merge failed");
+}
+END_TEST
+
+START_TEST (test_parallel_fd)
+{
+	results r;
+	buffer b=numbers(100000);
+	FILE *f=tmpfile();
+	fwrite(b->data,1,b->size,f);
+	fputs("100000",f); //last record without delimiter
+	fflush(f);
+	lseek(fileno(f),0,SEEK_SET);
+	memset(&r,0,sizeof(r));
+	r.in_order=true;
+	parallel_job job=parallel_job_new(count_record,&r);
+	job->init=totals_new;
+	job->merge=merge_totals;
+	job->threads=3;
+	job->chunk_size=1000;
+	fail_unless (parallel_run_fd(job,fileno(f)), "parallel_run_fd failed");
+	fail_unless (r.all.count==100001, "record count failed");
+	fail_unless (r.all.sum==100001L*100000/2, "record sum failed");
+	fclose(f);
+}
+END_TEST
+
+TEST_HEADER
+	tcase_add_test (tc, test_parallel_view);
+	tcase_add_test (tc, test_parallel_fd);
+TEST_FOOTER("PARALLEL")
@@ -0,0 +1,123 @@
+/**
+ *
+ * libscriptify
+ *
+ * @author  Erik Poupaert <erik@sankuru.biz>
+ *
+ * @section LICENSE
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU LGPL as
+ * published by the Free Software Foundation; either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * LGPL for more details at: http://www.gnu.org/licenses/lgpl.html
+ *
+ * @section DESCRIPTION
+ *
+ * Unit test for the lock-free queue.
+ *
+ */
+#include <string.h>
+#include "test.h"
+#include "object.h"
+#include "queue.h"
+
+#define PRODUCERS 4
+#define CONSUMERS 4
+#define PER_PRODUCER 50000
+
+static queue shared;
+
+static void *produce(void *arg)
+{
+	long base=(long)arg*PER_PRODUCER;
+	any batch[16];
+	long i;
+	int n=0;
+	for(i=0; i<PER_PRODUCER; i++)
+	{
+		batch[n++]=any_new_long(base+i);
+		if(n==16 || i==PER_PRODUCER-1)
+		{
+			queue_push_batch_wait(shared,batch,n);
+			n=0;
+		}
+	}
+	return NULL;
+}
+
+static void *consume(void *arg)
+{
+	long *sum=(long *)arg;
+	any batch[8];
+	size_t n, i;
+	while((n=queue_pop_batch_wait(shared,batch,8))>0)
+		for(i=0; i<n; i++) *sum+=batch[i]->lng;
+	return NULL;
+}
+
+START_TEST (test_queue_push_pop)
+{
+	queue q=queue_new(3);
+	any value;
+	fail_unless (queue_capacity(q)==4, "capacity not rounded up");
+	fail_unless (!queue_pop(q,&value), "popped from an empty queue");
+	fail_unless (queue_push(q,any_new_int(1)), "queue_push failed");
+	fail_unless (queue_push(q,any_new_int(2)), "queue_push failed");
+	fail_unless (queue_size(q)==2, "queue_size failed");
+	fail_unless (queue_pop(q,&value) && value->i==1, "queue_pop failed");
+	fail_unless (queue_push(q,any_new_int(3)), "queue_push failed");
+	fail_unless (queue_push(q,any_new_int(4)), "queue_push failed");
+	fail_unless (queue_push(q,any_new_int(5)), "queue_push failed");
+	fail_unless (!queue_push(q,any_new_int(6)), "pushed into a full queue");
+	fail_unless (queue_pop(q,&value) && value->i==2, "queue_pop failed after wrapping");
+}
+END_TEST
+
+START_TEST (test_queue_batch)
+{
+	queue q=queue_new(8);
+	any in[10], out[10];
+	size_t i;
+	for(i=0; i<10; i++) in[i]=any_new_long((long)i);
+	fail_unless (queue_push_batch(q,in,10)==8, "queue_push_batch did not fill the queue");
+	fail_unless (queue_pop_batch(q,out,3)==3, "queue_pop_batch failed");
+	fail_unless (queue_push_batch(q,in+8,2)==2, "queue_push_batch failed");
+	fail_unless (queue_pop_batch(q,out+3,10)==7, "queue_pop_batch failed");
+	for(i=0; i<10; i++)
+		fail_unless (out[i]->lng==(long)i, "values out of order");
+	queue_close(q);
+	fail_unless (!queue_push(q,in[0]), "pushed into a closed queue");
+	fail_unless (queue_pop_batch_wait(q,out,1)==0, "waited on a closed queue");
+}
+END_TEST
+
+START_TEST (test_queue_threads)
+{
+	pthread_t producers[PRODUCERS], consumers[CONSUMERS];
+	long sums[CONSUMERS], total=0, n=(long)PRODUCERS*PER_PRODUCER;
+	int i;
+	shared=queue_new(64);
+	memset(sums,0,sizeof(sums));
+	for(i=0; i<CONSUMERS; i++) object_thread_create(&consumers[i],consume,&sums[i]);
+	for(i=0; i<PRODUCERS; i++) object_thread_create(&producers[i],produce,(void *)(long)i);
+	for(i=0; i<PRODUCERS; i++) object_thread_join(producers[i],NULL);
+	queue_close(shared);
+	for(i=0; i<CONSUMERS; i++)
+	{
+		object_thread_join(consumers[i],NULL);
+		total+=sums[i];
+	}
+	fail_unless (total==n*(n-1)/2, "values lost or duplicated between threads");
+}
+END_TEST
+
+TEST_HEADER
+	tcase_add_test (tc, test_queue_push_pop);
+	tcase_add_test (tc, test_queue_batch);
+	tcase_add_test (tc, test_queue_threads);
+TEST_FOOTER("QUEUE")
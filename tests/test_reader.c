@@ -0,0 +1,90 @@
+/**
+ *
+ * libscriptify
+ *
+ * @author  Erik Poupaert <erik@sankuru.biz>
+ *
+ * @section LICENSE
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU LGPL as
+ * published by the Free Software Foundation; either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * LGPL for more details at: http://www.gnu.org/licenses/lgpl.html
+ *
+ * @section DESCRIPTION
+ *
+ * Unit test for readers.
+ *
+ */
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include "test.h"
+#include "reader.h"
+#include "string_utf8.h"
+
+START_TEST (test_reader_lines)
+{
+	view line;
+	FILE *f=tmpfile();
+	fputs("first\r\nsecond\n\nlast",f);
+	rewind(f);
+	reader r=reader_new_file(f);
+	fail_unless (reader_next_line(r,&line) && view_equal_string(line,"first"), "CRLF line failed");
+	fail_unless (reader_next_line(r,&line) && view_equal_string(line,"second"), "LF line failed");
+	fail_unless (reader_next_line(r,&line) && line.size==0, "empty line failed");
+	fail_unless (reader_next_line(r,&line) && view_equal_string(line,"last"), "unterminated last line failed");
+	fail_unless (!reader_next_line(r,&line), "end of input failed");
+	fail_unless (reader_error(r)==0, "reader_error failed");
+	fclose(f);
+}
+END_TEST
+
+START_TEST (test_reader_records)
+{
+	view record;
+	int fds[2];
+	fail_unless (pipe(fds)==0, "pipe failed");
+	fail_unless (write(fds[1],"a,bb,,ccc,",10)==10, "write failed");
+	close(fds[1]);
+	reader r=reader_new_fd(fds[0]);
+	fail_unless (reader_next_record(r,',',&record) && view_equal_string(record,"a"), "record failed");
+	fail_unless (reader_next_record(r,',',&record) && view_equal_string(record,"bb"), "record failed");
+	fail_unless (reader_next_record(r,',',&record) && record.size==0, "empty record failed");
+	fail_unless (reader_next_record(r,',',&record) && view_equal_string(record,"ccc"), "record failed");
+	fail_unless (!reader_next_record(r,',',&record), "end of input failed");
+	close(fds[0]);
+}
+END_TEST
+
+START_TEST (test_reader_long_lines)
+{
+	view line;
+	size_t i, count=0, size=3*READER_INIT_CAPACITY+17;
+	FILE *f=tmpfile();
+	for(i=0; i<size; i++) fputc('x',f);
+	fputc('\n',f);
+	for(i=0; i<100000; i++) fprintf(f,"line %zu\n",i);
+	rewind(f);
+	reader r=reader_new_file(f);
+	fail_unless (reader_next_line(r,&line) && line.size==size, "line longer than the buffer failed");
+	while(reader_next_line(r,&line))
+	{
+		fail_unless (view_equal_string(line,string_format("line %zu",count)), "line across refills failed");
+		count++;
+	}
+	fail_unless (count==100000, "line count failed");
+	fclose(f);
+}
+END_TEST
+
+TEST_HEADER
+	tcase_add_test (tc, test_reader_lines);
+	tcase_add_test (tc, test_reader_records);
+	tcase_add_test (tc, test_reader_long_lines);
+TEST_FOOTER("READER")
@@ -0,0 +1,97 @@
+/**
+ *
+ * libscriptify
+ *
+ * @author  Erik Poupaert <erik@sankuru.biz>
+ *
+ * @section LICENSE
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU LGPL as
+ * published by the Free Software Foundation; either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * LGPL for more details at: http://www.gnu.org/licenses/lgpl.html
+ *
+ * @section DESCRIPTION
+ *
+ * Unit test for the 'rope' data type.
+ *
+ */
+#include "test.h"
+#include "rope.h"
+#include "string_utf8.h"
+
+START_TEST (test_rope_concat)
+{
+	rope r=rope_concat(rope_new_string("Hello"),rope_new_string(" World"));
+	fail_unless (rope_length(r)==11, "rope_length failed");
+	fail_unless (string_equal(rope_tostring(r),"Hello World"), "rope_concat failed");
+	fail_unless (rope_charat(r,6)=='W', "rope_charat failed");
+	fail_unless (rope_length(rope_concat(rope_new(),r))==11, "concatenating empty rope");
+}
+END_TEST
+
+START_TEST (test_rope_substr)
+{
+	rope r=rope_append(rope_append(rope_new_string("Hello"),", "),"World");
+	fail_unless (string_equal(rope_tostring(rope_substr(r,3,6)),"lo, Wo"), "rope_substr failed");
+	fail_unless (string_equal(rope_tostring(rope_substr(r,7,100)),"World"), "rope_substr past the end failed");
+}
+END_TEST
+
+START_TEST (test_rope_insert_delete)
+{
+	rope r=rope_new_string("Hello World");
+	r=rope_insert(r,5,rope_new_string(" big"));
+	fail_unless (string_equal(rope_tostring(r),"Hello big World"), "rope_insert failed");
+	r=rope_delete(r,0,6);
+	fail_unless (string_equal(rope_tostring(r),"big World"), "rope_delete failed");
+}
+END_TEST
+
+START_TEST (test_rope_balanced)
+{
+	int i;
+	string chunk=string_new(ROPE_SHORT_LIMIT+1);
+	memset(chunk,'x',ROPE_SHORT_LIMIT+1);
+	chunk[ROPE_SHORT_LIMIT+1]=0;
+	rope r=rope_new();
+	for(i=0; i<10000; i++) r=rope_append(r,chunk);
+	fail_unless (rope_length(r)==10000*(ROPE_SHORT_LIMIT+1), "appending many chunks");
+	fail_unless (r->height<=20, "rope stays balanced");
+	for(i=0; i<1000; i++) r=rope_insert(r,(i*7919)%rope_length(r),rope_new_string(chunk));
+	fail_unless (r->height<=22, "rope stays balanced after inserts");
+}
+END_TEST
+
+START_TEST (test_rope_iterator)
+{
+	const char *data;
+	size_t size, total=0;
+	int chunks=0;
+	rope r=rope_new();
+	int i;
+	for(i=0; i<100; i++) r=rope_append(r,string_format("%080d",i));
+	rope_iterator it=rope_iterator_new(r);
+	while(rope_iterator_next(it,&data,&size))
+	{
+		fail_unless (memcmp(data,rope_tostring(r)+total,size)==0, "chunk content");
+		total+=size;
+		chunks++;
+	}
+	fail_unless (total==rope_length(r), "chunks cover the rope");
+	fail_unless (chunks==100, "one chunk per long piece");
+}
+END_TEST
+
+TEST_HEADER
+	tcase_add_test (tc, test_rope_concat);
+	tcase_add_test (tc, test_rope_substr);
+	tcase_add_test (tc, test_rope_insert_delete);
+	tcase_add_test (tc, test_rope_balanced);
+	tcase_add_test (tc, test_rope_iterator);
+TEST_FOOTER("ROPE")
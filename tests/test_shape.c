@@ -0,0 +1,159 @@
+/**
+ *
+ * libscriptify
+ *
+ * @author  Erik Poupaert <erik@sankuru.biz>
+ *
+ * @section LICENSE
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU LGPL as
+ * published by the Free Software Foundation; either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * LGPL for more details at: http://www.gnu.org/licenses/lgpl.html
+ *
+ * @section DESCRIPTION
+ *
+ * Unit test for shapes and records.
+ *
+ */
+#include <string.h>
+#include <stdio.h>
+#include <pthread.h>
+#include "test.h"
+#include "object.h"
+#include "json.h"
+#include "shape.h"
+
+#define THREADS 4
+#define NAMES 40
+
+static shape built[THREADS];
+
+static void *build_shapes(void *arg)
+{
+	shape *result=(shape *)arg;
+	char name[16];
+	shape s=shape_empty();
+	int i;
+	for(i=0; i<NAMES; i++)
+	{
+		snprintf(name,sizeof(name),"p%d",i);
+		s=shape_add(s,name);
+	}
+	*result=s;
+	return NULL;
+}
+
+START_TEST (test_shape_transitions)
+{
+	shape xy=shape_add(shape_add(shape_empty(),"x"),"y");
+	shape yx=shape_add(shape_add(shape_empty(),"y"),"x");
+	char name[]="x";
+	fail_unless (shape_empty()->count==0 && xy->count==2, "count failed");
+	fail_unless (shape_add(shape_add(shape_empty(),name),"y")==xy, "shapes not shared");
+	fail_unless (xy!=yx && xy->parent==shape_add(shape_empty(),"x"), "order ignored");
+	fail_unless (shape_add(xy,"x")==xy, "adding an existing property changed the shape");
+	fail_unless (shape_slot(xy,"x")==0 && shape_slot(xy,"y")==1 && shape_slot(yx,"x")==1, "shape_slot failed");
+	fail_unless (shape_slot(xy,"z")==-1 && shape_slot(shape_empty(),"x")==-1, "missing property found");
+	fail_unless (string_is_interned(xy->names[0]), "names not interned");
+}
+END_TEST
+
+START_TEST (test_shape_index)
+{
+	pthread_t threads[THREADS];
+	char name[16];
+	int i;
+	for(i=0; i<THREADS; i++) pthread_create(&threads[i],NULL,build_shapes,&built[i]);
+	for(i=0; i<THREADS; i++) pthread_join(threads[i],NULL);
+	for(i=1; i<THREADS; i++) fail_unless (built[i]==built[0], "threads built different shapes");
+	fail_unless (built[0]->count==NAMES && built[0]->index!=NULL, "index not built");
+	for(i=0; i<NAMES; i++)
+	{
+		snprintf(name,sizeof(name),"p%d",i);
+		fail_unless (shape_slot(built[0],name)==i, "indexed lookup failed");
+	}
+	fail_unless (shape_slot(built[0],"p40")==-1 && shape_slot(built[0],"q")==-1, "indexed lookup found a missing name");
+}
+END_TEST
+
+START_TEST (test_shape_records)
+{
+	record a=record_new(), b=record_new(), c;
+	int i;
+	record_put(a,"name",any_new_string("Ann"));
+	record_put(a,"age",any_new_int(31));
+	record_put(b,"name",any_new_string("Bob"));
+	record_put(b,"age",any_new_int(42));
+	fail_unless (a->shape==b->shape && record_size(a)==2, "records built alike do not share a shape");
+	record_put(a,"age",any_new_int(32));
+	fail_unless (a->shape==b->shape && record_get(a,"age")->i==32, "overwriting failed");
+	fail_unless (strcmp(record_get(b,"name")->str,"Bob")==0 && record_get(b,"email")==NULL, "record_get failed");
+	for(i=0; i<20; i++)
+	{
+		char name[16];
+		snprintf(name,sizeof(name),"f%d",i);
+		record_put(b,name,any_new_int(i));
+	}
+	fail_unless (record_size(b)==22 && record_get(b,"f19")->i==19 && record_get(b,"name")!=NULL, "growing failed");
+	c=record_new_shape(a->shape);
+	fail_unless (c->shape==a->shape && record_get(c,"name")==NULL, "record_new_shape failed");
+	record_put(c,"age",any_new_int(1));
+	fail_unless (c->shape==a->shape && record_get(c,"age")->i==1, "filling a shaped record changed its shape");
+}
+END_TEST
+
+START_TEST (test_shape_cache)
+{
+	_shape_cache get_cache, put_x, put_y;
+	record records[100];
+	long sum=0;
+	int i;
+	memset(&get_cache,0,sizeof(get_cache));
+	memset(&put_x,0,sizeof(put_x));
+	memset(&put_y,0,sizeof(put_y));
+	for(i=0; i<100; i++)
+	{
+		records[i]=record_new();
+		if(i%10==0) record_put(records[i],"first",any_new_null());
+		record_put_cached(records[i],"x",any_new_int(i),&put_x);
+		record_put_cached(records[i],"y",any_new_int(2*i),&put_y);
+	}
+	fail_unless (records[1]->shape==records[2]->shape && records[0]->shape!=records[1]->shape, "cached puts failed");
+	for(i=0; i<100; i++) sum+=record_get_cached(records[i],"y",&get_cache)->i;
+	fail_unless (sum==2*4950, "cached gets failed");
+	fail_unless (get_cache.shape==records[99]->shape && get_cache.slot==1, "cache not filled");
+	fail_unless (record_get_cached(records[0],"z",&get_cache)==NULL && get_cache.shape==records[99]->shape, "missing property cached");
+	record_put_cached(records[1],"x",any_new_int(-1),&put_x);
+	fail_unless (record_get(records[1],"x")->i==-1 && record_size(records[1])==2, "cached overwrite failed");
+	fail_unless (record_get_cached(records[0],"x",&put_x)->i==0, "get through a put cache failed");
+}
+END_TEST
+
+START_TEST (test_shape_any)
+{
+	record r=record_new(), inner=record_new();
+	any value=any_new_record(r);
+	record_put(inner,"ok",any_new_bool(true));
+	record_put(r,"id",any_new_int(7));
+	record_put(r,"tags",any_new_null());
+	record_put(r,"inner",any_new_record(inner));
+	fail_unless (value->type==TYPE_RECORD && value->rec==r, "any_new_record failed");
+	fail_unless (strcmp(json_tostring(value,0),"{\"id\":7,\"tags\":null,\"inner\":{\"ok\":true}}")==0, "json failed");
+	record_put(inner,"self",any_new_record(inner));
+	fail_unless (!json_write(buffer_new(),value,0), "cycle not detected");
+}
+END_TEST
+
+TEST_HEADER
+	tcase_add_test (tc, test_shape_transitions);
+	tcase_add_test (tc, test_shape_index);
+	tcase_add_test (tc, test_shape_records);
+	tcase_add_test (tc, test_shape_cache);
+	tcase_add_test (tc, test_shape_any);
+TEST_FOOTER("SHAPE")
@@ -124,6 +124,14 @@ START_TEST (test_string_valid_utf8);
 }
 END_TEST
 
+START_TEST (test_string_hash)
+{
+    string s = string_new_copy("Hello World");
+	fail_unless (string_hash(s) == string_hash("Hello World"), "string_hash failed");
+	fail_unless (string_hash(s) != string_hash("Hello world"), "string_hash failed");
+}
+END_TEST
+
 TEST_HEADER
 	tcase_add_test (tc, test_string_new);
 	tcase_add_test (tc, test_string_length);
@@ -139,5 +147,6 @@ TEST_HEADER
 	tcase_add_test (tc, test_string_toupper_utf8);
 	tcase_add_test (tc, test_string_valid_utf8);
 	tcase_add_test (tc, test_string_charat_utf8);
+	tcase_add_test (tc, test_string_hash);
 TEST_FOOTER("STRING_UTF8")
 
@@ -0,0 +1,128 @@
+/**
+ *
+ * libscriptify
+ *
+ * @author  Erik Poupaert <erik@sankuru.biz>
+ *
+ * @section LICENSE
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU LGPL as
+ * published by the Free Software Foundation; either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * LGPL for more details at: http://www.gnu.org/licenses/lgpl.html
+ *
+ * @section DESCRIPTION
+ *
+ * Unit test for batch string operations.
+ *
+ */
+#include <string.h>
+#include <locale.h>
+#include "test.h"
+#include "object.h"
+#include "string_batch.h"
+
+START_TEST (test_string_batch_case)
+{
+	string strings[]={"Hello World", "", "ABC xyz 123", "Caf\xc3\xa9 OK"};
+	view *items=string_batch_views(strings,4);
+	string *lower=string_batch_tolower(items,4);
+	string *upper=string_batch_toupper(items,4);
+	fail_unless (string_equal(lower[0],"hello world"), "string_batch_tolower failed");
+	fail_unless (string_equal(lower[1],""), "string_batch_tolower failed on an empty string");
+	fail_unless (string_equal(lower[2],"abc xyz 123"), "string_batch_tolower failed");
+	fail_unless (strncmp(lower[3],"caf",3)==0 && strlen(lower[3])==strlen(strings[3]), "string_batch_tolower failed on utf-8");
+	fail_unless (string_equal(upper[2],"ABC XYZ 123"), "string_batch_toupper failed");
+}
+END_TEST
+
+START_TEST (test_string_batch_case_invalid)
+{
+	string strings[]={"\xff\xfe abc", "x\xe2\x82", "\xc3\xa9\x80Z"};
+	view *items=string_batch_views(strings,3);
+	string *lower=string_batch_tolower(items,3);
+	string *upper=string_batch_toupper(items,3);
+	fail_unless (string_equal(lower[0],"\xff\xfe abc") && string_equal(upper[0],"\xff\xfe ABC"), "invalid bytes were not kept");
+	fail_unless (string_equal(lower[1],"x\xe2\x82") && string_equal(upper[1],"X\xe2\x82"), "a truncated sequence was not kept");
+	fail_unless (string_equal(lower[2],"\xc3\xa9\x80z"), "a stray continuation byte was not kept");
+}
+END_TEST
+
+START_TEST (test_string_batch_case_size)
+{
+	//the Kelvin sign takes three bytes, and its lowercase, 'k', only one
+	string strings[]={"ABC", "\xe2\x84\xaa and \xe2\x84\xaa", "DEF"};
+	view *items=string_batch_views(strings,3);
+	string *lower;
+	string longer[]={"\xc8\xba\xc8\xba", "ab"};
+	fail_unless (setlocale(LC_CTYPE,"C.UTF-8")!=NULL, "the C.UTF-8 locale is required");
+	lower=string_batch_tolower(items,3);
+	fail_unless (string_equal(lower[0],"abc") && string_equal(lower[2],"def"), "neighbours of a shorter result changed");
+	fail_unless (string_equal(lower[1],"k and k"), "a result of another size failed");
+	fail_unless (lower[2]==lower[1]+strlen(lower[1])+1, "a result of another size was given the size of its input");
+	//U+023A takes two bytes, and its lowercase, U+2C65, three
+	lower=string_batch_tolower(string_batch_views(longer,2),2);
+	setlocale(LC_CTYPE,"C");
+	fail_unless (string_equal(lower[0],"\xe2\xb1\xa5\xe2\xb1\xa5") && string_equal(lower[1],"ab"), "a longer result failed");
+}
+END_TEST
+
+START_TEST (test_string_batch_valid_utf8)
+{
+	string strings[]={"Hello World", "caf\xc3\xa9", "\xe2\x82\xac and \xf0\x9f\x98\x80",
+		"\xc3", "\xc0\xaf", "\xed\xa0\x80", "\xf4\x90\x80\x80", "tail \x80"};
+	bool expected[]={true, true, true, false, false, false, false, false};
+	bool valid[8];
+	int i;
+	string_batch_valid_utf8(string_batch_views(strings,8),8,valid);
+	for(i=0; i<8; i++)
+		fail_unless (valid[i]==expected[i], "string_batch_valid_utf8 failed");
+}
+END_TEST
+
+START_TEST (test_string_batch_trim)
+{
+	string strings[]={"  Hello World \t\n", "   ", "x"};
+	view trimmed[3];
+	string_batch_trim(string_batch_views(strings,3),3,true,true,trimmed);
+	fail_unless (view_equal_string(trimmed[0],"Hello World"), "string_batch_trim failed");
+	fail_unless (trimmed[1].size==0, "string_batch_trim failed on whitespace only");
+	fail_unless (view_equal_string(trimmed[2],"x"), "string_batch_trim failed");
+	string_batch_trim(string_batch_views(strings,1),1,false,true,trimmed);
+	fail_unless (view_equal_string(trimmed[0],"  Hello World"), "string_batch_trim failed on the right only");
+}
+END_TEST
+
+START_TEST (test_string_batch_parallel)
+{
+	size_t i, n=3*STRING_BATCH_PARALLEL_MIN+7;
+	string *strings=(string *)object_new(n*sizeof(string));
+	view *items;
+	string *lower;
+	uint64_t *hashes=(uint64_t *)object_new(n*sizeof(uint64_t));
+	for(i=0; i<n; i++) strings[i]=string_format("Item %zu", i);
+	items=string_batch_views(strings,n);
+	lower=string_batch_tolower(items,n);
+	string_batch_hash(items,n,hashes);
+	for(i=0; i<n; i++)
+	{
+		if(lower[i][0]!='i' || strcmp(lower[i]+1,strings[i]+1)!=0) break;
+		if(hashes[i]!=string_hash(strings[i])) break;
+	}
+	fail_unless (i==n, "large batches failed");
+}
+END_TEST
+
+TEST_HEADER
+	tcase_add_test (tc, test_string_batch_case);
+	tcase_add_test (tc, test_string_batch_case_invalid);
+	tcase_add_test (tc, test_string_batch_case_size);
+	tcase_add_test (tc, test_string_batch_valid_utf8);
+	tcase_add_test (tc, test_string_batch_trim);
+	tcase_add_test (tc, test_string_batch_parallel);
+TEST_FOOTER("STRING_BATCH")
@@ -0,0 +1,89 @@
+/**
+ *
+ * libscriptify
+ *
+ * @author  Erik Poupaert <erik@sankuru.biz>
+ *
+ * @section LICENSE
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU LGPL as
+ * published by the Free Software Foundation; either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * LGPL for more details at: http://www.gnu.org/licenses/lgpl.html
+ *
+ * @section DESCRIPTION
+ *
+ * Unit test for the string intern pool.
+ *
+ */
+#define GC_THREADS
+#include <pthread.h>
+#include <gc/gc.h>
+#include "test.h"
+#include "string_utf8.h"
+
+START_TEST (test_string_intern)
+{
+	string a=string_intern(string_new_copy("field"));
+	string b=string_intern("field");
+	string c=string_intern("other");
+	fail_unless (a==b, "equal strings intern to the same pointer");
+	fail_unless (a!=c, "different strings intern to different pointers");
+	fail_unless (string_equal(a,"field"), "interned copy keeps the content");
+	fail_unless (string_intern_bytes("fieldname",5)==a, "interning bytes");
+	fail_unless (string_intern("")==string_intern_bytes("",0), "interning the empty string");
+}
+END_TEST
+
+START_TEST (test_string_is_interned)
+{
+	string a=string_intern("enum_value");
+	fail_unless (string_is_interned(a), "canonical copy is interned");
+	fail_unless (!string_is_interned(string_new_copy("enum_value")), "other copy is not interned");
+	fail_unless (!string_is_interned(a+1) && !string_is_interned(string_intern("a longer enum value name")+16), "inner pointers are not interned");
+	fail_unless (!string_equal(a,string_intern("enum_valuf")) && string_equal(a,string_new_copy("enum_value")), "string_equal on interned strings");
+}
+END_TEST
+
+START_TEST (test_string_intern_many)
+{
+	int i;
+	string first[2000];
+	for(i=0; i<2000; i++) first[i]=string_intern(string_format("key%d",i));
+	for(i=0; i<2000; i++)
+		fail_unless (string_intern(string_format("key%d",i))==first[i], "stable across table growth");
+}
+END_TEST
+
+static void *intern_worker(void *arg)
+{
+	string *results=(string *)arg;
+	int i;
+	for(i=0; i<500; i++) results[i]=string_intern(string_format("shared%d",i));
+	return NULL;
+}
+
+START_TEST (test_string_intern_threads)
+{
+	pthread_t threads[4];
+	static string results[4][500];
+	int i, j;
+	for(i=0; i<4; i++) pthread_create(&threads[i],NULL,intern_worker,results[i]);
+	for(i=0; i<4; i++) pthread_join(threads[i],NULL);
+	for(i=1; i<4; i++)
+		for(j=0; j<500; j++)
+			fail_unless (results[i][j]==results[0][j], "threads agree on the canonical copy");
+}
+END_TEST
+
+TEST_HEADER
+	tcase_add_test (tc, test_string_intern);
+	tcase_add_test (tc, test_string_is_interned);
+	tcase_add_test (tc, test_string_intern_many);
+	tcase_add_test (tc, test_string_intern_threads);
+TEST_FOOTER("STRING_INTERN")
@@ -0,0 +1,113 @@
+/**
+ *
+ * libscriptify
+ *
+ * @author  Erik Poupaert <erik@sankuru.biz>
+ *
+ * @section LICENSE
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU LGPL as
+ * published by the Free Software Foundation; either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * LGPL for more details at: http://www.gnu.org/licenses/lgpl.html
+ *
+ * @section DESCRIPTION
+ *
+ * Unit test for the thread pool.
+ *
+ */
+#include <string.h>
+#include "test.h"
+#include "threadpool.h"
+
+static void add_one(void *arg)
+{
+	__atomic_add_fetch((long *)arg,1,__ATOMIC_RELAXED);
+}
+
+typedef struct
+{
+	threadpool_group group;
+	long n;
+	long *result;
+} fib_arg;
+
+static void fib_task(void *arg)
+{
+	fib_arg *f=(fib_arg *)arg;
+	if(f->n<2)
+	{
+		*f->result=f->n;
+		return;
+	}
+	long a, b;
+	fib_arg *left=(fib_arg *)object_new(sizeof(fib_arg));
+	fib_arg right;
+	threadpool_group group=threadpool_group_new(f->group->pool);
+	left->group=group;
+	left->n=f->n-1;
+	left->result=&a;
+	right.group=group;
+	right.n=f->n-2;
+	right.result=&b;
+	threadpool_group_spawn(group,fib_task,left);
+	fib_task(&right);
+	threadpool_group_wait(group);
+	*f->result=a+b;
+}
+
+static void square_range(size_t begin, size_t end, void *arg)
+{
+	long *values=(long *)arg;
+	size_t i;
+	for(i=begin; i<end; i++) values[i]=(long)(i*i);
+}
+
+START_TEST (test_threadpool_group)
+{
+	long counter=0;
+	int i;
+	threadpool_group group=threadpool_group_new(threadpool_default());
+	for(i=0; i<10000; i++) threadpool_group_spawn(group,add_one,&counter);
+	threadpool_group_wait(group);
+	fail_unless (counter==10000, "not all tasks ran");
+}
+END_TEST
+
+START_TEST (test_threadpool_fork_join)
+{
+	long result=0;
+	threadpool pool=threadpool_new(3);
+	fib_arg f;
+	f.group=threadpool_group_new(pool);
+	f.n=22;
+	f.result=&result;
+	threadpool_group_spawn(f.group,fib_task,&f);
+	threadpool_group_wait(f.group);
+	fail_unless (result==17711, "recursive fork/join failed");
+	threadpool_stop(pool);
+}
+END_TEST
+
+START_TEST (test_threadpool_for)
+{
+	size_t i, n=1000003;
+	long *values=(long *)object_new(n*sizeof(long));
+	threadpool_for(threadpool_default(),0,n,0,square_range,values);
+	for(i=0; i<n; i++)
+		if(values[i]!=(long)(i*i)) break;
+	fail_unless (i==n, "parallel for missed indexes");
+	threadpool_for(threadpool_default(),5,5,0,square_range,values);
+}
+END_TEST
+
+TEST_HEADER
+	tcase_add_test (tc, test_threadpool_group);
+	tcase_add_test (tc, test_threadpool_fork_join);
+	tcase_add_test (tc, test_threadpool_for);
+TEST_FOOTER("THREADPOOL")
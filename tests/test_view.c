@@ -0,0 +1,51 @@
+/**
+ *
+ * libscriptify
+ *
+ * @author  Erik Poupaert <erik@sankuru.biz>
+ *
+ * @section LICENSE
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU LGPL as
+ * published by the Free Software Foundation; either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * LGPL for more details at: http://www.gnu.org/licenses/lgpl.html
+ *
+ * @section DESCRIPTION
+ *
+ * Unit test for the 'view' data type.
+ *
+ */
+#include "test.h"
+#include "view.h"
+#include "string_utf8.h"
+
+START_TEST (test_view_new)
+{
+	string s="Hello World";
+	view v=view_new(s+6,5);
+	fail_unless (string_equal(view_tostring(v),"World"), "view_tostring failed");
+	fail_unless (view_from_string(s).size==11, "view_from_string failed");
+}
+END_TEST
+
+START_TEST (test_view_equal)
+{
+	string s="Hello World";
+	fail_unless (view_equal(view_new(s,5),view_from_string("Hello")), "view_equal failed");
+	fail_unless (!view_equal(view_new(s,5),view_new(s+6,5)), "view_equal failed");
+	fail_unless (view_equal_string(view_new(s+6,5),"World"), "view_equal_string failed");
+	fail_unless (!view_equal_string(view_new(s+6,5),"Worlds"), "view_equal_string failed");
+	fail_unless (view_hash(view_new(s,5))==string_hash("Hello"), "view_hash failed");
+}
+END_TEST
+
+TEST_HEADER
+	tcase_add_test (tc, test_view_new);
+	tcase_add_test (tc, test_view_equal);
+TEST_FOOTER("VIEW")